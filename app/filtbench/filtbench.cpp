@@ -0,0 +1,195 @@
+/*------------------------------------------------------------------------------
+* filtbench.c : kalman filter update benchmark
+*
+* measure the cost of the measurement update of filter() with the update
+* algorithms selected by setfiltalg() for the state and measurement layouts
+* of the relative (double-differenced) and precise point positioning filters,
+* and check the updated states and covariance against the batch update
+*
+* version : $Revision:$ $Date:$
+* history : 2026/10/18 1.0 new
+*-----------------------------------------------------------------------------*/
+#include <stdarg.h>
+#include "rtklib.h"
+
+#define PROGNAME    "filtbench"         /* program name */
+#define MAXSIZE     16                  /* max number of satellite counts */
+#define MINTIME     0.2                 /* min time of a measurement (s) */
+#define SQR(x)      ((x)*(x))
+
+/* update algorithms and filter layouts --------------------------------------*/
+static const char *algname[]={"std","chol","seq"};
+static const int algopt[]={FILTALG_STD,FILTALG_CHOL,FILTALG_SEQ};
+static const char *layname[]={"rtk","ppp"};
+#define NALG        3
+#define NLAY        2
+
+/* help text -----------------------------------------------------------------*/
+static const char *help[]={
+"",
+" usage: filtbench [option]...",
+"",
+" Measure the cost (us/call) of the measurement update of filter() with the",
+" batch update with LU inverse (std), the cholesky gain with joseph form",
+" covariance (chol) and the sequential scalar updates (seq) for synthetic",
+" filters of a number of satellites: rtk (position + ambiguities, double-",
+" differenced phase and code with correlated R) and ppp (position, clock,",
+" troposphere, ionosphere + ambiguities, undifferenced with diagonal R).",
+" The max differences of the states (m) and the covariance (relative to",
+" the max element) to std are printed.",
+"",
+" -?        print help",
+" -s n[,n...] number of satellites [5,10,20,30,40]",
+" -f nf     number of frequencies [2]",
+""
+};
+/* show message --------------------------------------------------------------*/
+extern int showmsg(const char *format, ...)
+{
+    va_list arg;
+    va_start(arg,format); vfprintf(stderr,format,arg); va_end(arg);
+    fprintf(stderr,"\r");
+    return 0;
+}
+extern void settspan(gtime_t ts, gtime_t te) {}
+extern void settime(gtime_t time) {}
+
+/* print help ----------------------------------------------------------------*/
+static void printhelp(void)
+{
+    int i;
+    for (i=0;i<(int)(sizeof(help)/sizeof(*help));i++) fprintf(stderr,"%s\n",help[i]);
+    exit(0);
+}
+/* uniform random number (-0.5 to 0.5) ---------------------------------------*/
+static double rnd(void)
+{
+    return (double)rand()/RAND_MAX-0.5;
+}
+/* synthetic filter ----------------------------------------------------------
+* rtk: x={pos,amb[f*ns+s]}, v={phase,code} double-differenced to sat 0
+* ppp: x={pos,clk,trop,ion[s],amb[f*ns+s]}, v={phase,code} undifferenced
+*-----------------------------------------------------------------------------*/
+static void genfilt(int lay, int ns, int nf, int *n, int *m, double **x,
+                    double **P, double **H, double **v, double **R)
+{
+    double e[MAXSIZE*8][3],*A,var[2]={SQR(0.003),SQR(0.3)};
+    int i,j,f,t,s,nd=lay==0?ns-1:ns,k;
+
+    *n=lay==0?3+nf*ns:5+ns+nf*ns;
+    *m=2*nf*nd;
+    *x=mat(*n,1); *P=zeros(*n,*n); *H=zeros(*n,*m); *v=mat(*m,1);
+    *R=zeros(*m,*m);
+
+    for (s=0;s<ns;s++) {
+        e[s][0]=rnd(); e[s][1]=rnd(); e[s][2]=0.5+rnd();
+    }
+    for (i=0;i<*n;i++) (*x)[i]=10.0*rnd()+20.0;
+
+    /* covariance of states: A*A'+diag */
+    A=mat(*n,*n);
+    for (i=0;i<*n*(*n);i++) A[i]=rnd();
+    matmul("NT",*n,*n,*n,0.1,A,A,0.0,*P);
+    for (i=0;i<*n;i++) (*P)[i+i*(*n)]+=i<3?1.0:10.0;
+    free(A);
+
+    for (f=k=0;f<nf;f++) for (t=0;t<2;t++) for (s=0;s<nd;s++,k++) {
+        j=lay==0?s+1:s;
+        if (lay==0) {
+            for (i=0;i<3;i++) (*H)[i+k*(*n)]=e[j][i]-e[0][i];
+            if (t==0) {
+                (*H)[3+f*ns+j+k*(*n)]= 0.19;
+                (*H)[3+f*ns  +k*(*n)]=-0.19;
+            }
+            /* double-differenced error correlated by reference satellite */
+            for (i=k-s;i<k-s+nd;i++) (*R)[i+k*(*m)]=var[t];
+            (*R)[k+k*(*m)]+=var[t];
+        }
+        else {
+            for (i=0;i<3;i++) (*H)[i+k*(*n)]=-e[j][i];
+            (*H)[3+k*(*n)]=1.0;
+            (*H)[4+k*(*n)]=1.0/e[j][2];
+            (*H)[5+j+k*(*n)]=t==0?-1.0-f*0.6:1.0+f*0.6;
+            if (t==0) (*H)[5+ns+f*ns+j+k*(*n)]=1.0;
+            (*R)[k+k*(*m)]=var[t]/SQR(e[j][2]);
+        }
+        (*v)[k]=t==0?0.01*rnd():rnd();
+    }
+}
+/* time of filter update (us/call) -------------------------------------------*/
+static double benchfilt(const double *x, const double *P, const double *H,
+                        const double *v, const double *R, int n, int m,
+                        double *xp, double *Pp, int *info)
+{
+    unsigned int tick;
+    double t;
+    int i,nrep=1;
+
+    for (;;nrep*=2) {
+        tick=tickget();
+        for (i=0;i<nrep;i++) {
+            matcpy(xp,x,n,1);
+            matcpy(Pp,P,n,n);
+            *info=filter(xp,Pp,H,v,R,n,m);
+        }
+        if ((t=(tickget()-tick)*1E-3)>=MINTIME) break;
+    }
+    return t/nrep*1E6;
+}
+/* max difference (relative to max element for matrix) ----------------------*/
+static double maxdiff(const double *A, const double *B, int n, int m)
+{
+    double d=0.0,r=0.0;
+    int i;
+
+    for (i=0;i<n*m;i++) {
+        if (fabs(A[i]-B[i])>d) d=fabs(A[i]-B[i]);
+        if (fabs(B[i])>r) r=fabs(B[i]);
+    }
+    return m>1&&r>0.0?d/r:d;
+}
+/* filtbench main ------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    double *x,*P,*H,*v,*R,*xp,*Pp,*xs,*Ps,t,dx,dP;
+    int i,j,l,n,m,nf=2,nsize=5,size[MAXSIZE]={5,10,20,30,40},info;
+    char *p,*q;
+
+    for (i=1;i<argc;i++) {
+        if (!strcmp(argv[i],"-s")&&i+1<argc) {
+            for (p=argv[++i],nsize=0;p&&nsize<MAXSIZE;p=q?q+1:NULL) {
+                if ((q=strchr(p,','))) *q='\0';
+                if ((n=atoi(p))>1&&n<=MAXSIZE*8) size[nsize++]=n;
+            }
+        }
+        else if (!strcmp(argv[i],"-f")&&i+1<argc) nf=atoi(argv[++i]);
+        else printhelp();
+    }
+    if (nf<1) nf=1;
+
+    printf("%% %-4s %4s %5s %5s %5s %12s %10s %10s\n","lay","ns","n","m","alg",
+           "us/call","dx(m)","dP");
+
+    for (l=0;l<NLAY;l++) for (i=0;i<nsize;i++) {
+        srand(size[i]);
+        genfilt(l,size[i],nf,&n,&m,&x,&P,&H,&v,&R);
+        xp=mat(n,1); Pp=mat(n,n); xs=mat(n,1); Ps=mat(n,n);
+
+        for (j=0;j<NALG;j++) {
+            setfiltalg(algopt[j]);
+            t=benchfilt(x,P,H,v,R,n,m,xp,Pp,&info);
+            if (j==0) {
+                matcpy(xs,xp,n,1); matcpy(Ps,Pp,n,n);
+            }
+            dx=maxdiff(xp,xs,n,1);
+            dP=maxdiff(Pp,Ps,n,n);
+            printf("  %-4s %4d %5d %5d %5s %12.2f %10.2E %10.2E%s\n",layname[l],
+                   size[i],n,m,algname[j],t,dx,dP,
+                   info?" error":"");
+        }
+        setfiltalg(FILTALG_STD);
+        free(x); free(P); free(H); free(v); free(R);
+        free(xp); free(Pp); free(xs); free(Ps);
+    }
+    return 0;
+}
@@ -0,0 +1,383 @@
+/*------------------------------------------------------------------------------
+* ionbench.c : ionosphere model benchmark and cross-comparison
+*
+* evaluate the broadcast and grid ionosphere models of ionocorr() over global
+* grids of receiver positions, satellite geometries and epochs, report the
+* cost per evaluation and the scaling with the number of threads and output
+* the difference maps of the models against IONEX
+*
+* version : $Revision:$ $Date:$
+* history : 2026/10/18 1.0 new
+*-----------------------------------------------------------------------------*/
+#include <stdarg.h>
+#include "rtklib.h"
+
+#define PROGNAME    "ionbench"          /* program name */
+#define MAXFILE     16                  /* max number of input files */
+#define SQR(x)      ((x)*(x))
+#define MAXTHRD     8                   /* max number of thread counts */
+#define HSAT        21528E3             /* satellite height (MEO) (m) */
+#define TECU2M      (40.28E16/FREQ1_CMP/FREQ1_CMP) /* tecu->B1I iono (m) */
+
+/* ionosphere models ---------------------------------------------------------*/
+static const char *modname[]={"klob","bdsk8","bdssh9","nequick","ionex"};
+static const int modopt[]={
+    IONOOPT_BRDC,IONOOPT_BDSK8,IONOOPT_BDSSH9,IONOOPT_GALION,IONOOPT_TEC
+};
+#define NMOD        ((int)(sizeof(modopt)/sizeof(*modopt)))
+#define IMOD_NQ     3                   /* index of NeQuick-G model */
+#define IMOD_TEC    4                   /* index of IONEX model */
+
+/* help text -----------------------------------------------------------------*/
+static const char *help[]={
+"",
+" usage: ionbench [option]... file file [...]",
+"",
+" Evaluate the ionosphere models (Klobuchar, BDS Klobuchar-8, BDSSH9/BDGIM,",
+" NeQuick-G and IONEX) over a grid of receiver positions, satellite",
+" geometries (azimuth/elevation) and epochs with a number of threads, and",
+" print the cost (ns/evaluation), the throughput (evaluation/s) and the",
+" speedup to one thread of each model. The input files are RINEX NAV files",
+" with the broadcast coefficients. The delays of all models are converted",
+" to B1I by ionocorr(). With -x and -o, the mean and rms differences of the",
+" models to IONEX (TECU) are output for each receiver position.",
+" With -nq, the fast NeQuick-G STEC integration mode is compared to the",
+" reference integration instead over the same grids with the Galileo",
+" coefficients of the RINEX NAV files (max/rms error in TECU, cost per",
+" satellite and speedup, see ionmodel_nequick_bench()).",
+"",
+" -?        print help",
+" -ts ds ts start day/time (ds=y/m/d ts=h:m:s) [required]",
+" -te de te end day/time   (de=y/m/d te=h:m:s) [start + 1 day]",
+" -ti tint  time interval (sec) [3600]",
+" -r dlat dlon receiver grid spacing (deg) [10 20]",
+" -g del daz satellite geometry spacing, elevation from 10 deg (deg) [15 45]",
+" -m model[,model...] models (klob,bdsk8,bdssh9,nequick,ionex) [all]",
+" -t n[,n...] number of threads (0:number of cpus) [1,2,4,0]",
+" -x file   IONEX file (wild-card * is expanded) [off]",
+" -o file   output file of difference maps to IONEX [off]",
+" -nq mode  compare NeQuick-G fast mode (1:fast,2:fast+profile grid) to",
+"           reference integration [off]",
+""
+};
+/* benchmark type ------------------------------------------------------------*/
+typedef struct {
+    const nav_t *nav;   /* navigation data */
+    prcopt_t opt;       /* processing options */
+    int imod;           /* model index */
+    int sat;            /* satellite number of ionospheric factor */
+    gtime_t ts;         /* start time */
+    double ti;          /* time interval (s) */
+    int nr,ng;          /* number of receivers/geometries */
+    const double *pos;  /* receiver positions {lat,lon,h} pos[(0:2)+i*3] */
+    const double *azel; /* geometries {az,el} azel[(0:1)+i*2] */
+    double *ion;        /* delays ion[k+j*ng+i*nr*ng] (epoch i,rcv j,geom k) */
+    int *stat;          /* status */
+} bench_t;
+
+/* show message --------------------------------------------------------------*/
+extern int showmsg(const char *format, ...)
+{
+    va_list arg;
+    va_start(arg,format); vfprintf(stderr,format,arg); va_end(arg);
+    fprintf(stderr,"\r");
+    return 0;
+}
+extern void settspan(gtime_t ts, gtime_t te) {}
+extern void settime(gtime_t time) {}
+
+/* print help ----------------------------------------------------------------*/
+static void printhelp(void)
+{
+    int i;
+    for (i=0;i<(int)(sizeof(help)/sizeof(*help));i++) fprintf(stderr,"%s\n",help[i]);
+    exit(0);
+}
+/* satellite position of a geometry ------------------------------------------*/
+static void geomsat(const double *pos, const double *azel, double *rs)
+{
+    double rr[3],enu[3],e[3],b,c,rho;
+    
+    pos2ecef(pos,rr);
+    enu[0]=sin(azel[0])*cos(azel[1]);
+    enu[1]=cos(azel[0])*cos(azel[1]);
+    enu[2]=sin(azel[1]);
+    enu2ecef(pos,enu,e);
+    
+    /* range to the sphere of satellite height: |rr+rho*e|=RE_WGS84+HSAT */
+    b=dot(rr,e,3);
+    c=dot(rr,rr,3)-SQR(RE_WGS84+HSAT);
+    rho=-b+sqrt(b*b-c);
+    
+    rs[0]=rr[0]+rho*e[0];
+    rs[1]=rr[1]+rho*e[1];
+    rs[2]=rr[2]+rho*e[2];
+}
+/* evaluate a model for an epoch ---------------------------------------------*/
+static void benchepoch(int i, void *arg)
+{
+    bench_t *b=(bench_t *)arg;
+    gtime_t time=timeadd(b->ts,b->ti*i);
+    double rs[3],var;
+    int j,k,m;
+    
+    for (j=0;j<b->nr;j++) for (k=0;k<b->ng;k++) {
+        m=k+j*b->ng+i*b->nr*b->ng;
+        geomsat(b->pos+j*3,b->azel+k*2,rs);
+        b->stat[m]=ionocorr(b->opt,time,b->nav,b->sat,b->pos+j*3,rs,
+                            b->azel+k*2,modopt[b->imod],b->ion+m,&var);
+    }
+}
+/* cost of satellite positions of geometries ---------------------------------*/
+static void benchgeom(int i, void *arg)
+{
+    bench_t *b=(bench_t *)arg;
+    double rs[3];
+    int j,k,m;
+    
+    for (j=0;j<b->nr;j++) for (k=0;k<b->ng;k++) {
+        m=k+j*b->ng+i*b->nr*b->ng;
+        geomsat(b->pos+j*3,b->azel+k*2,rs);
+        b->ion[m]=rs[0];
+    }
+}
+/* model available by navigation data ----------------------------------------*/
+static int modvalid(const nav_t *nav, int imod)
+{
+    switch (modopt[imod]) {
+        case IONOOPT_BRDC  : return norm(nav->ion_gps,8)>0.0;
+        case IONOOPT_BDSK8 : return nav->ion_bdsk9->bds_ion.nk8>0;
+        case IONOOPT_BDSSH9: return nav->ion_bdsk9->bds_ion.nsh9>0;
+        case IONOOPT_GALION: return norm(nav->ion_gal,3)>0.0;
+        case IONOOPT_TEC   : return nav->nt>0;
+    }
+    return 0;
+}
+/* wall time of a benchmark run (s) ------------------------------------------*/
+static double benchrun(bench_t *b, int ne, int nthread, parfunc_t *func)
+{
+    unsigned int tick=tickget();
+    
+    parfor(ne,nthread,func,b);
+    
+    return (tickget()-tick)*1E-3;
+}
+/* compare NeQuick-G fast mode to reference integration --------------------*/
+static void benchnq(const bench_t *b, int ne, int mode)
+{
+    gtime_t time;
+    double *sat,rs[3],pos[3],ep[6],stat[6],emax=0.0,esum=0.0,eest=0.0;
+    double tref=0.0,tfast=0.0;
+    int i,j,k,n,nc=0;
+    
+    sat=mat(3,b->ng);
+    
+    for (i=0;i<ne;i++) {
+        time=timeadd(b->ts,b->ti*i);
+        time2epoch(gpst2utc(time),ep);
+        
+        for (j=0;j<b->nr;j++) {
+            for (k=0;k<b->ng;k++) {
+                geomsat(b->pos+j*3,b->azel+k*2,rs);
+                ecef2pos(rs,pos);
+                sat[k*3]=pos[1]*R2D; sat[1+k*3]=pos[0]*R2D; sat[2+k*3]=pos[2];
+            }
+            n=ionmodel_nequick_bench(b->nav->ion_gal,(int)ep[1],
+                                     ep[3]+ep[4]/60.0+ep[5]/3600.0,
+                                     b->pos[1+j*3]*R2D,b->pos[j*3]*R2D,
+                                     b->pos[2+j*3],sat,b->ng,mode,1,stat);
+            if (n<=0) continue;
+            if (stat[0]>emax) emax=stat[0];
+            if (stat[2]>eest) eest=stat[2];
+            esum+=SQR(stat[1])*n;
+            tref +=stat[3]*b->ng;
+            tfast+=stat[4]*b->ng;
+            nc+=n;
+        }
+    }
+    free(sat);
+    
+    printf("%% %-8s %5s %10s %10s %10s %10s %10s %8s\n","model","mode",
+           "max(TECU)","rms(TECU)","est(TECU)","ref(ms)","fast(ms)","speedup");
+    printf("  %-8s %5d %10.3f %10.3f %10.3f %10.4f %10.4f %8.2f\n","nequick",
+           mode,emax,nc>0?sqrt(esum/nc):0.0,eest,nc>0?tref/nc:0.0,
+           nc>0?tfast/nc:0.0,tfast>0.0?tref/tfast:0.0);
+}
+/* output difference maps to IONEX -------------------------------------------*/
+static void outdiff(FILE *fp, const char *mod, const bench_t *b, int ne,
+                    const double *ion, const int *stat, const double *tec,
+                    const int *stec)
+{
+    double d,sum,sum2;
+    int i,j,k,m,n;
+    
+    for (j=0;j<b->nr;j++) {
+        sum=sum2=0.0;
+        for (i=n=0;i<ne;i++) for (k=0;k<b->ng;k++) {
+            m=k+j*b->ng+i*b->nr*b->ng;
+            if (!stat[m]||!stec[m]) continue;
+            d=(ion[m]-tec[m])/TECU2M;
+            sum+=d; sum2+=d*d; n++;
+        }
+        if (n<=0) continue;
+        fprintf(fp,"%-8s %7.2f %7.2f %9.3f %9.3f %7d\n",mod,b->pos[j*3]*R2D,
+                b->pos[1+j*3]*R2D,sum/n,sqrt(sum2/n),n);
+    }
+}
+/* ionbench main -------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    nav_t nav;
+    bench_t b={0};
+    FILE *fp=NULL;
+    gtime_t te={0};
+    double es[]={2000,1,1,0,0,0},ee[]={2000,1,1,0,0,0},tint=3600.0;
+    double dlat=10.0,dlon=20.0,del=15.0,daz=45.0,lat,lon,el,az;
+    double *pos,*azel,*ion[NMOD]={0},t,t1,tg,neval;
+    int i,j,n=0,ne,nthd=4,thd[MAXTHRD]={1,2,4,0},mods[NMOD]={0},nsel=0,nq=0;
+    int *stat[NMOD]={0};
+    const char *ionex="",*outfile="";
+    char *infile[MAXFILE],*p,*q;
+    
+    for (i=1;i<argc;i++) {
+        if (!strcmp(argv[i],"-ts")&&i+2<argc) {
+            sscanf(argv[++i],"%lf/%lf/%lf",es,es+1,es+2);
+            sscanf(argv[++i],"%lf:%lf:%lf",es+3,es+4,es+5);
+            b.ts=epoch2time(es);
+        }
+        else if (!strcmp(argv[i],"-te")&&i+2<argc) {
+            sscanf(argv[++i],"%lf/%lf/%lf",ee,ee+1,ee+2);
+            sscanf(argv[++i],"%lf:%lf:%lf",ee+3,ee+4,ee+5);
+            te=epoch2time(ee);
+        }
+        else if (!strcmp(argv[i],"-ti")&&i+1<argc) tint=atof(argv[++i]);
+        else if (!strcmp(argv[i],"-r")&&i+2<argc) {
+            dlat=atof(argv[++i]);
+            dlon=atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i],"-g")&&i+2<argc) {
+            del=atof(argv[++i]);
+            daz=atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i],"-m")&&i+1<argc) {
+            for (p=argv[++i];p;p=q?q+1:NULL) {
+                if ((q=strchr(p,','))) *q='\0';
+                for (j=0;j<NMOD;j++) if (!strcmp(p,modname[j])) {mods[j]=1; nsel++;}
+            }
+        }
+        else if (!strcmp(argv[i],"-t")&&i+1<argc) {
+            for (p=argv[++i],nthd=0;p&&nthd<MAXTHRD;p=q?q+1:NULL) {
+                if ((q=strchr(p,','))) *q='\0';
+                thd[nthd++]=atoi(p);
+            }
+        }
+        else if (!strcmp(argv[i],"-x")&&i+1<argc) ionex=argv[++i];
+        else if (!strcmp(argv[i],"-o")&&i+1<argc) outfile=argv[++i];
+        else if (!strcmp(argv[i],"-nq")&&i+1<argc) nq=atoi(argv[++i]);
+        else if (*argv[i]=='-') printhelp();
+        else if (n<MAXFILE) infile[n++]=argv[i];
+    }
+    if (b.ts.time==0||dlat<=0.0||dlon<=0.0||del<=0.0||daz<=0.0||tint<=0.0) {
+        printhelp();
+    }
+    if (te.time==0) te=timeadd(b.ts,86400.0-tint);
+    if (!nsel) for (j=0;j<NMOD;j++) mods[j]=1;
+    
+    /* read navigation and ionex data */
+    init_nav(&nav);
+    for (i=0;i<n;i++) {
+        readrnx(infile[i],1,"",NULL,&nav,NULL);
+    }
+    if (*ionex) readtec(ionex,&nav,1);
+    
+    /* receiver positions and satellite geometries */
+    b.nr=(int)floor(160.0/dlat+1E-6)+1;
+    b.nr*=(int)floor(360.0/dlon-1E-6)+1;
+    b.ng=(int)floor(80.0/del+1E-6)+1;
+    b.ng*=(int)floor(360.0/daz-1E-6)+1;
+    pos=mat(3,b.nr); azel=mat(2,b.ng);
+    
+    for (lat=-80.0,b.nr=0;lat<=80.0+1E-6;lat+=dlat) {
+        for (lon=-180.0;lon<180.0-1E-6;lon+=dlon,b.nr++) {
+            pos[b.nr*3]=lat*D2R; pos[1+b.nr*3]=lon*D2R; pos[2+b.nr*3]=0.0;
+        }
+    }
+    for (el=10.0,b.ng=0;el<=90.0+1E-6;el+=del) {
+        for (az=0.0;az<360.0-1E-6;az+=daz,b.ng++) {
+            azel[b.ng*2]=az*D2R; azel[1+b.ng*2]=el*D2R;
+        }
+    }
+    ne=(int)floor(timediff(te,b.ts)/tint+1E-6)+1;
+    neval=(double)ne*b.nr*b.ng;
+    
+    b.nav=&nav;
+    b.opt=prcopt_default;
+    b.sat=satno(SYS_CMP,1);
+    b.ti=tint;
+    b.pos=pos;
+    b.azel=azel;
+    
+    printf("%% epochs=%d receivers=%d geometries=%d evaluations=%.0f cpus=%d\n",
+           ne,b.nr,b.ng,neval,ncpuget());
+    
+    /* compare NeQuick-G fast mode to reference integration */
+    if (nq) {
+        if (!modvalid(&nav,IMOD_NQ)) {
+            printf("%% %-8s no model data\n",modname[IMOD_NQ]);
+        }
+        else benchnq(&b,ne,nq);
+        free(pos); free(azel);
+        return 0;
+    }
+    printf("%% %-8s %7s %12s %14s %8s\n","model","threads","ns/eval",
+           "eval/s","speedup");
+    
+    /* satellite positions of geometries (included in the model costs) */
+    b.ion=mat(b.nr*b.ng,ne); b.stat=imat(b.nr*b.ng,ne);
+    tg=benchrun(&b,ne,1,benchgeom);
+    free(b.ion); free(b.stat);
+    printf("%% %-8s %7d %12.1f\n","geometry",1,tg*1E9/neval);
+    
+    for (j=0;j<NMOD;j++) {
+        if (!mods[j]) continue;
+        if (!modvalid(&nav,j)) {
+            printf("%% %-8s no model data\n",modname[j]);
+            continue;
+        }
+        ion[j]=mat(b.nr*b.ng,ne); stat[j]=imat(b.nr*b.ng,ne);
+        b.imod=j; b.ion=ion[j]; b.stat=stat[j];
+        
+        /* one thread baseline of the speedup if not the first entry */
+        t1=thd[0]==1?0.0:benchrun(&b,ne,1,benchepoch);
+        
+        for (i=0;i<nthd;i++) {
+            t=benchrun(&b,ne,thd[i],benchepoch);
+            if (i==0&&thd[0]==1) t1=t;
+            printf("  %-8s %7d %12.1f %14.0f %8.2f\n",modname[j],
+                   thd[i]>0?thd[i]:ncpuget(),t*1E9/neval,t>0.0?neval/t:0.0,
+                   t>0.0?t1/t:0.0);
+        }
+    }
+    /* difference maps to ionex */
+    if (*outfile&&ion[IMOD_TEC]) {
+        if (!(fp=fopen(outfile,"w"))) {
+            fprintf(stderr,"file open error: %s\n",outfile);
+        }
+        else {
+            fprintf(fp,"%% %-6s %7s %7s %9s %9s %7s\n","model","lat(deg)",
+                    "lon(deg)","mean(TECU)","rms(TECU)","n");
+            for (j=0;j<NMOD;j++) {
+                if (j==IMOD_TEC||!ion[j]) continue;
+                outdiff(fp,modname[j],&b,ne,ion[j],stat[j],ion[IMOD_TEC],
+                        stat[IMOD_TEC]);
+            }
+            fclose(fp);
+        }
+    }
+    else if (*outfile) {
+        fprintf(stderr,"no ionex data for difference maps\n");
+    }
+    for (j=0;j<NMOD;j++) {free(ion[j]); free(stat[j]);}
+    free(pos); free(azel);
+    return 0;
+}
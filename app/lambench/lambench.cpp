@@ -0,0 +1,342 @@
+/*------------------------------------------------------------------------------
+* lambench.c : integer ambiguity resolution benchmark
+*
+* measure the cost of lambda() with the reference implementation allocating the
+* work matrices and check the fixed solutions, and measure the fix rate and the
+* cost of the partial ambiguity resolution by lambda_par() with the serial and
+* the parallel evaluation of the subsets for synthetic float ambiguities
+*
+* version : $Revision:$ $Date:$
+* history : 2026/10/18 1.0 new
+*-----------------------------------------------------------------------------*/
+#include <stdarg.h>
+#include "rtklib.h"
+
+#define PROGNAME    "lambench"          /* program name */
+#define MAXSIZE     32                  /* max number of sizes */
+#define MINTIME     0.2                 /* min time of a measurement (s) */
+#define LOOPMAX     10000               /* maximum count of search loop */
+
+#define SQR(x)      ((x)*(x))
+#define SGN(x)      ((x)<=0.0?-1.0:1.0)
+#define ROUND(x)    (floor((x)+0.5))
+#define SWAP(x,y)   do {double tmp_; tmp_=x; x=y; y=tmp_;} while (0)
+
+/* help text -----------------------------------------------------------------*/
+static const char *help[]={
+"",
+" usage: lambench [option]...",
+"",
+" Measure the cost (us/call) of the integer least square estimation of n",
+" synthetic float ambiguities by the reference lambda/mlambda allocating the",
+" work matrices (ref) and lambda() (new), and print the max differences of",
+" the fixed solutions and the residuals to the reference. Then measure the",
+" rate of the fix by the ratio-test for the full set (lambda) and the",
+" partial ambiguity resolution (lambda_par) with nw weak ambiguities, the",
+" mean number of fixed ambiguities, the rate of wrong fix and the cost with",
+" the serial (1 thread) and the parallel evaluation of the subsets.",
+"",
+" -?        print help",
+" -n n[,n...] number of ambiguities [5,10,20,30,40,60]",
+" -w nw     number of weak ambiguities [3]",
+" -r ratio  threshold of ratio-test [3.0]",
+" -p p0     min success rate of bootstrapping [0.999]",
+" -t nthread number of threads of parallel evaluation (0:cpus) [0]",
+" -k ntrial number of trials [200]",
+""
+};
+/* show message --------------------------------------------------------------*/
+extern int showmsg(const char *format, ...)
+{
+    va_list arg;
+    va_start(arg,format); vfprintf(stderr,format,arg); va_end(arg);
+    fprintf(stderr,"\r");
+    return 0;
+}
+extern void settspan(gtime_t ts, gtime_t te) {}
+extern void settime(gtime_t time) {}
+
+/* print help ----------------------------------------------------------------*/
+static void printhelp(void)
+{
+    int i;
+    for (i=0;i<(int)(sizeof(help)/sizeof(*help));i++) fprintf(stderr,"%s\n",help[i]);
+    exit(0);
+}
+/* reference LD factorization ------------------------------------------------*/
+static int refLD(int n, const double *Q, double *L, double *D)
+{
+    int i,j,k,info=0;
+    double a,*A=mat(n,n);
+
+    memcpy(A,Q,sizeof(double)*n*n);
+    for (i=n-1;i>=0;i--) {
+        if ((D[i]=A[i+i*n])<=0.0) {info=-1; break;}
+        a=sqrt(D[i]);
+        for (j=0;j<=i;j++) L[i+j*n]=A[i+j*n]/a;
+        for (j=0;j<=i-1;j++) for (k=0;k<=j;k++) A[j+k*n]-=L[i+k*n]*L[i+j*n];
+        for (j=0;j<=i;j++) L[i+j*n]/=L[i+i*n];
+    }
+    free(A);
+    return info;
+}
+/* reference integer gauss transformation ------------------------------------*/
+static void refgauss(int n, double *L, double *Z, int i, int j)
+{
+    int k,mu;
+
+    if ((mu=(int)ROUND(L[i+j*n]))!=0) {
+        for (k=i;k<n;k++) L[k+n*j]-=(double)mu*L[k+i*n];
+        for (k=0;k<n;k++) Z[k+n*j]-=(double)mu*Z[k+i*n];
+    }
+}
+/* reference permutations ----------------------------------------------------*/
+static void refperm(int n, double *L, double *D, int j, double del, double *Z)
+{
+    int k;
+    double eta,lam,a0,a1;
+
+    eta=D[j]/del;
+    lam=D[j+1]*L[j+1+j*n]/del;
+    D[j]=eta*D[j+1]; D[j+1]=del;
+    for (k=0;k<=j-1;k++) {
+        a0=L[j+k*n]; a1=L[j+1+k*n];
+        L[j+k*n]=-L[j+1+j*n]*a0+a1;
+        L[j+1+k*n]=eta*a0+lam*a1;
+    }
+    L[j+1+j*n]=lam;
+    for (k=j+2;k<n;k++) SWAP(L[k+j*n],L[k+(j+1)*n]);
+    for (k=0;k<n;k++) SWAP(Z[k+j*n],Z[k+(j+1)*n]);
+}
+/* reference lambda reduction ------------------------------------------------*/
+static void refreduction(int n, double *L, double *D, double *Z)
+{
+    int i,j,k;
+    double del;
+
+    j=n-2; k=n-2;
+    while (j>=0) {
+        if (j<=k) for (i=j+1;i<n;i++) refgauss(n,L,Z,i,j);
+        del=D[j]+L[j+1+j*n]*L[j+1+j*n]*D[j+1];
+        if (del+1E-6<D[j+1]) {
+            refperm(n,L,D,j,del,Z);
+            k=j; j=n-2;
+        }
+        else j--;
+    }
+}
+/* reference mlambda search --------------------------------------------------*/
+static int refsearch(int n, int m, const double *L, const double *D,
+                     const double *zs, double *zn, double *s)
+{
+    int i,j,k,c,nn=0,imax=0;
+    double newdist,maxdist=1E99,y;
+    double *S=zeros(n,n),*dist=mat(n,1),*zb=mat(n,1),*z=mat(n,1),*step=mat(n,1);
+
+    k=n-1; dist[k]=0.0;
+    zb[k]=zs[k];
+    z[k]=ROUND(zb[k]); y=zb[k]-z[k]; step[k]=SGN(y);
+    for (c=0;c<LOOPMAX;c++) {
+        newdist=dist[k]+y*y/D[k];
+        if (newdist<maxdist) {
+            if (k!=0) {
+                dist[--k]=newdist;
+                for (i=0;i<=k;i++)
+                    S[k+i*n]=S[k+1+i*n]+(z[k+1]-zb[k+1])*L[k+1+i*n];
+                zb[k]=zs[k]+S[k+k*n];
+                z[k]=ROUND(zb[k]); y=zb[k]-z[k]; step[k]=SGN(y);
+            }
+            else {
+                if (nn<m) {
+                    if (nn==0||newdist>s[imax]) imax=nn;
+                    for (i=0;i<n;i++) zn[i+nn*n]=z[i];
+                    s[nn++]=newdist;
+                }
+                else {
+                    if (newdist<s[imax]) {
+                        for (i=0;i<n;i++) zn[i+imax*n]=z[i];
+                        s[imax]=newdist;
+                        for (i=imax=0;i<m;i++) if (s[imax]<s[i]) imax=i;
+                    }
+                    maxdist=s[imax];
+                }
+                z[0]+=step[0]; y=zb[0]-z[0]; step[0]=-step[0]-SGN(step[0]);
+            }
+        }
+        else {
+            if (k==n-1) break;
+            else {
+                k++;
+                z[k]+=step[k]; y=zb[k]-z[k]; step[k]=-step[k]-SGN(step[k]);
+            }
+        }
+    }
+    for (i=0;i<m-1;i++) {
+        for (j=i+1;j<m;j++) {
+            if (s[i]<s[j]) continue;
+            SWAP(s[i],s[j]);
+            for (k=0;k<n;k++) SWAP(zn[k+i*n],zn[k+j*n]);
+        }
+    }
+    free(S); free(dist); free(zb); free(z); free(step);
+    return c>=LOOPMAX?-1:0;
+}
+/* reference lambda/mlambda --------------------------------------------------*/
+static int reflambda(int n, int m, const double *a, const double *Q, double *F,
+                     double *s)
+{
+    int info;
+    double *L,*D,*Z,*z,*E;
+
+    L=zeros(n,n); D=mat(n,1); Z=eye(n); z=mat(n,1); E=mat(n,m);
+    if (!(info=refLD(n,Q,L,D))) {
+        refreduction(n,L,D,Z);
+        matmul("TN",n,1,n,1.0,Z,a,0.0,z);
+        if (!(info=refsearch(n,m,L,D,z,E,s))) {
+            info=solve("T",Z,E,n,m,F);
+        }
+    }
+    free(L); free(D); free(Z); free(z); free(E);
+    return info;
+}
+/* gaussian random number ----------------------------------------------------*/
+static double randn(void)
+{
+    double u1=(rand()+1.0)/(RAND_MAX+2.0),u2=(rand()+1.0)/(RAND_MAX+2.0);
+    return sqrt(-2.0*log(u1))*cos(2.0*PI*u2);
+}
+/* synthetic float ambiguities -------------------------------------------------
+* Q=G*G'*sg^2+Qd, Qd(i,i)=v(i), Qd(i,j)=sqrt(v(i)*v(j))/2 (common reference)
+* the last nw ambiguities are weak (rising satellites)
+*-----------------------------------------------------------------------------*/
+static void genamb(int n, int nw, double *a, double *Q, double *z)
+{
+    const double sg=0.1;
+    double G[3*256],v[256],e[3],e0;
+    int i,j,k;
+
+    for (i=0;i<n;i++) {
+        for (k=0;k<3;k++) G[i+k*n]=2.0*rand()/RAND_MAX-1.0;
+        v[i]=i<n-nw?SQR(0.02):SQR(0.3);
+        z[i]=floor(200.0*rand()/RAND_MAX-100.0);
+    }
+    for (i=0;i<n;i++) for (j=0;j<n;j++) {
+        for (k=0,Q[i+j*n]=0.0;k<3;k++) Q[i+j*n]+=G[i+k*n]*G[j+k*n]*sg*sg;
+        Q[i+j*n]+=i==j?v[i]:sqrt(v[i]*v[j])/2.0;
+    }
+    for (k=0;k<3;k++) e[k]=randn()*sg;
+    e0=randn();
+    for (i=0;i<n;i++) {
+        a[i]=z[i]+G[i]*e[0]+G[i+n]*e[1]+G[i+2*n]*e[2];
+        a[i]+=sqrt(v[i]/2.0)*(randn()+e0);
+    }
+}
+/* lambench main -------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    unsigned int tick;
+    double *a,*Q,*z,*F,*R,s[2],r[2],t[3],df,ds,thres=3.0,p0=0.999;
+    int i,j,k,n,nsize=6,size[MAXSIZE]={5,10,20,30,40,60},nw=3,nthread=0;
+    int ntrial=200,nrep,*fix,*ord,*o,nok[2],nbad,nsum,l,m;
+    char *p,*q;
+
+    for (i=1;i<argc;i++) {
+        if (!strcmp(argv[i],"-n")&&i+1<argc) {
+            for (p=argv[++i],nsize=0;p&&nsize<MAXSIZE;p=q?q+1:NULL) {
+                if ((q=strchr(p,','))) *q='\0';
+                if ((n=atoi(p))>0&&n<=256) size[nsize++]=n;
+            }
+        }
+        else if (!strcmp(argv[i],"-w")&&i+1<argc) nw=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"-r")&&i+1<argc) thres=atof(argv[++i]);
+        else if (!strcmp(argv[i],"-p")&&i+1<argc) p0=atof(argv[++i]);
+        else if (!strcmp(argv[i],"-t")&&i+1<argc) nthread=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"-k")&&i+1<argc) ntrial=atoi(argv[++i]);
+        else printhelp();
+    }
+    printf("%% %5s %12s %12s %10s %10s\n","n","ref(us)","new(us)","maxdiffF",
+           "maxdiffs");
+
+    for (i=0;i<nsize;i++) {
+        n=size[i];
+        a=mat(n,ntrial); Q=mat(n*n,ntrial); z=mat(n,ntrial); F=mat(n,2);
+        R=mat(n,2);
+        srand(n);
+        for (k=0;k<ntrial;k++) genamb(n,0,a+k*n,Q+k*n*n,z+k*n);
+
+        /* cost and differences of lambda() to reference */
+        df=ds=0.0;
+        for (k=0;k<ntrial;k++) {
+            if (reflambda(n,2,a+k*n,Q+k*n*n,R,r)||lambda(n,2,a+k*n,Q+k*n*n,F,s)) {
+                continue;
+            }
+            for (j=0;j<2*n;j++) if (fabs(F[j]-R[j])>df) df=fabs(F[j]-R[j]);
+            for (j=0;j<2;j++) if (fabs(s[j]-r[j])/r[j]>ds) ds=fabs(s[j]-r[j])/r[j];
+        }
+        for (j=0;j<2;j++) {
+            for (nrep=1;;nrep*=2) {
+                tick=tickget();
+                for (k=0;k<nrep*ntrial;k++) {
+                    if (j==0) reflambda(n,2,a+k%ntrial*n,Q+k%ntrial*n*n,R,r);
+                    else lambda(n,2,a+k%ntrial*n,Q+k%ntrial*n*n,F,s);
+                }
+                if ((t[j]=(tickget()-tick)*1E-3)>=MINTIME) break;
+            }
+            t[j]=t[j]/nrep/ntrial*1E6;
+        }
+        printf("  %5d %12.2f %12.2f %10.2E %10.2E\n",n,t[0],t[1],df,ds);
+        free(a); free(Q); free(z); free(F); free(R);
+    }
+    printf("\n%% %5s %3s %9s %9s %9s %9s %12s %12s\n","n","nw","full(%)",
+           "par(%)","nfix","wrong(%)","par1(us)","parN(us)");
+
+    for (i=0;i<nsize;i++) {
+        n=size[i];
+        if (n<=nw) continue;
+        a=mat(n,ntrial); Q=mat(n*n,ntrial); z=mat(n,ntrial); F=mat(n,2);
+        fix=imat(n,1); ord=imat(n,ntrial);
+        srand(n);
+        for (k=0;k<ntrial;k++) {
+            genamb(n,nw,a+k*n,Q+k*n*n,z+k*n);
+
+            /* order of priority by variance */
+            for (j=0,o=ord+k*n;j<n;j++) {
+                for (l=j;l>0&&Q[o[l-1]*(n+1)+k*n*n]>Q[j*(n+1)+k*n*n];l--) {
+                    o[l]=o[l-1];
+                }
+                o[l]=j;
+            }
+        }
+
+        /* fix rate of full set and partial ambiguity resolution */
+        nok[0]=nok[1]=nbad=nsum=0;
+        for (k=0;k<ntrial;k++) {
+            if (!lambda(n,2,a+k*n,Q+k*n*n,F,s)&&(s[0]<=0.0||s[1]/s[0]>=thres)) {
+                nok[0]++;
+            }
+            if ((m=lambda_par(n,2,a+k*n,Q+k*n*n,ord+k*n,4,p0,thres,1,F,s,
+                              fix))>0) {
+                nok[1]++; nsum+=m;
+                for (j=0;j<n;j++) if (fix[j]&&F[j]!=z[j+k*n]) {nbad++; break;}
+            }
+        }
+        /* cost of serial and parallel evaluation */
+        for (j=0;j<2;j++) {
+            for (nrep=1;;nrep*=2) {
+                tick=tickget();
+                for (k=0;k<nrep*ntrial;k++) {
+                    lambda_par(n,2,a+k%ntrial*n,Q+k%ntrial*n*n,ord+k%ntrial*n,4,p0,thres,
+                               j==0?1:nthread,F,s,fix);
+                }
+                if ((t[j]=(tickget()-tick)*1E-3)>=MINTIME) break;
+            }
+            t[j]=t[j]/nrep/ntrial*1E6;
+        }
+        printf("  %5d %3d %9.1f %9.1f %9.1f %9.1f %12.2f %12.2f\n",n,nw,
+               100.0*nok[0]/ntrial,100.0*nok[1]/ntrial,
+               nok[1]?(double)nsum/nok[1]:0.0,nok[1]?100.0*nbad/nok[1]:0.0,
+               t[0],t[1]);
+        free(a); free(Q); free(z); free(F); free(fix); free(ord);
+    }
+    return 0;
+}
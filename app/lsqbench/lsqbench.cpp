@@ -0,0 +1,174 @@
+/*------------------------------------------------------------------------------
+* lsqbench.c : least square estimation benchmark
+*
+* measure the cost of the least square estimation of the point positioning
+* with the design matrix and lsq() and with the normal equation accumulated
+* without the design matrix and lsqnrm(), and check the solutions
+*
+* version : $Revision:$ $Date:$
+* history : 2026/10/18 1.0 new
+*-----------------------------------------------------------------------------*/
+#include <stdarg.h>
+#include "rtklib.h"
+
+#define PROGNAME    "lsqbench"          /* program name */
+#define MAXSIZE     32                  /* max number of sizes */
+#define MINTIME     0.2                 /* min time of a measurement (s) */
+
+/* help text -----------------------------------------------------------------*/
+static const char *help[]={
+"",
+" usage: lsqbench [option]...",
+"",
+" Measure the cost (us/call) and the rate (solutions/s) of a weighted least",
+" square estimation of n parameters (position, clock and n-4 time offsets)",
+" by m pseudoranges with the design matrix allocated by mat() and lsq()",
+" (lsq) and with the normal equation accumulated on the stack and lsqnrm()",
+" (nrm). The max differences of the parameters (m) and the covariance to",
+" lsq are printed.",
+"",
+" -?        print help",
+" -n n[,n...] number of parameters [4,5,6,7,8,9,10,12]",
+" -m m[,m...] number of measurements [8,16,32,64]",
+""
+};
+/* show message --------------------------------------------------------------*/
+extern int showmsg(const char *format, ...)
+{
+    va_list arg;
+    va_start(arg,format); vfprintf(stderr,format,arg); va_end(arg);
+    fprintf(stderr,"\r");
+    return 0;
+}
+extern void settspan(gtime_t ts, gtime_t te) {}
+extern void settime(gtime_t time) {}
+
+/* print help ----------------------------------------------------------------*/
+static void printhelp(void)
+{
+    int i;
+    for (i=0;i<(int)(sizeof(help)/sizeof(*help));i++) fprintf(stderr,"%s\n",help[i]);
+    exit(0);
+}
+/* parse list of sizes -------------------------------------------------------*/
+static int getsize(char *p, int *size)
+{
+    char *q;
+    int n=0;
+
+    for (;p&&n<MAXSIZE;p=q?q+1:NULL) {
+        if ((q=strchr(p,','))) *q='\0';
+        if (atoi(p)>0) size[n++]=atoi(p);
+    }
+    return n;
+}
+/* synthetic measurements ----------------------------------------------------
+* row j: -e (line-of-sight), 1 (clock), 1 at time offset ih[j] (0: none)
+*-----------------------------------------------------------------------------*/
+static void genmeas(int n, int m, double *e, int *ih, double *v, double *sig)
+{
+    double az,el;
+    int j;
+
+    for (j=0;j<m;j++) {
+        az=rand()*2.0*PI/RAND_MAX;
+        el=rand()*PI/2.0/RAND_MAX;
+        e[  j*3]=sin(az)*cos(el);
+        e[1+j*3]=cos(az)*cos(el);
+        e[2+j*3]=sin(el);
+        ih[j]=n>4&&j%(n-3)?4+j%(n-3)-1:0;
+        v[j]=10.0*((double)rand()/RAND_MAX-0.5);
+        sig[j]=0.3+(double)rand()/RAND_MAX;
+    }
+}
+/* estimation with design matrix ---------------------------------------------*/
+static int estlsq(int n, int m, const double *e, const int *ih,
+                  const double *v, const double *sig, double *x, double *Q)
+{
+    double *H,*y;
+    int i,j,info;
+
+    H=zeros(n,m); y=mat(m,1);
+    for (j=0;j<m;j++) {
+        for (i=0;i<4;i++) H[i+j*n]=(i<3?-e[i+j*3]:1.0)/sig[j];
+        if (ih[j]) H[ih[j]+j*n]=1.0/sig[j];
+        y[j]=v[j]/sig[j];
+    }
+    info=lsq(H,y,n,m,x,Q,0.0);
+    matfree(H); matfree(y);
+    return info;
+}
+/* estimation with normal equation -------------------------------------------*/
+static int estnrm(int n, int m, const double *e, const int *ih,
+                  const double *v, const double *sig, double *x, double *Q)
+{
+    double N[MAXSIZE*MAXSIZE]={0},b[MAXSIZE]={0},r[4],w;
+    int i,j,k;
+
+    for (j=0;j<m;j++) {
+        w=1.0/sig[j];
+        for (i=0;i<4;i++) r[i]=(i<3?-e[i+j*3]:1.0)*w;
+        for (i=0;i<4;i++) {
+            b[i]+=r[i]*v[j]*w;
+            for (k=0;k<4;k++) N[i+k*n]+=r[i]*r[k];
+        }
+        if (!ih[j]) continue;
+        b[ih[j]]+=v[j]*w*w;
+        N[ih[j]+ih[j]*n]+=w*w;
+        for (i=0;i<4;i++) {
+            N[ih[j]+i*n]+=r[i]*w;
+            N[i+ih[j]*n]+=r[i]*w;
+        }
+    }
+    return lsqnrm(N,b,n,x,Q);
+}
+/* max difference ------------------------------------------------------------*/
+static double maxdiff(const double *A, const double *B, int n)
+{
+    double d=0.0;
+    int i;
+
+    for (i=0;i<n;i++) if (fabs(A[i]-B[i])>d) d=fabs(A[i]-B[i]);
+    return d;
+}
+/* lsqbench main -------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    double *e,*v,*sig,x[2][MAXSIZE],Q[2][MAXSIZE*MAXSIZE],t;
+    int i,j,k,l,n,m,nn=8,nm=4,ns[MAXSIZE]={4,5,6,7,8,9,10,12};
+    int ms[MAXSIZE]={8,16,32,64},*ih,nrep,info;
+    unsigned int tick;
+
+    for (i=1;i<argc;i++) {
+        if      (!strcmp(argv[i],"-n")&&i+1<argc) nn=getsize(argv[++i],ns);
+        else if (!strcmp(argv[i],"-m")&&i+1<argc) nm=getsize(argv[++i],ms);
+        else printhelp();
+    }
+    printf("%% %4s %4s %4s %10s %12s %10s %10s\n","n","m","alg","us/call",
+           "sol/s","dx(m)","dQ");
+
+    for (i=0;i<nn;i++) for (j=0;j<nm;j++) {
+        n=ns[i]; m=ms[j];
+        if (n<4||n>MAXSIZE||m<n) continue;
+        e=mat(3,m); v=mat(m,1); sig=mat(m,1); ih=imat(m,1);
+        srand(n*1000+m);
+        genmeas(n,m,e,ih,v,sig);
+
+        for (k=0;k<2;k++) {
+            for (nrep=1;;nrep*=2) {
+                tick=tickget();
+                for (l=0;l<nrep;l++) {
+                    info=k==0?estlsq(n,m,e,ih,v,sig,x[k],Q[k]):
+                              estnrm(n,m,e,ih,v,sig,x[k],Q[k]);
+                }
+                if ((t=(tickget()-tick)*1E-3)>=MINTIME) break;
+            }
+            t=t/nrep*1E6;
+            printf("  %4d %4d %4s %10.3f %12.0f %10.2E %10.2E%s\n",n,m,
+                   k==0?"lsq":"nrm",t,1E6/t,k?maxdiff(x[1],x[0],n):0.0,
+                   k?maxdiff(Q[1],Q[0],n*n):0.0,info?" error":"");
+        }
+        matfree(e); matfree(v); matfree(sig); matfree(ih);
+    }
+    return 0;
+}
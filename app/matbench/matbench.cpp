@@ -0,0 +1,244 @@
+/*------------------------------------------------------------------------------
+* matbench.c : matrix routine benchmark
+*
+* measure the cost of matmul() and matinv() for the matrix sizes of the
+* filters and the least square estimation with the reference (unblocked)
+* routines, the internal blocked kernels and the system BLAS/LAPACK selected
+* by setmatlib(), and check the results against the reference
+*
+* version : $Revision:$ $Date:$
+* history : 2026/10/18 1.0 new
+*-----------------------------------------------------------------------------*/
+#include <stdarg.h>
+#include "rtklib.h"
+
+#define PROGNAME    "matbench"          /* program name */
+#define MAXSIZE     32                  /* max number of matrix sizes */
+#define MINTIME     0.2                 /* min time of a measurement (s) */
+
+/* matrix libraries and operations -------------------------------------------*/
+static const char *libname[]={"ref","int","sys"};
+static const char *opname[]={"AB","A'B","AA'","inv"};
+#define NLIB        3
+#define NOP         4
+
+/* help text -----------------------------------------------------------------*/
+static const char *help[]={
+"",
+" usage: matbench [option]...",
+"",
+" Measure the cost (us/call) and the throughput (GFLOPS) of the matrix",
+" multiplication C=A*B, C=A'*B, C=A*A' (matmul) and the matrix inversion",
+" (matinv) for square matrices of the sizes with the reference unblocked",
+" routines (ref), the internal blocked kernels (int) and the system",
+" BLAS/LAPACK loaded at runtime (sys). The max difference to the reference",
+" relative to the max element of the result is printed for int and sys.",
+"",
+" -?        print help",
+" -n n[,n...] matrix sizes [3,6,10,20,50,100,200,500,1000]",
+" -l lib[,lib...] libraries (ref,int,sys) [all]",
+""
+};
+/* show message --------------------------------------------------------------*/
+extern int showmsg(const char *format, ...)
+{
+    va_list arg;
+    va_start(arg,format); vfprintf(stderr,format,arg); va_end(arg);
+    fprintf(stderr,"\r");
+    return 0;
+}
+extern void settspan(gtime_t ts, gtime_t te) {}
+extern void settime(gtime_t time) {}
+
+/* print help ----------------------------------------------------------------*/
+static void printhelp(void)
+{
+    int i;
+    for (i=0;i<(int)(sizeof(help)/sizeof(*help));i++) fprintf(stderr,"%s\n",help[i]);
+    exit(0);
+}
+/* reference matrix multiplication (unblocked) -------------------------------*/
+static void refmul(const char *tr, int n, int k, int m, double alpha,
+                   const double *A, const double *B, double beta, double *C)
+{
+    double d;
+    int i,j,x,f=tr[0]=='N'?(tr[1]=='N'?1:2):(tr[1]=='N'?3:4);
+
+    for (i=0;i<n;i++) for (j=0;j<k;j++) {
+        d=0.0;
+        switch (f) {
+            case 1: for (x=0;x<m;x++) d+=A[i+x*n]*B[x+j*m]; break;
+            case 2: for (x=0;x<m;x++) d+=A[i+x*n]*B[j+x*k]; break;
+            case 3: for (x=0;x<m;x++) d+=A[x+i*m]*B[x+j*m]; break;
+            case 4: for (x=0;x<m;x++) d+=A[x+i*m]*B[j+x*k]; break;
+        }
+        if (beta==0.0) C[i+j*n]=alpha*d; else C[i+j*n]=alpha*d+beta*C[i+j*n];
+    }
+}
+/* reference LU decomposition ------------------------------------------------*/
+static int refludcmp(double *A, int n, int *indx, double *d)
+{
+    double big,s,tmp,*vv=mat(n,1);
+    int i,imax=0,j,k;
+
+    *d=1.0;
+    for (i=0;i<n;i++) {
+        big=0.0; for (j=0;j<n;j++) if ((tmp=fabs(A[i+j*n]))>big) big=tmp;
+        if (big>0.0) vv[i]=1.0/big; else {free(vv); return -1;}
+    }
+    for (j=0;j<n;j++) {
+        for (i=0;i<j;i++) {
+            s=A[i+j*n]; for (k=0;k<i;k++) s-=A[i+k*n]*A[k+j*n]; A[i+j*n]=s;
+        }
+        big=0.0;
+        for (i=j;i<n;i++) {
+            s=A[i+j*n]; for (k=0;k<j;k++) s-=A[i+k*n]*A[k+j*n]; A[i+j*n]=s;
+            if ((tmp=vv[i]*fabs(s))>=big) {big=tmp; imax=i;}
+        }
+        if (j!=imax) {
+            for (k=0;k<n;k++) {
+                tmp=A[imax+k*n]; A[imax+k*n]=A[j+k*n]; A[j+k*n]=tmp;
+            }
+            *d=-(*d); vv[imax]=vv[j];
+        }
+        indx[j]=imax;
+        if (A[j+j*n]==0.0) {free(vv); return -1;}
+        if (j!=n-1) {
+            tmp=1.0/A[j+j*n]; for (i=j+1;i<n;i++) A[i+j*n]*=tmp;
+        }
+    }
+    free(vv);
+    return 0;
+}
+/* reference LU back-substitution --------------------------------------------*/
+static void reflubksb(const double *A, int n, const int *indx, double *b)
+{
+    double s;
+    int i,ii=-1,ip,j;
+
+    for (i=0;i<n;i++) {
+        ip=indx[i]; s=b[ip]; b[ip]=b[i];
+        if (ii>=0) for (j=ii;j<i;j++) s-=A[i+j*n]*b[j]; else if (s) ii=i;
+        b[i]=s;
+    }
+    for (i=n-1;i>=0;i--) {
+        s=b[i]; for (j=i+1;j<n;j++) s-=A[i+j*n]*b[j]; b[i]=s/A[i+i*n];
+    }
+}
+/* reference inverse of matrix -----------------------------------------------*/
+static int refinv(double *A, int n)
+{
+    double d,*B;
+    int i,j,*indx;
+
+    indx=imat(n,1); B=mat(n,n); matcpy(B,A,n,n);
+    if (refludcmp(B,n,indx,&d)) {free(indx); free(B); return -1;}
+    for (j=0;j<n;j++) {
+        for (i=0;i<n;i++) A[i+j*n]=0.0;
+        A[j+j*n]=1.0;
+        reflubksb(B,n,indx,A+j*n);
+    }
+    free(indx); free(B);
+    return 0;
+}
+/* run an operation ----------------------------------------------------------*/
+static void runop(int lib, int op, int n, const double *A, const double *B,
+                  double *C)
+{
+    void (*mul)(const char *, int, int, int, double, const double *,
+                const double *, double, double *)=lib==0?refmul:matmul;
+
+    switch (op) {
+        case 0: mul("NN",n,n,n,1.0,A,B,0.0,C); break;
+        case 1: mul("TN",n,n,n,1.0,A,B,0.0,C); break;
+        case 2: mul("NT",n,n,n,1.0,A,A,0.0,C); break;
+        case 3: matcpy(C,B,n,n); if (lib==0) refinv(C,n); else matinv(C,n); break;
+    }
+}
+/* time of an operation (us/call) --------------------------------------------*/
+static double benchop(int lib, int op, int n, const double *A, const double *B,
+                      double *C)
+{
+    unsigned int tick;
+    double t;
+    int i,nrep=1;
+
+    for (;;nrep*=2) {
+        tick=tickget();
+        for (i=0;i<nrep;i++) runop(lib,op,n,A,B,C);
+        if ((t=(tickget()-tick)*1E-3)>=MINTIME) break;
+    }
+    return t/nrep*1E6;
+}
+/* max difference relative to max element ------------------------------------*/
+static double maxdiff(const double *C, const double *R, int n)
+{
+    double d=0.0,r=0.0;
+    int i;
+
+    for (i=0;i<n*n;i++) {
+        if (fabs(C[i]-R[i])>d) d=fabs(C[i]-R[i]);
+        if (fabs(R[i])>r) r=fabs(R[i]);
+    }
+    return r>0.0?d/r:d;
+}
+/* matbench main -------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    double *A,*B,*C,*R,t,flops;
+    int i,j,k,n,nsize=9,size[MAXSIZE]={3,6,10,20,50,100,200,500,1000};
+    int libs[NLIB]={0},nsel=0,stat[NLIB]={1,1,0};
+    char *p,*q;
+
+    for (i=1;i<argc;i++) {
+        if (!strcmp(argv[i],"-n")&&i+1<argc) {
+            for (p=argv[++i],nsize=0;p&&nsize<MAXSIZE;p=q?q+1:NULL) {
+                if ((q=strchr(p,','))) *q='\0';
+                if ((n=atoi(p))>0) size[nsize++]=n;
+            }
+        }
+        else if (!strcmp(argv[i],"-l")&&i+1<argc) {
+            for (p=argv[++i];p;p=q?q+1:NULL) {
+                if ((q=strchr(p,','))) *q='\0';
+                for (j=0;j<NLIB;j++) if (!strcmp(p,libname[j])) {libs[j]=1; nsel++;}
+            }
+        }
+        else printhelp();
+    }
+    if (!nsel) for (j=0;j<NLIB;j++) libs[j]=1;
+
+    stat[2]=setmatlib(MATLIB_SYS);
+    setmatlib(MATLIB_INT);
+    if (libs[2]&&!stat[2]) fprintf(stderr,"no system matrix library\n");
+
+    printf("%% %-4s %5s %4s %12s %9s %10s\n","op","n","lib","us/call","GFLOPS",
+           "maxdiff");
+
+    for (i=0;i<nsize;i++) {
+        n=size[i];
+        A=mat(n,n); B=mat(n,n); C=mat(n,n); R=mat(n,n);
+
+        /* diagonally dominant matrix for inversion */
+        srand(n);
+        for (j=0;j<n*n;j++) A[j]=(double)rand()/RAND_MAX-0.5;
+        for (j=0;j<n*n;j++) B[j]=(double)rand()/RAND_MAX-0.5;
+        for (j=0;j<n;j++) B[j+j*n]+=n;
+
+        for (k=0;k<NOP;k++) {
+            flops=2.0*n*n*n; /* multiply: 2n^3, inverse: ~2n^3 */
+            runop(0,k,n,A,B,R);
+
+            for (j=0;j<NLIB;j++) {
+                if (!libs[j]||!stat[j]) continue;
+                if (j>0) setmatlib(j==1?MATLIB_INT:MATLIB_SYS);
+                t=benchop(j,k,n,A,B,C);
+                runop(j,k,n,A,B,C);
+                printf("  %-4s %5d %4s %12.3f %9.3f %10.2E\n",opname[k],n,
+                       libname[j],t,flops/t*1E-3,j>0?maxdiff(C,R,n):0.0);
+            }
+        }
+        setmatlib(MATLIB_INT);
+        free(A); free(B); free(C); free(R);
+    }
+    return 0;
+}
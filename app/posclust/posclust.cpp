@@ -0,0 +1,153 @@
+/*------------------------------------------------------------------------------
+* posclust.c : solution cloud clustering
+*
+* cluster the positions of solution files by dbscan() in the local coordinates
+* around the mean position to find the outlier epochs (noise) and the groups
+* of biased epochs (clusters other than the main one)
+*
+* version : $Revision:$ $Date:$
+* history : 2026/10/18 1.0 new
+*-----------------------------------------------------------------------------*/
+#include <stdarg.h>
+#include "rtklib.h"
+#include "DBSCAN.h"
+
+#define PROGNAME    "posclust"          /* program name */
+#define MAXFILE     256                 /* max number of input files */
+#define SQR(x)      ((x)*(x))
+
+/* help text -----------------------------------------------------------------*/
+static const char *help[]={
+"",
+" usage: posclust [option]... file [...]",
+"",
+" Read the solutions of the files, convert the positions to local east,",
+" north and up (m) around the mean position and cluster them by dbscan. The",
+" number of epochs, the mean and the std of each cluster are printed (*:",
+" main cluster with most epochs). With -v, the epochs not in the main",
+" cluster are listed.",
+"",
+" -?        print help",
+" -e eps    radius of neighborhood (m) [0.5]",
+" -m minpts min number of epochs in neighborhood of core epoch [10]",
+" -d dim    dimension (2:east/north,3:east/north/up) [3]",
+" -q qflag  quality flag of solutions (0:all) [0]",
+" -t n      number of threads (0:number of cpus) [0]",
+" -v        list epochs not in the main cluster",
+""
+};
+/* show message --------------------------------------------------------------*/
+extern int showmsg(const char *format, ...)
+{
+    va_list arg;
+    va_start(arg,format); vfprintf(stderr,format,arg); va_end(arg);
+    fprintf(stderr,"\r");
+    return 0;
+}
+extern void settspan(gtime_t ts, gtime_t te) {}
+extern void settime(gtime_t time) {}
+
+/* print help ----------------------------------------------------------------*/
+static void printhelp(void)
+{
+    int i;
+    for (i=0;i<(int)(sizeof(help)/sizeof(*help));i++) fprintf(stderr,"%s\n",help[i]);
+    exit(0);
+}
+/* posclust main -------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    solbuf_t solbuf={0};
+    gtime_t t0={0};
+    double eps=0.5,rr[3]={0},pos[3],dr[3],enu[3],*x,*mean,*std;
+    char *infile[MAXFILE],tstr[32];
+    int i,j,k,n=0,nfile=0,minpts=10,dim=3,qflag=0,nthread=0,verb=0,nc,imax;
+    int *cl,*cnt;
+    unsigned int tick;
+    
+    for (i=1;i<argc;i++) {
+        if      (!strcmp(argv[i],"-e")&&i+1<argc) eps=atof(argv[++i]);
+        else if (!strcmp(argv[i],"-m")&&i+1<argc) minpts=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"-d")&&i+1<argc) dim=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"-q")&&i+1<argc) qflag=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"-t")&&i+1<argc) nthread=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"-v")) verb=1;
+        else if (*argv[i]=='-') printhelp();
+        else if (nfile<MAXFILE) infile[nfile++]=argv[i];
+    }
+    if (nfile<=0||dim<2||dim>3) printhelp();
+    
+    if (!readsolt(infile,nfile,t0,t0,0.0,qflag,&solbuf)) {
+        fprintf(stderr,"no solution data\n");
+        return -1;
+    }
+    x=mat(dim,solbuf.n); cl=imat(solbuf.n,1);
+    
+    /* mean position of ecef solutions */
+    for (i=0;i<solbuf.n;i++) {
+        if (solbuf.data[i].type!=0||norm(solbuf.data[i].rr,3)<=0.0) continue;
+        for (j=0;j<3;j++) rr[j]+=(solbuf.data[i].rr[j]-rr[j])/(n+1);
+        n++;
+    }
+    if (n<=0) {
+        fprintf(stderr,"no ecef solution data\n");
+        return -1;
+    }
+    ecef2pos(rr,pos);
+    
+    /* local coordinates (solbuf.data reordered to valid solutions) */
+    for (i=n=0;i<solbuf.n;i++) {
+        if (solbuf.data[i].type!=0||norm(solbuf.data[i].rr,3)<=0.0) continue;
+        for (j=0;j<3;j++) dr[j]=solbuf.data[i].rr[j]-rr[j];
+        ecef2enu(pos,dr,enu);
+        for (j=0;j<dim;j++) x[j+n*dim]=enu[j];
+        solbuf.data[n++]=solbuf.data[i];
+    }
+    tick=tickget();
+    if ((nc=dbscan(x,n,dim,eps,minpts,nthread,cl,NULL))<0) {
+        fprintf(stderr,"dbscan error\n");
+        return -1;
+    }
+    fprintf(stderr,"dbscan: n=%d nc=%d time=%.3f s\n",n,nc,
+            (tickget()-tick)*1E-3);
+    
+    /* statistics of clusters (0:noise) */
+    cnt=imat(nc+1,1); mean=zeros(3,nc+1); std=zeros(3,nc+1);
+    for (i=0;i<=nc;i++) cnt[i]=0;
+    for (i=0;i<n;i++) {
+        k=cl[i]; cnt[k]++;
+        for (j=0;j<dim;j++) mean[j+k*3]+=(x[j+i*dim]-mean[j+k*3])/cnt[k];
+    }
+    for (i=0;i<n;i++) {
+        k=cl[i];
+        for (j=0;j<dim;j++) std[j+k*3]+=SQR(x[j+i*dim]-mean[j+k*3]);
+    }
+    for (i=1,imax=0;i<=nc;i++) if (!imax||cnt[i]>cnt[imax]) imax=i;
+    
+    printf("%% mean pos: %14.4f %14.4f %14.4f (m) n=%d eps=%.3f minpts=%d\n",
+           rr[0],rr[1],rr[2],n,eps,minpts);
+    printf("%% %7s %8s %9s %9s %9s %8s %8s %8s\n","cluster","n","e(m)","n(m)",
+           "u(m)","se(m)","sn(m)","su(m)");
+    for (i=0;i<=nc;i++) {
+        if (!cnt[i]) continue;
+        if (i==0) sprintf(tstr,"noise"); else sprintf(tstr,"%d%s",i,i==imax?"*":"");
+        printf("  %-7s %8d",tstr,cnt[i]);
+        for (j=0;j<3;j++) printf(" %9.4f",mean[j+i*3]);
+        for (j=0;j<3;j++) printf(" %8.4f",sqrt(std[j+i*3]/cnt[i]));
+        printf("\n");
+    }
+    if (verb) {
+        printf("%% %-21s %7s %9s %9s %9s\n","time","cluster","e(m)","n(m)",
+               dim>2?"u(m)":"");
+        for (i=0;i<n;i++) {
+            if (cl[i]==imax) continue;
+            time2str(solbuf.data[i].time,tstr,1);
+            printf("  %-21s %7d",tstr,cl[i]);
+            for (j=0;j<dim;j++) printf(" %9.4f",x[j+i*dim]);
+            printf("\n");
+        }
+    }
+    free(x); free(cl); free(cnt); free(mean); free(std);
+    freesolbuf(&solbuf);
+    return 0;
+}
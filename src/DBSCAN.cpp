@@ -1,214 +1,359 @@
-#include "DBSCAN.h"  
+/*------------------------------------------------------------------------------
+* DBSCAN.c : density-based clustering (dbscan)
+*
+* the points are bucketed to a uniform grid of cell size eps/sqrt(dim), so
+* that the points of a cell are within eps each other and the neighbors of a
+* point are in the cells of a fixed stencil. the points are stored flat in
+* the cell order. a cell of minpts or more points has only core points and
+* the core points of a cell are in one cluster, otherwise the neighbors are
+* counted point by point.
+*
+* references :
+*     [1] M.Ester, H.P.Kriegel, J.Sander, X.Xu, A density-based algorithm for
+*         discovering clusters in large spatial databases with noise, KDD-96,
+*         1996
+*     [2] A.Gunawan, A faster algorithm for DBSCAN, Master's thesis, Technische
+*         University Eindhoven, 2013
+*
+* version : $Revision:$ $Date:$
+* history : 2026/10/18 1.0  rebuilt on uniform grid, reentrant, parallel core
+*                           point detection (replaces O(n^2) implementation)
+*-----------------------------------------------------------------------------*/
+#include <algorithm>
+#include "rtklib.h"
+#include "DBSCAN.h"
 
-int clusterID = 0;
+#define NBLK        256                 /* number of cells of a work block */
+#define MAXKEY      (1LL<<62)           /* max cell key */
+#define MAXSTENCIL  125                 /* max number of stencil cells */
 
-void point::init()
-{
-	cluster = 0;
-	pointType = pointType_UNDO;//pointType_NOISE pointType_UNDO  
-	pts = 0;
-	visited = 0;
-	corePointID = -1;
-}
+typedef struct {        /* grid point type */
+    long long key;      /* cell key */
+    int i;              /* point index */
+} gpoint_t;
 
+typedef struct {        /* dbscan grid type */
+    int n,dim;          /* number of points, dimension */
+    int nc;             /* number of cells */
+    double eps2;        /* eps^2 */
+    double *x;          /* points in cell order {x,...} */
+    int *idx;           /* point indices in cell order */
+    long long *ckey;    /* cell keys {key[0],...,key[nc-1]} */
+    int *cs;            /* cell start {cs[0],...,cs[nc]} */
+    unsigned char *fit; /* cell points within eps each other flags */
+    long long nd[DBSCAN_MAXDIM]; /* number of cells of each dimension */
+    int ns,ns1;         /* number of stencil cells (all, adjacent) */
+    int sten[MAXSTENCIL][DBSCAN_MAXDIM]; /* stencil cell offsets */
+    int minpts;         /* min number of points of core point */
+    unsigned char *core; /* core point flags in cell order */
+    int *cl;            /* clusters in cell order */
+} dbgrid_t;
 
-float stringToFloat(string i){
-	stringstream sf;
-	float score = 0;
-	sf << i;
-	sf >> score;
-	return score;
+/* compare grid points -------------------------------------------------------*/
+static bool cmpgpoint(const gpoint_t &p1, const gpoint_t &p2)
+{
+    return p1.key<p2.key||(p1.key==p2.key&&p1.i<p2.i);
 }
-
-vector<point> openFile(const char* dataset){
-	fstream file;
-	file.open(dataset, ios::in);
-	if (!file)
-	{
-		cout << "Open File Failed!" << endl;
-		vector<point> a;
-		return a;
-	}
-	vector<point> data;
-
-	int i = 1;
-	while (!file.eof()){
-		string temp;
-		file >> temp; //read one row data  
-		int split = temp.find(',', 0);
-
-		//point p(stringToFloat(temp.substr(0,split)),stringToFloat(temp.substr(split+1,temp.length()-1)),i++);  
-
-		//three or more dimension data process  
-		int numSpit = 0;
-		vector <int> splitN1, splitN2;
-		numSpit = count(temp.begin(), temp.end(), ',');
-		if (numSpit>0){ // 2d or 3d 4d....
-			vector<float> xn;
-			int m = 0; int cPos = 0;
-			while (1){//  
-				int splitTemp = temp.find_first_of(',', cPos);
-				if (splitTemp != string::npos){
-					m++;
-					splitN1.push_back(cPos);
-					cPos = splitTemp + 1;
-					splitN2.push_back(splitTemp);
-				}
-				else
-					break;
-			}
-			for (int m = 0; m<numSpit; m++){
-				xn.push_back(stringToFloat(temp.substr(splitN1[m], splitN2[m])));
-			}
-			xn.push_back(stringToFloat(temp.substr(splitN2[numSpit - 1] + 1, temp.length() - 1)));
-			point p(xn, i++);
-			data.push_back(p);
-		}
-		else
-		{
-			vector<float> xn;
-			int m = 0; int cPos = 0;
-			xn.push_back(stringToFloat(temp));
-			point p(xn, i++);
-			data.push_back(p);
-		}
-	}
-	file.close();
-	cout << "successful!" << endl;
-	return data;
+/* cell index by cell key (-1: no cell) --------------------------------------*/
+static int findcell(const dbgrid_t *g, long long key)
+{
+    const long long *p=std::lower_bound(g->ckey,g->ckey+g->nc,key);
+    return p<g->ckey+g->nc&&*p==key?(int)(p-g->ckey):-1;
 }
-
-float squareDistance(point a, point b){
-	return sqrt((a.x - b.x)*(a.x - b.x) + (a.y - b.y)*(a.y - b.y));
+/* neighbor cells of a cell ----------------------------------------------------
+* cells of the stencil i0 to i1-1 around the cell c (including c) which have
+* points
+*-----------------------------------------------------------------------------*/
+static int nbrcell(const dbgrid_t *g, int c, int i0, int i1, int *nbr)
+{
+    long long key=g->ckey[c],cc[DBSCAN_MAXDIM],k,m;
+    int i,j,n=0;
+    
+    for (j=0;j<g->dim;j++) {
+        cc[j]=key%g->nd[j]; key/=g->nd[j];
+    }
+    for (i=i0;i<i1;i++) {
+        for (j=g->dim-1,k=0;j>=0;j--) {
+            m=cc[j]+g->sten[i][j];
+            if (m<0||m>=g->nd[j]) break;
+            k=k*g->nd[j]+m;
+        }
+        if (j>=0) continue;
+        if ((m=findcell(g,k))>=0) nbr[n++]=(int)m;
+    }
+    return n;
 }
-
-float squareDistanceVect(point a, point b){
-	vector <float> xn1 = a.xn;
-	vector <float> yn1 = b.xn;
-
-	float sumSqrt = 0;
-	for (int i = 0; i<xn1.size(); i++){
-		sumSqrt = sumSqrt + (xn1[i] - yn1[i])*(xn1[i] - yn1[i]);
-	}
-	return sqrt(sumSqrt);
+/* distance within eps -------------------------------------------------------*/
+static int nearpoint(const dbgrid_t *g, int i, int j)
+{
+    const double *p=g->x+i*g->dim,*q=g->x+j*g->dim;
+    double d=0.0;
+    int k;
+    
+    for (k=0;k<g->dim;k++) d+=(p[k]-q[k])*(p[k]-q[k]);
+    return d<=g->eps2;
+}
+/* core points of a block of cells -------------------------------------------*/
+static void corepoint(int b, void *arg)
+{
+    const dbgrid_t *g=(const dbgrid_t *)arg;
+    int c,i,j,k,m,nn,nbr[MAXSTENCIL];
+    
+    for (c=b*NBLK;c<(b+1)*NBLK&&c<g->nc;c++) {
+        
+        /* dense cell */
+        if (g->cs[c+1]-g->cs[c]>=g->minpts&&g->fit[c]) {
+            for (i=g->cs[c];i<g->cs[c+1];i++) g->core[i]=1;
+            continue;
+        }
+        nn=nbrcell(g,c,0,g->ns,nbr);
+        
+        for (i=g->cs[c];i<g->cs[c+1];i++) {
+            for (k=m=0;k<nn&&m<g->minpts;k++) {
+                for (j=g->cs[nbr[k]];j<g->cs[nbr[k]+1]&&m<g->minpts;j++) {
+                    if (nearpoint(g,i,j)) m++;
+                }
+            }
+            g->core[i]=m>=g->minpts;
+        }
+    }
+}
+/* border points of a block of cells -------------------------------------------
+* a border point belongs to the cluster of the core point of the min index
+* within eps
+*-----------------------------------------------------------------------------*/
+static void borderpoint(int b, void *arg)
+{
+    const dbgrid_t *g=(const dbgrid_t *)arg;
+    int c,i,j,k,nn,imin,nbr[MAXSTENCIL];
+    
+    for (c=b*NBLK;c<(b+1)*NBLK&&c<g->nc;c++) {
+        nn=-1;
+        for (i=g->cs[c];i<g->cs[c+1];i++) {
+            if (g->core[i]) continue;
+            if (nn<0) nn=nbrcell(g,c,0,g->ns,nbr);
+            for (k=0,imin=-1;k<nn;k++) {
+                for (j=g->cs[nbr[k]];j<g->cs[nbr[k]+1];j++) {
+                    if (!g->core[j]||(imin>=0&&g->idx[j]>=g->idx[imin])) continue;
+                    if (nearpoint(g,i,j)) imin=j;
+                }
+            }
+            g->cl[i]=imin>=0?g->cl[imin]:0;
+        }
+    }
+}
+/* root of union-find --------------------------------------------------------*/
+static int findroot(int *par, int i)
+{
+    int r=i,j;
+    
+    while (par[r]!=r) r=par[r];
+    while (par[i]!=r) {j=par[i]; par[i]=r; i=j;}
+    return r;
+}
+/* join clusters of union-find -----------------------------------------------*/
+static void joinroot(int *par, int i, int j)
+{
+    i=findroot(par,i); j=findroot(par,j);
+    if (i<j) par[j]=i; else if (j<i) par[i]=j;
+}
+/* join core points of two cells (all: all pairs of core points) -----------*/
+static void joincell(const dbgrid_t *g, int *par, int c, int d, int all)
+{
+    int i,j;
+    
+    for (i=g->cs[c];i<g->cs[c+1];i++) {
+        if (!g->core[i]) continue;
+        for (j=c==d?i+1:g->cs[d];j<g->cs[d+1];j++) {
+            if (!g->core[j]||!nearpoint(g,i,j)) continue;
+            joinroot(par,i,j);
+            if (!all) return; /* any pair of core points within eps */
+        }
+    }
+}
+/* join clusters of core points ------------------------------------------------
+* the core points of a cell are joined first, then the cells are joined to the
+* adjacent cells and the other neighbor cells unless they are in a cluster
+*-----------------------------------------------------------------------------*/
+static void joincore(const dbgrid_t *g, int *par, int *rep)
+{
+    int c,d,i,k,nn,nbr[MAXSTENCIL],pass;
+    
+    /* core points of a cell */
+    for (c=0;c<g->nc;c++) {
+        for (i=g->cs[c],rep[c]=-1;i<g->cs[c+1];i++) {
+            if (!g->core[i]) continue;
+            if (rep[c]<0) rep[c]=i;
+            else if (g->fit[c]) joinroot(par,rep[c],i);
+        }
+        if (rep[c]>=0&&!g->fit[c]) joincell(g,par,c,c,1);
+    }
+    /* core points of adjacent and other neighbor cells */
+    for (pass=0;pass<2;pass++) for (c=0;c<g->nc;c++) {
+        if (rep[c]<0) continue;
+        nn=pass==0?nbrcell(g,c,0,g->ns1,nbr):nbrcell(g,c,g->ns1,g->ns,nbr);
+        
+        for (k=0;k<nn;k++) {
+            if ((d=nbr[k])<=c||rep[d]<0) continue;
+            if (!g->fit[c]||!g->fit[d]) {
+                joincell(g,par,c,d,1);
+            }
+            else if (findroot(par,rep[c])!=findroot(par,rep[d])) {
+                joincell(g,par,c,d,0);
+            }
+        }
+    }
+}
+/* generate grid -------------------------------------------------------------*/
+static int gengrid(dbgrid_t *g, const double *x, int n, int dim, double eps)
+{
+    gpoint_t *p;
+    double xmin[DBSCAN_MAXDIM],xmax[DBSCAN_MAXDIM],s=eps/sqrt((double)dim);
+    long long m;
+    int i,j,k,d,r=(int)floor(sqrt((double)dim))+1,o[DBSCAN_MAXDIM];
+    
+    g->n=n; g->dim=dim; g->eps2=eps*eps;
+    
+    for (j=0;j<dim;j++) xmin[j]=xmax[j]=x[j];
+    for (i=1;i<n;i++) for (j=0;j<dim;j++) {
+        if (x[j+i*dim]<xmin[j]) xmin[j]=x[j+i*dim];
+        if (x[j+i*dim]>xmax[j]) xmax[j]=x[j+i*dim];
+    }
+    for (j=0,m=1;j<dim;j++) {
+        if ((g->nd[j]=(long long)((xmax[j]-xmin[j])/s)+1)<=0||
+            g->nd[j]>MAXKEY/m) {
+            trace(2,"dbscan: too many cells dim=%d eps=%.3g\n",dim,eps);
+            return 0;
+        }
+        m*=g->nd[j];
+    }
+    /* stencil in the order of distance */
+    for (d=0,g->ns=0;d<=dim*r*r;d++) for (i=0;i<MAXSTENCIL;i++) {
+        for (j=0,k=i;j<dim;j++,k/=2*r+1) o[j]=k%(2*r+1)-r;
+        if (k>0) break;
+        for (j=0,m=0;j<dim;j++) m+=o[j]*o[j];
+        if (m!=d) continue;
+        for (j=0;j<dim;j++) g->sten[g->ns][j]=o[j];
+        g->ns++;
+    }
+    for (j=0,g->ns1=1;j<dim;j++) g->ns1*=3;
+    /* sort points by cell */
+    if (!(p=(gpoint_t *)malloc(sizeof(gpoint_t)*n))) return 0;
+    
+    for (i=0;i<n;i++) {
+        for (j=dim-1,m=0;j>=0;j--) {
+            m=m*g->nd[j]+(long long)((x[j+i*dim]-xmin[j])/s);
+        }
+        p[i].key=m; p[i].i=i;
+    }
+    std::sort(p,p+n,cmpgpoint);
+    
+    for (i=0,g->nc=0;i<n;i++) if (i==0||p[i].key!=p[i-1].key) g->nc++;
+    
+    g->x=mat(dim,n); g->idx=imat(n,1); g->cs=imat(g->nc+1,1);
+    g->ckey=(long long *)malloc(sizeof(long long)*g->nc);
+    g->fit=(unsigned char *)malloc(g->nc);
+    if (!g->x||!g->idx||!g->cs||!g->ckey||!g->fit) {
+        free(p);
+        return 0;
+    }
+    for (i=k=0;i<n;i++) {
+        if (i==0||p[i].key!=p[i-1].key) {
+            g->ckey[k]=p[i].key; g->cs[k++]=i;
+        }
+        g->idx[i]=p[i].i;
+        for (j=0;j<dim;j++) g->x[j+i*dim]=x[j+p[i].i*dim];
+    }
+    g->cs[k]=n;
+    free(p);
+    
+    /* cell points within eps each other by bounding box */
+    for (k=0;k<g->nc;k++) {
+        for (j=0;j<dim;j++) xmin[j]=xmax[j]=g->x[j+g->cs[k]*dim];
+        for (i=g->cs[k]+1;i<g->cs[k+1];i++) for (j=0;j<dim;j++) {
+            if (g->x[j+i*dim]<xmin[j]) xmin[j]=g->x[j+i*dim];
+            if (g->x[j+i*dim]>xmax[j]) xmax[j]=g->x[j+i*dim];
+        }
+        for (j=0,s=0.0;j<dim;j++) s+=(xmax[j]-xmin[j])*(xmax[j]-xmin[j]);
+        g->fit[k]=s<=g->eps2;
+    }
+    return 1;
+}
+/* free grid -----------------------------------------------------------------*/
+static void freegrid(dbgrid_t *g)
+{
+    matfree(g->x); matfree(g->idx); free(g->ckey); matfree(g->cs); free(g->fit);
+    free(g->core);
+    matfree(g->cl);
+}
+/* dbscan clustering -----------------------------------------------------------
+* cluster points by density-based spatial clustering (dbscan) [1]
+* args   : double *x        I   points {x[0],...,x[n*dim-1]} (point i:
+*                               x[i*dim],...,x[i*dim+dim-1])
+*          int    n         I   number of points
+*          int    dim       I   dimension of points (1-DBSCAN_MAXDIM)
+*          double eps       I   radius of neighborhood (same unit as x)
+*          int    minpts    I   min number of points (including itself)
+*                               within eps of a core point
+*          int    nthread   I   number of threads (0:number of cpus,1:serial)
+*          int    *cluster  O   cluster of points {cl[0],...,cl[n-1]}
+*                               (1...:cluster,0:noise)
+*          unsigned char *core O core point flags {core[0],...,core[n-1]}
+*                               (NULL: no output)
+* return : number of clusters (-1:error)
+* notes  : the clusters are numbered in the order of the min index of their
+*          core points. a border point belongs to the cluster of the core
+*          point of the min index within eps.
+*          the function is reentrant. the core points are detected in parallel
+*          by nthread threads. the memory is O(n)
+*-----------------------------------------------------------------------------*/
+extern int dbscan(const double *x, int n, int dim, double eps, int minpts,
+                  int nthread, int *cluster, unsigned char *core)
+{
+    dbgrid_t g={0};
+    int i,j,r,nc=0,*par,*lab,*rep;
+    
+    trace(3,"dbscan  : n=%d dim=%d eps=%.3g minpts=%d\n",n,dim,eps,minpts);
+    
+    if (n<=0) return 0;
+    if (dim<1||dim>DBSCAN_MAXDIM||eps<=0.0) return -1;
+    
+    g.minpts=minpts;
+    if (!gengrid(&g,x,n,dim,eps)||
+        !(g.core=(unsigned char *)calloc(n,1))||!(g.cl=imat(n,1))) {
+        freegrid(&g);
+        return -1;
+    }
+    /* core points */
+    parfor((g.nc+NBLK-1)/NBLK,nthread,corepoint,&g);
+    
+    /* clusters of core points */
+    par=imat(n,1); lab=imat(n,1); rep=imat(g.nc,1);
+    if (!par||!lab||!rep) {
+        matfree(par); matfree(lab); matfree(rep); freegrid(&g);
+        return -1;
+    }
+    for (i=0;i<n;i++) {par[i]=i; lab[g.idx[i]]=i;}
+    joincore(&g,par,rep);
+    matfree(rep);
+    
+    for (i=0;i<n;i++) g.cl[i]=0;
+    for (i=0;i<n;i++) { /* numbering in point index order */
+        if (!g.core[j=lab[i]]) continue;
+        if (!g.cl[r=findroot(par,j)]) g.cl[r]=++nc;
+        g.cl[j]=g.cl[r];
+    }
+    matfree(par);
+    
+    /* clusters of border points */
+    parfor((g.nc+NBLK-1)/NBLK,nthread,borderpoint,&g);
+    
+    for (i=0;i<n;i++) {
+        cluster[g.idx[i]]=g.cl[i];
+        if (core) core[g.idx[i]]=g.core[i];
+    }
+    matfree(lab); freegrid(&g);
+    
+    trace(4,"dbscan  : nc=%d\n",nc);
+    return nc;
 }
-
-double  DBSCAN(vector<point> dataset, float Eps, int MinPts){
-	double mean_t = 0.0;
-	int n = 0;
-	int len = dataset.size();//ݳ  
-	if (len <= 0)return mean_t;
-
-	for (int i = 0; i<len; i++)//ʼ  
-	{
-		dataset[i].init();
-	}
-	clusterID = 0;
-	vector<vector <float>> distP2P(len);
-
-	//calculate pts  
-	//cout << "calculate pts" << endl;
-	for (int i = 0; i<len; i++){
-		for (int j = 0; j<len; j++){//i+1  
-			float distance = squareDistanceVect(dataset[i], dataset[j]);//squareDistanceVect squareDistance   
-			distP2P[i].push_back(distance);//disp for debug  
-			if (distance <= Eps){
-				dataset[i].pts++;
-			}
-		}
-	}
-	//core point   
-	//cout << "core point " << endl;
-	vector<point> corePoint;
-	for (int i = 0; i<len; i++){
-		int tempPts = dataset[i].pts;
-		if (tempPts >= MinPts) {
-			dataset[i].pointType = pointType_CORE;
-			dataset[i].corePointID = i;
-			corePoint.push_back(dataset[i]);
-		}
-	}
-	//cout << "joint core point" << endl;
-
-	//joint core point  
-	int numCorePoint = corePoint.size(); //core point number  
-
-	for (int i = 0; i<numCorePoint; i++){
-		for (int j = 0; j<numCorePoint; j++){
-			float distTemp = distP2P[corePoint[i].corePointID][corePoint[j].corePointID];//display for debug  
-			if (distTemp <= Eps){//squareDistance(corePoint[i],corePoint[j])  
-				corePoint[i].corepts.push_back(j);//other point orderID link to core point  
-			}
-		}
-	}
-	for (int i = 0; i<numCorePoint; i++){
-		stack<point*> ps;
-		if (corePoint[i].visited == 1) continue;
-		clusterID++;
-		corePoint[i].cluster = clusterID; //create a new cluster  
-		ps.push(&corePoint[i]);
-		point *v;
-		while (!ps.empty()){
-			v = ps.top();
-			v->visited = 1;
-			ps.pop();
-			for (int j = 0; j<v->corepts.size(); j++){
-				if (corePoint[v->corepts[j]].visited == 1) continue;
-				corePoint[v->corepts[j]].cluster = corePoint[i].cluster;
-				corePoint[v->corepts[j]].visited = 1;
-				ps.push(&corePoint[v->corepts[j]]);
-			}
-		}
-
-	}
-
-	//cout << "border point,joint border point to core point" << endl;
-	//border point,joint border point to core point  
-	for (int i = 0; i<len; i++){
-		for (int j = 0; j<numCorePoint; j++){
-			float distTemp = distP2P[i][corePoint[j].corePointID];
-			if (distTemp <= Eps) {
-				dataset[i].pointType = pointType_BORDER;
-				dataset[i].cluster = corePoint[j].cluster;
-				break;
-			}
-		}
-	}
-	//cout << "output" << endl;
-	//output  
-	//display    
-	//save in .txt format named clustering.txt  
-	//fstream clustering;//save .txt  
-	//clustering.open("clustering.txt", ios::out);//save .txt  
-
-	char dispInfo[500];
-	int dataDim = dataset[0].xn.size();//data dimension  
-	//for (int i = 0; i<len; i++){
-	//	//%11.4lf,%11.4lf,%11.4lf,%11.4lf  
-	//	sprintf(dispInfo, "%3dݣ", i + 1);
-	//	for (int j = 0; j<dataDim; j++){
-	//		char dataSrc[30];
-	//		if (j == 0)
-	//			sprintf(dataSrc, "%11.4lf", dataset[i].xn[j]);
-	//		else
-	//			sprintf(dataSrc, ",%11.4lf", dataset[i].xn[j]);
-	//		strcat(dispInfo, dataSrc);
-	//	}
-	//	char dataClust[30];
-	//	sprintf(dataClust, ",%4d\n", dataset[i].cluster);
-	//	strcat(dispInfo, dataClust);
-	//	//trace(5, "%s\n", dispInfo);
-	//	//cout << dispInfo;      //display in cmd window  
-	//	//clustering << dispInfo;//save the results in .txt format named clustering.txt  
-
-	//}
-	//clustering.close();//save .txt  
-
-	for (int i = 0; i < dataset.size(); i++)
-	{
-		//printf("%d: %d \n", i,dataset[i].cluster);
-		if (dataset[i].cluster != 1)continue;
-		mean_t += (dataset[i].xn[0] - mean_t) / ++n;
-	}
-	return mean_t;
-}
\ No newline at end of file
@@ -1,59 +1,23 @@
-#if !defined(_DBSCAN_H_INCLUDED_)  
-#define _DBSCAN_H_INCLUDED_  
-
-#include <iostream>  
-#include <sstream>  
-#include <fstream>  
-#include <vector>  
-#include <ctime>  
-#include <cstdlib>  
-#include <limits>  
-#include <cmath>  
-#include <stack>  
-#include <map>  
-
-using namespace std;
-
-enum
-{
-	pointType_UNDO,
-	pointType_NOISE,
-	pointType_BORDER,
-	pointType_CORE
-
-};
-
-class point{
-public:
-	float x;
-	float y;
-	vector<float> xn;
-	//vector<float> yn;  
-	int cluster;
-	int pointType;  //1 noise 2 border 3 core  
-	int pts;        //points in MinPts   
-	int corePointID;
-	vector<int> corepts;
-	int  visited;
-	void init();
-	point();
-	point(float a, float b, int c){
-		x = a;
-		y = b;
-		cluster = c;
-	};
-	point(vector<float>  an, int c){//three or more dimension  
-		xn = an;
-		cluster = c;
-	};
-};
-
-
-float stringToFloat(string i);
-vector<point> openFile(const char* dataset);
-float squareDistance(point a, point b);
-float squareDistanceVect(point a, point b);
-double  DBSCAN(vector<point> dataset, float Eps, int MinPts);
-
-
-#endif  
\ No newline at end of file
+/*------------------------------------------------------------------------------
+* DBSCAN.h : density-based clustering (dbscan) header
+*
+* version : $Revision:$ $Date:$
+* history : 2026/10/18 1.0  rebuilt on uniform grid, reentrant
+*-----------------------------------------------------------------------------*/
+#ifndef _DBSCAN_H_INCLUDED_
+#define _DBSCAN_H_INCLUDED_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DBSCAN_MAXDIM 3                 /* max dimension of points */
+
+/* dbscan clustering ---------------------------------------------------------*/
+extern int dbscan(const double *x, int n, int dim, double eps, int minpts,
+                  int nthread, int *cluster, unsigned char *core);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _DBSCAN_H_INCLUDED_ */
@@ -286,108 +286,300 @@ static int on_jrc_file(
 
 
 /********************************************************************************************************************/
-extern double ionmodel_nequick(double * galionpar,int month, double UTC, double usr_longitude_degree, double usr_latitude_degree, double usr_height_meters,
-	double sat_longitude_degree, double sat_latitude_degree, double sat_height_meters) {
-
-  volatile int ret = NEQUICK_OK;
+#ifdef _WIN32
+#define NEQUICK_THREADLOCAL __declspec(thread)
+#define NEQUICK_PATH_SEP '\\'
+#else
+#define NEQUICK_THREADLOCAL __thread
+#define NEQUICK_PATH_SEP '/'
+#endif
 
-  volatile NeQuickG_handle nequick = NEQUICKG_INVALID_HANDLE;
-  static int first = 1;
-  static NeQuickG_handle nequick_;
+/* NeQuick-G context of a thread: library handle and the inputs last set in it.
+ * Inputs are only pushed to the library when they change, so the time (solar
+ * declination) and month/UT/Az (CCIR Fourier coefficients) dependent parts
+ * cached by the library are shared by all satellites of an epoch */
+typedef struct {
+	NeQuickG_handle handle;     /* library handle (NEQUICKG_INVALID_HANDLE: none) */
+	int stat;                   /* 0: not initialized, 1: ok, -1: init error */
+	double coef[3];             /* solar activity coefficients set */
+	int month;                  /* month set (0: none) */
+	double utc;                 /* UT set (hours) */
+	double usr[3];              /* receiver position set {lon,lat,h} (deg,deg,m) */
+	int usr_valid;              /* receiver position set flag */
+	int mode;                   /* integration mode set (NEQUICKG_INTEGRATION_???) */
+} nequick_ctx_t;
+
+static NEQUICK_THREADLOCAL nequick_ctx_t nequick_ctx;
+static char nequick_data_dir[MAX_PATH];  /* MODIP/CCIR directory ("": executable dir + NQfile) */
+static int nequick_mode;                 /* STEC integration mode (0:reference,1:fast,2:fast+grid) */
+
+/* set NeQuick-G data directory --------------------------------------------------
+ * directory containing modip/modip2001_wrapped.asc and ccir/ccirXX.asc. not used
+ * when MODIP/CCIR tables are built in (FTR_MODIP_CCIR_AS_CONSTANTS). call before
+ * the first ionmodel_nequick() of a thread
+ *-------------------------------------------------------------------------------*/
+extern void ionmodel_nequick_setdir(const char *dir) {
+	strncpy(nequick_data_dir, dir ? dir : "", MAX_PATH - 1);
+	nequick_data_dir[MAX_PATH - 1] = '\0';
+}
 
+/* set NeQuick-G STEC integration mode -------------------------------------------
+ * 0: reference (adaptive Kronrod G7-K15 with the tolerances of the specification)
+ * 1: fast (fixed order G7-K15 quadrature with error estimate)
+ * 2: fast + profiles tabulated on a lat/lon grid per epoch (pays off when many
+ *    rays of an epoch cross the same region)
+ * see ionmodel_nequick_bench() for the error and the speedup. applied to the
+ * contexts of all threads at their next call
+ *-------------------------------------------------------------------------------*/
+extern void ionmodel_nequick_setmode(int mode) {
+	nequick_mode = mode;
+}
 
-  if (first) {
-	  char BufferFileName[MAX_PATH];//MAX_PATHϵͳĺ궨
-	  memset(BufferFileName, 0, MAX_PATH);
-	  /*if (!GetModuleFileName(NULL, BufferFileName, MAX_PATH))
-	  {
-		  return 0.0;
-	  }*/
+/* library integration mode flags of a mode */
+static int nequick_lib_mode(int mode) {
+	switch (mode) {
+		case 1: return NEQUICKG_INTEGRATION_FIXED_ORDER;
+		case 2: return NEQUICKG_INTEGRATION_FIXED_ORDER | NEQUICKG_INTEGRATION_PROFILE_GRID;
+	}
+	return NEQUICKG_INTEGRATION_REFERENCE;
+}
 
-      // 滻 GetModuleFileName
+#ifndef FTR_MODIP_CCIR_AS_CONSTANTS
+/* default data directory: NQfile next to the executable */
+static int nequick_default_dir(char *dir, size_t size) {
+	char exe[MAX_PATH] = { 0 }, *p;
 #ifdef _WIN32
-      if (!GetModuleFileName(NULL, BufferFileName, MAX_PATH))
-      {
-          return 0.0;
-      }
+	if (!GetModuleFileName(NULL, exe, MAX_PATH)) return 0;
+	if (!(p = strrchr(exe, '\\'))) return 0;
 #else
-  // Linux 磺
-      char path[MAX_PATH];
-      ssize_t len = readlink("/proc/self/exe", BufferFileName, sizeof(path) - 1);
-      if (len = -1)
-      {
-          return 0.0;
-      }
-      else
-      {
-          BufferFileName[len] = '\0'; // ȷַ null β
-	  
-      }
+	ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	if (len <= 0) return 0;
+	exe[len] = '\0';
+	if (!(p = strrchr(exe, '/'))) return 0;
+#endif
+	p[1] = '\0';
+	if (strlen(exe) + strlen("NQfile") + 1 > size) return 0;
+	sprintf(dir, "%sNQfile", exe);
+	return 1;
+}
 #endif
 
-	  (strrchr(BufferFileName, '\\'))[1] = 0;
-
-	  char pModip_file[1024];
-	  char pCCIR_directory[1024];
-	  strcpy(pModip_file, BufferFileName);
-	  strcat(pModip_file, "\\NQfile\\modip\\modip2001_wrapped.asc");
-	  strcpy(pCCIR_directory, BufferFileName);
-	  strcat(pCCIR_directory, "\\NQfile\\ccir");
-
+/* initialize NeQuick-G context of the thread */
+static int nequick_init(nequick_ctx_t *ctx) {
+	NeQuickG_handle handle = NEQUICKG_INVALID_HANDLE;
 
-	  // NeQuickG_handle nequick_;
-	  ret = NeQuickG.init(pModip_file, pCCIR_directory, &nequick_);
-	  if (ret != NEQUICK_OK) {
-		  NeQuick_exception_throw(
-			  NEQUICK_USAGE_EXCEPTION, NEQUICK_USAGE_BAD_FORMAT);
-	  }
-	  first = 0;
-  }
-    nequick = nequick_;
+	if (ctx->stat) return ctx->stat > 0;
+	ctx->stat = -1;
 
-	double_t TEC_expected = 0.0;
-	size_t coef_count = NEQUICKG_AZ_COEFFICIENTS_COUNT;
+#ifndef FTR_MODIP_CCIR_AS_CONSTANTS
+	char dir[MAX_PATH], pModip_file[MAX_PATH + 64], pCCIR_directory[MAX_PATH + 64];
 
-	double coef[3];
-	//coef[3] = { 236.831641, -0.39362878, 0.00402826613 };
-	for (int i = 0; i < 3; i++) {
-		coef[i] = galionpar[i];
+	if (*nequick_data_dir) {
+		strcpy(dir, nequick_data_dir);
+		if (dir[strlen(dir) - 1] == '\\' || dir[strlen(dir) - 1] == '/') dir[strlen(dir) - 1] = '\0';
 	}
+	else if (!nequick_default_dir(dir, sizeof(dir))) {
+		return 0;
+	}
+	sprintf(pModip_file, "%s%cmodip%cmodip2001_wrapped.asc", dir, NEQUICK_PATH_SEP, NEQUICK_PATH_SEP);
+	sprintf(pCCIR_directory, "%s%cccir", dir, NEQUICK_PATH_SEP);
 
-	if (NeQuickG.set_solar_activity_coefficients(
-		nequick,
-		coef, coef_count) != NEQUICK_OK) {
-		printf("ECOEF rror!\n");
+	if (NeQuickG.init(pModip_file, pCCIR_directory, &handle) != NEQUICK_OK) {
+		return 0;
+	}
+#else
+	if (NeQuickG.init(NULL, NULL, &handle) != NEQUICK_OK) {
+		return 0;
 	}
+#endif
+	ctx->handle = handle;
+	ctx->month = 0;
+	ctx->usr_valid = 0;
+	ctx->mode = NEQUICKG_INTEGRATION_REFERENCE;
+	ctx->coef[0] = ctx->coef[1] = ctx->coef[2] = NAN;
+	ctx->stat = 1;
+	return 1;
+}
 
-	//1 20 307.19 5.25 -25.76 10.94 44.72 20450566.19 381.63445
+/* free NeQuick-G context of the calling thread ---------------------------------*/
+extern void ionmodel_nequick_free(void) {
+	if (nequick_ctx.stat > 0) NeQuickG.close(nequick_ctx.handle);
+	memset(&nequick_ctx, 0, sizeof(nequick_ctx));
+}
 
-	if (NeQuickG.set_time(nequick, (uint8_t)month, UTC) != NEQUICK_OK) {
-		printf("DATE&TIME rror!\n");
-	}
+/* set integration mode of the context if changed */
+static int nequick_set_mode(nequick_ctx_t *ctx, int mode) {
+	if (mode == ctx->mode) return 1;
+	if (NeQuickG.set_integration_mode(ctx->handle, (uint8_t)mode) != NEQUICK_OK) return 0;
+	ctx->mode = mode;
+	return 1;
+}
 
+/* set epoch and receiver dependent inputs of the context if changed */
+static int nequick_set_epoch(nequick_ctx_t *ctx, const double *galionpar, int month, double UTC,
+	double usr_longitude_degree, double usr_latitude_degree, double usr_height_meters) {
+
+	if (galionpar[0] != ctx->coef[0] || galionpar[1] != ctx->coef[1] || galionpar[2] != ctx->coef[2]) {
+		double coef[3] = { galionpar[0], galionpar[1], galionpar[2] };
+		if (NeQuickG.set_solar_activity_coefficients(ctx->handle, coef, NEQUICKG_AZ_COEFFICIENTS_COUNT) != NEQUICK_OK) {
+			ctx->coef[0] = NAN;
+			return 0;
+		}
+		ctx->coef[0] = coef[0]; ctx->coef[1] = coef[1]; ctx->coef[2] = coef[2];
+	}
+	if (month != ctx->month || UTC != ctx->utc) {
+		if (NeQuickG.set_time(ctx->handle, (uint8_t)month, UTC) != NEQUICK_OK) {
+			ctx->month = 0;
+			return 0;
+		}
+		ctx->month = month; ctx->utc = UTC;
+	}
+	if (!ctx->usr_valid || usr_longitude_degree != ctx->usr[0] || usr_latitude_degree != ctx->usr[1] ||
+		usr_height_meters != ctx->usr[2]) {
+		ctx->usr_valid = 0;
+		if (NeQuickG.set_receiver_position(ctx->handle, usr_longitude_degree, usr_latitude_degree,
+			usr_height_meters) != NEQUICK_OK) {
+			return 0;
+		}
+		ctx->usr[0] = usr_longitude_degree; ctx->usr[1] = usr_latitude_degree; ctx->usr[2] = usr_height_meters;
+		ctx->usr_valid = 1;
+	}
+	return 1;
+}
 
+/* NeQuick-G STEC of satellites of an epoch ----------------------------------------
+ * args   : double *galionpar   I   solar activity coefficients {ai0,ai1,ai2}
+ *          int    month        I   month (1-12)
+ *          double UTC          I   UT (hours)
+ *          double usr_*        I   receiver longitude, latitude (deg) and height (m)
+ *          double *sat         I   satellite {lon,lat,h} (deg,deg,m) sat[(0:2)+i*3]
+ *          int    n            I   number of satellites
+ *          double *stec        O   STEC (TECU) (0.0: error)
+ * return : number of satellites with STEC
+ * notes  : the context of the calling thread is used, so the function can be
+ *          called from several threads at the same time
+ *-------------------------------------------------------------------------------*/
+extern int ionmodel_nequicks(const double *galionpar, int month, double UTC, double usr_longitude_degree,
+	double usr_latitude_degree, double usr_height_meters, const double *sat, int n, double *stec) {
+
+	nequick_ctx_t *ctx = &nequick_ctx;
+	double_t tec;
+	int i, nok = 0;
+
+	for (i = 0; i < n; i++) stec[i] = 0.0;
+
+	if (!nequick_init(ctx) ||
+		!nequick_set_mode(ctx, nequick_lib_mode(nequick_mode)) ||
+		!nequick_set_epoch(ctx, galionpar, month, UTC, usr_longitude_degree, usr_latitude_degree,
+			usr_height_meters)) {
+		return 0;
+	}
+	for (i = 0; i < n; i++) {
+		if (NeQuickG.set_satellite_position(ctx->handle, sat[i * 3], sat[1 + i * 3], sat[2 + i * 3]) != NEQUICK_OK ||
+			NeQuickG.get_total_electron_content(ctx->handle, &tec) != NEQUICK_OK) {
+			continue;
+		}
+		stec[i] = tec;
+		nok++;
+	}
+	return nok;
+}
 
-	if (NeQuickG.set_receiver_position(
-		nequick,
-		usr_longitude_degree,
-		usr_latitude_degree,
-		usr_height_meters) != NEQUICK_OK) {
-		printf("USR POS rror!\n");
+/* STEC of satellites in an integration mode, cpu time (s) in *t */
+static int nequick_stecs(nequick_ctx_t *ctx, int mode, const double *sat, int n, double *stec,
+	double *err, double *t) {
+	clock_t begin = clock();
+	double_t tec;
+	int i, nok = 0;
+
+	/* new epoch for the tabulated profiles */
+	if (NeQuickG.set_integration_mode(ctx->handle, (uint8_t)mode) != NEQUICK_OK) return 0;
+	ctx->mode = mode;
+
+	for (i = 0; i < n; i++) {
+		stec[i] = err[i] = 0.0;
+		if (NeQuickG.set_satellite_position(ctx->handle, sat[i * 3], sat[1 + i * 3], sat[2 + i * 3]) != NEQUICK_OK ||
+			NeQuickG.get_total_electron_content(ctx->handle, &tec) != NEQUICK_OK) {
+			continue;
+		}
+		stec[i] = tec;
+		err[i] = NeQuickG.get_integration_error(ctx->handle);
+		nok++;
 	}
+	*t += (double)(clock() - begin) / CLOCKS_PER_SEC;
+	return nok;
+}
 
-	if (NeQuickG.set_satellite_position(
-		nequick,
-		sat_longitude_degree,
-		sat_latitude_degree,
-		sat_height_meters) != NEQUICK_OK) {
-		printf("SAT POS rror!\n");
+/* benchmark fast NeQuick-G STEC mode against the reference mode ------------------
+ * args   : double *galionpar   I   solar activity coefficients {ai0,ai1,ai2}
+ *          int    month        I   month (1-12)
+ *          double UTC          I   UT (hours)
+ *          double usr_*        I   receiver longitude, latitude (deg) and height (m)
+ *          double *sat         I   satellite {lon,lat,h} (deg,deg,m) sat[(0:2)+i*3]
+ *          int    n            I   number of satellites
+ *          int    mode         I   fast mode to compare (1 or 2, see ionmodel_nequick_setmode())
+ *          int    nrep         I   number of repetitions for timing
+ *          double *stat        O   statistics of the fast mode
+ *                                  stat[0]: max abs error (TECU)
+ *                                  stat[1]: rms error (TECU)
+ *                                  stat[2]: max error estimate (TECU)
+ *                                  stat[3]: reference cpu time per satellite (ms)
+ *                                  stat[4]: fast cpu time per satellite (ms)
+ *                                  stat[5]: speedup (reference/fast time)
+ * return : number of satellites compared
+ * notes  : every repetition starts a new epoch, so the fast time includes the
+ *          tabulation of the profiles of the epoch (mode 2)
+ *-------------------------------------------------------------------------------*/
+extern int ionmodel_nequick_bench(const double *galionpar, int month, double UTC, double usr_longitude_degree,
+	double usr_latitude_degree, double usr_height_meters, const double *sat, int n, int mode, int nrep,
+	double *stat) {
+
+	nequick_ctx_t *ctx = &nequick_ctx;
+	double *ref, *fast, *err, tref = 0.0, tfast = 0.0, d;
+	int i, j, nc = 0, mode0 = ctx->mode;
+
+	for (i = 0; i < 6; i++) stat[i] = 0.0;
+
+	if (n <= 0 || nrep <= 0 ||
+		!nequick_init(ctx) ||
+		!nequick_set_epoch(ctx, galionpar, month, UTC, usr_longitude_degree, usr_latitude_degree,
+			usr_height_meters)) {
+		return 0;
 	}
+	if (!(ref = (double *)malloc(sizeof(double) * n * 3))) return 0;
+	fast = ref + n; err = fast + n;
 
-	if (!get_TEC(nequick, &TEC_expected)) {
-		return 0.0;
+	for (j = 0; j < nrep; j++) {
+		nequick_stecs(ctx, NEQUICKG_INTEGRATION_REFERENCE, sat, n, ref, err, &tref);
+		nequick_stecs(ctx, nequick_lib_mode(mode), sat, n, fast, err, &tfast);
 	}
-   return TEC_expected;
+	for (i = 0; i < n; i++) {
+		if (ref[i] == 0.0 || fast[i] == 0.0) continue;
+		d = fabs(fast[i] - ref[i]);
+		if (d > stat[0]) stat[0] = d;
+		if (err[i] > stat[2]) stat[2] = err[i];
+		stat[1] += d * d;
+		nc++;
+	}
+	if (nc > 0) stat[1] = sqrt(stat[1] / nc);
+	stat[3] = tref * 1E3 / nrep / n;
+	stat[4] = tfast * 1E3 / nrep / n;
+	stat[5] = tfast > 0.0 ? tref / tfast : 0.0;
+
+	nequick_set_mode(ctx, mode0);
+	free(ref);
+	return nc;
+}
+
+extern double ionmodel_nequick(double * galionpar,int month, double UTC, double usr_longitude_degree, double usr_latitude_degree, double usr_height_meters,
+	double sat_longitude_degree, double sat_latitude_degree, double sat_height_meters) {
+
+	double sat[3] = { sat_longitude_degree, sat_latitude_degree, sat_height_meters }, stec = 0.0;
+
+	ionmodel_nequicks(galionpar, month, UTC, usr_longitude_degree, usr_latitude_degree, usr_height_meters,
+		sat, 1, &stec);
+
+	return stec;
 }
 
 #undef NEQUICK_UNIT_TEST_EXCEPTION
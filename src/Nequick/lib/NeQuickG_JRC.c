@@ -125,6 +125,10 @@ static int32_t init(
     return ret;
   }
 
+  pContext->integration.mode = NEQUICKG_INTEGRATION_REFERENCE;
+  pContext->integration.error_estimate = 0.0;
+  profile_grid_init(&pContext->integration.grid);
+
   return NEQUICK_OK;
 }
 
@@ -249,6 +253,42 @@ static int32_t set_satellite_position(
     NEQUICK_G_JRC_HEIGHT_UNITS_METERS);
 }
 
+/** {@ref NeQuickG_library.set_integration_mode} */
+static int32_t set_integration_mode(
+  const NeQuickG_handle handle,
+  const uint8_t mode) {
+
+  int32_t ret = check_handle(handle);
+  if (ret != NEQUICK_OK) {
+    return ret;
+  }
+
+  if (mode &
+      ~(NEQUICKG_INTEGRATION_FIXED_ORDER | NEQUICKG_INTEGRATION_PROFILE_GRID)) {
+    NEQUICK_ERROR_RETURN(
+      NEQUICK_ERROR_SRC_INPUT_DATA,
+      NEQUICK_ERROR_CODE_BAD_INTEGRATION_MODE,
+      "integration mode not valid: %u", (unsigned int)mode);
+  }
+
+  NeQuickG_context_t* pContext = (NeQuickG_context_t*)(handle);
+  pContext->integration.mode = mode;
+  pContext->integration.error_estimate = 0.0;
+  profile_grid_init(&pContext->integration.grid);
+
+  return NEQUICK_OK;
+}
+
+/** {@ref NeQuickG_library.get_integration_error} */
+static double_t get_integration_error(NeQuickG_chandle handle) {
+  if (handle == NEQUICKG_INVALID_HANDLE) {
+    return 0.0;
+  }
+  // Eq. 151, same scale factor as the TEC
+  return ((const NeQuickG_context_t* const)handle)->
+    integration.error_estimate / 1.0E13;
+}
+
 /** {@ref NeQuickG_library.input_data_to_std_output} */
 static void input_data_to_std_output_impl(NeQuickG_chandle handle) {
   if (handle == NEQUICKG_INVALID_HANDLE) {
@@ -304,6 +344,8 @@ const struct NeQuickG_library NeQuickG = {
   .set_satellite_position = set_satellite_position,
   .get_modip = get_modip_interface,
   .get_total_electron_content = get_total_electron_content,
+  .set_integration_mode = set_integration_mode,
+  .get_integration_error = get_integration_error,
   .input_data_to_std_output = input_data_to_std_output_impl,
   .input_data_to_output = input_data_to_output_impl,
 #ifdef FTR_UNIT_TEST
@@ -124,14 +124,13 @@ static int32_t get_total_electron_content(
   }
 }
 
-int32_t Gauss_Kronrod_integrate(
-  gauss_kronrod_context_t* const pContext,
+/** Applies the G7 and K15 rules between two points */
+static int32_t Gauss_Kronrod_rule(
   NeQuickG_context_t* const pNequick_Context,
   const double_t point_1_height_km,
   const double_t point_2_height_km,
-  double_t* const pResult) {
-
-  *pResult = 0.0;
+  double_t* const pK15_integration,
+  double_t* const pG7_integration) {
 
   double_t mid_point = (point_1_height_km + point_2_height_km) / 2.0;
   double_t half_diff = (point_2_height_km - point_1_height_km) / 2.0;
@@ -161,8 +160,70 @@ int32_t Gauss_Kronrod_integrate(
     }
   }
 
-  K15_integration *= half_diff;
-  G7_integration *= half_diff;
+  *pK15_integration = K15_integration * half_diff;
+  *pG7_integration = G7_integration * half_diff;
+  return NEQUICK_OK;
+}
+
+int32_t Gauss_Kronrod_integrate_fixed(
+  NeQuickG_context_t* const pNequick_Context,
+  const double_t point_1_height_km,
+  const double_t point_2_height_km,
+  const size_t interval_count,
+  double_t* const pResult,
+  double_t* const pError) {
+
+  *pResult = 0.0;
+  *pError = 0.0;
+
+  double_t interval_km =
+    (point_2_height_km - point_1_height_km) / (double_t)interval_count;
+
+  size_t i;
+  for (i = 0; i < interval_count; i++) {
+
+    double_t K15_integration, G7_integration;
+
+    int32_t ret = Gauss_Kronrod_rule(
+      pNequick_Context,
+      point_1_height_km + (interval_km * i),
+      (i == interval_count - 1) ?
+        point_2_height_km :
+        point_1_height_km + (interval_km * (i + 1)),
+      &K15_integration,
+      &G7_integration);
+    if (ret != NEQUICK_OK) {
+      return ret;
+    }
+
+    *pResult += K15_integration;
+    *pError += fabs(K15_integration - G7_integration);
+  }
+  return NEQUICK_OK;
+}
+
+int32_t Gauss_Kronrod_integrate(
+  gauss_kronrod_context_t* const pContext,
+  NeQuickG_context_t* const pNequick_Context,
+  const double_t point_1_height_km,
+  const double_t point_2_height_km,
+  double_t* const pResult) {
+
+  *pResult = 0.0;
+
+  double_t half_diff = (point_2_height_km - point_1_height_km) / 2.0;
+
+  double_t K15_integration, G7_integration;
+
+  int32_t ret = Gauss_Kronrod_rule(
+    pNequick_Context,
+    point_1_height_km,
+    point_2_height_km,
+    &K15_integration,
+    &G7_integration);
+  if (ret != NEQUICK_OK) {
+    return ret;
+  }
 
   if (is_error_within_tolerance(
     pContext,
@@ -186,8 +247,6 @@ int32_t Gauss_Kronrod_integrate(
 
     double_t result;
 
-    int32_t ret;
-
     ret = Gauss_Kronrod_integrate(
       pContext,
       pNequick_Context,
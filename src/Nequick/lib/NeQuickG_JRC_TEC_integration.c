@@ -49,6 +49,15 @@
 /** Kronrod G7-K15 integration maximum recursion level */
 #define NEQUICK_G_JRC_RECURSION_LIMIT_MAX (50)
 
+/** Fixed order integration: maximum interval length along the ray
+ * for the paths integrated with the tolerance below 1000 km
+ */
+#define NEQUICK_G_JRC_INTEGRATION_FIXED_STEP_BELOW_FIRST_POINT_KM (1000.0)
+/** Fixed order integration: maximum interval length along the ray
+ * for the paths integrated with the tolerance above 1000 km
+ */
+#define NEQUICK_G_JRC_INTEGRATION_FIXED_STEP_ABOVE_FIRST_POINT_KM (30000.0)
+
 static double_t get_point_height(
   const NeQuickG_context_t* const pContext,
   double_t height_km) {
@@ -74,6 +83,32 @@ static int32_t Gauss_Kronrod_integrate_impl(
   const double_t point_2_height_km,
   double_t* const pTEC) {
 
+  if (pNequick_Context->integration.mode & NEQUICKG_INTEGRATION_FIXED_ORDER) {
+    // fixed order: the tighter tolerance gets the shorter intervals
+    double_t step_km =
+      (pContext->tolerance <
+       NEQUICK_G_JRC_INTEGRATION_KRONROD_TOLERANCE_ABOVE_FIRST_POINT) ?
+      NEQUICK_G_JRC_INTEGRATION_FIXED_STEP_BELOW_FIRST_POINT_KM :
+      NEQUICK_G_JRC_INTEGRATION_FIXED_STEP_ABOVE_FIRST_POINT_KM;
+
+    size_t interval_count =
+      (size_t)ceil(fabs(point_2_height_km - point_1_height_km) / step_km);
+    if (interval_count < 1) {
+      interval_count = 1;
+    }
+
+    double_t error;
+    int32_t ret = Gauss_Kronrod_integrate_fixed(
+      pNequick_Context,
+      point_1_height_km,
+      point_2_height_km,
+      interval_count,
+      pTEC,
+      &error);
+    pNequick_Context->integration.error_estimate += error;
+    return ret;
+  }
+
   pContext->recursion_level = 0;
   pContext->recursion_max = NEQUICK_G_JRC_RECURSION_LIMIT_MAX;
 
@@ -377,6 +412,15 @@ int32_t NeQuickG_integrate(
   int32_t ret;
   *pTEC = 0.0;
 
+  pContext->integration.error_estimate = 0.0;
+
+  if (pContext->integration.mode & NEQUICKG_INTEGRATION_PROFILE_GRID) {
+    profile_grid_set_epoch(
+      &pContext->integration.grid,
+      &pContext->input_data.time,
+      &pContext->solar_activity);
+  }
+
   if (pContext->ray.is_vertical) {
     ret = ray_vertical_get_profile(pContext);
     if (ret != NEQUICK_OK) {
@@ -406,6 +450,8 @@ int32_t NeQuickG_integrate(
 }
 
 #undef NEQUICK_G_JRC_RECURSION_LIMIT_MAX
+#undef NEQUICK_G_JRC_INTEGRATION_FIXED_STEP_BELOW_FIRST_POINT_KM
+#undef NEQUICK_G_JRC_INTEGRATION_FIXED_STEP_ABOVE_FIRST_POINT_KM
 #undef IS_SATELLITE_BELOW_FIRST_POINT
 #undef IS_SATELLITE_BELOW_SECOND_POINT
 #undef IS_RECEIVER_ABOVE_FIRST_POINT
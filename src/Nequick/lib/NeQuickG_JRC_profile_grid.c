@@ -0,0 +1,258 @@
+/** NeQuickG ionospheric profiles tabulated on a latitude/longitude grid.
+ *
+ * @ingroup NeQuickG_JRC
+ * @copyright Joint Research Centre (JRC), 2019<br>
+ *  This software has been released as free and open source software
+ *  under the terms of the European Union Public Licence (EUPL), version 1.<br>
+ *  Questions? Submit your query at https://www.gsc-europa.eu/contact-us/helpdesk
+ * @file
+ */
+#include "NeQuickG_JRC_profile_grid.h"
+
+#include <string.h>
+
+#include "NeQuickG_JRC.h"
+#include "NeQuickG_JRC_electron_density.h"
+#include "NeQuickG_JRC_geometry.h"
+
+/** Number of latitude intervals of the grid */
+#define NEQUICK_G_JRC_PROFILE_GRID_LATITUDE_COUNT \
+  ((int32_t)(180.0 / NEQUICK_G_JRC_PROFILE_GRID_LATITUDE_STEP_DEGREE + 0.5))
+
+/** Number of longitude intervals of the grid */
+#define NEQUICK_G_JRC_PROFILE_GRID_LONGITUDE_COUNT \
+  ((int32_t)(NEQUICK_G_JRC_CIRCLE_DEGREES / \
+             NEQUICK_G_JRC_PROFILE_GRID_LONGITUDE_STEP_DEGREE + 0.5))
+
+/** Maximum number of slots probed in the hash table */
+#define NEQUICK_G_JRC_PROFILE_GRID_PROBE_MAX (16)
+
+void profile_grid_init(profile_grid_t* const pGrid) {
+  memset(pGrid, 0, sizeof(*pGrid));
+}
+
+void profile_grid_set_epoch(
+  profile_grid_t* const pGrid,
+  const NeQuickG_time_t* const pTime,
+  const solar_activity_t* const pSolar_activity) {
+
+  if ((pGrid->epoch != 0) &&
+      (pGrid->time.month == pTime->month) &&
+      (pGrid->time.utc == pTime->utc) &&
+      (pGrid->effective_ionisation_level_sfu ==
+       pSolar_activity->effective_ionisation_level_sfu)) {
+    return;
+  }
+
+  pGrid->epoch++;
+  if (pGrid->epoch == 0) {
+    // stamp wrapped around, old stamps could become valid again
+    memset(pGrid->node, 0, sizeof(pGrid->node));
+    pGrid->epoch = 1;
+  }
+  pGrid->time = *pTime;
+  pGrid->effective_ionisation_level_sfu =
+    pSolar_activity->effective_ionisation_level_sfu;
+  pGrid->node_count = 0;
+}
+
+static size_t get_hash(int32_t latitude_index, int32_t longitude_index) {
+  uint32_t key =
+    ((uint32_t)latitude_index * 73856093u) ^
+    ((uint32_t)longitude_index * 19349663u);
+  return (size_t)(key & (NEQUICK_G_JRC_PROFILE_GRID_NODE_COUNT - 1));
+}
+
+static int32_t get_node_profile(
+  profile_grid_node_t* const pNode,
+  iono_profile_t* const pProfile,
+  const NeQuickG_time_t* const pTime,
+  modip_context_t* const pModip,
+  const solar_activity_t* const pSolar_activity,
+  const double_t height_km) {
+
+  position_t position;
+
+  int32_t ret = position_set(
+    &position,
+    pNode->longitude_index * NEQUICK_G_JRC_PROFILE_GRID_LONGITUDE_STEP_DEGREE,
+    -90.0 +
+      (pNode->latitude_index * NEQUICK_G_JRC_PROFILE_GRID_LATITUDE_STEP_DEGREE),
+    height_km,
+    NEQUICK_G_JRC_HEIGHT_UNITS_KM);
+  if (ret != NEQUICK_OK) {
+    return ret;
+  }
+
+  ret = iono_profile_get(
+    pProfile,
+    pTime,
+    pModip,
+    pSolar_activity,
+    &position);
+  if (ret != NEQUICK_OK) {
+    return ret;
+  }
+
+  pNode->E = pProfile->E.layer;
+  pNode->F1 = pProfile->F1;
+  pNode->F2 = pProfile->F2.layer;
+  return NEQUICK_OK;
+}
+
+/** Gets the profile parameters of a node, the node profile is computed
+ * and tabulated if it is not in the grid for the current epoch
+ */
+static int32_t get_node(
+  profile_grid_t* const pGrid,
+  iono_profile_t* const pProfile,
+  const NeQuickG_time_t* const pTime,
+  modip_context_t* const pModip,
+  const solar_activity_t* const pSolar_activity,
+  int32_t latitude_index,
+  int32_t longitude_index,
+  const double_t height_km,
+  profile_grid_node_t* const pNode) {
+
+  profile_grid_node_t* pSlot_free = NULL;
+
+  size_t slot = get_hash(latitude_index, longitude_index);
+  size_t i;
+  for (i = 0; i < NEQUICK_G_JRC_PROFILE_GRID_PROBE_MAX; i++) {
+    profile_grid_node_t* const pSlot = &pGrid->node[slot];
+    if (pSlot->epoch != pGrid->epoch) {
+      pSlot_free = pSlot;
+      break;
+    }
+    if ((pSlot->latitude_index == latitude_index) &&
+        (pSlot->longitude_index == longitude_index)) {
+      *pNode = *pSlot;
+      return NEQUICK_OK;
+    }
+    slot = (slot + 1) & (NEQUICK_G_JRC_PROFILE_GRID_NODE_COUNT - 1);
+  }
+
+  pNode->latitude_index = latitude_index;
+  pNode->longitude_index = longitude_index;
+  pNode->epoch = pGrid->epoch;
+
+  int32_t ret = get_node_profile(
+    pNode, pProfile, pTime, pModip, pSolar_activity, height_km);
+  if (ret != NEQUICK_OK) {
+    return ret;
+  }
+
+  // if the grid is full around the slot the node is not tabulated
+  if (pSlot_free) {
+    *pSlot_free = *pNode;
+    pGrid->node_count++;
+  }
+  return NEQUICK_OK;
+}
+
+static void interpolate_layer(
+  layer_t* const pLayer,
+  const layer_t* const pNode_layer[4],
+  const double_t weight[4]) {
+
+  memset(pLayer, 0, sizeof(*pLayer));
+
+  size_t i;
+  for (i = 0; i < 4; i++) {
+    pLayer->critical_frequency_MHz +=
+      weight[i] * pNode_layer[i]->critical_frequency_MHz;
+    pLayer->peak.amplitude +=
+      weight[i] * pNode_layer[i]->peak.amplitude;
+    pLayer->peak.height_km +=
+      weight[i] * pNode_layer[i]->peak.height_km;
+    pLayer->peak.thickness.top_km +=
+      weight[i] * pNode_layer[i]->peak.thickness.top_km;
+    pLayer->peak.thickness.bottom_km +=
+      weight[i] * pNode_layer[i]->peak.thickness.bottom_km;
+    pLayer->peak.electron_density +=
+      weight[i] * pNode_layer[i]->peak.electron_density;
+  }
+}
+
+int32_t profile_grid_get_electron_density(
+  profile_grid_t* const pGrid,
+  iono_profile_t* const pProfile,
+  const NeQuickG_time_t* const pTime,
+  modip_context_t* const pModip,
+  const solar_activity_t* const pSolar_activity,
+  const position_t* const pPosition,
+  double_t* const pElectron_density) {
+
+  const int32_t latitude_count = NEQUICK_G_JRC_PROFILE_GRID_LATITUDE_COUNT;
+  const int32_t longitude_count = NEQUICK_G_JRC_PROFILE_GRID_LONGITUDE_COUNT;
+
+  *pElectron_density = 0.0;
+
+  double_t latitude =
+    (pPosition->latitude.degree + 90.0) /
+    NEQUICK_G_JRC_PROFILE_GRID_LATITUDE_STEP_DEGREE;
+  double_t longitude =
+    fmod(pPosition->longitude.degree, NEQUICK_G_JRC_CIRCLE_DEGREES);
+  if (longitude < 0.0) {
+    longitude += NEQUICK_G_JRC_CIRCLE_DEGREES;
+  }
+  longitude /= NEQUICK_G_JRC_PROFILE_GRID_LONGITUDE_STEP_DEGREE;
+
+  int32_t latitude_index = (int32_t)floor(latitude);
+  if (latitude_index < 0) {
+    latitude_index = 0;
+  } else if (latitude_index > latitude_count - 1) {
+    latitude_index = latitude_count - 1;
+  }
+  int32_t longitude_index = (int32_t)floor(longitude);
+  if (longitude_index > longitude_count - 1) {
+    longitude_index = longitude_count - 1;
+  }
+
+  double_t latitude_weight = latitude - latitude_index;
+  double_t longitude_weight = longitude - longitude_index;
+
+  profile_grid_node_t node[4];
+  const layer_t* pE[4];
+  const layer_t* pF1[4];
+  const layer_t* pF2[4];
+  double_t weight[4];
+
+  size_t i;
+  for (i = 0; i < 4; i++) {
+    int32_t ret = get_node(
+      pGrid,
+      pProfile,
+      pTime,
+      pModip,
+      pSolar_activity,
+      latitude_index + (int32_t)(i & 1),
+      (longitude_index + (int32_t)(i >> 1)) % longitude_count,
+      pPosition->height,
+      &node[i]);
+    if (ret != NEQUICK_OK) {
+      return ret;
+    }
+    pE[i] = &node[i].E;
+    pF1[i] = &node[i].F1;
+    pF2[i] = &node[i].F2;
+    weight[i] =
+      ((i & 1) ? latitude_weight : 1.0 - latitude_weight) *
+      ((i >> 1) ? longitude_weight : 1.0 - longitude_weight);
+  }
+
+  // bilinear interpolation of the profile parameters, the F2 peak
+  // electron density of the nodes is not a number (see
+  // F2_layer_exosphere_adjust) so it is recomputed by electron_density_get
+  interpolate_layer(&pProfile->E.layer, pE, weight);
+  interpolate_layer(&pProfile->F1, pF1, weight);
+  interpolate_layer(&pProfile->F2.layer, pF2, weight);
+
+  *pElectron_density = electron_density_get(pProfile, pPosition->height);
+
+  return NEQUICK_OK;
+}
+
+#undef NEQUICK_G_JRC_PROFILE_GRID_LATITUDE_COUNT
+#undef NEQUICK_G_JRC_PROFILE_GRID_LONGITUDE_COUNT
+#undef NEQUICK_G_JRC_PROFILE_GRID_PROBE_MAX
@@ -10,6 +10,7 @@
  */
 #include "NeQuickG_JRC_ray_slant.h"
 
+#include "NeQuickG_JRC.h"
 #include "NeQuickG_JRC_electron_density.h"
 #include "NeQuickG_JRC_geometry.h"
 #include "NeQuickG_JRC_math_utils.h"
@@ -98,6 +99,18 @@ int32_t ray_slant_get_electron_density(
   position_t current_position =
     get_current_position(&pContext->ray, height_km);
 
+  // fast mode: interpolate from the profiles tabulated for the epoch
+  if (pContext->integration.mode & NEQUICKG_INTEGRATION_PROFILE_GRID) {
+    return profile_grid_get_electron_density(
+      &pContext->integration.grid,
+      &pContext->profile,
+      &pContext->input_data.time,
+      &pContext->modip,
+      &pContext->solar_activity,
+      &current_position,
+      pElectron_density);
+  }
+
   // recalculate ionosphere information now that the latitude and longitude have
   // changed
   int32_t ret = iono_profile_get(
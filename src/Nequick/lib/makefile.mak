@@ -33,6 +33,7 @@ SOURCEFILES += \
   NeQuickG_JRC_math_utils \
   NeQuickG_JRC_MODIP \
   NeQuickG_JRC_MODIP_grid \
+  NeQuickG_JRC_profile_grid \
   NeQuickG_JRC_ray \
   NeQuickG_JRC_ray_slant \
   NeQuickG_JRC_ray_vertical \
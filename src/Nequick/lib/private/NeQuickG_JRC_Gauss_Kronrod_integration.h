@@ -64,4 +64,29 @@ extern int32_t Gauss_Kronrod_integrate(
   const double_t point_2_height_km,
   double_t* const pTEC);
 
+/** Integration function for calculating TEC along rays using a
+ * fixed order Kronrod G<SUB>7</SUB>-K<SUB>15</SUB> quadrature.
+ * The path is split into interval_count equal intervals and the
+ * K15 rule is applied once in each of them, without recursion.
+ * The sum of the differences between the K15 and G7 results
+ * of the intervals is returned as error estimate.
+ * Used by the fast integration mode (#NEQUICKG_INTEGRATION_FIXED_ORDER).
+ *
+ * @param[in, out] pContext NeQuick-G context
+ * @param[in] point_1_height_km Height of point 1 in km
+ * @param[in] point_2_height_km Height of point 2 in km
+ * @param[in] interval_count number of intervals (>= 1)
+ * @param[out] pTEC TEC value, to get TECU divide by 10<SUP>13</SUP>
+ * @param[out] pError error estimate, same units as pTEC
+ *
+ * @return on success NEQUICK_OK
+ */
+extern int32_t Gauss_Kronrod_integrate_fixed(
+  NeQuickG_context_t* const pContext,
+  const double_t point_1_height_km,
+  const double_t point_2_height_km,
+  const size_t interval_count,
+  double_t* const pTEC,
+  double_t* const pError);
+
 #endif // NEQUICK_G_JRC_GAUSS_KRONROD_INTEGRATION_H
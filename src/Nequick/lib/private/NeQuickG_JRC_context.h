@@ -15,9 +15,22 @@
 #include "NeQuickG_JRC_input_data.h"
 #include "NeQuickG_JRC_iono_profile.h"
 #include "NeQuickG_JRC_MODIP.h"
+#include "NeQuickG_JRC_profile_grid.h"
 #include "NeQuickG_JRC_solar_activity.h"
 #include "NeQuickG_JRC_ray.h"
 
+/** STEC integration context */
+typedef struct NeQuickG_integration_st {
+  /** integration mode (NEQUICKG_INTEGRATION_xxx flags) */
+  uint8_t mode;
+  /** error estimate of the last fixed order integration,
+   * same units as the integrated electron content
+   */
+  double_t error_estimate;
+  /** profiles tabulated on a lat/lon grid for the current epoch */
+  profile_grid_t grid;
+} integration_context_t;
+
 /** This structure contains the internal context
  * of the library.
  */
@@ -32,6 +45,8 @@ typedef struct NeQuickG_context_st {
   ray_context_t ray;
   /** input data contex.*/
   input_data_t input_data;
+  /** STEC integration contex.*/
+  integration_context_t integration;
 } NeQuickG_context_t;
 
 #endif // NEQUICK_G_JRC_CONTEXT_H
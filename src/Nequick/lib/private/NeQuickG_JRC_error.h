@@ -61,6 +61,9 @@
 /** Error code: invalid Nequick handle */
 #define NEQUICK_HANDLE_NULL (11)
 
+/** Error code: invalid STEC integration mode */
+#define NEQUICK_ERROR_CODE_BAD_INTEGRATION_MODE (12)
+
 /** Log an error in the standard error.
  * @param[in] error_src error source
  * @param[in] error_code error code
@@ -0,0 +1,114 @@
+/** NeQuickG ionospheric profiles tabulated on a latitude/longitude grid.
+ *
+ * Used by the fast STEC integration mode (#NEQUICKG_INTEGRATION_PROFILE_GRID):
+ * the profile parameters (E, F1 and F2 layer peaks) only depend on the
+ * latitude and longitude of the point for a given epoch (month, UT and Az),
+ * so they are computed once per grid node and epoch and shared by all the
+ * points of all the rays integrated in that epoch.<br>
+ * The profile parameters at a point are bilinearly interpolated from the
+ * ones of the four surrounding grid nodes.<br>
+ * The grid pays off when the rays of an epoch share nodes (many satellites
+ * or receivers close to each other), otherwise the node computation costs
+ * about the same as the points saved.
+ *
+ * @ingroup NeQuickG_JRC
+ * @copyright Joint Research Centre (JRC), 2019<br>
+ *  This software has been released as free and open source software
+ *  under the terms of the European Union Public Licence (EUPL), version 1.<br>
+ *  Questions? Submit your query at https://www.gsc-europa.eu/contact-us/helpdesk
+ * @file
+ */
+#ifndef NEQUICK_G_JRC_PROFILE_GRID_H
+#define NEQUICK_G_JRC_PROFILE_GRID_H
+
+#include <math.h>
+#include <stdint.h>
+
+#include "NeQuickG_JRC_coordinates.h"
+#include "NeQuickG_JRC_iono_profile.h"
+#include "NeQuickG_JRC_iono_profile_types.h"
+#include "NeQuickG_JRC_MODIP.h"
+#include "NeQuickG_JRC_solar_activity.h"
+#include "NeQuickG_JRC_time.h"
+
+/** Grid spacing in latitude (degrees) */
+#define NEQUICK_G_JRC_PROFILE_GRID_LATITUDE_STEP_DEGREE (1.0)
+
+/** Grid spacing in longitude (degrees) */
+#define NEQUICK_G_JRC_PROFILE_GRID_LONGITUDE_STEP_DEGREE (2.0)
+
+/** Number of nodes that can be tabulated per epoch (power of 2) */
+#define NEQUICK_G_JRC_PROFILE_GRID_NODE_COUNT (2048)
+
+/** Profile parameters of a grid node */
+typedef struct profile_grid_node_st {
+  /** latitude index, latitude = -90 + index * latitude step */
+  int32_t latitude_index;
+  /** longitude index, longitude = index * longitude step */
+  int32_t longitude_index;
+  /** epoch stamp, the node is valid if it is equal to the grid one */
+  uint32_t epoch;
+  /** E layer */
+  layer_t E;
+  /** F1 layer */
+  layer_t F1;
+  /** F2 layer */
+  layer_t F2;
+} profile_grid_node_t;
+
+/** Profile grid context */
+typedef struct profile_grid_st {
+  /** current epoch stamp (0: none) */
+  uint32_t epoch;
+  /** time of the current epoch */
+  NeQuickG_time_t time;
+  /** effective ionisation level of the current epoch */
+  double_t effective_ionisation_level_sfu;
+  /** number of nodes tabulated in the current epoch */
+  size_t node_count;
+  /** nodes (open addressing hash table) */
+  profile_grid_node_t node[NEQUICK_G_JRC_PROFILE_GRID_NODE_COUNT];
+} profile_grid_t;
+
+/** Initializes the grid, no node is tabulated.
+ *
+ * @param[out] pGrid profile grid context
+ */
+extern void profile_grid_init(profile_grid_t* const pGrid);
+
+/** Sets the epoch of the grid.
+ * The tabulated nodes are discarded if the time or the
+ * effective ionisation level have changed.
+ *
+ * @param[in, out] pGrid profile grid context
+ * @param[in] pTime time context
+ * @param[in] pSolar_activity solar activity context
+ */
+extern void profile_grid_set_epoch(
+  profile_grid_t* const pGrid,
+  const NeQuickG_time_t* const pTime,
+  const solar_activity_t* const pSolar_activity);
+
+/** Returns the electron density at a point interpolated from the grid.
+ * The nodes not tabulated yet in the epoch are computed with #iono_profile_get.
+ *
+ * @param[in, out] pGrid profile grid context
+ * @param[in, out] pProfile profile used as workspace
+ * @param[in] pTime time context
+ * @param[in, out] pModip modip context
+ * @param[in] pSolar_activity solar activity context
+ * @param[in] pPosition point position, height in km
+ * @param[out] pElectron_density electron density
+ *
+ * @return on success NEQUICK_OK
+ */
+extern int32_t profile_grid_get_electron_density(
+  profile_grid_t* const pGrid,
+  iono_profile_t* const pProfile,
+  const NeQuickG_time_t* const pTime,
+  modip_context_t* const pModip,
+  const solar_activity_t* const pSolar_activity,
+  const position_t* const pPosition,
+  double_t* const pElectron_density);
+
+#endif // NEQUICK_G_JRC_PROFILE_GRID_H
@@ -81,6 +81,19 @@
 /** NeQuick success */
 #define NEQUICK_OK 0
 
+/** STEC integration mode: Kronrod G<SUB>7</SUB>-K<SUB>15</SUB> adaptive quadrature
+ * with the tolerances defined in the specification (default)
+ */
+#define NEQUICKG_INTEGRATION_REFERENCE (0x00)
+/** STEC integration mode flag: fixed order Kronrod G<SUB>7</SUB>-K<SUB>15</SUB>
+ * quadrature on equal intervals along the ray, with error estimate
+ */
+#define NEQUICKG_INTEGRATION_FIXED_ORDER (0x01)
+/** STEC integration mode flag: profile parameters interpolated from the profiles
+ * tabulated on a latitude/longitude grid, shared by the rays of an epoch
+ */
+#define NEQUICKG_INTEGRATION_PROFILE_GRID (0x02)
+
 /** NequickG JRC handle */
 typedef void* NeQuickG_handle;
 
@@ -244,6 +257,33 @@ struct NeQuickG_library {
     const NeQuickG_handle,
     double_t* const TEC);
 
+  /** Sets the STEC integration mode.
+   *  The fast modes trade a bounded error (see get_integration_error)
+   *  for throughput. The profiles tabulated by #NEQUICKG_INTEGRATION_PROFILE_GRID
+   *  are kept while month, UT and Az do not change, so the rays of an epoch
+   *  should be computed one after the other.
+   *
+   * @param[in] NeQuickG_handle NequickG JRC handle
+   * @param[in] mode #NEQUICKG_INTEGRATION_REFERENCE or a combination of
+   *  #NEQUICKG_INTEGRATION_FIXED_ORDER and #NEQUICKG_INTEGRATION_PROFILE_GRID
+   *
+   * @return on success NEQUICK_OK
+   */
+  int32_t (*set_integration_mode)(
+    const NeQuickG_handle,
+    const uint8_t mode);
+
+  /** Gets the error estimate of the last STEC in TECU.
+   *  Sum of the differences between the K15 and G7 rules of the intervals,
+   *  only available in #NEQUICKG_INTEGRATION_FIXED_ORDER mode (0 otherwise).
+   *
+   * @param[in] NeQuickG_chandle NequickG JRC handle
+   *
+   * @return error estimate in TECU
+   */
+  double_t (*get_integration_error)(
+    NeQuickG_chandle);
+
   /** Input data set to std output
    *
    * @param[in] NeQuickG_chandle NequickG JRC handle
@@ -87,6 +87,35 @@ const int BrdPara_degord_table[BRDPARANUM][2] = {
 *		double *lon1	O		output longitude (in arc.)
 *****************************************************************************/
 void EFLSFL(double mjd,double *lat,double *lon,int geomag,int sunframe,double *lat1,double *lon1)
+{
+	EFLSFL_SUN(sunframe ? SunFixedLon(mjd) : 0.0, lat, lon, geomag, sunframe, lat1, lon1);
+}
+
+/*****************************************************************************
+* Description : geomagnetic longitude of the sun for the sun-fixed frame (the part
+*		of EFLSFL depending on the epoch only)
+* Parameters  :
+*		double mjd		I		the calculate epoch
+* return: double  sun longitude (in arc.)
+*****************************************************************************/
+double SunFixedLon(double mjd)
+{
+	double Bp = LAT_POLE;
+	double Lp = LON_POLE;
+	double SUNLON = PI * (1.0 - 2.0 * (mjd - (int)(mjd)));
+	double sinlon2 = 0.0, coslon2 = 0.0;
+	sinlon2 = sin(SUNLON - Lp*PI / 180);
+	coslon2 = sin(Bp*PI / 180)*cos(SUNLON - Lp*PI / 180);
+	return atan2(sinlon2, coslon2);
+}
+
+/*****************************************************************************
+* Description : EFLSFL with the sun longitude given by SunFixedLon
+* Parameters  :
+*		double sunlon	I		sun longitude by SunFixedLon (in arc.)
+*		(others same as EFLSFL)
+*****************************************************************************/
+void EFLSFL_SUN(double sunlon,double *lat,double *lon,int geomag,int sunframe,double *lat1,double *lon1)
 {
 	double Bp=LAT_POLE;
 	double Lp=LON_POLE;
@@ -106,12 +135,7 @@ void EFLSFL(double mjd,double *lat,double *lon,int geomag,int sunframe,double *l
 
 	if(sunframe)
 	{
-		double SUNLON = PI * (1.0 - 2.0 * (mjd - (int)(mjd)));
-		double sinlon2 = 0.0, coslon2 = 0.0;
-		sinlon2 = sin(SUNLON-Lp*PI/180);
-		coslon2 = sin(Bp*PI/180)*cos(SUNLON-Lp*PI/180);
-		SUNLON = atan2(sinlon2,coslon2);
-		*lon1=*lon1-SUNLON;
+		*lon1=*lon1-sunlon;
 		*lon1=atan2(sin(*lon1),cos(*lon1));
 	}
 }
@@ -559,3 +583,268 @@ extern int IonBdsBrdModel(NonBrdIonData* nonBrdData, BrdIonData* brdData, double
 
 	return 1;
 }
+
+/*****************************************************************************
+* Description : initialize the BDGIM context: degree/order tables, period table,
+*		omiga and normalization factors of the legendre functions. The context
+*		holds all the state of the model, so the functions using it are reentrant
+*		as long as every thread owns its context.
+* Parameters  :
+*       BdgimCtx* ctx               O       BDGIM model context
+*****************************************************************************/
+void InitBdgimCtx(BdgimCtx* ctx)
+{
+	double KDELTA;
+	int num, i, j, n, m;
+
+	memset(ctx, 0, sizeof(BdgimCtx));
+
+	for (num = 0; num < NONBRDNUM; num++) {
+		ctx->nonBrdData.degOrd[num][0] = NonBrdPara_degord_table[num][0];
+		ctx->nonBrdData.degOrd[num][1] = NonBrdPara_degord_table[num][1];
+
+		for (j = 0; j < TRISERINUM; j++) {
+			ctx->nonBrdData.perdTable[num][j] = NonBrdPara_table[num][j];
+		}
+	}
+	for (i = 0; i < BRDPARANUM; i++) {
+		ctx->brdData.degOrd[i][0] = BrdPara_degord_table[i][0];
+		ctx->brdData.degOrd[i][1] = BrdPara_degord_table[i][1];
+	}
+	SetNonBrdCoefPeriod(&ctx->nonBrdData);
+
+	// same expression as ASLEFU for identical factors
+	for (n = 0; n <= MAXSHDEG; n++) {
+		for (m = 0; m <= n; m++) {
+			KDELTA = m == 0 ? 1.0 : 0.0;
+			ctx->normFac[n][m] = sqrt(2.0*(2.0*n + 1.0) / (1.0 + KDELTA)* FAKULT(n - m) / FAKULT(n + m));
+		}
+	}
+	ctx->init = 1;
+}
+
+/*****************************************************************************
+* Description : set the broadcast parameters of the BDGIM context and compute the
+*		non-broadcast coefficients when the day changes
+* Parameters  :
+*       BdgimCtx* ctx               IO      BDGIM model context
+*		double mjd		            I		the compute epoch [in mjd]
+*	    double* brdPara		        I		broadcast ionospheric parameters [9 parameters]
+* return :    1: ok
+*****************************************************************************/
+int SetBdgimCtx(BdgimCtx* ctx, double mjd, const double* brdPara)
+{
+	NonBrdIonData* nonBrdData = &ctx->nonBrdData;
+	double day = (int)(mjd), dmjd = 2.0 / 24.0, tmjd, coef;
+	int igroup, icoef, ipar, n, i;
+
+	if (!ctx->init) InitBdgimCtx(ctx);
+
+	for (i = 0; i < BRDPARANUM; i++) ctx->brdData.brdIonCoef[i] = brdPara[i];
+
+	if (ctx->nonBrdMjd == day) return 1;
+
+	// non-broadcast coefficients at the centers of the 2-hour sessions
+	for (igroup = 0; igroup < MAXGROUP; igroup++)
+	{
+		tmjd = day + igroup*dmjd;
+
+		for (icoef = 0; icoef < NONBRDNUM; icoef++)
+		{
+			coef = 0.0; ipar = 0;
+			for (n = 0; n < PERIODNUM; n++)
+			{
+				if (nonBrdData->omiga[n] == 0)
+				{
+					coef = nonBrdData->perdTable[icoef][ipar++];
+				}
+				else
+				{
+					coef += nonBrdData->perdTable[icoef][ipar++] * cos(nonBrdData->omiga[n] * (tmjd + dmjd / 2.0));
+					coef += nonBrdData->perdTable[icoef][ipar++] * sin(nonBrdData->omiga[n] * (tmjd + dmjd / 2.0));
+				}
+			}
+			nonBrdData->nonBrdCoef[icoef][igroup] = coef;
+		}
+	}
+	ctx->nonBrdMjd = day;
+	return 1;
+}
+
+/*****************************************************************************
+* Description : normalized legendre functions of all degree/order up to MAXSHDEG
+*		in one recursive pass (same recursion and normalization as ASLEFU)
+* Parameters  :
+*       BdgimCtx* ctx               I       BDGIM model context
+*		double lat                  I	    latitude [arc]
+*		double lon                  I	    longitude [arc]
+*		double *Pc                  O       P(n,m)*cos(m*lon) [degree][order]
+*		double *Ps                  O       P(n,m)*sin(m*lon) [degree][order]
+*****************************************************************************/
+static void LegendreSH(const BdgimCtx* ctx, double lat, double lon,
+	double Pc[MAXSHDEG + 1][MAXSHDEG + 1], double Ps[MAXSHDEG + 1][MAXSHDEG + 1])
+{
+	double P[MAXSHDEG + 1][MAXSHDEG + 1] = { { 0.0 } };
+	double XX = sin(lat), SOMX2 = sqrt((1.0 - XX)*(1.0 + XX)), PMM = 1.0, cm, sm;
+	int n, m;
+
+	for (m = 0; m <= MAXSHDEG; m++)
+	{
+		if (m > 0) PMM = PMM*(2.0*m - 1.0)*SOMX2;
+		P[m][m] = PMM;
+		if (m < MAXSHDEG) P[m + 1][m] = XX*(2 * m + 1)*PMM;
+		for (n = m + 2; n <= MAXSHDEG; n++)
+		{
+			P[n][m] = (XX*(2 * n - 1)*P[n - 1][m] - (n + m - 1)*P[n - 2][m]) / (n - m);
+		}
+	}
+	for (m = 0; m <= MAXSHDEG; m++)
+	{
+		cm = cos(m*lon);
+		sm = sin(m*lon);
+		for (n = m; n <= MAXSHDEG; n++)
+		{
+			Pc[n][m] = ctx->normFac[n][m] * P[n][m] * cm;
+			Ps[n][m] = ctx->normFac[n][m] * P[n][m] * sm;
+		}
+	}
+}
+
+/*****************************************************************************
+* Description : obtains the vertical ionospheric TEC using the BDGIM context
+* Parameters  :
+*       BdgimCtx* ctx               I       BDGIM model context (set by SetBdgimCtx)
+*		double mjd					I	[MJD]		The calculate time (Modified Julian Day)
+*		double ipp_b				I	[arc]		The geomagnetic latitude of the IPP
+*		double ipp_l                I	[arc]		The geomagnetic longitude of the IPP
+*		double *vtec			    O   [TECU]	    Ionospheric correction in TECU
+* return :    1: ok, 0: error
+*****************************************************************************/
+int VtecBdgimCtx(const BdgimCtx* ctx, double mjd, double ipp_b, double ipp_l, double* vtec)
+{
+	const int(*degOrd)[2];
+	const double *brdIonCoef = ctx->brdData.brdIonCoef;
+	double Pc[MAXSHDEG + 1][MAXSHDEG + 1], Ps[MAXSHDEG + 1][MAXSHDEG + 1];
+	double vtec_brd = 0.0, vtec_A0 = 0.0;
+	int ipar, igroup, n, m;
+
+	*vtec = 0.0;
+
+	// session group of the day
+	igroup = (int)((mjd - ctx->nonBrdMjd)*24.0 / 2.0);
+	if (!ctx->init || igroup < 0 || igroup >= MAXGROUP)
+		return 0;
+
+	LegendreSH(ctx, ipp_b, ipp_l, Pc, Ps);
+
+	// calculate the VTEC computed from the broadcast coefficients
+	degOrd = ctx->brdData.degOrd;
+	for (ipar = 0; ipar < BRDPARANUM; ipar++)
+	{
+		n = degOrd[ipar][0]; m = degOrd[ipar][1];
+		vtec_brd = vtec_brd + brdIonCoef[ipar] * (m >= 0 ? Pc[n][m] : Ps[n][-m]);
+	}
+
+	// calculate the VTEC computed from the non-broadcast coefficients
+	degOrd = ctx->nonBrdData.degOrd;
+	for (ipar = 0; ipar < NONBRDNUM; ipar++)
+	{
+		n = degOrd[ipar][0]; m = degOrd[ipar][1];
+		vtec_A0 = vtec_A0 + ctx->nonBrdData.nonBrdCoef[ipar][igroup] * (m >= 0 ? Pc[n][m] : Ps[n][-m]);
+	}
+
+	*vtec = vtec_brd + vtec_A0;
+
+	if (brdIonCoef[0] > 35.0)
+		*vtec = MAX(brdIonCoef[0] / 10.0, *vtec);
+	else if (brdIonCoef[0] > 20.0)
+		*vtec = MAX(brdIonCoef[0] / 8.0, *vtec);
+	else if (brdIonCoef[0] > 12.0)
+		*vtec = MAX(brdIonCoef[0] / 6.0, *vtec);
+	else
+		*vtec = MAX(brdIonCoef[0] / 4.0, *vtec);
+
+	return 1;
+}
+
+/*****************************************************************************
+* Description : obtains the slant ionospheric delay in B1C using the BDGIM context
+*		(reentrant counterpart of IonBdsBrdModel)
+* Parameters  :
+*      BdgimCtx* ctx               IO   BDGIM model context
+*	   double mjd			       I	current epoch
+*	   double* sta_xyz		       I	station x,y,z
+*	   double* sat_xyz		       I	satellite x,y,z
+*	   double* brdPara		       I	broadcast ionospheric parameters [const: 9 parameters model]
+*	   double* ion_delay	       O	ionospheric delay in B1C [m]
+* return :    1: ok, 0: error
+*****************************************************************************/
+int IonBdgimCtx(BdgimCtx* ctx, double mjd, const double* sta_xyz, const double* sat_xyz, const double* brdPara, double* ion_delay)
+{
+	int stat = 0;
+
+	IonBdgimCtxs(ctx, mjd, sta_xyz, sat_xyz, 1, 3, brdPara, ion_delay, &stat);
+	return stat;
+}
+
+/*****************************************************************************
+* Description : obtains the slant ionospheric delays in B1C of all satellites of
+*		an epoch using the BDGIM context. The day coefficients, the sun-fixed
+*		frame and the delay factor are evaluated once for the batch; the result
+*		of every satellite is identical to IonBdgimCtx
+* Parameters  :
+*      BdgimCtx* ctx               IO   BDGIM model context
+*	   double mjd			       I	current epoch
+*	   double* sta_xyz		       I	station x,y,z
+*	   double* sat_xyz		       I	satellite x,y,z (sat_xyz[(0:2)+i*stride])
+*	   int n				       I	number of satellites
+*	   int stride			       I	stride of satellite positions (3: packed, 6: with velocity)
+*	   double* brdPara		       I	broadcast ionospheric parameters [const: 9 parameters model]
+*	   double* ion_delay	       O	ionospheric delays in B1C [m] (0.0: error)
+*	   int* stat			       O	status of satellites (1: ok, 0: error)
+* return :    number of satellites with delay
+*****************************************************************************/
+int IonBdgimCtxs(BdgimCtx* ctx, double mjd, const double* sta_xyz, const double* sat_xyz, int n, int stride, const double* brdPara, double* ion_delay, int* stat)
+{
+	double sta[3], sat[3], ipp_xyz[3] = { 0.0 };
+	double ipp_b = 0.0, ipp_l = 0.0, ipp_e = 0.0, geomag_b = 0.0, geomag_l = 0.0;
+	double sat_ele = 0.0, mf, K, vtec = 0.0, sunlon;
+	int i, j, nok = 0;
+
+	// 1:set broadcast parameters and non-broadcast coefficients of the day
+	SetBdgimCtx(ctx, mjd, brdPara);
+
+	sunlon = SunFixedLon(mjd);
+
+	// delay conversion factor
+	K = 40.3e16 / (1.0*pow(FREQ1_BDS, 2));
+
+	for (i = 0; i < 3; i++) sta[i] = sta_xyz[i];
+
+	for (j = 0; j < n; j++)
+	{
+		ion_delay[j] = 0.0;
+		stat[j] = 0;
+
+		// 2:calculate IPP information
+		for (i = 0; i < 3; i++) sat[i] = sat_xyz[i + j*stride];
+		if (!IPPBLH1(sta, sat, Hion_bdgim, ipp_xyz, &ipp_b, &ipp_l, &ipp_e, &sat_ele))
+			continue;
+
+		// 3:Transform earth-fixed coordinate to sun-fixed and geomagnetic coordinate
+		EFLSFL_SUN(sunlon, &ipp_b, &ipp_l, 1, 1, &geomag_b, &geomag_l);
+
+		// 4:Calcute the vertical ionospheric TEC
+		if (!VtecBdgimCtx(ctx, mjd, geomag_b, geomag_l, &vtec))
+			continue;
+
+		// 5:Calcute the mapping factor
+		mf = IonMapping(2, ipp_e, sat_ele, Hion_bdgim);
+
+		// 6:calculate the ionospheric Delay in BDS B1C frequency
+		ion_delay[j] = mf * K * vtec;
+		stat[j] = 1;
+		nok++;
+	}
+	return nok;
+}
@@ -30,6 +30,7 @@
 #define TRISERINUM    (PERIODNUM*2-1)     // Trigonometric series number 
 #define NONBRDNUM      17                 // Number of non-broadcast one group
 #define MAXGROUP       12                 // 12 groups non-broadcast coefficient every day
+#define MAXSHDEG        5                 // maximum degree of BDGIM spherical harmonic
 
 /*********** BDGIM Non-Broadcast Ionospheric Parameters Struct **************************/
 typedef struct{
@@ -45,6 +46,15 @@ typedef struct{
 	int degOrd[BRDPARANUM][2];		    // spheric harmonic function degree and order index for broadcast parameter
 } BrdIonData;
 
+/*********** BDGIM Model Context Struct **************************/
+typedef struct{
+	int init;                                     // tables and factors initialized flag
+	double nonBrdMjd;                             // day of the non-broadcast coefficients [mjd] (0: not computed)
+	NonBrdIonData nonBrdData;                     // non-broadcast tables and coefficients of the day
+	BrdIonData brdData;                           // broadcast parameters of the context
+	double normFac[MAXSHDEG+1][MAXSHDEG+1];       // normalization factors of legendre functions [degree][order]
+} BdgimCtx;
+
 /*-------------------------------- BDGIM model function ----------------------------*/
 
 /* obtains the slant ionospheric delay in B1C using BDGIM ionospheric model */
@@ -56,6 +66,8 @@ int VtecBrdSH(NonBrdIonData* nonBrdData, BrdIonData* brdData, double mjd, double
 
 /* transform earth-fixed latitude/longitude into sun-fixed latitude/longitude */
 void EFLSFL(double mjd, double* lat, double* lon, int geomag, int sunframe, double* lat1, double* lon1);
+void EFLSFL_SUN(double sunlon, double* lat, double* lon, int geomag, int sunframe, double* lat1, double* lon1);
+double SunFixedLon(double mjd);
 
 /* ionospheric mapping functions */
 double IonMapping(int type, double ipp_elev, double sat_elev, double Hion);
@@ -73,3 +85,11 @@ double ASLEFU(double XLAT,double XLON,int INN,int IMM);		    // Normalized legen
 double FAKULT(int N);										    // compute the factorial of N
 double Distance(double *xyz1,double *xyz2);
 
+/*-------------------------------- BDGIM context function --------------------------*/
+
+void InitBdgimCtx(BdgimCtx* ctx);						        // initialize tables and normalization factors of BDGIM context
+int SetBdgimCtx(BdgimCtx* ctx, double mjd, const double* brdPara);	// set broadcast parameters and non-broadcast coefficients of the day
+int VtecBdgimCtx(const BdgimCtx* ctx, double mjd, double ipp_b, double ipp_l, double* vtec);	// vertical tec by BDGIM context
+int IonBdgimCtx(BdgimCtx* ctx, double mjd, const double* sta_xyz, const double* sat_xyz, const double* brdPara, double* ion_delay);	// slant delay in B1C by BDGIM context
+int IonBdgimCtxs(BdgimCtx* ctx, double mjd, const double* sta_xyz, const double* sat_xyz, int n, int stride, const double* brdPara, double* ion_delay, int* stat);	// slant delays of all satellites of an epoch
+
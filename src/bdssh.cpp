@@ -17,114 +17,199 @@
 
 
 
-void sort(double *data, int n){
-	int i, j;
-	double help, tmp;
-	for (i = 0; i < n; i++){
-		tmp = fabs(data[i]);
-		for (j = i + 1; j< n; j++){
-			if (tmp > fabs(data[j])){
-				help = data[j];
-				data[j] = data[i];
-				data[i] = help;
-			}
+/* number of parameters of a BDS broadcast ionosphere model */
+static int nbdsion(int model)
+{
+	return model == BDSION_K8 ? 8 : 9;
+}
+
+/* update the hour of day index of a store -------------------------------------
+* each hour of day uses the nearest hour slot with parameters (the earlier one
+* on ties). without hourly parameters, all hours use the slot without hour
+*-----------------------------------------------------------------------------*/
+static void indexbdsion(bdsionstore_t *store)
+{
+	int i, h, dt, hourly = 0;
+
+	for (i = 0; i < 24; i++) if (store->sel[i] >= 0) hourly = 1;
+
+	for (h = 0; h < 24; h++) {
+		store->slot[h] = -1;
+		if (!hourly) {
+			if (store->sel[24] >= 0) store->slot[h] = 24;
+			continue;
 		}
+		for (i = 0, dt = 24; i < 24; i++) {
+			if (store->sel[i] < 0 || abs(h - i) >= dt) continue;
+			dt = abs(h - i);
+			store->slot[h] = i;
+		}
+	}
+}
+
+/* initialize BDS broadcast ionosphere parameters ----------------------------*/
+void initbdsion(bds_ion_t *bds_ion)
+{
+	int i, j;
+
+	memset(bds_ion, 0, sizeof(bds_ion_t));
+
+	for (i = 0; i < BDSION_NMOD; i++) {
+		for (j = 0; j < BDSION_NSLOT; j++) bds_ion->store[i].sel[j] = -1;
+		for (j = 0; j < 24; j++) bds_ion->store[i].slot[j] = -1;
+	}
+}
+
+/* free dated BDS broadcast ionosphere parameters ----------------------------*/
+void freebdsion(bds_ion_t *bds_ion)
+{
+	int i;
+
+	for (i = 0; i < BDSION_NMOD; i++) {
+		free(bds_ion->store[i].dslot);
+		bds_ion->store[i].dslot = NULL;
+		bds_ion->store[i].nd = bds_ion->store[i].ndmax = 0;
 	}
 }
 
-/* unique ion ----------------------------------------------------------
-* unique ion in navigation data and update carrier wave length
-* args   : nav_t *nav    IO     navigation data
-* return : number of epochs
+/* vote parameters in sets of a slot -------------------------------------------
+* return : status (1:ok,0:no room in slot)
 *-----------------------------------------------------------------------------*/
-int  selemajority(double *tmp, int n){
-	int i, j, k, l;
-	int freq[512], nf = 0;
-	if (n <= 0)return -1;
-
-	sort(tmp, n);
-	for (i = 0, j = 0; i < n; i++){
-		if (tmp[j] == tmp[i])nf++;
-		else{
-			freq[j] = nf;
-			tmp[++j] = tmp[i];
-			nf = 1;
-		}
+static int votebdsion(bdsionset_t *set, int *nset, int *sel, const double *ion,
+	int n, double nrm)
+{
+	int i, j;
+
+	for (i = 0; i < *nset; i++) {
+		if (set[i].norm == nrm) break;
 	}
-	freq[j] = nf;
-	k = freq[0];
-	l = 0;
-	for (i = 0; i <= j; i++){
-		if (k<freq[i]) {
-			k = freq[i];
-			l = i;
-		}
+	if (i >= *nset) {
+		if (i >= BDSION_NSET) return 0;
+		set[i].nvote = 0;
+		set[i].norm = nrm;
+		for (j = 0; j < 9; j++) set[i].ion[j] = j < n ? ion[j] : 0.0;
+		(*nset)++;
 	}
-	for (i = 0; i < n; i++){
-		if (tmp[i] == tmp[l])return i;
+	set[i].nvote++;
+
+	/* majority set of the slot */
+	for (i = j = 0; i < *nset; i++) {
+		if (set[i].nvote > set[j].nvote ||
+			(set[i].nvote == set[j].nvote && set[i].norm < set[j].norm)) j = i;
 	}
-	return -1;
+	*sel = j;
+	return 1;
 }
 
-char uniqion(double* ep, BDSSH* bdssh)
+/* search dated slot (first slot at or after hour) ---------------------------*/
+static int searchbdsion(const bdsionstore_t *store, int hour)
 {
-	int i, j, k;
-	int sys, nigmas = 0;
-	double tmp[512];
-	int n = 0;
-	int ii, idx;
-	double fjd;
-	int year, month, day;
-
-	trace(3, "uniqion:\n");
-
-	if (bdssh->bds_ion.nsh9 <= 0)return -1;
-	//if (bds_ion.nsh9 <= 0)return -1;
-
-	bdssh->BrdIonCoefNum = 9;
-	for (i = 0; i < bdssh->bds_ion.nsh9; i++) {
-		if (bdssh->bds_ion.bdssh9[i].hour != -1)nigmas++;
+	int i = 0, j = store->nd, k;
+
+	while (i < j) {
+		k = (i + j) / 2;
+		if (store->dslot[k].hour < hour) i = k + 1; else j = k;
 	}
-	if (nigmas == 0)
-	{ /* not igmas format, keeps only the first one */
-		bdssh->BrdIonCoefGroup = 1;
-		for (j = 0; j < bdssh->BrdIonCoefNum; j++) {
-			bdssh->BrdIonCoef[j][0] = bdssh->bds_ion.bdssh9[0].ion[j];
+	return i;
+}
+
+/* add dated parameters --------------------------------------------------------*/
+static int adddatedbdsion(bdsionstore_t *store, int hour, const double *ion,
+	int n, double nrm)
+{
+	bdsionslot_t *slot;
+	int i = searchbdsion(store, hour);
+
+	if (i >= store->nd || store->dslot[i].hour != hour) {
+		if (store->nd >= store->ndmax) {
+			store->ndmax = store->ndmax <= 0 ? 48 : store->ndmax * 2;
+			if (!(slot = (bdsionslot_t *)realloc(store->dslot,
+				sizeof(bdsionslot_t)*store->ndmax))) {
+				store->ndmax = store->nd;
+				return 0;
+			}
+			store->dslot = slot;
 		}
+		memmove(store->dslot + i + 1, store->dslot + i,
+			sizeof(bdsionslot_t)*(store->nd - i));
+		store->dslot[i].hour = hour;
+		store->dslot[i].nset = 0;
+		store->dslot[i].sel = -1;
+		store->nd++;
+	}
+	slot = store->dslot + i;
+	return votebdsion(slot->set, &slot->nset, &slot->sel, ion, n, nrm);
+}
+
+/* add BDS broadcast ionosphere parameters -------------------------------------
+* add a decoded message to the parameter store. the messages of a slot are
+* deduplicated and the set with most messages (the one with the smallest norm
+* on ties) is selected
+* args   : bds_ion_t *bds_ion  IO  BDS broadcast ionosphere parameters
+*          int    model        I   model (BDSION_???)
+*          int    day          I   day of message (days from 1970/1/1, 0: undated)
+*          int    hour         I   hour of day (0-23, others: no hour)
+*          double *ion         I   parameters (K8: 8, SH9: 9)
+* return : status (1:ok,0:empty parameters or no room in slot)
+* notes  : dated messages (RINEX 4 ION records by toc) are kept in slots of
+*          (day,hour) over any number of days. undated messages (hour letters
+*          of RINEX 3 headers) are kept in slots of hour of day. messages not
+*          stored for no room are counted in bds_ion->nrej
+*-----------------------------------------------------------------------------*/
+int addbdsion(bds_ion_t *bds_ion, int model, int day, int hour, const double *ion)
+{
+	bdsionstore_t *store = bds_ion->store + model;
+	double nrm;
+	int n = nbdsion(model), s = hour >= 0 && hour < 24 ? hour : 24, first, stat;
+
+	if ((nrm = norm(ion, n)) == 0.0) return 0;
+
+	if (model == BDSION_K8) bds_ion->nk8++; else bds_ion->nsh9++;
+
+	if (day > 0 && s < 24) {
+		stat = adddatedbdsion(store, day * 24 + hour, ion, n, nrm);
 	}
 	else {
-		bdssh->BrdIonCoefGroup = 24;
-		for (i = 0; i < 24; i++) {
-			n = 0;
-			for (j = 0; j < bdssh->bds_ion.nsh9; j++) {
-				if (bdssh->bds_ion.bdssh9[j].hour != i)continue;
-				tmp[n] = norm(bdssh->bds_ion.bdssh9[j].ion, bdssh->BrdIonCoefNum);
-				if (tmp[n] == 0.0)continue;
-				n++;
-			}
-			ii = selemajority(tmp, n);
-			if (ii < 0) {
-				for (j = 0; j < bdssh->BrdIonCoefNum; j++) {
-					bdssh->BrdIonCoef[j][i] = 0.0;
-				}
-			}
-			else
-			{
-				idx = -1;
-				for (j = 0; j < bdssh->bds_ion.nsh9; j++) {
-					if (bdssh->bds_ion.bdssh9[j].hour != i)continue;
-					if (tmp[ii] == norm(bdssh->bds_ion.bdssh9[j].ion, 9)) {
-						for (k = 0; k < bdssh->BrdIonCoefNum; k++) {
-							bdssh->BrdIonCoef[k][i] = bdssh->bds_ion.bdssh9[j].ion[k];
-						}
-						break;
-					}
-				}
-				//if (idx == -1){ printf("Error!\n"); }
-			}
-		}
+		first = store->sel[s] < 0;
+		stat = votebdsion(store->set[s], store->nset + s, store->sel + s, ion, n, nrm);
+
+		/* hour index only changes when a slot gets its first set */
+		if (stat && first) indexbdsion(store);
+	}
+	if (!stat) {
+		trace(2, "bds ion set overflow: model=%d day=%d hour=%d\n", model, day, hour);
+		bds_ion->nrej++;
 	}
-	return true;
+	return stat;
+}
+
+/* get BDS broadcast ionosphere parameters of an hour --------------------------
+* args   : bds_ion_t *bds_ion  I   BDS broadcast ionosphere parameters
+*          int    model        I   model (BDSION_???)
+*          int    day          I   day (days from 1970/1/1)
+*          int    hour         I   hour of day (0-23)
+* return : parameters (NULL: no parameters)
+* notes  : with dated parameters, the nearest dated slot in time is selected
+*          (the earlier one on ties). otherwise the slot of the hour of day
+*-----------------------------------------------------------------------------*/
+const double *getbdsion(const bds_ion_t *bds_ion, int model, int day, int hour)
+{
+	const bdsionstore_t *store = bds_ion->store + model;
+	const bdsionslot_t *slot;
+	int i, s, h = day * 24 + hour;
+
+	if (hour < 0 || hour >= 24) return NULL;
+
+	if (store->nd > 0) {
+		i = searchbdsion(store, h);
+		if (i >= store->nd || (i > 0 && h - store->dslot[i - 1].hour <=
+			store->dslot[i].hour - h)) i--;
+		slot = store->dslot + i;
+		return slot->set[slot->sel].ion;
+	}
+	if ((s = store->slot[hour]) < 0) return NULL;
+
+	return store->set[s][store->sel[s]].ion;
 }
 
 
@@ -191,56 +276,74 @@ extern double ionmodel_BDSK8(gtime_t t, const double *ion, const double *pos,
 	return CLIGHT*f*vtime*varr;
 }
 
-/* BDSSH9 for B1I */
-extern double ionmodel_BDSK9(gtime_t time, const BDSSH *bdssh, const double *pos, const double *satxyz)
+/* select BDSSH9 broadcast parameters of the hour ----------------------------*/
+static int selbdsk9(gtime_t time, const double *ep, const BDSSH *bdsk9, double *brdPara)
 {
+	const double *ion = getbdsion(&bdsk9->bds_ion, BDSION_SH9, (int)(time.time / 86400),
+		(int)ep[3]);
+	int i;
+
+	if (!ion) return 0;
+
+	for (i = 0; i < 9; i++) brdPara[i] = ion[i];
+	return 1;
+}
 
+/* BDSSH9 for B1I of all satellites of an epoch --------------------------------
+* args   : gtime_t time     I   time (bdt)
+*          BDSSH  *bdssh    I   BDSSH9 broadcast parameters
+*          double *pos      I   receiver position {lat,lon,h} (rad|m)
+*          double *rs       I   satellite positions (ecef) rs[(0:2)+i*6] (m)
+*          int    n         I   number of satellites
+*          double *ion      O   ionospheric delays (B1I) (m) (0.0: no correction)
+* return : number of satellites with correction
+* notes  : the coefficient selection, epoch and station position are done once
+*          for all satellites. each delay equals ionmodel_BDSK9() of the
+*          satellite
+*-----------------------------------------------------------------------------*/
+extern int ionmodel_BDSK9s(gtime_t time, const BDSSH *bdssh, const double *pos, const double *rs,
+                           int n, double *ion)
+{
+	static THREADLOCAL BdgimCtx bdgim;      // per-thread model context (tables and day coefficients)
 	MjdData mjdData;
-	NonBrdIonData nonBrdData;				 // non-broadcast parameter structure
-	BrdIonData brdData;                      // broadcast parameter structure
-	double ep[6], brdPara[9], sta_xyz[3], sat_xyz[3],iondelay=0.0;
+	double ep[6], brdPara[9], sta_xyz[3], k;
+	int i, nok = 0, stat[MAXOBS];
 	memset(&mjdData, 0, sizeof(MjdData));
-	memset(&nonBrdData, 0, sizeof(NonBrdIonData));
-	memset(&brdData, 0, sizeof(BrdIonData));
-	BDSSH *bdsk9 = (BDSSH*)bdssh;
-	int igroup = -1,i,j;
-	double ionsh9[9],dt;
 
-	time2epoch(time, ep);
-	
+	for (i = 0; i < n; i++) ion[i] = 0.0;
 
-	/* select reference ion par and ref hour */
-	if (bdsk9->BrdIonCoefGroup == 1){
-		igroup = 0;
-		for (i = 0; i < bdsk9->BrdIonCoefNum; i++)brdPara[i] = bdsk9->BrdIonCoef[i][0];
-	}
-	else if (bdsk9->BrdIonCoefGroup == 24){
-		dt = 48.0;
-		for (i = 0; i<24; i++){
-			for (j = 0; j < bdsk9->BrdIonCoefNum; j++)ionsh9[j] = bdsk9->BrdIonCoef[j][i];
-			if (norm(ionsh9, bdsk9->BrdIonCoefNum) == 0.0)continue;
-			if (fabs(ep[3] - i) < dt){
-				dt = fabs(ep[3] - i);
-				igroup = i;
-				for (j = 0; j < bdsk9->BrdIonCoefNum; j++)brdPara[j] = ionsh9[j];
-			}
-		}
-	}
-	if (dt >= 48.0 || igroup<0)return 0.0;
+	time2epoch(time, ep);
 
+	if (n <= 0 || n > MAXOBS || !selbdsk9(time, ep, bdssh, brdPara)) return 0;
 
 	UTC2MJD((int)ep[0], (int)ep[1], (int)ep[2], (int)ep[3], (int)ep[4], ep[5], &mjdData);
 	pos2ecef(pos, sta_xyz);
-	for (i = 0; i < 3; i++)sat_xyz[i] = satxyz[i];
 
-	IonBdsBrdModel(&nonBrdData, &brdData, mjdData.mjd, sta_xyz, sat_xyz, brdPara, &iondelay);
-	//printf(" the ionosphere delay in B1C : %7.2lf [m]\n", iondelay);
+	IonBdgimCtxs(&bdgim, mjdData.mjd, sta_xyz, rs, n, 6, brdPara, ion, stat);
 
 	// B1C to B1I 
-	double k = FREQ1*FREQ1/ FREQ1_CMP / FREQ1_CMP;
-	iondelay = iondelay*k;
+	k = FREQ1*FREQ1/ FREQ1_CMP / FREQ1_CMP;
 
-	return iondelay<0.0 ? 0.0 : iondelay;
+	for (i = 0; i < n; i++) {
+		if (!stat[i]) continue;
+		ion[i] = ion[i]*k;
+		if (ion[i] < 0.0) ion[i] = 0.0;
+		else nok++;
+	}
+	return nok;
+}
+
+/* BDSSH9 for B1I */
+extern double ionmodel_BDSK9(gtime_t time, const BDSSH *bdssh, const double *pos, const double *satxyz)
+{
+	double rs[6] = { 0.0 }, iondelay = 0.0;
+	int i;
+
+	for (i = 0; i < 3; i++)rs[i] = satxyz[i];
+
+	ionmodel_BDSK9s(time, bdssh, pos, rs, 1, &iondelay);
+
+	return iondelay;
 }
 
 /* BDSSH9 for B1I */
@@ -48,10 +48,40 @@ typedef struct {        /* GPS/QZS/GAL broadcast ephemeris type */
 	double ion[9];      /* bds sh9 parameters */
 } bdssh9_t;
 
-typedef struct {        /* navigation data type */
-	int nk8, nk14, nsh9;
-	bdsk8_t bdsk8[1024];
-	bdssh9_t bdssh9[1024];
+#define BDSION_K8		0		/* BDS broadcast ionosphere model: Klobuchar 8 parameters */
+#define BDSION_SH9		1		/* BDS broadcast ionosphere model: BDSSH9 (BDGIM) */
+#define BDSION_NMOD		2		/* number of BDS broadcast ionosphere models */
+#define BDSION_NSLOT	25		/* parameter slots: hour of day 0-23, 24: no hour */
+#define BDSION_NSET		4		/* max number of distinct sets voted in a slot */
+
+typedef struct {        /* broadcast ionosphere parameter set */
+	int nvote;          /* number of messages with the set */
+	double norm;        /* norm of parameters (vote key) */
+	double ion[9];      /* parameters (K8: 8, SH9: 9) */
+} bdsionset_t;
+
+typedef struct {        /* dated broadcast ionosphere parameter slot */
+	int hour;           /* hour of validity (hours from 1970/1/1) */
+	int nset;           /* number of sets in slot */
+	int sel;            /* majority set of slot */
+	bdsionset_t set[BDSION_NSET]; /* sets voted in slot */
+} bdsionslot_t;
+
+typedef struct {        /* broadcast ionosphere parameter store of a model */
+	int nset[BDSION_NSLOT];                     /* number of sets in slots */
+	bdsionset_t set[BDSION_NSLOT][BDSION_NSET]; /* sets voted in slots */
+	int sel[BDSION_NSLOT];                      /* majority set of slots (-1: none) */
+	int slot[24];                               /* slot of hour of day (-1: none) */
+	int nd, ndmax;                              /* number of dated slots/allocated */
+	bdsionslot_t *dslot;                        /* dated slots sorted by hour */
+} bdsionstore_t;
+
+typedef struct {        /* BDS broadcast ionosphere parameters */
+	int nk8, nk14, nsh9;    /* number of messages */
+	int nrej;               /* number of rejected messages (slot full) */
+	bdsk8_t bdsk8;          /* K8 message being decoded */
+	bdssh9_t bdssh9;        /* SH9 message being decoded */
+	bdsionstore_t store[BDSION_NMOD]; /* parameter stores by model (BDSION_???) */
 }bds_ion_t;
 
 //class BDSSH	
@@ -73,11 +103,10 @@ typedef struct {        /* navigation data type */
 
 typedef struct
 {
-	int i;
-	int BrdIonCoefNum;
-	double BrdIonCoef[BRDCOUNT][24];			// the body array for storing the bdssh broadcast parameter
-	bds_ion_t bds_ion;
-	int BrdIonCoefGroup;
+	bds_ion_t bds_ion;		// broadcast parameters indexed by hour of day
 }BDSSH;
-char uniqion(double* ep, BDSSH* bdssh);
+void initbdsion(bds_ion_t *bds_ion);
+void freebdsion(bds_ion_t *bds_ion);
+int addbdsion(bds_ion_t *bds_ion, int model, int day, int hour, const double *ion);
+const double *getbdsion(const bds_ion_t *bds_ion, int model, int day, int hour);
 #endif
@@ -93,6 +93,9 @@
 
 #define MAX_ITER_KEPLER 30        /* max number of iteration of Kelpler */
 
+#define NPSGRID  10               /* number of points of grid interpolation */
+#define MAXSGRID 1000000          /* max number of satellite grid epochs */
+
 static int dscode;                  /* GAL CODE 1: I/NAV, 2:F/NAV */
 /* ephemeris selections ------------------------------------------------------*/
 static int eph_sel[]={ /* GPS,GLO,GAL,QZS,BDS,SBS */
@@ -963,6 +966,25 @@ extern int satpos(const prcopt_t *opt,gtime_t time, gtime_t teph, int sat, int e
     *svh=-1;
     return 0;
 }
+/* satellite position and clock at transmission time by state grid ----------*/
+static int satposs_grid(const satgrid_t *sgrid, gtime_t *time, int sat,
+                        double *rs, double *dts, double *var, int *svh)
+{
+    gtime_t t;
+    int i;
+    
+    if (satgrid_pos(sgrid,*time,sat,rs,dts,var,svh)) {
+        t=timeadd(*time,-dts[0]);
+        if (satgrid_pos(sgrid,t,sat,rs,dts,var,svh)) {
+            *time=t;
+            return 1;
+        }
+    }
+    for (i=0;i<6;i++) rs[i]=0.0;
+    dts[0]=dts[1]=0.0;
+    *var=0.0; *svh=0;
+    return 0;
+}
 /* satellite positions and clocks ----------------------------------------------
 * compute satellite positions, velocities and clocks
 * args   : gtime_t teph     I   time to select ephemeris (gpst)һԪʱ
@@ -986,13 +1008,15 @@ extern int satpos(const prcopt_t *opt,gtime_t time, gtime_t teph, int sat, int e
 *          satellite clock does not include code bias correction (tgd or bgd)
 *          any pseudorange and broadcast ephemeris are always needed to get
 *          signal transmission time
+*          with precise ephemeris, satellite antenna offsets of all satellites
+*          are computed by satantoffs() with a sun position of the epoch
 *-----------------------------------------------------------------------------*/
 extern void satposs(gtime_t teph, const obsd_t *obs, int n, const nav_t *nav,
 	const prcopt_t *opt,int ephopt, double *rs, double *dts, double *var, int *svh)
 {
     gtime_t time[2*MAXOBS]={{0}};
-    double dt,pr;
-    int i,j;
+    double dt,pr,dant[6*MAXOBS];
+    int i,j,nant=0,sats[2*MAXOBS]={0},rel[2*MAXOBS]={0};
 	int prn;
    // trace(3,"satposs : teph=%s n=%d ephopt=%d\n",time_str(teph,3),n,ephopt);
     
@@ -1011,6 +1035,12 @@ extern void satposs(gtime_t teph, const obsd_t *obs, int n, const nav_t *nav,
         /* transmission time by satellite clock */
         time[i]=timeadd(obs[i].time,-pr/CLIGHT);
         
+        /* satellite position and clock by session state grid */
+        if (nav->sgrid&&nav->sgrid->ephopt==ephopt&&
+            satposs_grid(nav->sgrid,time+i,obs[i].sat,rs+i*6,dts+i*2,var+i,
+                         svh+i)) {
+            continue;
+        }
         /* satellite clock bias by broadcast ephemeris */
         if (!ephclk(opt,time[i],teph,obs[i].sat,nav,&dt)) {
             trace(3,"no broadcast clock %s sat=%2d\n",time_str(time[i],3),obs[i].sat);
@@ -1019,8 +1049,16 @@ extern void satposs(gtime_t teph, const obsd_t *obs, int n, const nav_t *nav,
         time[i]=timeadd(time[i],-dt);
         
         /* satellite position and clock at transmission time */
-        if (!satpos(opt,time[i],teph,obs[i].sat,ephopt,nav,rs+i*6,dts+i*2,var+i,
-                    svh+i)) {
+        if (ephopt==EPHOPT_PREC) { /* center of mass (antenna offset below) */
+            if (!peph2pos(time[i],obs[i].sat,nav,0,rs+i*6,dts+i*2,var+i)) {
+                trace(3,"no ephemeris %s sat=%2d\n",time_str(time[i],3),obs[i].sat);
+                svh[i]=-1;
+                continue;
+            }
+            sats[i]=obs[i].sat; rel[i]=1; nant++;
+        }
+        else if (!satpos(opt,time[i],teph,obs[i].sat,ephopt,nav,rs+i*6,dts+i*2,
+                         var+i,svh+i)) {
             trace(3,"no ephemeris %s sat=%2d\n",time_str(time[i],3),obs[i].sat);
             continue;
         }
@@ -1029,6 +1067,21 @@ extern void satposs(gtime_t teph, const obsd_t *obs, int n, const nav_t *nav,
             if (!ephclk(opt,time[i],teph,obs[i].sat,nav,dts+i*2)) continue;
             dts[1+i*2]=0.0;
             *var=SQR(STD_BRDCCLK);
+            rel[i]=0;
+        }
+    }
+    /* satellite antenna offsets of precise ephemeris */
+    if (nant>0) {
+        satantoffs(obs[0].time,rs,sats,n<2*MAXOBS?n:2*MAXOBS,nav,dant);
+        
+        for (i=0;i<n&&i<2*MAXOBS;i++) {
+            if (!sats[i]) continue;
+            for (j=0;j<3;j++) rs[j+i*6]+=dant[j+i*3];
+            
+            /* relativity correction of the offset as peph2pos() */
+            if (rel[i]) {
+                dts[i*2]-=2.0*dot(dant+i*3,rs+3+i*6,3)/CLIGHT/CLIGHT;
+            }
         }
     }
 
@@ -1041,6 +1094,207 @@ extern void satposs(gtime_t teph, const obsd_t *obs, int n, const nav_t *nav,
               dts[i*2]*1E9,var[i],svh[i]);
     }
 }
+/* ephemeris index for satellite state grid ---------------------------------*/
+static int sgrid_eid(const prcopt_t *opt, gtime_t time, int sat, int ephopt,
+                     const nav_t *nav)
+{
+    eph_t  *eph;
+    geph_t *geph;
+    seph_t *seph;
+    int sys;
+    
+    if (ephopt!=EPHOPT_BRDC) return 0;
+    
+    sys=satsys(sat,NULL);
+    
+    if (sys==SYS_GPS||sys==SYS_GAL||sys==SYS_QZS||sys==SYS_CMP) {
+        return (eph=seleph(opt,time,sat,-1,nav))?(int)(eph-nav->eph):-1;
+    }
+    else if (sys==SYS_GLO) {
+        return (geph=selgeph(time,sat,-1,nav))?(int)(geph-nav->geph):-1;
+    }
+    else if (sys==SYS_SBS) {
+        return (seph=selseph(time,sat,nav))?(int)(seph-nav->seph):-1;
+    }
+    return -1;
+}
+typedef struct {        /* satellite state grid fill argument type */
+    const prcopt_t *opt; /* processing options */
+    const nav_t *nav;   /* navigation data */
+    satgrid_t *sgrid;   /* satellite state grid */
+} sgridarg_t;
+
+/* fill satellite state grid of a satellite ----------------------------------*/
+static void sgrid_fill(int i, void *arg)
+{
+    sgridarg_t *a=(sgridarg_t *)arg;
+    const satgrid_t *sgrid=a->sgrid;
+    sgridd_t *d=sgrid->data+i*sgrid->n;
+    gtime_t time;
+    double var;
+    int j,k,sat=i+1;
+    
+    for (k=0;k<sgrid->n;k++,d++) {
+        for (j=0;j<6;j++) d->rs[j]=0.0;
+        d->dts[0]=d->dts[1]=0.0;
+        d->var=0.0f; d->svh=-1;
+        
+        time=timeadd(sgrid->ts,k*sgrid->tint);
+        
+        if ((d->eid=sgrid_eid(a->opt,time,sat,sgrid->ephopt,a->nav))<0) continue;
+        
+        if (!satpos(a->opt,time,time,sat,sgrid->ephopt,a->nav,d->rs,d->dts,&var,
+                    &d->svh)) {
+            d->eid=-1;
+            continue;
+        }
+        /* if no precise clock available, use broadcast clock instead */
+        if (d->dts[0]==0.0) {
+            if (!ephclk(a->opt,time,time,sat,a->nav,d->dts)) {
+                d->eid=-1;
+                continue;
+            }
+            d->dts[1]=0.0;
+            var=SQR(STD_BRDCCLK);
+        }
+        d->var=(float)var;
+    }
+}
+/* generate satellite state grid -----------------------------------------------
+* precompute satellite positions, velocities and clocks of all satellites on a
+* regular time grid covering a processing session
+* args   : prcopt_t *opt    I   processing options
+*          gtime_t ts       I   session start time (gpst)
+*          gtime_t te       I   session end time (gpst)
+*          double tint      I   grid interval (s)
+*          int    ephopt    I   ephemeris option (EPHOPT_BRDC or EPHOPT_PREC)
+*          nav_t  *nav      I   navigation data
+* return : satellite state grid (NULL: error or ephemeris option not supported)
+* notes  : grid epochs are aligned to integer multiples of tint in gps week and
+*          padded for the interpolation stencil at both ends.
+*          grid data are filled in parallel by opt->nthread threads.
+*          the grid must be released by satgrid_free()
+*-----------------------------------------------------------------------------*/
+extern satgrid_t *satgrid_new(const prcopt_t *opt, gtime_t ts, gtime_t te,
+                              double tint, int ephopt, const nav_t *nav)
+{
+    satgrid_t *sgrid;
+    sgridarg_t arg;
+    double tow;
+    int week,n;
+    
+    trace(3,"satgrid_new: ts=%s tint=%.0f ephopt=%d\n",time_str(ts,0),tint,
+          ephopt);
+    
+    if (tint<=0.0||(ephopt!=EPHOPT_BRDC&&ephopt!=EPHOPT_PREC)) return NULL;
+    
+    tow=time2gpst(ts,&week);
+    ts=gpst2time(week,(floor(tow/tint)-NPSGRID/2)*tint);
+    n=(int)ceil(timediff(te,ts)/tint)+NPSGRID/2+2;
+    
+    if (n<=NPSGRID||n>MAXSGRID) {
+        trace(2,"satgrid_new: invalid grid epochs n=%d\n",n);
+        return NULL;
+    }
+    if (!(sgrid=(satgrid_t *)malloc(sizeof(satgrid_t)))||
+        !(sgrid->data=(sgridd_t *)malloc(sizeof(sgridd_t)*MAXSAT*n))) {
+        trace(1,"satgrid_new: malloc error n=%d\n",n);
+        free(sgrid);
+        return NULL;
+    }
+    sgrid->ts=ts;
+    sgrid->tint=tint;
+    sgrid->n=n;
+    sgrid->ephopt=ephopt;
+    
+    arg.opt=opt;
+    arg.nav=nav;
+    arg.sgrid=sgrid;
+    
+    parfor(MAXSAT,opt->nthread,sgrid_fill,&arg);
+    
+    return sgrid;
+}
+/* free satellite state grid ---------------------------------------------------
+* free satellite state grid generated by satgrid_new()
+* args   : satgrid_t *sgrid I   satellite state grid (NULL: no operation)
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void satgrid_free(satgrid_t *sgrid)
+{
+    if (!sgrid) return;
+    free(sgrid->data);
+    free(sgrid);
+}
+/* polynomial interpolation by Neville's algorithm ---------------------------*/
+static double sgrid_interp(const double *x, double *y, int n)
+{
+    int i,j;
+    
+    for (j=1;j<n;j++) {
+        for (i=0;i<n-j;i++) {
+            y[i]=(x[i+j]*y[i]-x[i]*y[i+1])/(x[i+j]-x[i]);
+        }
+    }
+    return y[0];
+}
+/* satellite position and clock by satellite state grid -----------------------
+* interpolate satellite position, velocity and clock on satellite state grid
+* args   : satgrid_t *sgrid I   satellite state grid
+*          gtime_t time     I   time (gpst)
+*          int    sat       I   satellite number
+*          double *rs       O   sat position and velocity (ecef) {x,y,z,vx,vy,vz}
+*          double *dts      O   sat clock {bias,drift} (s|s/s)
+*          double *var      O   sat position and clock error variance (m^2)
+*          int    *svh      O   sat health flag
+* return : status (1:ok,0:out of grid or not interpolatable)
+* notes  : position and velocity are interpolated by NPSGRID points polynomial,
+*          clock by linear interpolation. the interpolation fails if the
+*          stencil includes an epoch without data or a change of ephemeris or
+*          health flag, so the caller should compute the state directly
+*-----------------------------------------------------------------------------*/
+extern int satgrid_pos(const satgrid_t *sgrid, gtime_t time, int sat,
+                       double *rs, double *dts, double *var, int *svh)
+{
+    const sgridd_t *d;
+    double tt,a,t[NPSGRID],p[6][NPSGRID],sinl,cosl;
+    int i,j,k,i0;
+    
+    if (!sgrid||sat<=0||sat>MAXSAT) return 0;
+    
+    tt=timediff(time,sgrid->ts)/sgrid->tint;
+    k=(int)floor(tt);
+    i0=k-NPSGRID/2+1;
+    
+    if (i0<0||i0+NPSGRID>sgrid->n) return 0;
+    
+    d=sgrid->data+(sat-1)*sgrid->n+i0;
+    
+    for (i=0;i<NPSGRID;i++) {
+        if (d[i].eid<0||d[i].eid!=d[0].eid||d[i].svh!=d[0].svh) return 0;
+    }
+    for (i=0;i<NPSGRID;i++) {
+        t[i]=(i0+i-tt)*sgrid->tint;
+        
+        /* correction for earh rotation ver.2.4.0 */
+        sinl=sin(OMGE*t[i]);
+        cosl=cos(OMGE*t[i]);
+        p[0][i]=cosl*d[i].rs[0]-sinl*d[i].rs[1];
+        p[1][i]=sinl*d[i].rs[0]+cosl*d[i].rs[1];
+        p[2][i]=d[i].rs[2];
+        for (j=3;j<6;j++) p[j][i]=d[i].rs[j];
+    }
+    for (j=0;j<6;j++) rs[j]=sgrid_interp(t,p[j],NPSGRID);
+    
+    /* linear interpolation of clock */
+    d+=k-i0;
+    a=tt-k;
+    dts[0]=(1.0-a)*d[0].dts[0]+a*d[1].dts[0];
+    dts[1]=(1.0-a)*d[0].dts[1]+a*d[1].dts[1];
+    *var=d[0].var>d[1].var?d[0].var:d[1].var;
+    *svh=d[0].svh;
+    return 1;
+}
 /* select satellite ephemeris --------------------------------------------------
 * select satellite ephemeris. call it before calling satpos(),satposs().
 * args   : int    sys       I   satellite system (SYS_???)
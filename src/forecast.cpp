@@ -0,0 +1,406 @@
+/*------------------------------------------------------------------------------
+* forecast.c : satellite visibility and dop forecast functions
+*
+* references :
+*     [1] IS-GPS-200K, Navstar GPS Space Segment/Navigation User Interfaces,
+*         March 4, 2019
+*     [2] U.S.Coast Guard Navigation Center, YUMA almanac format
+*         (https://www.navcen.uscg.gov)
+*
+* version : $Revision:$ $Date:$
+* history : 2026/10/18 1.0  new
+*-----------------------------------------------------------------------------*/
+#include "rtklib.h"
+
+#define MU_GPS   3.9860050E14     /* gravitational constant         ref [1] */
+#define MU_GAL   3.986004418E14   /* earth gravitational constant */
+#define RTOL_KEPLER 1E-13         /* relative tolerance for Kepler equation */
+#define MAX_ITER_KEPLER 30        /* max number of iteration of Kelpler */
+
+/* add almanac data ----------------------------------------------------------*/
+static int add_alm(nav_t *nav, const alm_t *alm)
+{
+    alm_t *nav_alm;
+    
+    if (nav->na>=nav->namax) {
+        nav->namax+=MAXSAT;
+        if (!(nav_alm=(alm_t *)realloc(nav->alm,sizeof(alm_t)*nav->namax))) {
+            trace(1,"readyuma malloc error: n=%d\n",nav->namax);
+            free(nav->alm); nav->alm=NULL; nav->na=nav->namax=0;
+            return 0;
+        }
+        nav->alm=nav_alm;
+    }
+    nav->alm[nav->na++]=*alm;
+    return 1;
+}
+/* read yuma almanac -----------------------------------------------------------
+* read GPS almanac in YUMA format (ref [2])
+* args   : char   *file     I   YUMA almanac file
+*          nav_t  *nav      IO  navigation data (nav->alm,na,namax)
+* return : number of almanacs read (-1: error)
+* notes  : gps week number of almanac (mod 1024) is adjusted by adjgpsweek()
+*-----------------------------------------------------------------------------*/
+extern int readyuma(const char *file, nav_t *nav)
+{
+    FILE *fp;
+    alm_t alm={0};
+    char buff[256],*p;
+    double val;
+    int n=0;
+    
+    trace(3,"readyuma: file=%s\n",file);
+    
+    if (!(fp=fopen(file,"r"))) {
+        trace(2,"yuma almanac file open error: %s\n",file);
+        return -1;
+    }
+    while (fgets(buff,sizeof(buff),fp)) {
+        if (!(p=strchr(buff,':'))) continue;
+        val=atof(p+1);
+    
+        if      (!strncmp(buff,"ID"          , 2)) alm.sat=satno(SYS_GPS,(int)val);
+        else if (!strncmp(buff,"Health"      , 6)) alm.svh=(int)val;
+        else if (!strncmp(buff,"Eccentricity",12)) alm.e=val;
+        else if (!strncmp(buff,"Time of Appl",12)) alm.toas=val;
+        else if (!strncmp(buff,"Orbital Incl",12)) alm.i0=val;
+        else if (!strncmp(buff,"Rate of Righ",12)) alm.OMGd=val;
+        else if (!strncmp(buff,"SQRT(A)"     , 7)) alm.A=val*val;
+        else if (!strncmp(buff,"Right Ascen" ,11)) alm.OMG0=val;
+        else if (!strncmp(buff,"Argument of" ,11)) alm.omg=val;
+        else if (!strncmp(buff,"Mean Anom"   , 9)) alm.M0=val;
+        else if (!strncmp(buff,"Af0"         , 3)) alm.f0=val;
+        else if (!strncmp(buff,"Af1"         , 3)) alm.f1=val;
+        else if (!strncmp(buff,"week"        , 4)) {
+            alm.week=adjgpsweek((int)val);
+            alm.toa=gpst2time(alm.week,alm.toas);
+            if (alm.sat>0&&alm.A>0.0) {
+                if (!add_alm(nav,&alm)) {
+                    fclose(fp);
+                    return -1;
+                }
+                n++;
+            }
+            memset(&alm,0,sizeof(alm_t));
+        }
+    }
+    fclose(fp);
+    return n;
+}
+/* orbit kernels ---------------------------------------------------------------
+* satellite positions on time grid are stored as struct of arrays:
+* x[k+i*nt],y[k+i*nt],z[k+i*nt] for satellite i+1 at epoch k, v[k+i*nt]=0 for
+* no position
+*-----------------------------------------------------------------------------*/
+typedef struct {        /* forecast argument type */
+    const nav_t *nav;   /* navigation data */
+    int alm;            /* orbit source (1:almanac,0:broadcast ephemeris) */
+    int navsys;         /* navigation systems */
+    const double *pos;  /* site positions {lat,lon,h} (rad,m) */
+    double elmask;      /* elevation mask (rad) */
+    visfcst_t *vf;      /* forecast */
+    double *x,*y,*z;    /* satellite positions on time grid (ecef) (m) */
+    unsigned char *v;   /* valid flags on time grid */
+    unsigned char act[MAXSAT]; /* satellites with orbit */
+    int *nw,*nwmax;     /* number of windows of sites */
+    int *err;           /* memory allocation error of sites */
+    viswin_t **win;     /* windows of sites */
+} fcstarg_t;
+
+/* almanac orbit on time grid ------------------------------------------------*/
+static void orbit_alm(const alm_t *alm, gtime_t ts, double tint, int nt,
+                      double *x, double *y, double *z, unsigned char *v)
+{
+    double tk0,tk,n0,sqe,cosi,sini,Od,O0,M,E,Ek,sinE,cosE,u,r,xo,yo,sinO,cosO;
+    int k,n;
+    
+    if (alm->A<=0.0) return;
+    
+    /* constants of orbit */
+    n0=sqrt((satsys(alm->sat,NULL)==SYS_GAL?MU_GAL:MU_GPS)/
+            (alm->A*alm->A*alm->A));
+    sqe=sqrt(1.0-alm->e*alm->e);
+    cosi=cos(alm->i0); sini=sin(alm->i0);
+    Od=alm->OMGd-OMGE;
+    O0=alm->OMG0-OMGE*alm->toas;
+    tk0=timediff(ts,alm->toa);
+    
+    for (k=0;k<nt;k++) {
+        tk=tk0+k*tint;
+        M=alm->M0+n0*tk;
+        for (n=0,E=M,Ek=0.0;fabs(E-Ek)>RTOL_KEPLER&&n<MAX_ITER_KEPLER;n++) {
+            Ek=E; E-=(E-alm->e*sin(E)-M)/(1.0-alm->e*cos(E));
+        }
+        if (n>=MAX_ITER_KEPLER) continue;
+    
+        sinE=sin(E); cosE=cos(E);
+        u=atan2(sqe*sinE,cosE-alm->e)+alm->omg;
+        r=alm->A*(1.0-alm->e*cosE);
+        sinO=sin(O0+Od*tk); cosO=cos(O0+Od*tk);
+        xo=r*cos(u); yo=r*sin(u);
+        x[k]=xo*cosO-yo*cosi*sinO;
+        y[k]=xo*sinO+yo*cosi*cosO;
+        z[k]=yo*sini;
+        v[k]=1;
+    }
+}
+/* broadcast ephemeris orbit on time grid ------------------------------------*/
+static void orbit_eph(const nav_t *nav, int sat, gtime_t ts, double tint,
+                      int nt, double *x, double *y, double *z, unsigned char *v)
+{
+    gtime_t time;
+    double rs[3],dts,var,tt;
+    int i,j,k,*idx,n=0;
+    
+    if (!(idx=(int *)malloc(sizeof(int)*(nav->n>0?nav->n:1)))) return;
+    
+    /* ephemerides of satellite sorted by toe */
+    for (i=0;i<nav->n;i++) {
+        if (nav->eph[i].sat!=sat) continue;
+        for (j=n++;j>0&&timediff(nav->eph[idx[j-1]].toe,nav->eph[i].toe)>0.0;j--) {
+            idx[j]=idx[j-1];
+        }
+        idx[j]=i;
+    }
+    for (k=j=0;k<nt&&n>0;k++) {
+        time=timeadd(ts,k*tint);
+    
+        /* ephemeris with nearest toe */
+        for (;j<n-1;j++) {
+            tt=timediff(time,nav->eph[idx[j]].toe);
+            if (fabs(timediff(time,nav->eph[idx[j+1]].toe))>=fabs(tt)) break;
+        }
+        if (nav->eph[idx[j]].svh) continue;
+    
+        eph2pos(time,nav->eph+idx[j],rs,&dts,&var);
+        x[k]=rs[0]; y[k]=rs[1]; z[k]=rs[2];
+        v[k]=1;
+    }
+    free(idx);
+}
+static void fcst_orbit(int i, void *arg)
+{
+    fcstarg_t *a=(fcstarg_t *)arg;
+    const visfcst_t *vf=a->vf;
+    int j,nt=vf->nt,sys=satsys(i+1,NULL);
+    
+    if (!(sys&a->navsys)) return;
+    
+    if (a->alm) {
+        for (j=0;j<a->nav->na;j++) {
+            if (a->nav->alm[j].sat!=i+1||a->nav->alm[j].svh) continue;
+            orbit_alm(a->nav->alm+j,vf->ts,vf->tint,nt,a->x+i*nt,a->y+i*nt,
+                      a->z+i*nt,a->v+i*nt);
+            break;
+        }
+    }
+    else if (sys!=SYS_GLO&&sys!=SYS_SBS) {
+        orbit_eph(a->nav,i+1,vf->ts,vf->tint,nt,a->x+i*nt,a->y+i*nt,
+                  a->z+i*nt,a->v+i*nt);
+    }
+}
+/* add visibility window -----------------------------------------------------*/
+static int add_win(fcstarg_t *a, int m, const viswin_t *win)
+{
+    viswin_t *data;
+    
+    if (a->nw[m]>=a->nwmax[m]) {
+        a->nwmax[m]=a->nwmax[m]<=0?64:a->nwmax[m]*2;
+        if (!(data=(viswin_t *)realloc(a->win[m],sizeof(viswin_t)*a->nwmax[m]))) {
+            free(a->win[m]); a->win[m]=NULL; a->nw[m]=a->nwmax[m]=0;
+            return 0;
+        }
+        a->win[m]=data;
+    }
+    a->win[m][a->nw[m]++]=*win;
+    return 1;
+}
+/* visibility and dops of a site ---------------------------------------------*/
+static void fcst_site(int m, void *arg)
+{
+    fcstarg_t *a=(fcstarg_t *)arg;
+    visfcst_t *vf=a->vf;
+    viswin_t win[MAXSAT]={{0}};
+    const double *pos=a->pos+m*3;
+    double rr[3],e[3],r,el,elp[MAXSAT],azel[2*MAXSAT],dop[4],x;
+    int i,j,k,n,nt=vf->nt,vis[MAXSAT]={0};
+    
+    pos2ecef(pos,rr);
+    
+    /* elevation angle at previous epoch (-pi/2: no position) */
+    for (i=0;i<MAXSAT;i++) elp[i]=-PI/2.0;
+    
+    for (k=0;k<nt;k++) {
+        for (i=n=0;i<MAXSAT;i++) {
+            if (!a->act[i]) continue;
+            
+            /* azimuth/elevation angle */
+            el=-PI/2.0;
+            if (a->v[k+i*nt]) {
+                e[0]=a->x[k+i*nt]-rr[0];
+                e[1]=a->y[k+i*nt]-rr[1];
+                e[2]=a->z[k+i*nt]-rr[2];
+                r=norm(e,3);
+                for (j=0;j<3;j++) e[j]/=r;
+                el=satazel(pos,e,azel+n*2);
+            }
+            if (el>=a->elmask) {
+                if (!vis[i]) { /* start of window */
+                    x=k>0&&elp[i]>-PI/2.0?(a->elmask-elp[i])/(el-elp[i]):1.0;
+                    win[i].sat=i+1;
+                    win[i].site=m;
+                    win[i].ts=timeadd(vf->ts,(k-1+x)*vf->tint);
+                    win[i].elmax=el;
+                    vis[i]=1;
+                }
+                else if (el>win[i].elmax) win[i].elmax=el;
+                n++;
+            }
+            else if (vis[i]) { /* end of window */
+                x=el>-PI/2.0?(a->elmask-elp[i])/(el-elp[i]):0.0;
+                win[i].te=timeadd(vf->ts,(k-1+x)*vf->tint);
+                if (!add_win(a,m,win+i)) {
+                    a->err[m]=1;
+                    return;
+                }
+                vis[i]=0;
+            }
+            elp[i]=el;
+        }
+        vf->ns[k+m*nt]=n;
+        
+        dops(n,azel,a->elmask,dop);
+        for (j=0;j<4;j++) vf->dop[(k+m*nt)*4+j]=(float)dop[j];
+    }
+    /* windows in progress at last epoch */
+    for (i=0;i<MAXSAT;i++) {
+        if (!vis[i]) continue;
+        win[i].te=timeadd(vf->ts,(nt-1)*vf->tint);
+        if (!add_win(a,m,win+i)) {
+            a->err[m]=1;
+            return;
+        }
+    }
+}
+/* compare visibility windows by site and start time -------------------------*/
+static int cmp_win(const void *p1, const void *p2)
+{
+    const viswin_t *q1=(const viswin_t *)p1,*q2=(const viswin_t *)p2;
+    double tt;
+    
+    if (q1->site!=q2->site) return q1->site-q2->site;
+    if ((tt=timediff(q1->ts,q2->ts))!=0.0) return tt<0.0?-1:1;
+    return q1->sat-q2->sat;
+}
+/* visibility and dop forecast -------------------------------------------------
+* forecast satellite visibility windows, number of visible satellites and dops
+* of sites over a time grid
+* args   : nav_t  *nav      I   navigation data
+*          int    alm       I   orbit source (1:almanac,0:broadcast ephemeris)
+*          int    navsys    I   navigation systems (SYS_???)
+*          gtime_t ts       I   first epoch (GPST)
+*          double tint      I   epoch interval (s)
+*          int    nt        I   number of epochs
+*          double *pos      I   site positions {lat,lon,h} (rad,m) (3 x nsite)
+*          int    nsite     I   number of sites
+*          double elmask    I   elevation mask (rad)
+*          int    nthread   I   number of threads (0:number of cpus)
+*          visfcst_t *vf    O   forecast
+* return : status (1:ok,0:error)
+* notes  : satellite orbits are computed once on the time grid and shared by
+*          all sites. orbits and sites are processed in parallel.
+*          broadcast ephemeris with the nearest toe is used for each epoch,
+*          so the forecast beyond the ephemeris span is extrapolated.
+*          glonass and sbas are not supported.
+*          unhealthy satellites are excluded.
+*          release the forecast by visfcst_free()
+*-----------------------------------------------------------------------------*/
+extern int visfcst(const nav_t *nav, int alm, int navsys, gtime_t ts,
+                   double tint, int nt, const double *pos, int nsite,
+                   double elmask, int nthread, visfcst_t *vf)
+{
+    fcstarg_t arg={0};
+    int i,k,n;
+    
+    trace(3,"visfcst: alm=%d ts=%s tint=%.0f nt=%d nsite=%d\n",alm,
+          time_str(ts,0),tint,nt,nsite);
+    
+    vf->nsite=vf->nt=vf->nw=0;
+    vf->ns=NULL; vf->dop=NULL; vf->win=NULL;
+    
+    if (nt<=0||nsite<=0) return 0;
+    
+    arg.nav=nav;
+    arg.alm=alm;
+    arg.navsys=navsys;
+    arg.pos=pos;
+    arg.elmask=elmask;
+    arg.vf=vf;
+    
+    if (!(arg.x=zeros(3*MAXSAT,nt))||
+        !(arg.v=(unsigned char *)calloc(MAXSAT*nt,1))||
+        !(arg.nw=(int *)calloc(nsite,sizeof(int)))||
+        !(arg.nwmax=(int *)calloc(nsite,sizeof(int)))||
+        !(arg.err=(int *)calloc(nsite,sizeof(int)))||
+        !(arg.win=(viswin_t **)calloc(nsite,sizeof(viswin_t *)))||
+        !(vf->ns=(int *)malloc(sizeof(int)*nt*nsite))||
+        !(vf->dop=(float *)malloc(sizeof(float)*4*nt*nsite))) {
+        trace(1,"visfcst: malloc error nt=%d nsite=%d\n",nt,nsite);
+        matfree(arg.x); free(arg.v); free(arg.nw); free(arg.nwmax);
+        free(arg.err); free(arg.win);
+        free(vf->ns); vf->ns=NULL;
+        return 0;
+    }
+    arg.y=arg.x+MAXSAT*nt;
+    arg.z=arg.y+MAXSAT*nt;
+    vf->nsite=nsite;
+    vf->nt=nt;
+    vf->ts=ts;
+    vf->tint=tint;
+    
+    /* satellite orbits on time grid */
+    parfor(MAXSAT,nthread,fcst_orbit,&arg);
+    
+    for (i=0;i<MAXSAT;i++) for (k=0;k<nt&&!arg.act[i];k++) {
+        arg.act[i]=arg.v[k+i*nt];
+    }
+    
+    /* visibility and dops of sites */
+    parfor(nsite,nthread,fcst_site,&arg);
+    
+    for (i=n=0;i<nsite;i++) {
+        if (arg.err[i]) {
+            trace(1,"visfcst: malloc error site=%d\n",i);
+            n=-1;
+            break;
+        }
+        n+=arg.nw[i];
+    }
+    if (n>0&&(vf->win=(viswin_t *)malloc(sizeof(viswin_t)*n))) {
+        for (i=0;i<nsite;i++) {
+            memcpy(vf->win+vf->nw,arg.win[i],sizeof(viswin_t)*arg.nw[i]);
+            vf->nw+=arg.nw[i];
+        }
+        qsort(vf->win,vf->nw,sizeof(viswin_t),cmp_win);
+    }
+    else if (n!=0) {
+        trace(1,"visfcst: malloc error nw=%d\n",n);
+        visfcst_free(vf);
+    }
+    for (i=0;i<nsite;i++) free(arg.win[i]);
+    matfree(arg.x); free(arg.v); free(arg.nw); free(arg.nwmax); free(arg.err);
+    free(arg.win);
+    return n>=0&&vf->nt>0;
+}
+/* free visibility and dop forecast --------------------------------------------
+* free forecast generated by visfcst()
+* args   : visfcst_t *vf    IO  forecast
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void visfcst_free(visfcst_t *vf)
+{
+    free(vf->ns ); vf->ns =NULL;
+    free(vf->dop); vf->dop=NULL;
+    free(vf->win); vf->win=NULL;
+    vf->nsite=vf->nt=vf->nw=0;
+}
@@ -23,6 +23,14 @@
 #define MIN_EL      0.0         /* min elevation angle (rad) */
 #define MIN_HGT     -1000.0     /* min user height (m) */
 
+typedef struct {        /* tec grid maps of an epoch */
+    const tec_t *tec[2]; /* maps before/after the epoch */
+    double a;           /* time interpolation weight of the map after */
+    double rot[2];      /* earth rotation corrections of the maps (rad) */
+    int share;          /* pierce points shared by the maps (same layers) */
+    int opt;            /* model option */
+} tecep_t;
+
 /* get index -----------------------------------------------------------------*/
 static int getindex(double value, const double *range)
 {
@@ -370,44 +378,198 @@ static int interptec(const tec_t *tec, int k, const double *posp, double *value,
     }
     return 1;
 }
-/* ionosphere delay by tec grid data -----------------------------------------*/
-static int iondelay(gtime_t time, const tec_t *tec, const double *pos,
-                    const double *azel, int opt, double *delay, double *var)
+/* index of the first tec grid map after time --------------------------------*/
+static int tecindex(gtime_t time, const nav_t *nav)
 {
-    const double fact=40.30E16/FREQ1/FREQ1; /* tecu->L1 iono (m) */
-    double fs,posp[3]={0},vtec,rms,hion,rp;
-    int i;
+    int i=0,j=nav->nt,k;
     
-    trace(3,"iondelay: time=%s pos=%.1f %.1f azel=%.1f %.1f\n",time_str(time,0),
-          pos[0]*R2D,pos[1]*R2D,azel[0]*R2D,azel[1]*R2D);
+    /* binary search (maps sorted by time in combtec()) */
+    while (i<j) {
+        k=(i+j)/2;
+        if (timediff(nav->tec[k].time,time)>0.0) j=k; else i=k+1;
+    }
+    return i;
+}
+/* tec grid maps of an epoch -------------------------------------------------*/
+static int tecepoch(gtime_t time, const nav_t *nav, int opt, tecep_t *ep)
+{
+    const tec_t *tec;
+    double tt;
+    int i,k;
     
-    *delay=*var=0.0;
+    i=tecindex(time,nav);
     
-    for (i=0;i<tec->ndata[2];i++) { /* for a layer */
-        
-        hion=tec->hgts[0]+tec->hgts[2]*i;
+    if (i==0||i>=nav->nt) {
+        trace(2,"%s: tec grid out of period\n",time_str(time,0));
+        return 0;
+    }
+    if ((tt=timediff(nav->tec[i].time,nav->tec[i-1].time))==0.0) {
+        trace(2,"tec grid time interval error\n");
+        return 0;
+    }
+    ep->tec[0]=nav->tec+i-1;
+    ep->tec[1]=nav->tec+i;
+    ep->a=timediff(time,nav->tec[i-1].time)/tt;
+    
+    for (k=0;k<2;k++) {
+        ep->rot[k]=2.0*PI*timediff(time,ep->tec[k]->time)/86400.0;
+    }
+    /* pierce points shared by both maps if same layers */
+    tec=ep->tec[0];
+    ep->share=tec->rb==ep->tec[1]->rb&&tec->ndata[2]==ep->tec[1]->ndata[2]&&
+              tec->hgts[0]==ep->tec[1]->hgts[0]&&tec->hgts[2]==ep->tec[1]->hgts[2];
+    ep->opt=opt;
+    return 1;
+}
+/* pierce points of satellites for a layer of tec grid map -------------------*/
+static void tecipps(const tec_t *tec, int k, const double *pos,
+                    const double *azel, const int *sel, int n, int opt,
+                    double *posp, double *fs)
+{
+    double hion,rp;
+    int i;
+    
+    hion=tec->hgts[0]+tec->hgts[2]*k;
+    
+    for (i=0;i<n;i++) {
+        if (!sel[i]) continue;
         
         /* ionospheric pierce point position */
-        fs=ionppp(pos,azel,tec->rb,hion,posp);
+        fs[i]=ionppp(pos,azel+i*2,tec->rb,hion,posp+i*3);
         
         if (opt&2) {
             /* modified single layer mapping function (M-SLM) ref [2] */
-            rp=tec->rb/(tec->rb+hion)*sin(0.9782*(PI/2.0-azel[1]));
-            fs=1.0/sqrt(1.0-rp*rp);
-        }
-        if (opt&1) {
-            /* earth rotation correction (sun-fixed coordinate) */
-            posp[1]+=2.0*PI*timediff(time,tec->time)/86400.0;
+            rp=tec->rb/(tec->rb+hion)*sin(0.9782*(PI/2.0-azel[1+i*2]));
+            fs[i]=1.0/sqrt(1.0-rp*rp);
         }
-        /* interpolate tec grid data */
-        if (!interptec(tec,i,posp,&vtec,&rms)) return 0;
+    }
+}
+/* ionosphere delays by tec grid map for satellites --------------------------*/
+static void iondelays(const tecep_t *ep, int m, const double *pos,
+                      const double *azel, const int *sel, int n,
+                      double *posp, double *fs, double *delay, double *var,
+                      int *stat)
+{
+    const double fact=40.30E16/FREQ1/FREQ1; /* tecu->L1 iono (m) */
+    const tec_t *tec=ep->tec[m];
+    double pp[3]={0},vtec,rms;
+    int i,k,nl=tec->ndata[2];
+    
+    for (i=0;i<n;i++) {
+        delay[i]=var[i]=0.0;
+        stat[i]=sel[i];
+    }
+    for (k=0;k<nl;k++) { /* for a layer */
         
-        *delay+=fact*fs*vtec;
-        *var+=fact*fact*fs*fs*rms*rms;
+        /* pierce points (computed for the first map if shared) */
+        if (m==0||!ep->share) {
+            tecipps(tec,k,pos,azel,sel,n,ep->opt,posp+k*n*3,fs+k*n);
+        }
+        for (i=0;i<n;i++) {
+            if (!stat[i]) continue;
+            
+            pp[0]=posp[  (i+k*n)*3];
+            pp[1]=posp[1+(i+k*n)*3];
+            
+            if (ep->opt&1) {
+                /* earth rotation correction (sun-fixed coordinate) */
+                pp[1]+=ep->rot[m];
+            }
+            /* interpolate tec grid data */
+            if (!interptec(tec,k,pp,&vtec,&rms)) {
+                stat[i]=0;
+                continue;
+            }
+            delay[i]+=fact*fs[i+k*n]*vtec;
+            var[i]+=fact*fact*fs[i+k*n]*fs[i+k*n]*rms*rms;
+        }
     }
-    trace(4,"iondelay: delay=%7.2f std=%6.2f\n",*delay,sqrt(*var));
+}
+/* ionosphere model by tec grid data for satellites ----------------------------
+* compute ionospheric delays of satellites by tec grid data
+* args   : gtime_t time     I   time (gpst)
+*          nav_t  *nav      I   navigation data
+*          double *pos      I   receiver position {lat,lon,h} (rad,m)
+*          double *azel     I   azimuth/elevation angles azel[(0:1)+i*2] (rad)
+*          int    n         I   number of satellites
+*          int    opt       I   model option (see iontec())
+*          double *delay    IO  ionospheric delays (B1I) (m)
+*          double *var      IO  ionospheric dealy (B1I) variances (m^2)
+*          int    *stat     O   status of satellites (1:ok,0:error)
+* return : number of satellites ok
+* notes  : the bracketing maps, the time interpolation weight and the earth
+*          rotation corrections are computed once for the epoch. the pierce
+*          points are computed once for both maps and looked up map by map
+*          for all satellites
+*          delay and var are not modified for the satellites with error
+*          the delays are equal to the ones of iontec()
+*-----------------------------------------------------------------------------*/
+extern int iontecs(gtime_t time, const nav_t *nav, const double *pos,
+                   const double *azel, int n, int opt, double *delay,
+                   double *var, int *stat)
+{
+    const double k=FREQ1*FREQ1/FREQ1_CMP/FREQ1_CMP; /* GPS L1 -> BDS B1I */
+    tecep_t ep;
+    double *posp,*fs,*dels,*vars;
+    int i,nl,nok=0,*sel,*stats;
     
-    return 1;
+    trace(3,"iontecs : time=%s pos=%.1f %.1f n=%d\n",time_str(time,0),
+          pos[0]*R2D,pos[1]*R2D,n);
+    
+    if (n<=0) return 0;
+    
+    sel=imat(n,3);
+    for (i=0;i<n;i++) {
+        stat[i]=0;
+        if (azel[1+i*2]<MIN_EL||pos[2]<MIN_HGT) {
+            delay[i]=0.0;
+            var[i]=VAR_NOTEC;
+            stat[i]=1; nok++;
+        }
+        sel[i]=!stat[i];
+    }
+    if (nok>=n||!tecepoch(time,nav,opt,&ep)) {
+        matfree(sel);
+        return nok;
+    }
+    nl=ep.tec[0]->ndata[2]>ep.tec[1]->ndata[2]?ep.tec[0]->ndata[2]:ep.tec[1]->ndata[2];
+    stats=sel+n;
+    posp=zeros(3,n*nl); fs=mat(n,nl);
+    dels=mat(n,2); vars=mat(n,2);
+    
+    /* ionospheric delays by tec grid maps before/after the epoch */
+    iondelays(&ep,0,pos,azel,sel,n,posp,fs,dels  ,vars  ,stats  );
+    iondelays(&ep,1,pos,azel,sel,n,posp,fs,dels+n,vars+n,stats+n);
+    
+    for (i=0;i<n;i++) {
+        if (!sel[i]) continue;
+        
+        if (!stats[i]&&!stats[i+n]) {
+            trace(2,"%s: tec grid out of area pos=%6.2f %7.2f azel=%6.1f %5.1f\n",
+                  time_str(time,0),pos[0]*R2D,pos[1]*R2D,azel[i*2]*R2D,
+                  azel[1+i*2]*R2D);
+            continue;
+        }
+        if (stats[i]&&stats[i+n]) { /* linear interpolation by time */
+            delay[i]=dels[i]*(1.0-ep.a)+dels[i+n]*ep.a;
+            var  [i]=vars[i]*(1.0-ep.a)+vars[i+n]*ep.a;
+        }
+        else if (stats[i]) { /* nearest-neighbour extrapolation by time */
+            delay[i]=dels[i];
+            var  [i]=vars[i];
+        }
+        else {
+            delay[i]=dels[i+n];
+            var  [i]=vars[i+n];
+        }
+        /* transfer GPS L1 to BDS B1I */
+        delay[i]=delay[i]*k;
+        stat[i]=1; nok++;
+        
+        trace(4,"iontecs : i=%d delay=%5.2f std=%5.2f\n",i,delay[i],sqrt(var[i]));
+    }
+    matfree(sel); matfree(posp); matfree(fs); matfree(dels); matfree(vars);
+    return nok;
 }
 /* ionosphere model by tec grid data -------------------------------------------
 * compute ionospheric delay by tec grid data
@@ -427,53 +589,13 @@ static int iondelay(gtime_t time, const tec_t *tec, const double *pos,
 extern int iontec(gtime_t time, const nav_t *nav, const double *pos,
                   const double *azel, int opt, double *delay, double *var)
 {
-    double dels[2],vars[2],a,tt;
-    int i,stat[2];
+    int stat;
     
     trace(3,"iontec  : time=%s pos=%.1f %.1f azel=%.1f %.1f\n",time_str(time,0),
           pos[0]*R2D,pos[1]*R2D,azel[0]*R2D,azel[1]*R2D);
     
-    if (azel[1]<MIN_EL||pos[2]<MIN_HGT) {
-        *delay=0.0;
-        *var=VAR_NOTEC;
-        return 1;
-    }
-    for (i=0;i<nav->nt;i++) {
-        if (timediff(nav->tec[i].time,time)>0.0) break;
-    }
-    if (i==0||i>=nav->nt) {
-        trace(2,"%s: tec grid out of period\n",time_str(time,0));
-        return 0;
-    }
-    if ((tt=timediff(nav->tec[i].time,nav->tec[i-1].time))==0.0) {
-        trace(2,"tec grid time interval error\n");
-        return 0;
-    }
-    /* ionospheric delay by tec grid data */
-    stat[0]=iondelay(time,nav->tec+i-1,pos,azel,opt,dels  ,vars  );
-    stat[1]=iondelay(time,nav->tec+i  ,pos,azel,opt,dels+1,vars+1);
+    if (!iontecs(time,nav,pos,azel,1,opt,delay,var,&stat)) return 0;
     
-    if (!stat[0]&&!stat[1]) {
-        trace(2,"%s: tec grid out of area pos=%6.2f %7.2f azel=%6.1f %5.1f\n",
-              time_str(time,0),pos[0]*R2D,pos[1]*R2D,azel[0]*R2D,azel[1]*R2D);
-        return 0;
-    }
-    if (stat[0]&&stat[1]) { /* linear interpolation by time */
-        a=timediff(time,nav->tec[i-1].time)/tt;
-        *delay=dels[0]*(1.0-a)+dels[1]*a;
-        *var  =vars[0]*(1.0-a)+vars[1]*a;
-    }
-    else if (stat[0]) { /* nearest-neighbour extrapolation by time */
-        *delay=dels[0];
-        *var  =vars[0];
-    }
-    else {
-        *delay=dels[1];
-        *var  =vars[1];
-    }
-	/*transfer GPS L1 to BDS B1I */
-	double k = FREQ1 * FREQ1/FREQ1_CMP/FREQ1_CMP;
-	*delay = *delay*k;
     trace(3,"iontec  : delay=%5.2f std=%5.2f\n",*delay,sqrt(*var));
     return 1;
 }
@@ -13,12 +13,19 @@
 * version : $Revision: 1.1 $ $Date: 2008/07/17 21:48:06 $
 * history : 2007/01/13 1.0 new
 *           2015/05/31 1.1 add api lambda_reduction(), lambda_search()
+*           2026/10/18 1.2 allocation-free decorrelation and search
+*                          lazy update of partial sums in search
+*                          fixed solutions by inverse of Z instead of solve
+*                          add api lambda_par()
 *-----------------------------------------------------------------------------*/
 #include "rtklib.h"
 
 /* constants/macros ----------------------------------------------------------*/
 
 #define LOOPMAX     10000           /* maximum count of search loop */
+#define NSTK        48              /* max number of parameters in stack */
+#define MSTK        2               /* max number of fixed solutions in stack */
+#define MAXPARSET   64              /* max number of subsets by lambda_par() */
 
 #define SGN(x)      ((x)<=0.0?-1.0:1.0)
 #define ROUND(x)    (floor((x)+0.5))
@@ -28,32 +35,35 @@
 static int LD(int n, const double *Q, double *L, double *D)
 {
     int i,j,k,info=0;
-    double a,*A=mat(n,n);
+    double a;
+    
+    /* factorized in place of the lower triangle of Q copied to L */
+    for (j=0;j<n;j++) for (i=0;i<n;i++) L[i+j*n]=i>=j?Q[i+j*n]:0.0;
     
-    memcpy(A,Q,sizeof(double)*n*n);
     for (i=n-1;i>=0;i--) {
-        if ((D[i]=A[i+i*n])<=0.0) {info=-1; break;}
+        if ((D[i]=L[i+i*n])<=0.0) {info=-1; break;}
         a=sqrt(D[i]);
-        for (j=0;j<=i;j++) L[i+j*n]=A[i+j*n]/a;
-        for (j=0;j<=i-1;j++) for (k=0;k<=j;k++) A[j+k*n]-=L[i+k*n]*L[i+j*n];
+        for (j=0;j<=i;j++) L[i+j*n]/=a;
+        for (j=0;j<=i-1;j++) for (k=0;k<=j;k++) L[j+k*n]-=L[i+k*n]*L[i+j*n];
         for (j=0;j<=i;j++) L[i+j*n]/=L[i+i*n];
     }
-    free(A);
     if (info) fprintf(stderr,"%s : LD factorization error\n",__FILE__);
     return info;
 }
-/* integer gauss transformation ----------------------------------------------*/
-static void gauss(int n, double *L, double *Z, int i, int j)
+/* integer gauss transformation (Zi: inverse of Z or NULL) ------------------*/
+static void gauss(int n, double *L, double *Z, double *Zi, int i, int j)
 {
     int k,mu;
     
     if ((mu=(int)ROUND(L[i+j*n]))!=0) {
         for (k=i;k<n;k++) L[k+n*j]-=(double)mu*L[k+i*n];
         for (k=0;k<n;k++) Z[k+n*j]-=(double)mu*Z[k+i*n];
+        if (Zi) for (k=0;k<n;k++) Zi[i+n*k]+=(double)mu*Zi[j+n*k];
     }
 }
 /* permutations --------------------------------------------------------------*/
-static void perm(int n, double *L, double *D, int j, double del, double *Z)
+static void perm(int n, double *L, double *D, int j, double del, double *Z,
+                 double *Zi)
 {
     int k;
     double eta,lam,a0,a1;
@@ -69,32 +79,48 @@ static void perm(int n, double *L, double *D, int j, double del, double *Z)
     L[j+1+j*n]=lam;
     for (k=j+2;k<n;k++) SWAP(L[k+j*n],L[k+(j+1)*n]);
     for (k=0;k<n;k++) SWAP(Z[k+j*n],Z[k+(j+1)*n]);
+    if (Zi) for (k=0;k<n;k++) SWAP(Zi[j+k*n],Zi[j+1+k*n]);
 }
 /* lambda reduction (z=Z'*a, Qz=Z'*Q*Z=L'*diag(D)*L) (ref.[1]) ---------------*/
-static void reduction(int n, double *L, double *D, double *Z)
+static void reduction(int n, double *L, double *D, double *Z, double *Zi)
 {
     int i,j,k;
     double del;
     
     j=n-2; k=n-2;
     while (j>=0) {
-        if (j<=k) for (i=j+1;i<n;i++) gauss(n,L,Z,i,j);
+        if (j<=k) for (i=j+1;i<n;i++) gauss(n,L,Z,Zi,i,j);
         del=D[j]+L[j+1+j*n]*L[j+1+j*n]*D[j+1];
         if (del+1E-6<D[j+1]) { /* compared considering numerical error */
-            perm(n,L,D,j,del,Z);
+            perm(n,L,D,j,del,Z,Zi);
             k=j; j=n-2;
         }
         else j--;
     }
 }
-/* modified lambda (mlambda) search (ref. [2]) -------------------------------*/
+/* modified lambda (mlambda) search (ref. [2]) ---------------------------------
+* the partial sums S(j,i)=sum_{l>j}(z(l)-zb(l))*L(l,i) are updated lazily. at
+* descent to level k only the column k is updated from the highest level
+* changed since its last update (path(k)) in the same order as the row update.
+* the levels changed are passed down to path(k-1) at descent to level k and at
+* move up to level k. with thres>0, the candidates with the distance over
+* thres*s[0] are pruned after the first two are found (early termination).
+* then s[1] is an upper bound of the second if the ratio s[1]/s[0]>=thres.
+*-----------------------------------------------------------------------------*/
 static int search(int n, int m, const double *L, const double *D,
-                  const double *zs, double *zn, double *s)
+                  const double *zs, double *zn, double *s, double thres)
 {
-    int i,j,k,c,nn=0,imax=0;
-    double newdist,maxdist=1E99,y;
-    double *S=zeros(n,n),*dist=mat(n,1),*zb=mat(n,1),*z=mat(n,1),*step=mat(n,1);
+    int i,j,k,c,u,nn=0,imax=0,pstk[NSTK],*path;
+    double newdist,maxdist=1E99,y,wstk[NSTK*(NSTK+4)];
+    double *S,*dist,*zb,*z,*step;
     
+    if (n<=NSTK) {S=wstk; path=pstk;}
+    else {S=mat(n,n+4); path=imat(n,1);}
+    dist=S+n*n; zb=dist+n; z=zb+n; step=z+n;
+    
+    for (i=0;i<n;i++) {
+        S[n-1+i*n]=0.0; path[i]=n-1; /* S(j,i) valid for j>=path(i) */
+    }
     k=n-1; dist[k]=0.0;
     zb[k]=zs[k];
     z[k]=ROUND(zb[k]); y=zb[k]-z[k]; step[k]=SGN(y);
@@ -103,8 +129,11 @@ static int search(int n, int m, const double *L, const double *D,
         if (newdist<maxdist) {
             if (k!=0) {
                 dist[--k]=newdist;
-                for (i=0;i<=k;i++)
-                    S[k+i*n]=S[k+1+i*n]+(z[k+1]-zb[k+1])*L[k+1+i*n];
+                u=path[k]<k+1?k+1:path[k];
+                for (j=u-1;j>=k;j--)
+                    S[j+k*n]=S[j+1+k*n]+(z[j+1]-zb[j+1])*L[j+1+k*n];
+                path[k]=k;
+                if (k>0&&path[k-1]<u) path[k-1]=u;
                 zb[k]=zs[k]+S[k+k*n];
                 z[k]=ROUND(zb[k]); y=zb[k]-z[k]; step[k]=SGN(y);
             }
@@ -121,6 +150,10 @@ static int search(int n, int m, const double *L, const double *D,
                         for (i=imax=0;i<m;i++) if (s[imax]<s[i]) imax=i;
                     }
                     maxdist=s[imax];
+                    if (thres>0.0) { /* bound by ratio-test */
+                        for (i=1,y=s[0];i<m;i++) if (s[i]<y) y=s[i];
+                        if (thres*y<maxdist) maxdist=thres*y;
+                    }
                 }
                 z[0]+=step[0]; y=zb[0]-z[0]; step[0]=-step[0]-SGN(step[0]);
             }
@@ -129,6 +162,7 @@ static int search(int n, int m, const double *L, const double *D,
             if (k==n-1) break;
             else {
                 k++;
+                if (path[k-1]<k) path[k-1]=k;
                 z[k]+=step[k]; y=zb[k]-z[k]; step[k]=-step[k]-SGN(step[k]);
             }
         }
@@ -140,7 +174,7 @@ static int search(int n, int m, const double *L, const double *D,
             for (k=0;k<n;k++) SWAP(zn[k+i*n],zn[k+j*n]);
         }
     }
-    free(S); free(dist); free(zb); free(z); free(step);
+    if (S!=wstk) {matfree(S); matfree(path);}
     
     if (c>=LOOPMAX) {
         fprintf(stderr,"%s : search loop count overflow\n",__FILE__);
@@ -148,6 +182,49 @@ static int search(int n, int m, const double *L, const double *D,
     }
     return 0;
 }
+/* lambda/mlambda with bootstrapped success rate ------------------------------
+* return : status (0:ok,1:success rate under p0 without search,other:error)
+*-----------------------------------------------------------------------------*/
+static int lambda_(int n, int m, const double *a, const double *Q, double p0,
+                   double thres, double *F, double *s, double *ps)
+{
+    int i,j,k,info;
+    double wstk[NSTK*(3*NSTK+2+MSTK)],*L,*D,*Z,*Zi,*z,*E,p=1.0;
+    
+    if (n<=0||m<=0) return -1;
+    L=n<=NSTK&&m<=MSTK?wstk:mat(n,3*n+2+m);
+    D=L+n*n; Z=D+n; Zi=Z+n*n; z=Zi+n*n; E=z+n;
+    
+    for (i=0;i<n;i++) for (j=0;j<n;j++) Z[i+j*n]=Zi[i+j*n]=i==j?1.0:0.0;
+    
+    /* LD factorization */
+    if (!(info=LD(n,Q,L,D))) {
+        
+        /* lambda reduction */
+        reduction(n,L,D,Z,Zi);
+        
+        /* success rate of bootstrapping (prod(2*Phi(1/(2*sqrt(D)))-1)) */
+        for (i=0;i<n;i++) p*=erf(1.0/sqrt(8.0*D[i]));
+        if (ps) *ps=p;
+        
+        if (p<p0) info=1;
+        else {
+            for (i=0;i<n;i++) { /* z=Z'*a */
+                for (k=0,z[i]=0.0;k<n;k++) z[i]+=Z[k+i*n]*a[k];
+            }
+            /* mlambda search */
+            if (!(info=search(n,m,L,D,z,E,s,thres))) {
+                
+                /* F=Z'\E=Zi'*E (exact for unimodular Z) */
+                for (i=0;i<n;i++) for (j=0;j<m;j++) {
+                    for (k=0,F[i+j*n]=0.0;k<n;k++) F[i+j*n]+=Zi[k+i*n]*E[k+j*n];
+                }
+            }
+        }
+    }
+    if (L!=wstk) matfree(L);
+    return info;
+}
 /* lambda/mlambda integer least-square estimation ------------------------------
 * integer least-square estimation. reduction is performed by lambda (ref.[1]),
 * and search by mlambda (ref.[2]).
@@ -159,31 +236,136 @@ static int search(int n, int m, const double *L, const double *D,
 *          double *s     O  sum of squared residulas of fixed solutions (1 x m)
 * return : status (0:ok,other:error)
 * notes  : matrix stored by column-major order (fortran convension)
+*          no memory is allocated for n<=48 and m<=2
 *-----------------------------------------------------------------------------*/
 extern int lambda(int n, int m, const double *a, const double *Q, double *F,
                   double *s)
 {
-    int info;
-    double *L,*D,*Z,*z,*E;
+    return lambda_(n,m,a,Q,0.0,0.0,F,s,NULL);
+}
+/* partial lambda subsets type -----------------------------------------------*/
+typedef struct {
+    int n,m;            /* number of float parameters and fixed solutions */
+    const double *a;    /* float parameters (n x 1) */
+    const double *Q;    /* covariance matrix of float parameters (n x n) */
+    const int *ord;     /* parameter indices in order of priority (n x 1) */
+    double p0;          /* min success rate of bootstrapping */
+    double thres;       /* threshold of ratio-test */
+    int k0;             /* number of parameters of first subset of batch */
+    double *F;          /* fixed solutions of subsets (n*m x nbatch) */
+    double *s;          /* sum of squared residuals of subsets (m x nbatch) */
+    int *info;          /* status of subsets (nbatch x 1) */
+} parset_t;
+
+/* fix subset of float parameters --------------------------------------------*/
+static void parsub(int i, void *arg)
+{
+    parset_t *par=(parset_t *)arg;
+    double wstk[NSTK*(NSTK+1)],*a,*Q;
+    int j,k,n=par->k0-i;
     
-    if (n<=0||m<=0) return -1;
-    L=zeros(n,n); D=mat(n,1); Z=eye(n); z=mat(n,1); E=mat(n,m);
+    a=n<=NSTK?wstk:mat(n,n+1); Q=a+n;
     
-    /* LD factorization */
-    if (!(info=LD(n,Q,L,D))) {
-        
-        /* lambda reduction */
-        reduction(n,L,D,Z);
-        matmul("TN",n,1,n,1.0,Z,a,0.0,z); /* z=Z'*a */
+    for (j=0;j<n;j++) {
+        a[j]=par->a[par->ord[j]];
+        for (k=0;k<n;k++) Q[j+k*n]=par->Q[par->ord[j]+par->ord[k]*par->n];
+    }
+    par->info[i]=lambda_(n,par->m,a,Q,par->p0,par->thres,par->F+i*par->n*par->m,
+                         par->s+i*par->m,NULL);
+    if (a!=wstk) matfree(a);
+}
+/* partial lambda/mlambda integer least-square estimation ----------------------
+* partial integer least-square estimation. the subsets of the first k float
+* parameters in the order of priority (k=n,n-1,...,nmin) are fixed by lambda/
+* mlambda and the largest subset which passes the success rate of bootstrapping
+* and the ratio-test is selected
+* args   : int    n      I  number of float parameters
+*          int    m      I  number of fixed solutions (m>=2)
+*          double *a     I  float parameters (n x 1)
+*          double *Q     I  covariance matrix of float parameters (n x n)
+*          int    *ord   I  parameter indices in order of priority (n x 1)
+*          int    nmin   I  min number of fixed parameters
+*          double p0     I  min success rate of bootstrapping (0:no check)
+*          double thres  I  threshold of ratio-test (s[1]/s[0])
+*          int    nthread I number of threads (0:number of cpus,1:serial)
+*          double *F     O  fixed solutions (n x m)
+*          double *s     O  sum of squared residulas of fixed solutions (1 x m)
+*          int    *fix   O  fixed flags of parameters (n x 1) (1:fixed,0:float)
+* return : number of fixed parameters (0:no subset passed,-1:error)
+* notes  : the subsets are evaluated in parallel by batches of nthread and the
+*          evaluation is terminated by the first batch with a passed subset.
+*          the search is skipped if the success rate is under p0 and pruned by
+*          the ratio-test, then the search of the selected subset is repeated
+*          without pruning for the exact s[1]. if no subset reaches p0, the
+*          full set is validated by the ratio-test only (as lambda()).
+*          F of not fixed parameters is set to the float parameters. if no
+*          subset passed, s is set to the values of the full set (0:failed)
+*-----------------------------------------------------------------------------*/
+extern int lambda_par(int n, int m, const double *a, const double *Q,
+                      const int *ord, int nmin, double p0, double thres,
+                      int nthread, double *F, double *s, int *fix)
+{
+    parset_t par;
+    double *Fp;
+    int i,j,k,nb,nbat,nfix=0,sel=0,nsucc=0;
+    
+    trace(3,"lambda_par: n=%d nmin=%d p0=%.4f thres=%.1f\n",n,nmin,p0,thres);
+    
+    if (n<=0||m<2) return -1;
+    if (nmin<1) nmin=1;
+    if (nmin>n) nmin=n;
+    if (nthread<=0) nthread=ncpuget();
+    nbat=nthread<n-nmin+1?nthread:n-nmin+1;
+    if (nbat>MAXPARSET) nbat=MAXPARSET;
+    
+    par.n=n; par.m=m; par.a=a; par.Q=Q; par.ord=ord; par.p0=p0; par.thres=thres;
+    par.F=mat(n*m,nbat); par.s=mat(m,nbat); par.info=imat(nbat,1);
+    
+    for (i=0;i<m;i++) s[i]=0.0;
+    
+    for (k=n;k>=nmin&&!nfix;k-=nb) {
+        nb=nbat<k-nmin+1?nbat:k-nmin+1;
+        par.k0=k;
+        parfor(nb,nthread,parsub,&par);
         
-        /* mlambda search */
-        if (!(info=search(n,m,L,D,z,E,s))) {
+        for (i=0;i<nb;i++) {
+            if (par.info[i]) continue;
+            if (k==n&&i==0) for (j=0;j<m;j++) s[j]=par.s[j];
+            nsucc++;
             
-            info=solve("T",Z,E,n,m,F); /* F=Z'\E */
+            /* validation by ratio-test */
+            if (par.s[i*m]>0.0&&par.s[1+i*m]/par.s[i*m]<thres) continue;
+            nfix=k-i; sel=i;
+            break;
         }
     }
-    free(L); free(D); free(Z); free(z); free(E);
-    return info;
+    /* exact s of selected subset or full set if no subset reaches p0 */
+    if (nfix>0||!nsucc) {
+        par.k0=nfix>0?nfix:n; par.p0=par.thres=0.0;
+        parsub(0,&par);
+        sel=0;
+        if (par.info[0]) nfix=0;
+        else if (!nfix) { /* validation of full set by ratio-test */
+            for (j=0;j<m;j++) s[j]=par.s[j];
+            if (par.s[0]<=0.0||par.s[1]/par.s[0]>=thres) nfix=n;
+        }
+    }
+    for (i=0;i<n;i++) {
+        fix[i]=0;
+        for (j=0;j<m;j++) F[i+j*n]=a[i];
+    }
+    if (nfix>0) {
+        Fp=par.F+sel*n*m;
+        for (i=0;i<nfix;i++) {
+            fix[ord[i]]=1;
+            for (j=0;j<m;j++) F[ord[i]+j*n]=Fp[i+j*nfix];
+        }
+        for (j=0;j<m;j++) s[j]=par.s[j+sel*m];
+    }
+    trace(3,"lambda_par: nfix=%d s=%.2f/%.2f\n",nfix,s[0],s[1]);
+    
+    matfree(par.F); matfree(par.s); matfree(par.info);
+    return nfix;
 }
 /* lambda reduction ------------------------------------------------------------
 * reduction by lambda (ref [1]) for integer least square
@@ -206,13 +388,13 @@ extern int lambda_reduction(int n, const double *Q, double *Z)
     }
     /* LD factorization */
     if ((info=LD(n,Q,L,D))) {
-        free(L); free(D);
+        matfree(L); matfree(D);
         return info;
     }
     /* lambda reduction */
-    reduction(n,L,D,Z);
+    reduction(n,L,D,Z,NULL);
      
-    free(L); free(D);
+    matfree(L); matfree(D);
     return 0;
 }
 /* mlambda search --------------------------------------------------------------
@@ -237,12 +419,12 @@ extern int lambda_search(int n, int m, const double *a, const double *Q,
     
     /* LD factorization */
     if ((info=LD(n,Q,L,D))) {
-        free(L); free(D);
+        matfree(L); matfree(D);
         return info;
     }
     /* mlambda search */
-    info=search(n,m,L,D,a,F,s);
+    info=search(n,m,L,D,a,F,s,0.0);
     
-    free(L); free(D);
+    matfree(L); matfree(D);
     return info;
 }
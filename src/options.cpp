@@ -53,6 +53,9 @@ static char snrmask_[NFREQ][1024];
 
 #define TYPOPT  "0:forward,1:backward,2:combined"
 #define IONOPT  "0:off,1:brdc,2:sbas,3:dual-freq,4:est-stec,5:ionex-tec,6:qzs-brdc,7:qzs-lex,8:vtec_sf,9:vtec_ef,10:gtec,11:bdsk8,12:bdssh9,13:bdsion,14:galion"
+#define NQMOPT  "0:ref,1:fast,2:fast-grid"
+#define MATOPT  "0:internal,1:system"
+#define FLTOPT  "0:std,1:chol-joseph,2:sequential"
 #define TRPOPT  "0:off,1:saas,2:sbas,3:est-ztd,4:est-ztdgrad,5:ztd"
 #define EPHOPT  "0:brdc,1:precise,2:brdc+sbas,3:brdc+ssrapc,4:brdc+ssrcom"
 #define NAVOPT  "1:gps+2:sbas+4:glo+8:gal+16:qzs+32:comp"
@@ -66,6 +69,7 @@ static char snrmask_[NFREQ][1024];
 #define STAOPT  "0:all,1:single"
 #define STSOPT  "0:off,1:state,2:residual"
 #define ARMOPT  "0:off,1:continuous,2:instantaneous,3:fix-and-hold"
+#define ARPOPT  "0:off,1:elevation,2:variance"
 #define POSOPT  "0:llh,1:xyz,2:single,3:posfile,4:rinexhead,5:rtcm,6:raw"
 #define TIDEOPT "0:off,1:on,2:otl"
 #define PHWOPT  "0:off,1:on,2:precise"
@@ -93,8 +97,12 @@ EXPORT opt_t sysopts[]={
     {"pos1-posopt4",    3,  (void *)&prcopt_.posopt[3],  SWTOPT },
     {"pos1-posopt5",    3,  (void *)&prcopt_.posopt[4],  SWTOPT },
     {"pos1-posopt6",    3,  (void *)&prcopt_.posopt[5],  SWTOPT },
+    {"pos1-raimexc",    0,  (void *)&prcopt_.raimexc,    ""     },
     {"pos1-exclsats",   2,  (void *)exsats_,             "prn ..."},
     {"pos1-navsys",     0,  (void *)&prcopt_.navsys,     NAVOPT },
+    {"pos1-satgrid",    1,  (void *)&prcopt_.sgridint,   "s"    },
+    {"pos1-tidegrid",   1,  (void *)&prcopt_.tgridint,   "s"    },
+    {"pos1-nqmode",     3,  (void *)&prcopt_.nqmode,     NQMOPT },
 	{"coordinate-fixed",1,  (void *)&prcopt_.coordfixed,  "" },
 
     {"pos2-armode",     3,  (void *)&prcopt_.modear,     ARMOPT },
@@ -109,6 +117,8 @@ EXPORT opt_t sysopts[]={
     {"pos2-arelmask",   1,  (void *)&elmaskar_,          "deg"  },
     {"pos2-arminfix",   0,  (void *)&prcopt_.minfix,     ""     },
     {"pos2-armaxiter",  0,  (void *)&prcopt_.armaxiter,  ""     },
+    {"pos2-arpartial",  3,  (void *)&prcopt_.arpartial,  ARPOPT },
+    {"pos2-arpsucc",    1,  (void *)&prcopt_.arpsucc,    ""     },
     {"pos2-elmaskhold", 1,  (void *)&elmaskhold_,        "deg"  },
     {"pos2-aroutcnt",   0,  (void *)&prcopt_.maxout,     ""     },
     {"pos2-maxage",     1,  (void *)&prcopt_.maxtdiff,   "s"    },
@@ -182,6 +192,9 @@ EXPORT opt_t sysopts[]={
     {"misc-rnxopt1",    2,  (void *)prcopt_.rnxopt[0],   ""     },
     {"misc-rnxopt2",    2,  (void *)prcopt_.rnxopt[1],   ""     },
     {"misc-pppopt",     2,  (void *)prcopt_.pppopt,      ""     },
+    {"misc-nthread",    0,  (void *)&prcopt_.nthread,    "0:auto"},
+    {"misc-matlib",     3,  (void *)&prcopt_.matlib,     MATOPT },
+    {"misc-filtalg",    3,  (void *)&prcopt_.filtalg,    FLTOPT },
     
     {"file-satantfile", 2,  (void *)&filopt_.satantp,    ""     },
     {"file-rcvantfile", 2,  (void *)&filopt_.rcvantp,    ""     },
@@ -195,6 +208,7 @@ EXPORT opt_t sysopts[]={
     {"file-geexefile",  2,  (void *)&filopt_.geexe,      ""     },
     {"file-solstatfile",2,  (void *)&filopt_.solstat,    ""     },
     {"file-tracefile",  2,  (void *)&filopt_.trace,      ""     },
+    {"file-nequickdir", 2,  (void *)&filopt_.nqdir,      ""     },
     
     {"",0,NULL,""} /* terminator */
 };
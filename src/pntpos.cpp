@@ -33,6 +33,17 @@
 #define ERR_BRDCI   0.5         /* broadcast iono model error factor */
 #define ERR_CBIAS   0.3         /* code bias error std (m) */
 #define REL_HUMI    0.7         /* relative humidity for saastamoinen model */
+#define MINSAT_RAIM 5           /* min number of satellites after exclusion */
+
+typedef struct {        /* converged pseudorange least square estimation */
+    double x[NX];       /* estimated parameters */
+    double Q[NX*NX];    /* covariance of parameters */
+    double v[MAXOBS+4]; /* weighted residuals */
+    double sig[MAXOBS+4]; /* residual std (m) */
+    double H[4*(MAXOBS+4)]; /* design matrix (position and clock) */
+    int ih[MAXOBS+4];   /* index of time offset parameter (0:none) */
+    int nv,ns;          /* number of residuals and satellites (0:no estimation) */
+} lsqest_t;
 
 
 extern "C" {
@@ -164,48 +175,92 @@ static double prange(const obsd_t *obs, const nav_t *nav, const double *azel,
 	return PC;
 }
 
-static int selion(const char *modelname, gtime_t time, bds_ion_t bds_ion)
-{/* selecte specified ion according experience */
-	/* GEO first; IGSO second; MEO last */
-	int i, j = -1, iGEO = -1, iIGSO = -1, iMEO = -1;
-	double ep[6], hour;
-	double t_GEO = 24.0, t_IGSO = 24.0, t_MEO = 24.0, dt;
-	double tmin = 24.0;
-	time2epoch(time, ep);
-	hour = ep[3];
-	if (strcmp(modelname, "BDSK8") == 0){
-		for (i = 0; i < bds_ion.nk8; i++){
-			dt = fabs(bds_ion.bdsk8[i].hour - hour);
-			if (dt <= tmin) {
-				j = i;
-				tmin = dt;
-			}
-		}
+/* ionospheric delay factor of the first frequency to B1I --------------------*/
+static double ionfactor(const prcopt_t *opt, const nav_t *nav, int sat)
+{
+	prcopt_t opt2 = *opt;
+	int fidx[MAXFREQ] = { 0 };
+	double freq;
 
-		if (j<0) {
-			//trace(2, "no broadcast ion: %s \n", time_str(time, 0));
-			return -1;
-		}
+	opt2.ionoopt = IONOOPT_IFLC;
+	frqidx(opt2, fidx);
+
+	freq = nav->lam[sat - 1][fidx[0]] > 0 ? CLIGHT / nav->lam[sat - 1][fidx[0]] : FREQ1_CMP;
 
-		return j;
+	return FREQ1_CMP*FREQ1_CMP/freq/freq;
+}
+/* NeQuick-G delays of satellites of an epoch ----------------------------------
+* args   : obsd_t *obs      I   observation data of the epoch
+*          int    n         I   number of observation data
+*          nav_t  *nav      I   navigation data
+*          double *pos      I   receiver position {lat,lon,h} (rad|m)
+*          double *rs       I   satellite positions (ecef) rs[(0:2)+i*6] (m)
+*          double elmin     I   elevation mask (rad)
+*          double *ion      O   ionospheric delays (B1I) (m) (0.0: no correction)
+* return : none
+* notes  : satellites without position or below the mask are not integrated
+*-----------------------------------------------------------------------------*/
+static void nequick_stec(const obsd_t *obs, int n, const nav_t *nav,
+                         const double *pos, const double *rs, double elmin,
+                         double *ion)
+{
+	double sat[3*MAXOBS],stec[MAXOBS],rr[3],e[3],azel[2],ep[6];
+	int i,j,m=0,idx[MAXOBS];
+
+	pos2ecef(pos,rr);
+
+	for (i=0;i<n;i++) {
+		ion[i]=0.0;
+		if (geodist(satsys(obs[i].sat,NULL),rs+i*6,rr,e,NULL)<=0.0||
+		    satazel(pos,e,azel)<elmin) continue;
+		ecef2pos(rs+i*6,sat+m*3);
+		for (j=0;j<2;j++) sat[j+m*3]*=R2D;
+		idx[m++]=i;
 	}
-	else if (strcmp(modelname, "BDSSH9") == 0){
-		for (i = 0; i < bds_ion.nsh9; i++){
-			dt = fabs(bds_ion.bdssh9[i].hour - hour);
-			if (dt <= tmin) {
-				j = i;
-				tmin = dt;
-			}
-		}
-		if (j<0) {
-			//trace(2, "no broadcast ion: %s \n", time_str(time, 0));
-			return -1;
-		}
+	if (m<=0) return;
+
+	time2epoch(obs[0].time,ep);
+
+	ionmodel_nequicks(nav->ion_gal,(int)ep[1],ep[3]+ep[4]/60.0+ep[5]/3600.0,
+	                  pos[1]*R2D,pos[0]*R2D,pos[2],sat,m,stec);
 
-		return j;
+	/* switch to BDS B1I */
+	for (i=0;i<m;i++) {
+		stec[i]=stec[i]*40.28e16/FREQ1_CMP/FREQ1_CMP;
+		ion[idx[i]]=stec[i]<0?0.0:stec[i];
 	}
 }
+/* ionex tec delays of satellites ----------------------------------------------
+* compute ionospheric delays of satellites by tec grid data in one pass
+* args   : obsd_t *obs      I   observation data
+*          int    n         I   number of observation data
+*          nav_t  *nav      I   navigation data
+*          double *pos      I   receiver position {lat,lon,h} (rad|m)
+*          double *rs       I   satellite positions (ecef) rs[(0:2)+i*6] (m)
+*          double elmin     I   elevation mask (rad)
+*          double *ion      O   ionospheric delays (B1I) (m) (0.0: no correction)
+*          double *var      O   ionospheric delay variances (m^2)
+* return : none
+* notes  : satellites without position or below the mask are not interpolated
+*-----------------------------------------------------------------------------*/
+static void tec_ion(const obsd_t *obs, int n, const nav_t *nav,
+                    const double *pos, const double *rs, double elmin,
+                    double *ion, double *var)
+{
+	double azel[2*MAXOBS],rr[3],e[3];
+	int i,stat[MAXOBS];
+
+	pos2ecef(pos,rr);
 
+	for (i=0;i<n;i++) {
+		ion[i]=var[i]=0.0;
+		if (geodist(satsys(obs[i].sat,NULL),rs+i*6,rr,e,NULL)<=0.0||
+		    satazel(pos,e,azel+i*2)<elmin) {
+			azel[i*2]=0.0; azel[1+i*2]=-PI/2.0; /* skipped by iontecs() */
+		}
+	}
+	iontecs(obs[0].time,nav,pos,azel,n,1,ion,var,stat);
+}
 /* ionospheric correction ------------------------------------------------------
 * compute ionospheric correction
 * args   : gtime_t time     I   time
@@ -224,21 +279,15 @@ extern int ionocorr(const prcopt_t opt, gtime_t time, const nav_t *nav, int sat,
     ////trace(4,"ionocorr: time=%s opt=%d sat=%2d pos=%.3f %.3f azel=%.3f %.3f\n",
     //      time_str(time,3),ionoopt,sat,pos[0]*R2D,pos[1]*R2D,azel[0]*R2D,
     //      azel[1]*R2D);
-	int stat, i, idx;
+	int stat, i;
 	double tow, k;
 	gtime_t bdt;
 	double ep[6];
 	double ionk8[8] = { 0.0 };
 	double ionsh9[9] = { 0.0 };
-	prcopt_t opt2 = opt;
-	opt2.ionoopt = IONOOPT_IFLC;
-	int fidx[MAXFREQ] = { 0 };
-	double freq = 0;
-	frqidx(opt2, fidx);
+	const double *ionpar;
 
-	freq = nav->lam[sat - 1][fidx[0]] > 0 ? CLIGHT / nav->lam[sat - 1][fidx[0]] : FREQ1_CMP;
-
-	k = FREQ1_CMP*FREQ1_CMP/freq/freq;
+	k = ionfactor(&opt, nav, sat);
     /* broadcast model */
     if (ionoopt==IONOOPT_BRDC) {
         *ion=k*ionmodel(time,nav->ion_gps,pos,azel);
@@ -249,8 +298,11 @@ extern int ionocorr(const prcopt_t opt, gtime_t time, const nav_t *nav, int sat,
 	/* BDSSH9 first, BDSK8 2nd */
 	if (ionoopt == IONOOPT_BDSK8){
 		bdt = gpst2bdt(time);
-		idx = selion("BDSK8", time, nav->ion_bdsk9->bds_ion);
-		if (idx >= 0) for (i = 0; i < 8; i++) ionk8[i] = nav->ion_bdsk9->bds_ion.bdsk8[idx].ion[i];
+		time2epoch(time, ep);
+		if ((ionpar = getbdsion(&nav->ion_bdsk9->bds_ion, BDSION_K8, (int)(time.time / 86400),
+			(int)ep[3]))) {
+			for (i = 0; i < 8; i++) ionk8[i] = ionpar[i];
+		}
 		*ion = k*ionmodel_BDSK8(bdt, ionk8, pos, azel);
 		//if (fabs(*ion)>10.0)printf("sat=%d ,ion=%lf\n", sat, *ion);
 		*var = SQR(*ion*ERR_BRDCI);
@@ -355,19 +407,39 @@ extern int ionocorr(const prcopt_t opt, gtime_t time, const nav_t *nav, int sat,
 extern int tropcorr(gtime_t time, const nav_t *nav, const double *pos,
                     const double *azel, int tropopt, double *trp, double *var)
 {
+    tropctx_t ctx;
+    
     //trace(4,"tropcorr: time=%s opt=%d pos=%.3f %.3f azel=%.3f %.3f\n",
     //      time_str(time,3),tropopt,pos[0]*R2D,pos[1]*R2D,azel[0]*R2D,
     //      azel[1]*R2D);
     
+    inittropctx(&ctx,time,pos,0.45);
+    
+    return tropcorrc(&ctx,nav,azel,tropopt,trp,var);
+}
+/* tropospheric correction with receiver context -------------------------------
+* compute tropospheric correction with station terms computed once per epoch
+* args   : tropctx_t *ctx   I   receiver troposphere context (humi=0.45)
+*          nav_t  *nav      I   navigation data
+*          double *azel     I   azimuth/elevation angle {az,el} (rad)
+*          int    tropopt   I   tropospheric correction option (TROPOPT_???)
+*          double *trp      O   tropospheric delay (m)
+*          double *var      O   tropospheric delay variance (m^2)
+* return : status(1:ok,0:error)
+*-----------------------------------------------------------------------------*/
+extern int tropcorrc(const tropctx_t *ctx, const nav_t *nav,
+                     const double *azel, int tropopt, double *trp,
+                     double *var)
+{
     /* saastamoinen model */
     if (tropopt==TROPOPT_SAAS||tropopt==TROPOPT_EST||tropopt==TROPOPT_ESTG) {
-        *trp=tropmodel(time,pos,azel,0.45);
+        *trp=tropmodelc(ctx,azel);
         *var=SQR(ERR_SAAS/(sin(azel[1])+0.1));
         return 1;
     }
     /* sbas troposphere model */
     if (tropopt==TROPOPT_SBAS) {
-        *trp=sbstropcorr(time,pos,azel,var);
+        *trp=sbstropcorr(ctx->time,ctx->pos,azel,var);
         return 1;
     }
     /* no correction */
@@ -379,11 +451,13 @@ extern int tropcorr(gtime_t time, const nav_t *nav, const double *pos,
 static int rescode(int iter, const obsd_t *obs, int n, const double *rs,
                    const double *dts, const double *vare, const int *svh,
                    const nav_t *nav, const double *x, const prcopt_t *opt,
-                   double *v, double *H, double *var, double *azel, int *vsat,
-				   double *resp, int *ns,int *sat)
+                   const int *exc, double *v, double *H, int *ih, double *var,
+                   double *azel, int *vsat, double *resp, int *ns, int *sat)
 {
     double r,dion,dtrp,vmeas,vion,vtrp,rr[3],pos[3],dtr,e[3],P,lam_L1;
-    int i,j,nv=0,sys,mask[4]={0};
+    double ionsh9[MAXOBS],stec[MAXOBS],tec[MAXOBS],vtec[MAXOBS];
+    int i,j,nv=0,sys,mask[4]={0},batsh9,batnq,battec;
+    tropctx_t trc;
 	char cprn[128];
 	double res, tgd1, tgd2, dr;
 
@@ -395,6 +469,22 @@ static int rescode(int iter, const obsd_t *obs, int n, const double *rs,
 
     ecef2pos(rr,pos);
     
+    /* BDSSH9 ionospheric delays of all satellites of the epoch */
+    if ((batsh9=iter>0&&opt->ionoopt==IONOOPT_BDSSH9)) {
+        ionmodel_BDSK9s(gpst2bdt(obs[0].time),nav->ion_bdsk9,pos,rs,
+                        n<MAXOBS?n:MAXOBS,ionsh9);
+    }
+    /* NeQuick-G STEC of all satellites of the epoch */
+    if ((batnq=iter>0&&opt->ionoopt==IONOOPT_GALION)) {
+        nequick_stec(obs,n<MAXOBS?n:MAXOBS,nav,pos,rs,opt->elmin,stec);
+    }
+    /* ionex tec delays of all satellites of the epoch */
+    if ((battec=iter>0&&opt->ionoopt==IONOOPT_TEC)) {
+        tec_ion(obs,n<MAXOBS?n:MAXOBS,nav,pos,rs,opt->elmin,tec,vtec);
+    }
+    /* receiver troposphere terms of the epoch */
+    inittropctx(&trc,obs[0].time,pos,0.45);
+    
 	for (i = *ns = 0; i < n&&i < MAXOBS; i++) {
 		vsat[i] = 0; azel[i * 2] = azel[1 + i * 2] = resp[i] = 0.0;
 		if (!(sys = satsys(obs[i].sat, NULL))) continue;
@@ -424,26 +514,40 @@ static int rescode(int iter, const obsd_t *obs, int n, const double *rs,
 
         /* excluded satellite? */
         if (satexclude(obs[i].sat,vare[i],svh[i],opt)) continue;
+        if (exc&&exc[i]) continue;
         
         /* ionospheric corrections */
-		if (!ionocorr(*opt, obs[i].time, nav, obs[i].sat, pos, rs + i * 6, azel + i * 2,
+        if (batsh9) {
+            dion=ionfactor(opt,nav,obs[i].sat)*ionsh9[i];
+            vion=SQR(dion*ERR_BRDCI);
+        }
+        else if (batnq) {
+            dion=ionfactor(opt,nav,obs[i].sat)*stec[i];
+            vion=SQR(dion*ERR_BRDCI);
+        }
+        else if (battec) {
+            dion=ionfactor(opt,nav,obs[i].sat)*tec[i];
+            vion=vtec[i];
+        }
+		else if (!ionocorr(*opt, obs[i].time, nav, obs[i].sat, pos, rs + i * 6, azel + i * 2,
                       iter>0?opt->ionoopt:IONOOPT_BRDC,&dion,&vion)) continue;
         
         /* tropospheric corrections */
-        if (!tropcorr(obs[i].time,nav,pos,azel+i*2,
-                      iter>0?opt->tropopt:TROPOPT_SAAS,&dtrp,&vtrp)) {
+        if (!tropcorrc(&trc,nav,azel+i*2,iter>0?opt->tropopt:TROPOPT_SAAS,
+                       &dtrp,&vtrp)) {
             continue;
         }
         /* pseudorange residual */
         v[nv]=P-(r+dtr-CLIGHT*dts[i*2]+dion+dtrp);
         
-        /* design matrix */
-        for (j=0;j<NX;j++) H[j+nv*NX]=j<3?-e[j]:(j==3?1.0:0.0);
+        /* design matrix (position and clock, offset index) */
+        for (j=0;j<4;j++) H[j+nv*4]=j<3?-e[j]:1.0;
+        ih[nv]=0;
         
         /* time system and receiver bias offset correction */
-        if      (sys==SYS_GLO) {v[nv]-=x[4]; H[4+nv*NX]=1.0; mask[1]=1;}
-        else if (sys==SYS_GAL) {v[nv]-=x[5]; H[5+nv*NX]=1.0; mask[2]=1;}
-        else if (sys==SYS_CMP) {v[nv]-=x[6]; H[6+nv*NX]=1.0; mask[3]=1;}
+        if      (sys==SYS_GLO) {v[nv]-=x[4]; ih[nv]=4; mask[1]=1;}
+        else if (sys==SYS_GAL) {v[nv]-=x[5]; ih[nv]=5; mask[2]=1;}
+        else if (sys==SYS_CMP) {v[nv]-=x[6]; ih[nv]=6; mask[3]=1;}
         else mask[0]=1;
 
 		sat[obs[i].sat - 1] = 1;
@@ -461,7 +565,8 @@ static int rescode(int iter, const obsd_t *obs, int n, const double *rs,
     for (i=0;i<4;i++) {
         if (mask[i]) continue;
         v[nv]=0.0;
-        for (j=0;j<NX;j++) H[j+nv*NX]=j==i+3?1.0:0.0;
+        for (j=0;j<4;j++) H[j+nv*4]=j==i+3?1.0:0.0;
+        ih[nv]=i>0?i+3:0;
         var[nv++]=0.01;
     }
     return nv;
@@ -500,19 +605,40 @@ static int valsol(const double *azel, const int *vsat, int n,
 	for (i = 0; i<4; i++) { dop0[i] = dop[i]; }
     return 1;
 }
+/* accumulate normal equation by a pseudorange ------------------------------*/
+static void nrmcode(const double *h, int ih, double v, double sig, double *N,
+                    double *b)
+{
+    double r[4];
+    int i,j;
+    
+    for (i=0;i<4;i++) r[i]=h[i]/sig;
+    for (i=0;i<4;i++) {
+        b[i]+=r[i]*v;
+        for (j=0;j<4;j++) N[i+j*NX]+=r[i]*r[j];
+    }
+    if (ih<=0) return;
+    b[ih]+=v/sig;
+    N[ih+ih*NX]+=1.0/(sig*sig);
+    for (i=0;i<4;i++) {
+        N[ih+i*NX]+=r[i]/sig;
+        N[i+ih*NX]+=r[i]/sig;
+    }
+}
 /* estimate receiver position ------------------------------------------------*/
 static int estpos(const obsd_t *obs, int n, const double *rs, const double *dts,
                   const double *vare, const int *svh, const nav_t *nav,
                   const prcopt_t *opt, sol_t *sol, double *azel, int *vsat,
-                  double *resp, char *msg)
+                  double *resp, const int *exc, lsqest_t *est, char *msg)
 {
-    double x[NX]={0},dx[NX],Q[NX*NX],*v,*H,*var,sig;
-    int i,j,k,info,stat,nv,ns;
+    double x[NX]={0},dx[NX],Q[NX*NX],N[NX*NX],b[NX],sig;
+    double v[MAXOBS+4],H[4*(MAXOBS+4)],var[MAXOBS+4],sigv[MAXOBS+4];
+    int i,j,info,stat,nv,ns,ih[MAXOBS+4];
 	double presp[MAXSAT], alpha[MAXSAT] = { 0.0};
 	double mean, std,extd;
     trace(3,"estpos  : n=%d\n",n);
     
-    v=mat(n+4,1); H=mat(NX,n+4); var=mat(n+4,1);
+    if (est) est->nv=est->ns=0;
     
 	for (i = 0; i<3; i++) x[i] = sol->rr[i];
 	if (opt->coordfixed != 0 && norm(opt->ru, 3) > 0.0)
@@ -525,8 +651,8 @@ static int estpos(const obsd_t *obs, int n, const double *rs, const double *dts,
     for (i=0;i<MAXITR;i++) {
         
         /* pseudorange residuals */
-        nv=rescode(i,obs,n,rs,dts,vare,svh,nav,x,opt,v,H,var,azel,vsat,resp,
-			&ns, sol->sat);
+        nv=rescode(i,obs,n,rs,dts,vare,svh,nav,x,opt,exc,v,H,ih,var,azel,
+                   vsat,resp,&ns,sol->sat);
         
 		//printf("iter=%d\n", i + 1);
         if (nv<NX) {
@@ -540,7 +666,9 @@ static int estpos(const obsd_t *obs, int n, const double *rs, const double *dts,
 		mean=median3_t(presp, nv-3,&std);
 
 
-        /* weight by variance */
+        /* weight by variance and normal equation */
+        for (j=0;j<NX*NX;j++) N[j]=0.0;
+        for (j=0;j<NX;j++) b[j]=0.0;
         for (j=0;j<nv;j++) {
             sig=sqrt(var[j]);
 			if (std!=0.0&&std < 5.0&&alpha[j] == 0.0)
@@ -554,11 +682,13 @@ static int estpos(const obsd_t *obs, int n, const double *rs, const double *dts,
 
 
 
-            v[j]/=sig;
-            for (k=0;k<NX;k++) H[k+j*NX]/=sig;
+            v[j]/=sig; sigv[j]=sig;
+            nrmcode(H+j*4,ih[j],v[j],sig,N,b);
         }
+        for (j=0;j<3;j++) N[j+j*NX]+=SQR(opt->coordfixed);
+        
         /* least square estimation */
-		if ((info = lsq(H, v, NX, nv, dx, Q, opt->coordfixed))) {
+        if ((info=lsqnrm(N,b,NX,dx,Q))) {
             sprintf(msg,"lsq error info=%d",info);
             break;
         }
@@ -581,107 +711,149 @@ static int estpos(const obsd_t *obs, int n, const double *rs, const double *dts,
             sol->ns=(unsigned char)ns;
             sol->age=sol->ratio=0.0;
             
+            /* save estimation for raim fde */
+            if (est) {
+                matcpy(est->x,x,NX,1);
+                matcpy(est->Q,Q,NX,NX);
+                matcpy(est->v,v,nv,1);
+                matcpy(est->sig,sigv,nv,1);
+                matcpy(est->H,H,4,nv);
+                for (j=0;j<nv;j++) est->ih[j]=ih[j];
+                est->nv=nv; est->ns=ns;
+            }
             /* validate solution */
 			if ((stat = valsol(azel, vsat, n, opt, v, nv, NX, msg, sol->dop))) {
                 sol->stat=opt->sateph==EPHOPT_SBAS?SOLQ_SBAS:SOLQ_SINGLE;
             }
-			free(v); free(H); free(var);
-            
             return stat;
         }
     }
     if (i>=MAXITR) sprintf(msg,"iteration divergent i=%d",i);
     
-	free(v); free(H); free(var);
-    
     return 0;
 }
-/* raim fde (failure detection and exclution) -------------------------------*/
+/* raim fde (failure detection and exclution) ---------------------------------
+* exclude the satellites failed by the leave-one-out test statistics computed
+* by rank-one downdates of the converged estimation without re-estimation:
+*
+*   dx_i =-Q*h_i*v_i/(1-p_i), vv_i=vv-v_i^2/(1-p_i), p_i=h_i'*Q*h_i
+*
+* (h_i,v_i: weighted design vector and residual of satellite i). the satellites
+* are tried in ascending order of vv_i and the first one whose solution is
+* validated by estpos() from the downdated position is excluded. if none is
+* validated, the exclusion of the satellite minimizing vv_i is kept and the
+* next satellite is searched. up to opt->raimexc (0:1) satellites are excluded
+*-----------------------------------------------------------------------------*/
 static int raim_fde(const obsd_t *obs, int n, const double *rs,
                     const double *dts, const double *vare, const int *svh,
                     const nav_t *nav, const prcopt_t *opt, sol_t *sol,
-                    double *azel, int *vsat, double *resp, char *msg)
+                    double *azel, int *vsat, double *resp, lsqest_t *est,
+                    char *msg)
 {
-    obsd_t *obs_e;
-    sol_t sol_e={{0}};
-    char tstr[32],name[16],msg_e[128];
-    double *rs_e,*dts_e,*vare_e,*azel_e,*resp_e,rms_e,rms=100.0;
-    int i,j,k,nvsat,stat=0,*svh_e,*vsat_e,sat=0;
+    sol_t sol0=*sol;
+    lsqest_t est0,est1;
+    char tstr[32],name[16];
+    double h[NX],Qh[NX],vv,vv_e,p,azel0[MAXOBS*2],resp0[MAXOBS];
+    double vvc[MAXOBS],rrc[MAXOBS*3];
+    int i,j,k,nc,nexc,maxexc,stat=0,iobs[MAXOBS],exc[MAXOBS]={0},cand[MAXOBS];
+    int vsat0[MAXOBS],vsat1[MAXOBS];
     
     trace(3,"raim_fde: %s n=%2d\n",time_str(obs[0].time,0),n);
     
-    if (!(obs_e=(obsd_t *)malloc(sizeof(obsd_t)*n))) return 0;
-    rs_e = mat(6,n); dts_e = mat(2,n); vare_e=mat(1,n); azel_e=zeros(2,n);
-    svh_e=imat(1,n); vsat_e=imat(1,n); resp_e=mat(1,n); 
+    if (n>MAXOBS) n=MAXOBS;
+    matcpy(azel0,azel,2,n); matcpy(resp0,resp,1,n);
+    for (i=0;i<n;i++) vsat0[i]=vsat[i];
+    maxexc=opt->raimexc>1?opt->raimexc:1;
     
-    for (i=0;i<n;i++) {
-        
-        /* satellite exclution */
-        for (j=k=0;j<n;j++) {
-            if (j==i) continue;
-            obs_e[k]=obs[j];
-            matcpy(rs_e +6*k,rs +6*j,6,1);
-            matcpy(dts_e+2*k,dts+2*j,2,1);
-            vare_e[k]=vare[j];
-            svh_e[k++]=svh[j];
-        }
-        /* estimate receiver position without a satellite */
-        if (!estpos(obs_e,n-1,rs_e,dts_e,vare_e,svh_e,nav,opt,&sol_e,azel_e,
-                    vsat_e,resp_e,msg_e)) {
-            trace(3,"raim_fde: exsat=%2d (%s)\n",obs[i].sat,msg);
-            continue;
-        }
-        for (j=nvsat=0,rms_e=0.0;j<n-1;j++) {
-            if (!vsat_e[j]) continue;
-            rms_e+=SQR(resp_e[j]);
-            nvsat++;
-        }
-        if (nvsat<5) {
-            trace(3,"raim_fde: exsat=%2d lack of satellites nvsat=%2d\n",
-                  obs[i].sat,nvsat);
-            continue;
+    for (nexc=0;nexc<maxexc&&est->nv>0;nexc++) {
+        if (est->ns-1<MINSAT_RAIM) {
+            trace(3,"raim_fde: lack of satellites ns=%2d\n",est->ns);
+            break;
         }
-        rms_e=sqrt(rms_e/nvsat);
+        for (i=k=0;i<n;i++) if (vsat[i]) iobs[k++]=i;
+        vv=dot(est->v,est->v,est->nv);
         
-        trace(3,"raim_fde: exsat=%2d rms=%8.3f\n",obs[i].sat,rms_e);
-        
-        if (rms_e>rms) continue;
+        /* leave-one-out test statistics in ascending order */
+        for (j=nc=0;j<est->ns;j++) {
+            for (i=0;i<NX;i++) h[i]=i<4?est->H[i+j*4]/est->sig[j]:0.0;
+            if (est->ih[j]>0) h[est->ih[j]]=1.0/est->sig[j];
+            for (i=0;i<NX;i++) Qh[i]=dot(est->Q+i*NX,h,NX);
+            
+            /* no redundancy for the satellite */
+            if ((p=1.0-dot(h,Qh,NX))<1E-9) continue;
+            
+            vv_e=vv-SQR(est->v[j])/p;
+            trace(3,"raim_fde: exsat=%2d rms=%8.3f\n",obs[iobs[j]].sat,
+                  sqrt(vv_e/(est->nv-1)));
+            if (vv_e>=vv) continue;
+            for (k=nc++;k>0&&vvc[k-1]>vv_e;k--) {
+                vvc[k]=vvc[k-1]; cand[k]=cand[k-1];
+                for (i=0;i<3;i++) rrc[i+k*3]=rrc[i+(k-1)*3];
+            }
+            vvc[k]=vv_e; cand[k]=j;
+            for (i=0;i<3;i++) rrc[i+k*3]=est->x[i]-Qh[i]*est->v[j]/p;
+        }
+        if (nc<=0) break;
+        if (nc>1) est0=*est;
         
-        /* save result */
-        for (j=k=0;j<n;j++) {
-            if (j==i) continue;
-            matcpy(azel+2*j,azel_e+2*k,2,1);
-            vsat[j]=vsat_e[k];
-            resp[j]=resp_e[k++];
+        /* validate solution without the satellites in order of the statistics */
+        for (k=0;k<nc;k++) {
+            if (k>0) {
+                exc[iobs[cand[k-1]]]=0;
+                *est=est0;
+            }
+            exc[iobs[cand[k]]]=1;
+            for (i=0;i<3;i++) sol->rr[i]=rrc[i+k*3];
+            if ((stat=estpos(obs,n,rs,dts,vare,svh,nav,opt,sol,azel,vsat,resp,
+                             exc,est,msg))) break;
+            
+            /* estimation of the first exclusion for the next satellite */
+            if (k==0&&nc>1&&nexc+1<maxexc) {
+                est1=*est;
+                for (i=0;i<n;i++) vsat1[i]=vsat[i];
+            }
         }
-        stat=1;
-        *sol=sol_e;
-        sat=obs[i].sat;
-        rms=rms_e;
-        vsat[i]=0;
-        strcpy(msg,msg_e);
+        if (stat) break;
+        if (nc>1) {
+            exc[iobs[cand[nc-1]]]=0;
+            exc[iobs[cand[0]]]=1;
+            if (nexc+1<maxexc) {
+                *est=est1;
+                for (i=0;i<n;i++) vsat[i]=vsat1[i];
+            }
+        }
+    }
+    if (!stat) {
+        *sol=sol0;
+        matcpy(azel,azel0,2,n); matcpy(resp,resp0,1,n);
+        for (i=0;i<n;i++) vsat[i]=vsat0[i];
+        return 0;
     }
-    if (stat) {
-        time2str(obs[0].time,tstr,2); satno2id(sat,name);
+    time2str(obs[0].time,tstr,2);
+    for (i=0;i<n;i++) {
+        if (!exc[i]) continue;
+        resp[i]=resp0[i];
+        sol->sat[obs[i].sat-1]=-1;
+        satno2id(obs[i].sat,name);
         trace(2,"%s: %s excluded by raim\n",tstr+11,name);
     }
-    free(obs_e);
-    free(rs_e ); free(dts_e ); free(vare_e); free(azel_e);
-    free(svh_e); free(vsat_e); free(resp_e);
     return stat;
 }
 /* doppler residuals ---------------------------------------------------------*/
 static int resdop(const obsd_t *obs, int n, const double *rs, const double *dts,
                   const nav_t *nav, const double *rr, const double *x,
-                  const double *azel, const int *vsat, double *v, double *H)
+                  const double *azel, const int *vsat, double *N, double *b)
 {
-    double lam,rate,pos[3],E[9],a[3],e[3],vs[3],cosel;
-    int i,j,nv=0;
+    double lam,rate,pos[3],E[9],a[3],e[3],vs[3],cosel,v,h[4];
+    int i,j,k,nv=0;
 	double doppler;
     trace(3,"resdop  : n=%d\n",n);
     
     ecef2pos(rr,pos); xyz2enu(pos,E);
     
+    for (i=0;i<16;i++) N[i]=0.0;
+    for (i=0;i<4;i++) b[i]=0.0;
+    
     for (i=0;i<n&&i<MAXOBS;i++) {
         
         lam=nav->lam[obs[i].sat-1][0];
@@ -707,11 +879,14 @@ static int resdop(const obsd_t *obs, int n, const double *rs, const double *dts,
 		/* igmas special */
 		if (nav->igmasta==1){ doppler = obs[i].D[0]; }
 		else{ doppler = obs[i].D[0]; }
-		v[nv] = -lam*doppler - (rate + x[3] - CLIGHT*dts[1 + i * 2]);
-		trace(5, "resdopper: %d dopv=%lf\n", obs[i].sat, v[nv]);
-        /* design matrix */
-        for (j=0;j<4;j++) H[j+nv*4]=j<3?-e[j]:1.0;
-        
+		v = -lam*doppler - (rate + x[3] - CLIGHT*dts[1 + i * 2]);
+		trace(5, "resdopper: %d dopv=%lf\n", obs[i].sat, v);
+        /* design matrix and normal equation */
+        for (j=0;j<4;j++) h[j]=j<3?-e[j]:1.0;
+        for (j=0;j<4;j++) {
+            b[j]+=h[j]*v;
+            for (k=0;k<4;k++) N[j+k*4]+=h[j]*h[k];
+        }
         nv++;
     }
     return nv;
@@ -721,21 +896,18 @@ static void estvel(const obsd_t *obs, int n, const double *rs, const double *dts
                    const nav_t *nav, const prcopt_t *opt, sol_t *sol,
                    const double *azel, const int *vsat)
 {
-    double x[4]={0},dx[4],Q[16],*v,*H;
-    int i,j,nv;
+    double x[4]={0},dx[4],N[16],b[4];
+    int i,j;
     
     trace(3,"estvel  : n=%d\n",n);
     
-    v=mat(n,1); H=mat(4,n);
-    
     for (i=0;i<MAXITR;i++) {
         
         /* doppler residuals */
-        if ((nv=resdop(obs,n,rs,dts,nav,sol->rr,x,azel,vsat,v,H))<4) {
-            break;
-        }
+        if (resdop(obs,n,rs,dts,nav,sol->rr,x,azel,vsat,N,b)<4) break;
+        
         /* least square estimation */
-        if (lsq(H,v,4,nv,dx,Q,0.0)) break;
+        if (lsqnrm(N,b,4,dx,NULL)) break;
         
         for (j=0;j<4;j++) x[j]+=dx[j];
         
@@ -744,7 +916,6 @@ static void estvel(const obsd_t *obs, int n, const double *rs, const double *dts
             break;
         }
     }
-    free(v); free(H);
 }
 /* single-point positioning ----------------------------------------------------
 * compute receiver position, velocity, clock bias by single-point positioning
@@ -767,6 +938,7 @@ extern int pntpos(const obsd_t *obs, int n, const nav_t *nav,
                   char *msg)
 {
     prcopt_t opt_=*opt;
+    lsqest_t est;
     double *rs,*dts,*var,*azel_,*resp;
     int i,stat,vsat[MAXOBS]={0},svh[MAXOBS];
 	double rescode[MAXSAT];
@@ -792,11 +964,13 @@ extern int pntpos(const obsd_t *obs, int n, const nav_t *nav,
     satposs(sol->time,obs,n,nav,&opt_,opt_.sateph,rs,dts,var,svh);
     
     /* estimate receiver position with pseudorange */
-    stat=estpos(obs,n,rs,dts,var,svh,nav,&opt_,sol,azel_,vsat,resp,msg);
+    stat=estpos(obs,n,rs,dts,var,svh,nav,&opt_,sol,azel_,vsat,resp,NULL,&est,
+                msg);
     
     /* raim fde */
     if (!stat&&n>=6&&opt->posopt[4]) {
-        //stat=raim_fde(obs,n,rs,dts,var,svh,nav,&opt_,sol,azel_,vsat,resp,msg);
+        stat=raim_fde(obs,n,rs,dts,var,svh,nav,&opt_,sol,azel_,vsat,resp,&est,
+                      msg);
     }
     /* estimate receiver velocity with doppler */
     if (stat) estvel(obs,n,rs,dts,nav,&opt_,sol,azel_,vsat);
@@ -832,6 +1006,6 @@ extern int pntpos(const obsd_t *obs, int n, const nav_t *nav,
             ssat[obs[i].sat-1].vs=1;
         }
     }
-    free(rs); free(dts); free(var); free(azel_); free(resp);
+    matfree(rs); matfree(dts); matfree(var); matfree(azel_); matfree(resp);
     return stat;
 }
@@ -97,10 +97,7 @@ void init_nav(nav_t* nav)
     nav->galcode = 1;  /* ? 1:I/Nav, 2:FNav */
     nav->obstsys = TSYS_GPS;
     //nav->ion_bdsk9 = new BDSSH(); BDSSHдΪṹʽ
-    nav->ion_bdsk9->BrdIonCoefNum = 0;// the parameter number for broadcast [9 in default] 
-    nav->ion_bdsk9->bds_ion.nk8 = 0;
-    nav->ion_bdsk9->bds_ion.nk14 = 0;
-    nav->ion_bdsk9->bds_ion.nsh9 = 0;// the total parameter number for SH resolution [26 in default]
+    initbdsion(&nav->ion_bdsk9->bds_ion); /* parameter store indexed by time */
     nav->igmasta = -1;
 }
 void init_obs(obs_t* obs)
@@ -845,14 +842,12 @@ static int readobsnav(gtime_t ts, gtime_t te, double ti, const char **infile,
     /* delete duplicated ephemeris */
     uniqnav(nav);
     
-	/* delete duplicated ion */
-	double ep[6];
-	if (obs->n > 0)
-    {
-		time2epoch(obs->data[0].time, ep);
-        char iftrue = uniqion(ep, nav->ion_bdsk9);
-	}
-
+    /* bds ionosphere parameter sets not stored */
+    if (nav->ion_bdsk9->bds_ion.nrej>0) {
+        showmsg("warning : %d bds ion messages rejected (slot full)",
+                nav->ion_bdsk9->bds_ion.nrej);
+        trace(2,"bds ion messages rejected: n=%d\n",nav->ion_bdsk9->bds_ion.nrej);
+    }
     /* set time span for progress display */
     if (ts.time==0||te.time==0) {
         for (i=0;   i<obs->n;i++) if (obs->data[i].rcv==1) break;
@@ -874,6 +869,9 @@ static void freeobsnav(obs_t *obs, nav_t *nav)
     free(nav->eph ); nav->eph =NULL; nav->n =nav->nmax =0;
     free(nav->geph); nav->geph=NULL; nav->ng=nav->ngmax=0;
     free(nav->seph); nav->seph=NULL; nav->ns=nav->nsmax=0;
+    satgrid_free(nav->sgrid); nav->sgrid=NULL;
+    tidegrid_free(nav->tgrid); nav->tgrid=NULL;
+    freebdsion(&nav->ion_bdsk9->bds_ion);
 }
 /* average of single position ------------------------------------------------*/
 static int avepos(double *ra, int rcv, const obs_t *obs, const nav_t *nav,
@@ -1097,6 +1095,34 @@ static void setpcv(gtime_t time, prcopt_t *popt, nav_t *nav, const pcvs_t *pcvs,
         popt->pcvr[i]=*pcv;
     }
 }
+/* generate tide displacement grid of rover and base ------------------------*/
+static tidegrid_t *tidegrid(const prcopt_t *opt, const obs_t *obs,
+                            const nav_t *nav, const sta_t *sta)
+{
+    double rr[6]={0};
+    int i,tideopt[2]={0};
+    
+    /* rover: fixed position or approx position of rinex header */
+    for (i=0;i<3;i++) {
+        rr[i]=opt->mode==PMODE_FIXED||opt->mode==PMODE_PPP_FIXED?opt->ru[i]:
+              sta[0].pos[i];
+    }
+    if (opt->mode>=PMODE_PPP_KINEMA) {
+        tideopt[0]=opt->tidecorr==1?1:7;
+    }
+    else {
+        tideopt[0]=opt->tidecorr;
+        
+        /* base: reference position */
+        if (PMODE_DGPS<=opt->mode&&opt->mode<=PMODE_STATIC) {
+            for (i=0;i<3;i++) rr[i+3]=opt->rb[i];
+            tideopt[1]=opt->tidecorr;
+        }
+    }
+    return tidegrid_new(opt,gpst2utc(obs->data[0].time),
+                        gpst2utc(obs->data[obs->n-1].time),opt->tgridint,rr,
+                        tideopt,&nav->erp);
+}
 /* read ocean tide loading parameters ----------------------------------------*/
 static void readotl(prcopt_t *popt, const char *file, const sta_t *sta)
 {
@@ -1171,6 +1197,15 @@ static int execses(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
         traceopen(tracefile);
         tracelevel(sopt->trace);
     }
+    /* NeQuick-G data directory and integration mode */
+    ionmodel_nequick_setdir(fopt->nqdir);
+    ionmodel_nequick_setmode(popt->nqmode);
+    
+    /* matrix library and filter update algorithm */
+    if (!setmatlib(popt->matlib)) {
+        showmsg("warning : no system matrix library");
+    }
+    setfiltalg(popt->filtalg);
     /* read ionosphere data file */
 	if (*fopt->iono && (ext = (char*)strrchr(fopt->iono, '.'))) 
     {
@@ -1209,6 +1244,11 @@ static int execses(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
     if (popt_.mode>PMODE_SINGLE&&*fopt->blq) {
         readotl(&popt_,fopt->blq,stas);
     }
+    /* generate satellite state grid */
+    if (popt_.sgridint>0.0&&obss.n>0) {
+        navs.sgrid=satgrid_new(&popt_,obss.data[0].time,obss.data[obss.n-1].time,
+                               popt_.sgridint,popt_.sateph,&navs);
+    }
     /* rover/reference fixed position */
     if (popt_.mode==PMODE_FIXED) {
         if (!antpos(&popt_,1,&obss,&navs,stas,fopt->stapos)) {
@@ -1222,6 +1262,10 @@ static int execses(gtime_t ts, gtime_t te, double ti, const prcopt_t *popt,
             return 0;
         }
     }
+    /* generate tide displacement grid */
+    if (popt_.tgridint>0.0&&popt_.tidecorr&&obss.n>0) {
+        navs.tgrid=tidegrid(&popt_,&obss,&navs,stas);
+    }
     /* open solution statistics */
     if (flag&&sopt->sstat>0) 
     {
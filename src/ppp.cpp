@@ -193,18 +193,15 @@ extern int pppoutstat(rtk_t *rtk, char *buff)
     return (int)(p-buff);
 }
 /* exclude meas of eclipsing satellite (block IIA) ---------------------------*/
-static void testeclipse(const obsd_t *obs, int n, const nav_t *nav, double *rs)
+static void testeclipse(const obsd_t *obs, int n, const nav_t *nav,
+                        const double *esun, double *rs)
 {
-    double rsun[3],esun[3],r,ang,erpv[5]={0},cosa;
+    double r,ang,cosa;
     int i,j;
     const char *type;
     
     trace(3,"testeclipse:\n");
     
-    /* unit vector of sun direction (ecef) */
-    sunmoonpos(gpst2utc(obs[0].time),erpv,rsun,NULL,NULL);
-    normv3(rsun,esun);
-    
     for (i=0;i<n;i++) {
         type=nav->pcvs[obs[i].sat-1].type;
         
@@ -241,15 +238,13 @@ extern int yaw_angle(int sat, const char *type, int opt, double beta, double mu,
     return 1;
 }
 /* satellite attitude model --------------------------------------------------*/
-static int sat_yaw(gtime_t time, int sat, const char *type, int opt,
+static int sat_yaw(const double *rsun, int sat, const char *type, int opt,
                    const double *rs, double *exs, double *eys)
 {
-    double rsun[3],ri[6],es[3],esun[3],n[3],p[3],en[3],ep[3],ex[3],E,beta,mu;
-    double yaw,cosy,siny,erpv[5]={0};
+    double ri[6],es[3],esun[3],n[3],p[3],en[3],ep[3],ex[3],E,beta,mu;
+    double yaw,cosy,siny;
     int i;
     
-    sunmoonpos(gpst2utc(time),erpv,rsun,NULL,NULL);
-    
     /* beta and orbit angle */
     matcpy(ri,rs,6,1);
     ri[3]-=OMGE*ri[1];
@@ -277,29 +272,55 @@ static int sat_yaw(gtime_t time, int sat, const char *type, int opt,
     }
     return 1;
 }
+/* satellite attitudes of an epoch ---------------------------------------------
+* compute sun direction and yaw attitudes (satellite fixed x,y-vectors) of all
+* satellites once per epoch
+* args   : gtime_t time     I   time (gpst)
+*          obsd_t *obs      I   observation data
+*          int    n         I   number of observation data
+*          nav_t  *nav      I   navigation data
+*          int    opt       I   attitude option (0:none,>0:yaw attitude model)
+*          double *rs       I   satellite positions and velocities (ecef)
+*          double *esun     O   unit vector of sun direction (ecef)
+*          double *att      O   satellite attitudes {exs,eys} (ecef)
+*                               att[(0:5)+i*6]= obs[i] attitude
+*          int    *stat     O   attitude status (1:ok,0:no attitude)
+* return : none
+*-----------------------------------------------------------------------------*/
+static void sat_atts(gtime_t time, const obsd_t *obs, int n, const nav_t *nav,
+                     int opt, const double *rs, double *esun, double *att,
+                     int *stat)
+{
+    double rsun[3],erpv[5]={0};
+    int i,sat;
+    
+    trace(3,"sat_atts: n=%d opt=%d\n",n,opt);
+    
+    sunmoonpos(gpst2utc(time),erpv,rsun,NULL,NULL);
+    if (!normv3(rsun,esun)) esun[0]=esun[1]=esun[2]=0.0;
+    
+    for (i=0;i<n&&i<MAXOBS;i++) {
+        stat[i]=0;
+        if (opt<=0||norm(rs+i*6,3)<=0.0) continue;
+        sat=obs[i].sat;
+        stat[i]=sat_yaw(rsun,sat,nav->pcvs[sat-1].type,opt,rs+i*6,att+i*6,
+                        att+i*6+3);
+    }
+}
 /* phase windup model --------------------------------------------------------*/
-static int model_phw(gtime_t time, int sat, const char *type, int opt,
-                     const double *rs, const double *rr, double *phw)
+static int model_phw(int opt, const double *exs, const double *eys,
+                     const double *exr, const double *eyr, const double *rs,
+                     const double *rr, double *phw)
 {
-    double exs[3],eys[3],ek[3],exr[3],eyr[3],eks[3],ekr[3],E[9];
-    double dr[3],ds[3],drs[3],r[3],pos[3],cosp,ph;
+    double ek[3],eks[3],ekr[3],dr[3],ds[3],drs[3],r[3],cosp,ph;
     int i;
     
     if (opt<=0) return 1; /* no phase windup */
     
-    /* satellite yaw attitude model */
-    if (!sat_yaw(time,sat,type,opt,rs,exs,eys)) return 0;
-    
     /* unit vector satellite to receiver */
     for (i=0;i<3;i++) r[i]=rr[i]-rs[i];
     if (!normv3(r,ek)) return 0;
     
-    /* unit vectors of receiver antenna */
-    ecef2pos(rr,pos);
-    xyz2enu(pos,E);
-    exr[0]= E[1]; exr[1]= E[4]; exr[2]= E[7]; /* x = north */
-    eyr[0]=-E[0]; eyr[1]=-E[3]; eyr[2]=-E[6]; /* y = west  */
-    
     /* phase windup effect */
     cross3(ek,eys,eks);
     cross3(ek,eyr,ekr);
@@ -516,7 +537,7 @@ static void udpos_ppp(rtk_t *rtk)
         if (rtk->x[i]!=0.0&&rtk->P[i+i*rtk->nx]>0.0) ix[nx++]=i;
     }
     if (nx<9) {
-        free(ix);
+        matfree(ix);
         return;
     }
     /* state transition of position/velocity/acceleration */
@@ -553,7 +574,7 @@ static void udpos_ppp(rtk_t *rtk)
     for (i=0;i<3;i++) for (j=0;j<3;j++) {
         rtk->P[i+6+(j+6)*rtk->nx]+=Qv[i+j*3];
     }
-    free(ix); free(F); free(P); free(FP); free(x); free(xp);
+    matfree(ix); matfree(F); matfree(P); matfree(FP); matfree(x); matfree(xp);
 }
 /* temporal update of clock --------------------------------------------------*/
 static void udclk_ppp(rtk_t *rtk)
@@ -789,18 +810,16 @@ static void satantpcv(const double *rs, const double *rr, const pcv_t *pcv,
     antmodel_s(pcv,nadir,dant);
 }
 /* precise tropospheric model ------------------------------------------------*/
-static double trop_model_prec(gtime_t time, const double *pos,
-                              const double *azel, const double *x, double *dtdx,
-                              double *var)
+static double trop_model_prec(const tropctx_t *trc, const double *azel,
+                              const double *x, double *dtdx, double *var)
 {
-    const double zazel[]={0.0,PI/2.0};
     double zhd,m_h,m_w,cotz,grad_n,grad_e;
     
     /* zenith hydrostatic delay */
-    zhd=tropmodel(time,pos,zazel,0.0);
+    zhd=trc->zhd;
     
     /* mapping function */
-    m_h=tropmapf(time,pos,azel,&m_w);
+    m_h=tropmapfc(trc,azel,&m_w);
     
     if (azel[1]>0.0) {
         
@@ -817,29 +836,29 @@ static double trop_model_prec(gtime_t time, const double *pos,
     return m_h*zhd+m_w*(x[0]-zhd);
 }
 /* tropospheric model ---------------------------------------------------------*/
-static int model_trop(gtime_t time, const double *pos, const double *azel,
+static int model_trop(const tropctx_t *trc, const double *azel,
                       const prcopt_t *opt, const double *x, double *dtdx,
                       const nav_t *nav, double *dtrp, double *var)
 {
     double trp[3]={0},std[3];
     
     if (opt->tropopt==TROPOPT_SAAS) {
-        *dtrp=tropmodel(time,pos,azel,REL_HUMI);
+        *dtrp=tropmodelc(trc,azel);
         *var=SQR(ERR_SAAS);
         return 1;
     }
     if (opt->tropopt==TROPOPT_SBAS) {
-        *dtrp=sbstropcorr(time,pos,azel,var);
+        *dtrp=sbstropcorr(trc->time,trc->pos,azel,var);
         return 1;
     }
     if (opt->tropopt==TROPOPT_EST||opt->tropopt==TROPOPT_ESTG) {
         matcpy(trp,x+IT(opt),opt->tropopt==TROPOPT_EST?1:3,1);
-        *dtrp=trop_model_prec(time,pos,azel,trp,dtdx,var);
+        *dtrp=trop_model_prec(trc,azel,trp,dtdx,var);
         return 1;
     }
     if (opt->tropopt==TROPOPT_ZTD) {
-        if (pppcorr_trop(&nav->pppcorr,time,pos,trp,std)) {
-            *dtrp=trop_model_prec(time,pos,azel,trp,dtdx,var);
+        if (pppcorr_trop(&nav->pppcorr,trc->time,trc->pos,trp,std)) {
+            *dtrp=trop_model_prec(trc,azel,trp,dtdx,var);
             *var=SQR(dtdx[0]*std[0]);
             return 1;
         }
@@ -925,13 +944,15 @@ static int const_corr(const obsd_t *obs, int n, const int *exc,
 /* phase and code residuals --------------------------------------------------*/
 static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
                    const double *dts, const double *var_rs, const int *svh,
-                   const double *dr, int *exc, const nav_t *nav,
-                   const double *x, rtk_t *rtk, double *v, double *H, double *R,
-                   double *azel)
+                   const double *dr, const double *att, const int *astat,
+                   int *exc, const nav_t *nav, const double *x, rtk_t *rtk,
+                   double *v, double *H, double *R, double *azel)
 {
     const double *lam;
     prcopt_t *opt=&rtk->opt;
     double y,r,cdtr,bias,C,rr[3],pos[3],e[3],dtdx[3],L[NFREQ],P[NFREQ],Lc,Pc;
+    double E[9],exr[3],eyr[3];
+    tropctx_t trc;
     double var[MAXOBS*2],dtrp=0.0,dion=0.0,vart=0.0,vari=0.0,dcb;
     double dantr[NFREQ]={0},dants[NFREQ]={0};
     double ve[MAXOBS*2*NFREQ]={0},vmax=0;
@@ -946,6 +967,14 @@ static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
     for (i=0;i<3;i++) rr[i]=x[i]+dr[i];
     ecef2pos(rr,pos);
     
+    /* unit vectors of receiver antenna */
+    xyz2enu(pos,E);
+    exr[0]= E[1]; exr[1]= E[4]; exr[2]= E[7]; /* x = north */
+    eyr[0]=-E[0]; eyr[1]=-E[3]; eyr[2]=-E[6]; /* y = west  */
+    
+    /* receiver troposphere terms of the epoch */
+    inittropctx(&trc,obs[0].time,pos,REL_HUMI);
+    
     for (i=0;i<n&&i<MAXOBS;i++) {
         sat=obs[i].sat;
         lam=nav->lam[sat-1];
@@ -962,7 +991,7 @@ static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
             continue;
         }
         /* tropospheric and ionospheric model */
-        if (!model_trop(obs[i].time,pos,azel+i*2,opt,x,dtdx,nav,&dtrp,&vart)||
+        if (!model_trop(&trc,azel+i*2,opt,x,dtdx,nav,&dtrp,&vart)||
             !model_iono(obs[i].time,pos,azel+i*2,opt,sat,x,nav,&dion,&vari)) {
             continue;
         }
@@ -971,8 +1000,9 @@ static int ppp_res(int post, const obsd_t *obs, int n, const double *rs,
         antmodel(opt->pcvr,opt->antdel[0],azel+i*2,opt->posopt[1],dantr);
         
         /* phase windup model */
-        if (!model_phw(rtk->sol.time,sat,nav->pcvs[sat-1].type,
-                       opt->posopt[2]?2:0,rs+i*6,rr,&rtk->ssat[sat-1].phw)) {
+        if ((opt->posopt[2]&&!astat[i])||
+            !model_phw(opt->posopt[2]?2:0,att+i*6,att+i*6+3,exr,eyr,rs+i*6,rr,
+                       &rtk->ssat[sat-1].phw)) {
             continue;
         }
         /* corrected phase and code measurements */
@@ -1121,6 +1151,19 @@ static void update_stat(rtk_t *rtk, const obsd_t *obs, int n, int stat)
         if (rtk->ssat[i].fix[j]==2&&stat!=SOLQ_FIX) rtk->ssat[i].fix[j]=1;
     }
 }
+/* get/set covariance block of states ---------------------------------------*/
+static void getblk(const double *P, int n, const int *ix, int k, double *Pk)
+{
+    int i,j;
+    
+    for (j=0;j<k;j++) for (i=0;i<k;i++) Pk[i+j*k]=P[ix[i]+ix[j]*n];
+}
+static void setblk(double *P, int n, const int *ix, int k, const double *Pk)
+{
+    int i,j;
+    
+    for (j=0;j<k;j++) for (i=0;i<k;i++) P[ix[i]+ix[j]*n]=Pk[i+j*k];
+}
 /* test hold ambiguity -------------------------------------------------------*/
 static int test_hold_amb(rtk_t *rtk)
 {
@@ -1149,14 +1192,16 @@ static int test_hold_amb(rtk_t *rtk)
 extern void pppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
 {
     const prcopt_t *opt=&rtk->opt;
-    double *rs,*dts,*var,*v,*H,*R,*azel,*xp,*Pp,dr[3]={0},std[3];
+    double *rs,*dts,*var,*v,*H,*R,*azel,*xp,*Pp=NULL,*Pb,*att,dr[3]={0},std[3];
+    double esun[3];
     char str[32];
-    int i,j,nv,info,svh[MAXOBS],exc[MAXOBS]={0},stat=SOLQ_SINGLE;
+    int i,j,k,nv,info,svh[MAXOBS],exc[MAXOBS]={0},astat[MAXOBS],*ix;
+    int stat=SOLQ_SINGLE;
     
     time2str(obs[0].time,str,2);
     trace(3,"pppos   : time=%s nx=%d n=%d\n",str,rtk->nx,n);
     
-    rs=mat(6,n); dts=mat(2,n); var=mat(1,n); azel=zeros(2,n);
+    rs=mat(6,n); dts=mat(2,n); var=mat(1,n); azel=zeros(2,n); att=zeros(6,n);
     
     for (i=0;i<MAXSAT;i++) for (j=0;j<opt->nf;j++) rtk->ssat[i].fix[j]=0;
     
@@ -1166,38 +1211,50 @@ extern void pppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
     /* satellite positions and clocks */
     satposs(obs[0].time,obs,n,nav,&(rtk->opt),rtk->opt.sateph,rs,dts,var,svh);
     
+    /* sun direction and satellite attitudes */
+    sat_atts(rtk->sol.time,obs,n,nav,opt->posopt[2]?2:0,rs,esun,att,astat);
+    
     /* exclude measurements of eclipsing satellite (block IIA) */
     if (rtk->opt.posopt[3]) {
-        testeclipse(obs,n,nav,rs);
+        testeclipse(obs,n,nav,esun,rs);
     }
     /* earth tides correction */
-    if (opt->tidecorr) {
+    if (opt->tidecorr&&!tidegrid_disp(nav->tgrid,0,gpst2utc(obs[0].time),
+                                      rtk->x,opt->tidecorr==1?1:7,dr)) {
         tidedisp(gpst2utc(obs[0].time),rtk->x,opt->tidecorr==1?1:7,&nav->erp,
                  opt->odisp[0],dr);
     }
     nv=n*rtk->opt.nf*2+MAXSAT+3;
-    xp=mat(rtk->nx,1); Pp=zeros(rtk->nx,rtk->nx);
-    v=mat(nv,1); H=mat(rtk->nx,nv); R=mat(nv,nv);
+    xp=mat(rtk->nx,1); v=mat(nv,1); H=mat(rtk->nx,nv); R=mat(nv,nv);
+    
+    /* covariance of active states is updated in place, backup for retry */
+    ix=imat(rtk->nx,1);
+    for (i=k=0;i<rtk->nx;i++) {
+        if (rtk->x[i]!=0.0&&rtk->P[i+i*rtk->nx]>0.0) ix[k++]=i;
+    }
+    Pb=mat(k,k);
+    getblk(rtk->P,rtk->nx,ix,k,Pb);
     
     for (i=0;i<MAX_ITER;i++) {
         
         matcpy(xp,rtk->x,rtk->nx,1);
-        matcpy(Pp,rtk->P,rtk->nx,rtk->nx);
+        if (i>0) setblk(rtk->P,rtk->nx,ix,k,Pb);
         
         /* prefit residuals */
-        if (!(nv=ppp_res(0,obs,n,rs,dts,var,svh,dr,exc,nav,xp,rtk,v,H,R,azel))) {
+        if (!(nv=ppp_res(0,obs,n,rs,dts,var,svh,dr,att,astat,exc,nav,xp,rtk,v,
+                         H,R,azel))) {
             trace(2,"%s ppp (%d) no valid obs data\n",str,i+1);
             break;
         }
         /* measurement update of ekf states */
-        if ((info=filter(xp,Pp,H,v,R,rtk->nx,nv))) {
+        if ((info=filter(xp,rtk->P,H,v,R,rtk->nx,nv))) {
             trace(2,"%s ppp (%d) filter error info=%d\n",str,i+1,info);
             break;
         }
         /* postfit residuals */
-        if (ppp_res(i+1,obs,n,rs,dts,var,svh,dr,exc,nav,xp,rtk,v,H,R,azel)) {
+        if (ppp_res(i+1,obs,n,rs,dts,var,svh,dr,att,astat,exc,nav,xp,rtk,v,H,R,
+                    azel)) {
             matcpy(rtk->x,xp,rtk->nx,1);
-            matcpy(rtk->P,Pp,rtk->nx,rtk->nx);
             stat=SOLQ_PPP;
             break;
         }
@@ -1205,11 +1262,18 @@ extern void pppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
     if (i>=MAX_ITER) {
         trace(2,"%s ppp (%d) iteration overflows\n",str,i);
     }
+    if (stat!=SOLQ_PPP) setblk(rtk->P,rtk->nx,ix,k,Pb);
+    
     if (stat==SOLQ_PPP) {
         
-        /* ambiguity resolution in ppp */
-        if (ppp_ar(rtk,obs,n,exc,nav,azel,xp,Pp)&&
-            ppp_res(9,obs,n,rs,dts,var,svh,dr,exc,nav,xp,rtk,v,H,R,azel)) {
+        /* ambiguity resolution in ppp (full state copies only if enabled) */
+        if (rtk->opt.modear!=ARMODE_OFF) {
+            Pp=mat(rtk->nx,rtk->nx);
+            matcpy(Pp,rtk->P,rtk->nx,rtk->nx);
+        }
+        if (Pp&&ppp_ar(rtk,obs,n,exc,nav,azel,xp,Pp)&&
+            ppp_res(9,obs,n,rs,dts,var,svh,dr,att,astat,exc,nav,xp,rtk,v,H,R,
+                    azel)) {
             
             matcpy(rtk->xa,xp,rtk->nx,1);
             matcpy(rtk->Pa,Pp,rtk->nx,rtk->nx);
@@ -1231,6 +1295,6 @@ extern void pppos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
             rtk->nfix=0;
         }
     }
-    free(rs); free(dts); free(var); free(azel);
-    free(xp); free(Pp); free(v); free(H); free(R);
+    matfree(rs); matfree(dts); matfree(var); matfree(azel); matfree(att);
+    matfree(xp); matfree(Pp); matfree(Pb); matfree(ix); matfree(v); matfree(H); matfree(R);
 }
@@ -642,31 +642,16 @@ static int pephclk(gtime_t time, int sat, const nav_t *nav, double *dts,
     if (varc) *varc=SQR(std);
     return 1;
 }
-/* satellite antenna phase center offset ---------------------------------------
-* compute satellite antenna phase center offset in ecef
-* args   : gtime_t time       I   time (gpst)
-*          double *rs         I   satellite position and velocity (ecef)
-*                                 {x,y,z,vx,vy,vz} (m|m/s)
-*          int    sat         I   satellite number
-*          nav_t  *nav        I   navigation data
-*          double *dant       I   satellite antenna phase center offset (ecef)
-*                                 {dx,dy,dz} (m) (iono-free LC value)
-* return : none
-*-----------------------------------------------------------------------------*/
-extern void satantoff(gtime_t time, const double *rs, int sat, const nav_t *nav,
-                      double *dant)
+/* satellite antenna phase center offset by sun position ---------------------*/
+static void satantoff_sun(const double *rsun, const double *rs, int sat,
+                          const nav_t *nav, double *dant)
 {
     const double *lam=nav->lam[sat-1];
     const pcv_t *pcv=nav->pcvs+sat-1;
-    double ex[3],ey[3],ez[3],es[3],r[3],rsun[3],gmst,erpv[5]={0};
+    double ex[3],ey[3],ez[3],es[3],r[3];
     double gamma,C1,C2,dant1,dant2;
     int i,j=0,k=1;
     
-    trace(4,"satantoff: time=%s sat=%2d\n",time_str(time,3),sat);
-    
-    /* sun position in ecef */
-    sunmoonpos(gpst2utc(time),erpv,rsun,NULL,&gmst);
-    
     /* unit vectors of satellite fixed coordinates */
     for (i=0;i<3;i++) r[i]=-rs[i];
     if (!normv3(r,ez)) return;
@@ -691,6 +676,58 @@ extern void satantoff(gtime_t time, const double *rs, int sat, const nav_t *nav,
         dant[i]=C1*dant1+C2*dant2;
     }
 }
+/* satellite antenna phase center offset ---------------------------------------
+* compute satellite antenna phase center offset in ecef
+* args   : gtime_t time       I   time (gpst)
+*          double *rs         I   satellite position and velocity (ecef)
+*                                 {x,y,z,vx,vy,vz} (m|m/s)
+*          int    sat         I   satellite number
+*          nav_t  *nav        I   navigation data
+*          double *dant       I   satellite antenna phase center offset (ecef)
+*                                 {dx,dy,dz} (m) (iono-free LC value)
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void satantoff(gtime_t time, const double *rs, int sat, const nav_t *nav,
+                      double *dant)
+{
+    trace(4,"satantoff: time=%s sat=%2d\n",time_str(time,3),sat);
+    
+    satantoffs(time,rs,&sat,1,nav,dant);
+}
+/* satellite antenna phase center offsets of an epoch --------------------------
+* compute satellite antenna phase center offsets in ecef for all satellites of
+* an epoch with single sun position
+* args   : gtime_t time       I   time (gpst)
+*          double *rs         I   satellite positions and velocities (ecef)
+*                                 rs[(0:2)+i*6]= sats[i] position (m)
+*          int    *sats       I   satellite numbers (0: skip)
+*          int    n           I   number of satellites
+*          nav_t  *nav        I   navigation data
+*          double *dant       O   satellite antenna phase center offsets (ecef)
+*                                 dant[(0:2)+i*3]= sats[i] offset (m)
+*                                 (iono-free LC value, 0: no offset)
+* return : none
+* notes  : the sun moves less than 1 mdeg in 0.1 s, so the sun position at
+*          the reception time serves the transmission times of all satellites
+*-----------------------------------------------------------------------------*/
+extern void satantoffs(gtime_t time, const double *rs, const int *sats, int n,
+                       const nav_t *nav, double *dant)
+{
+    double rsun[3],erpv[5]={0};
+    int i;
+    
+    trace(4,"satantoffs: time=%s n=%d\n",time_str(time,3),n);
+    
+    for (i=0;i<3*n;i++) dant[i]=0.0;
+    
+    /* sun position in ecef */
+    sunmoonpos(gpst2utc(time),erpv,rsun,NULL,NULL);
+    
+    for (i=0;i<n;i++) {
+        if (sats[i]<=0||MAXSAT<sats[i]||norm(rs+i*6,3)<=0.0) continue;
+        satantoff_sun(rsun,rs+i*6,sats[i],nav,dant+i*3);
+    }
+}
 /* satellite position/clock by precise ephemeris/clock -------------------------
 * compute satellite position/clock with precise ephemeris/clock
 * args   : gtime_t time       I   time (gpst)
@@ -558,26 +558,26 @@ static void decode_navh(char *buff, nav_t *nav)
             else if (!strncmp(buff,"BDSA",4)) { /* v.3.02 */
 				int hour = AZ2hour(buff[54]);
 				int sat = (int)str2num(buff, 57, 2);
-				int nk8 = nav->ion_bdsk9->bds_ion.nk8;
 				for (i = 0, j = 5; i<4; i++, j += 12) ionvalue[i] = str2num(buff, j, 12);
-				nav->ion_bdsk9->bds_ion.bdsk8[nk8].hour = hour;
-                for (i = 0; i < 4; i++) nav->ion_bdsk9->bds_ion.bdsk8[nk8].ion[i] = ionvalue[i];
-				for (i = 4; i < 8; i++) nav->ion_bdsk9->bds_ion.bdsk8[nk8].ion[i] = 0.0;
-                nav->ion_bdsk9->bds_ion.bdsk8[nk8].sat = sat;
+				nav->ion_bdsk9->bds_ion.bdsk8.hour = hour;
+                for (i = 0; i < 4; i++) nav->ion_bdsk9->bds_ion.bdsk8.ion[i] = ionvalue[i];
+				for (i = 4; i < 8; i++) nav->ion_bdsk9->bds_ion.bdsk8.ion[i] = 0.0;
+                nav->ion_bdsk9->bds_ion.bdsk8.sat = sat;
             }
             else if (!strncmp(buff,"BDSB",4)) { /* v.3.02 */
 				int hour = AZ2hour(buff[54]);
 				int sat = (int)str2num(buff, 57, 2);
-				int nk8 = nav->ion_bdsk9->bds_ion.nk8;
 				for (i = 0, j = 5; i<4; i++, j += 12) ionvalue[i] = str2num(buff, j, 12);
-				if (nav->ion_bdsk9->bds_ion.bdsk8[nk8].hour == hour &&
-					nav->ion_bdsk9->bds_ion.bdsk8[nk8].sat == sat)
+				if (nav->ion_bdsk9->bds_ion.bdsk8.hour == hour &&
+					nav->ion_bdsk9->bds_ion.bdsk8.sat == sat)
 				{
-					for (i = 0; i < 4; i++) nav->ion_bdsk9->bds_ion.bdsk8[nk8].ion[i + 4] = ionvalue[i];
-					if (norm(nav->ion_bdsk9->bds_ion.bdsk8[nk8].ion, 4) != 0.0&&
-						norm(nav->ion_bdsk9->bds_ion.bdsk8[nk8].ion + 4, 4) != 0.0)
+					for (i = 0; i < 4; i++) nav->ion_bdsk9->bds_ion.bdsk8.ion[i + 4] = ionvalue[i];
+					if (norm(nav->ion_bdsk9->bds_ion.bdsk8.ion, 4) != 0.0&&
+						norm(nav->ion_bdsk9->bds_ion.bdsk8.ion + 4, 4) != 0.0)
 					{
-						nav->ion_bdsk9->bds_ion.nk8++;
+						addbdsion(&nav->ion_bdsk9->bds_ion, BDSION_K8, 0, hour,
+						          nav->ion_bdsk9->bds_ion.bdsk8.ion);
+						nav->ion_bdsk9->bds_ion.bdsk8.sat = -1; /* message complete */
 					}
 				}
             }
@@ -585,37 +585,36 @@ static void decode_navh(char *buff, nav_t *nav)
 				int hour = AZ2hour(buff[54]);
 				int sat = (int)str2num(buff, 57, 2);
 				for (i = 0, j = 5; i<3; i++, j += 12) ionvalue[i] = str2num(buff, j, 12);
-				int nsh9 = nav->ion_bdsk9->bds_ion.nsh9;
-				nav->ion_bdsk9->bds_ion.bdssh9[nsh9].hour = hour;
-				for (i = 0; i<3; i++) nav->ion_bdsk9->bds_ion.bdssh9[nsh9].ion[i] = ionvalue[i];
-				for (i = 3; i < 9; i++) nav->ion_bdsk9->bds_ion.bdssh9[nsh9].ion[i] = 0.0;
-				nav->ion_bdsk9->bds_ion.bdssh9[nsh9].sat = sat;
+				nav->ion_bdsk9->bds_ion.bdssh9.hour = hour;
+				for (i = 0; i<3; i++) nav->ion_bdsk9->bds_ion.bdssh9.ion[i] = ionvalue[i];
+				for (i = 3; i < 9; i++) nav->ion_bdsk9->bds_ion.bdssh9.ion[i] = 0.0;
+				nav->ion_bdsk9->bds_ion.bdssh9.sat = sat;
 			}
 			else if (!strncmp(buff, "BDS2", 4)) { /* v.3.02 */
 				int hour = AZ2hour(buff[54]);
 				int sat = (int)str2num(buff, 57, 2);
-				int nsh9 = nav->ion_bdsk9->bds_ion.nsh9;
 				for (i = 0, j = 5; i<3; i++, j += 12) ionvalue[i] = str2num(buff, j, 12);
-				if (nav->ion_bdsk9->bds_ion.bdssh9[nsh9].hour == hour &&
-					nav->ion_bdsk9->bds_ion.bdssh9[nsh9].sat == sat)
+				if (nav->ion_bdsk9->bds_ion.bdssh9.hour == hour &&
+					nav->ion_bdsk9->bds_ion.bdssh9.sat == sat)
 				{
-					for (i = 0; i<3; i++) nav->ion_bdsk9->bds_ion.bdssh9[nsh9].ion[i + 3] = ionvalue[i];
+					for (i = 0; i<3; i++) nav->ion_bdsk9->bds_ion.bdssh9.ion[i + 3] = ionvalue[i];
 				}
 			}
 			else if (!strncmp(buff, "BDS3", 4)) { /* v.3.02 */
 				int hour = AZ2hour(buff[54]);
 				int sat = (int)str2num(buff, 57, 2);
-				int nsh9 = nav->ion_bdsk9->bds_ion.nsh9;
 				for (i = 0, j = 5; i<3; i++, j += 12) ionvalue[i] = str2num(buff, j, 12);
-				if (nav->ion_bdsk9->bds_ion.bdssh9[nsh9].hour == hour &&
-					nav->ion_bdsk9->bds_ion.bdssh9[nsh9].sat == sat)
+				if (nav->ion_bdsk9->bds_ion.bdssh9.hour == hour &&
+					nav->ion_bdsk9->bds_ion.bdssh9.sat == sat)
 				{
-					for (i = 0; i<3; i++) nav->ion_bdsk9->bds_ion.bdssh9[nsh9].ion[i + 6] = ionvalue[i];
-					if (norm(nav->ion_bdsk9->bds_ion.bdssh9[nsh9].ion, 3) != 0.0 &&
-						norm(nav->ion_bdsk9->bds_ion.bdssh9[nsh9].ion + 3, 3) != 0.0&&
-						norm(nav->ion_bdsk9->bds_ion.bdssh9[nsh9].ion + 6, 3) != 0.0)
+					for (i = 0; i<3; i++) nav->ion_bdsk9->bds_ion.bdssh9.ion[i + 6] = ionvalue[i];
+					if (norm(nav->ion_bdsk9->bds_ion.bdssh9.ion, 3) != 0.0 &&
+						norm(nav->ion_bdsk9->bds_ion.bdssh9.ion + 3, 3) != 0.0&&
+						norm(nav->ion_bdsk9->bds_ion.bdssh9.ion + 6, 3) != 0.0)
 					{
-						nav->ion_bdsk9->bds_ion.nsh9++;
+						addbdsion(&nav->ion_bdsk9->bds_ion, BDSION_SH9, 0, hour,
+						          nav->ion_bdsk9->bds_ion.bdssh9.ion);
+						nav->ion_bdsk9->bds_ion.bdssh9.sat = -1; /* message complete */
 					}
 				}
 			}
@@ -1998,7 +1997,7 @@ static int readrnxnavb(FILE *fp, const char *opt, double ver, int sys,
 static int add_ion(nav_t *nav, const ion_t iono, int type)
 {
 	double ep[6];
-	int i;
+	int i, day = (int)(iono.toc.time / 86400);
 
 	time2epoch(iono.toc, ep);
 
@@ -2011,18 +2010,10 @@ static int add_ion(nav_t *nav, const ion_t iono, int type)
 	else if (type == 6 && iono.sys == SYS_CMP){
 		for (i = 0; i < 8; i++){ nav->ion_cmp[i] = iono.ion[i]; }
 
-		int hour = int(ep[3]);
-		int nk8 = nav->ion_bdsk9->bds_ion.nk8;
-		nav->ion_bdsk9->bds_ion.bdsk8[nk8].hour = hour;
-		for (i = 0; i<8; i++) nav->ion_bdsk9->bds_ion.bdsk8[nk8].ion[i] = iono.ion[i];
-		nav->ion_bdsk9->bds_ion.nk8++;
+		addbdsion(&nav->ion_bdsk9->bds_ion, BDSION_K8, day, int(ep[3]), iono.ion);
 	}
 	else if (type == 7 ){
-		int hour = int(ep[3]);
-		int nsh9 = nav->ion_bdsk9->bds_ion.nsh9;
-		nav->ion_bdsk9->bds_ion.bdssh9[nsh9].hour = hour;
-		for (i = 0; i<9; i++) nav->ion_bdsk9->bds_ion.bdssh9[nsh9].ion[i] = iono.ion[i];
-		nav->ion_bdsk9->bds_ion.nsh9++;
+		addbdsion(&nav->ion_bdsk9->bds_ion, BDSION_SH9, day, int(ep[3]), iono.ion);
 	}
 	return 1;
 }
@@ -0,0 +1,143 @@
+/*------------------------------------------------------------------------------
+* robstat.c : robust statistics of residuals
+*
+* selection-based order statistics (median, mad) and 1-d density clustering
+* of the residuals of an epoch. the working memory is on the stack for up to
+* MAXSAT data
+*
+* references :
+*     [1] M.Ester, H.P.Kriegel, J.Sander, X.Xu, A density-based algorithm for
+*         discovering clusters in large spatial databases with noise, KDD-96,
+*         1996
+*
+* version : $Revision:$ $Date:$
+* history : 2026/10/18 1.0  new
+*-----------------------------------------------------------------------------*/
+#include <algorithm>
+#include <functional>
+#include "rtklib.h"
+
+typedef struct {        /* 1-d data point */
+    float x;            /* value */
+    int i;              /* index */
+} dpoint_t;
+
+/* compare 1-d data points ---------------------------------------------------*/
+static int cmpdpoint(const void *p1, const void *p2)
+{
+    const dpoint_t *q1=(const dpoint_t *)p1,*q2=(const dpoint_t *)p2;
+    return q1->x<q2->x?-1:(q1->x>q2->x?1:q1->i-q2->i);
+}
+/* distance of 1-d data points within eps ------------------------------------*/
+static int neardpoint(float x1, float x2, float eps)
+{
+    float d=x1-x2;
+    return (d<0.0f?-d:d)<=eps;
+}
+/* order statistic of non-zero data --------------------------------------------
+* select the order statistic of the data excluding zeros (|x|<=1E-6)
+* args   : int    flag      I   order (1:ascending,other:descending)
+*          double *x0       I   data {x0[0],...,x0[nx0-1]}
+*          int    nx0       I   number of data
+*          double ratio     I   ratio of order (0.5:median)
+* return : element round(ratio*nx)-1 of the sorted non-zero data (nx: number
+*          of non-zero data) (0.0: no data)
+*-----------------------------------------------------------------------------*/
+extern double permutation(int flag, const double *x0, const int nx0,
+                          const double ratio)
+{
+    double buff[MAXSAT],*x=nx0>MAXSAT?mat(nx0,1):buff,val=0.0;
+    int i,nx,index;
+    
+    for (i=nx=0;i<nx0;i++) {
+        if (fabs(x0[i])>1E-6) x[nx++]=x0[i];
+    }
+    index=nx>0?(int)round(ratio*nx)-1:-1;
+    
+    if (index>=0&&index<nx) {
+        if (flag==1) std::nth_element(x,x+index,x+nx);
+        else std::nth_element(x,x+index,x+nx,std::greater<double>());
+        val=x[index];
+    }
+    if (x!=buff) matfree(x);
+    return val;
+}
+/* mean of first density cluster of 1-d data -----------------------------------
+* cluster 1-d data by dbscan [1] and compute the mean of the cluster of the
+* first core point
+* args   : double *x        I   data {x[0],...,x[n-1]}
+*          int    n         I   number of data
+*          double eps       I   radius of neighborhood
+*          int    minpts    I   min number of points (including itself) in
+*                               neighborhood of core point
+* return : mean of the cluster (0.0: no cluster)
+* notes  : data and distances are evaluated in single precision.
+*          a border point belongs to the cluster of the first core point
+*          within eps. the mean is that of the first cluster of dbscan() (see
+*          DBSCAN.cpp) with the data of one dimension in single precision
+*-----------------------------------------------------------------------------*/
+extern double clustmean(const double *x, int n, double eps, int minpts)
+{
+    dpoint_t buff[MAXSAT],*p;
+    float e=(float)eps;
+    double mean=0.0;
+    int buffi[MAXSAT*4],*ibuff,*core,*comp,*que,*in;
+    int i,k,lo,hi,nc,qh,qt,c1=-1,imin=n,m=0;
+    
+    if (n<=0) return 0.0;
+    
+    if (n>MAXSAT) {
+        p=(dpoint_t *)malloc(sizeof(dpoint_t)*n);
+        ibuff=imat(n,4);
+        if (!p||!ibuff) {
+            free(p); matfree(ibuff);
+            return 0.0;
+        }
+    }
+    else {
+        p=buff; ibuff=buffi;
+    }
+    core=ibuff; comp=ibuff+n; que=ibuff+2*n; in=ibuff+3*n;
+    
+    /* sort data */
+    for (i=0;i<n;i++) {
+        p[i].x=(float)x[i]; p[i].i=i;
+    }
+    qsort(p,n,sizeof(dpoint_t),cmpdpoint);
+    
+    /* core points by number of points in neighborhood (sorted order) */
+    for (i=lo=hi=nc=0;i<n;i++) {
+        while (!neardpoint(p[i].x,p[lo].x,e)) lo++;
+        if (hi<i) hi=i;
+        while (hi+1<n&&neardpoint(p[hi+1].x,p[i].x,e)) hi++;
+        if (hi-lo+1>=minpts) core[nc++]=i;
+    }
+    if (nc<=0) {
+        if (p!=buff) {free(p); matfree(ibuff);}
+        return 0.0;
+    }
+    /* connected core points (chained by neighbors in sorted order) */
+    for (k=0;k<nc;k++) {
+        comp[k]=k>0&&neardpoint(p[core[k]].x,p[core[k-1]].x,e)?comp[k-1]:k;
+        if (p[core[k]].i<imin) {imin=p[core[k]].i; c1=comp[k];}
+    }
+    /* points of the first core point cluster: the first core point (min
+       index) within eps of each point belongs to the cluster */
+    for (i=lo=hi=qh=qt=0;i<n;i++) {
+        while (lo<nc&&!neardpoint(p[i].x,p[core[lo]].x,e)&&
+               p[core[lo]].x<p[i].x) lo++;
+        if (hi<lo) hi=lo;
+        while (hi<nc&&neardpoint(p[core[hi]].x,p[i].x,e)) {
+            while (qt>qh&&p[core[que[qt-1]]].i>p[core[hi]].i) qt--;
+            que[qt++]=hi++;
+        }
+        while (qh<qt&&que[qh]<lo) qh++;
+        in[p[i].i]=qh<qt&&comp[que[qh]]==c1;
+    }
+    /* mean of cluster in data order */
+    for (i=0;i<n;i++) {
+        if (in[i]) mean+=((double)(float)x[i]-mean)/++m;
+    }
+    if (p!=buff) {free(p); matfree(ibuff);}
+    return mean;
+}
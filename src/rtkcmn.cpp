@@ -5,6 +5,7 @@
 *
 * options : -DLAPACK   use LAPACK/BLAS
 *           -DMKL      use Intel MKL
+*           -mavx2 -mfma use AVX2/FMA kernels of matrix multiplication
 *           -DTRACE    enable debug trace
 *           -DWIN32    use WIN32 API
 *           -DNOCALLOC no use calloc for zero matrix
@@ -135,6 +136,11 @@
 #include <sys/time.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#endif
+#if defined(__AVX2__)&&defined(__FMA__)&&!defined(LAPACK)&&!defined(MKL)
+#include <immintrin.h>
 #endif
 #include "rtklib.h"
 
@@ -842,16 +848,112 @@ extern int decode_word(unsigned int word, unsigned char *data)
     for (i=0;i<3;i++) data[i]=(unsigned char)(word>>(22-i*8));
     return 1;
 }
+/* matrix arena of thread ---------------------------------------------------*/
+static THREADLOCAL matarena_t *matarena_=NULL;
+
+/* set matrix arena ------------------------------------------------------------
+* set the arena of mat(),imat(),zeros() and eye() of the calling thread
+* args   : matarena_t *arena IO  matrix arena (NULL: heap)
+* return : previous arena of the thread
+* notes  : the matrices allocated in the arena are released by matfree() and
+*          all together by matarena_reset(). the blocks are stacked and the
+*          released blocks on the top of the stack are reused.
+*          if the arena is full, the matrices are allocated in the heap and
+*          the arena is enlarged to the peak demand by matarena_reset()
+*-----------------------------------------------------------------------------*/
+extern matarena_t *matarena(matarena_t *arena)
+{
+    matarena_t *prev=matarena_;
+    matarena_=arena;
+    return prev;
+}
+/* reset matrix arena ----------------------------------------------------------
+* release all matrices allocated in the arena
+* args   : matarena_t *arena IO  matrix arena
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void matarena_reset(matarena_t *arena)
+{
+    size_t size;
+    
+    if (arena->peak>arena->size) {
+        size=arena->peak+arena->peak/4;
+        free(arena->buff);
+        if (!(arena->buff=(char *)malloc(size))) size=0;
+        arena->size=size;
+        trace(4,"matarena_reset: size=%d\n",(int)size);
+    }
+    arena->used=arena->peak=arena->ovf=0;
+    arena->top=(size_t)-1;
+}
+/* free matrix arena -----------------------------------------------------------
+* free memory of matrix arena
+* args   : matarena_t *arena IO  matrix arena
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void matarena_free(matarena_t *arena)
+{
+    free(arena->buff);
+    arena->buff=NULL;
+    arena->size=arena->used=arena->peak=arena->ovf=0;
+    arena->top=(size_t)-1;
+}
+/* allocate block in matrix arena of thread ----------------------------------*/
+static void *arenaalloc(size_t size)
+{
+    matarena_t *a=matarena_;
+    size_t *h;
+    
+    size=(size+15)/16*16;
+    
+    if (!a->buff||a->used+16+size>a->size) {
+        a->ovf+=16+size;
+        if (a->used+a->ovf>a->peak) a->peak=a->used+a->ovf;
+        return NULL;
+    }
+    h=(size_t *)(a->buff+a->used);
+    h[0]=a->top; /* previous block */
+    h[1]=size;   /* block size (bit0: released) */
+    a->top=a->used;
+    a->used+=16+size;
+    if (a->used+a->ovf>a->peak) a->peak=a->used+a->ovf;
+    return (void *)(h+2);
+}
+/* free matrix -----------------------------------------------------------------
+* free memory of matrix allocated by mat(),imat(),zeros() or eye()
+* args   : void   *p        I   matrix pointer (NULL: no operation)
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void matfree(void *p)
+{
+    matarena_t *a=matarena_;
+    size_t *h;
+    
+    if (!a||!a->buff||(char *)p<a->buff||(char *)p>=a->buff+a->size) {
+        free(p);
+        return;
+    }
+    h=(size_t *)p-2;
+    h[1]|=1;
+    
+    /* pop released blocks on the top */
+    while (a->top!=(size_t)-1&&(((size_t *)(a->buff+a->top))[1]&1)) {
+        a->used=a->top;
+        a->top=((size_t *)(a->buff+a->top))[0];
+    }
+}
 /* new matrix ------------------------------------------------------------------
 * allocate memory of matrix 
 * args   : int    n,m       I   number of rows and columns of matrix
 * return : matrix pointer (if n<=0 or m<=0, return NULL)
+* notes  : allocated in the matrix arena of the thread if set by matarena()
 *-----------------------------------------------------------------------------*/
 extern double *mat(int n, int m)
 {
     double *p;
     
     if (n<=0||m<=0) return NULL;
+    if (matarena_&&(p=(double *)arenaalloc(sizeof(double)*n*m))) return p;
     if (!(p=(double *)malloc(sizeof(double)*n*m))) {
         fatalerr("matrix memory allocation error: n=%d,m=%d\n",n,m);
     }
@@ -867,6 +969,7 @@ extern int *imat(int n, int m)
     int *p;
     
     if (n<=0||m<=0) return NULL;
+    if (matarena_&&(p=(int *)arenaalloc(sizeof(int)*n*m))) return p;
     if (!(p=(int *)malloc(sizeof(int)*n*m))) {
         fatalerr("integer matrix memory allocation error: n=%d,m=%d\n",n,m);
     }
@@ -885,6 +988,10 @@ extern double *zeros(int n, int m)
     if ((p=mat(n,m))) for (n=n*m-1;n>=0;n--) p[n]=0.0;
 #else
     if (n<=0||m<=0) return NULL;
+    if (matarena_&&(p=(double *)arenaalloc(sizeof(double)*n*m))) {
+        memset(p,0,sizeof(double)*n*m);
+        return p;
+    }
     if (!(p=(double *)calloc(sizeof(double),n*m))) {
         fatalerr("matrix memory allocation error: n=%d,m=%d\n",n,m);
     }
@@ -1001,7 +1108,7 @@ extern int matinv(double *A, int n)
     work=mat(lwork,1);
     dgetrf_(&n,&n,A,&n,ipiv,&info);
     if (!info) dgetri_(&n,A,&n,ipiv,work,&lwork,&info);
-    free(ipiv); free(work);
+    matfree(ipiv); matfree(work);
     return info;
 }
 /* solve linear equation -------------------------------------------------------
@@ -1025,104 +1132,370 @@ extern int solve(const char *tr, const double *A, const double *Y, int n,
     matcpy(X,Y,n,m);
     dgetrf_(&n,&n,B,&n,ipiv,&info);
     if (!info) dgetrs_((char *)tr,&n,&m,B,&n,ipiv,X,&n,&info);
-    free(ipiv); free(B); 
+    matfree(ipiv); matfree(B); 
     return info;
 }
+/* set matrix library (linked LAPACK/BLAS or MKL is always used) -------------*/
+extern int setmatlib(int lib)
+{
+    return lib==MATLIB_SYS;
+}
 
 #else /* without LAPACK/BLAS or MKL */
 
-/* multiply matrix ˷ C = (a * A * B) + (b * C) -----------------------------------------------------------
-    trʾ˷ʽN޸ĶTתãԴƣNTA޸ĶBת
-    AnmУBmkУCnk
-    a(alpha)ǰ˵ĳb(beta)Cǰ˵ĳ*/
-extern void matmul(const char *tr, int n, int k, int m, double alpha,
-                   const double *A, const double *B, double beta, double *C)
+/* system BLAS/LAPACK loaded at runtime by setmatlib() -----------------------*/
+typedef void dgemm_t(char *, char *, int *, int *, int *, double *, double *,
+                     int *, double *, int *, double *, double *, int *);
+typedef void dgetrf_t(int *, int *, double *, int *, int *, int *);
+typedef void dgetri_t(int *, double *, int *, int *, double *, int *, int *);
+
+static dgemm_t  *lib_dgemm =NULL;       /* dgemm of system library */
+static dgetrf_t *lib_dgetrf=NULL;       /* dgetrf of system library */
+static dgetri_t *lib_dgetri=NULL;       /* dgetri of system library */
+
+static const char *matlibs[]={          /* system library names */
+#ifdef WIN32
+    "libopenblas.dll","mkl_rt.dll","liblapack.dll",
+#else
+    "libopenblas.so.0","libopenblas.so","libmkl_rt.so","liblapack.so.3",
+    "liblapack.so",
+#endif
+    NULL
+};
+/* matrix kernel parameters --------------------------------------------------*/
+#define MATMR       8                   /* rows of register block */
+#define MATNR       4                   /* columns of register block */
+#define MATKC       256                 /* inner size of cache block */
+#define MATMC       96                  /* rows of cache block */
+#define MATNC       1024                /* columns of cache block */
+#define MATNB       32                  /* block size of LU/triangular solve */
+#define MATMINBLK   4096.0              /* min n*k*m of blocked multiply */
+#define MATMINLIB   32768.0             /* min n*k*m of system library */
+#define MATMINLIBN  64                  /* min size of system library inverse */
+
+/* set matrix library ----------------------------------------------------------
+* select the library of matrix multiplication and inversion
+* args   : int    lib       I   matrix library (MATLIB_INT:internal,
+*                               MATLIB_SYS:system BLAS/LAPACK)
+* return : status (1:ok,0:system library not found)
+* notes  : the system library (OpenBLAS, MKL or reference LAPACK) is loaded at
+*          runtime and used for the matrices larger than MATMINLIB operations.
+*          the internal kernels are used if no library is found.
+*          not thread-safe: call it before starting the processing threads
+*-----------------------------------------------------------------------------*/
+extern int setmatlib(int lib)
+{
+#ifdef WIN32
+    HMODULE h=NULL;
+#else
+    void *h=NULL;
+#endif
+    int i;
+
+    trace(3,"setmatlib: lib=%d\n",lib);
+
+    if (lib!=MATLIB_SYS) {
+        lib_dgemm=NULL; lib_dgetrf=NULL; lib_dgetri=NULL;
+        return 1;
+    }
+    if (lib_dgemm) return 1;
+
+    for (i=0;matlibs[i];i++) {
+#ifdef WIN32
+        if (!(h=LoadLibraryA(matlibs[i]))) continue;
+        lib_dgemm =(dgemm_t  *)GetProcAddress(h,"dgemm_");
+        lib_dgetrf=(dgetrf_t *)GetProcAddress(h,"dgetrf_");
+        lib_dgetri=(dgetri_t *)GetProcAddress(h,"dgetri_");
+#else
+        if (!(h=dlopen(matlibs[i],RTLD_NOW|RTLD_LOCAL))) continue;
+        lib_dgemm =(dgemm_t  *)dlsym(h,"dgemm_");
+        lib_dgetrf=(dgetrf_t *)dlsym(h,"dgetrf_");
+        lib_dgetri=(dgetri_t *)dlsym(h,"dgetri_");
+#endif
+        if (lib_dgemm&&lib_dgetrf&&lib_dgetri) {
+            trace(2,"matrix library: %s\n",matlibs[i]);
+            return 1;
+        }
+        lib_dgemm=NULL; lib_dgetrf=NULL; lib_dgetri=NULL;
+#ifdef WIN32
+        FreeLibrary(h);
+#else
+        dlclose(h);
+#endif
+    }
+    trace(2,"no system matrix library\n");
+    return 0;
+}
+/* multiply matrix (small) ---------------------------------------------------*/
+static void matmuls(int ta, int tb, int n, int k, int m, double alpha,
+                    const double *A, int lda, const double *B, int ldb,
+                    double beta, double *C)
 {
     double d;
-    int i,j,x,f=tr[0]=='N'?(tr[1]=='N'?1:2):(tr[1]=='N'?3:4);
-    
-    for (i=0;i<n;i++) 
-        for (j=0;j<k;j++) 
-        {
-            d=0.0;
-            switch (f) {
-                // CijеԪؼ
-                // עűΪ׼ǰΪ֮ǰԪأУ֮+Ԫڸеţкţ
-                case 1: for (x=0;x<m;x++) d+=A[i+x*n]*B[x+j*m]; break;
-                case 2: for (x=0;x<m;x++) d+=A[i+x*n]*B[j+x*k]; break;
-                case 3: for (x=0;x<m;x++) d+=A[x+i*m]*B[x+j*m]; break;
-                case 4: for (x=0;x<m;x++) d+=A[x+i*m]*B[j+x*k]; break;
+    int i,j,x,ai=ta?lda:1,ax=ta?1:lda,bx=tb?ldb:1,bj=tb?1:ldb;
+
+    for (i=0;i<n;i++) for (j=0;j<k;j++) {
+        for (x=0,d=0.0;x<m;x++) d+=A[i*ai+x*ax]*B[x*bx+j*bj];
+        if (beta==0.0) C[i+j*n]=alpha*d; else C[i+j*n]=alpha*d+beta*C[i+j*n];
+    }
+}
+/* pack block of matrix into strips ------------------------------------------
+* pack rows r0..r0+nr-1 and columns c0..c0+nc-1 of op(A) (op(A)=A or A') into
+* strips of w rows, each strip is stored as nc columns of w (zero padded)
+*-----------------------------------------------------------------------------*/
+static void matpack(int tr, const double *A, int lda, int r0, int nr, int c0,
+                    int nc, int w, double *buff)
+{
+    const double *p;
+    int i,j,k,n;
+
+    for (i=0;i<nr;i+=w) {
+        n=nr-i<w?nr-i:w;
+        for (j=0;j<nc;j++,buff+=w) {
+            if (tr) {
+                p=A+(c0+j)+(r0+i)*lda;
+                for (k=0;k<n;k++) buff[k]=p[k*lda];
+            }
+            else {
+                p=A+(r0+i)+(c0+j)*lda;
+                for (k=0;k<n;k++) buff[k]=p[k];
             }
-            if (beta==0.0) 
-                C[i+j*n]=alpha*d; 
-            else 
-                C[i+j*n]=alpha*d+beta*C[i+j*n];
+            for (;k<w;k++) buff[k]=0.0;
         }
+    }
 }
-/* LU decomposition ----------------------------------------------------------*/
-static int ludcmp(double *A, int n, int *indx, double *d)
+/* register block kernel (c=a*b', a:MATMR x kc, b:MATNR x kc packed) ---------*/
+#if defined(__AVX2__)&&defined(__FMA__)
+static void matkern(int kc, const double *a, const double *b, double *c)
 {
-    double big,s,tmp,*vv=mat(n,1);
-    int i,imax=0,j,k;
-    
-    *d=1.0;
-    for (i=0;i<n;i++) {
-        big=0.0; for (j=0;j<n;j++) if ((tmp=fabs(A[i+j*n]))>big) big=tmp;
-        if (big>0.0) vv[i]=1.0/big; else {free(vv); return -1;}
+    __m256d a0,a1,bj,c00,c01,c10,c11,c20,c21,c30,c31;
+    int p;
+
+    c00=c01=c10=c11=c20=c21=c30=c31=_mm256_setzero_pd();
+
+    for (p=0;p<kc;p++,a+=MATMR,b+=MATNR) {
+        a0=_mm256_loadu_pd(a);
+        a1=_mm256_loadu_pd(a+4);
+        bj=_mm256_broadcast_sd(b  ); c00=_mm256_fmadd_pd(a0,bj,c00);
+                                     c01=_mm256_fmadd_pd(a1,bj,c01);
+        bj=_mm256_broadcast_sd(b+1); c10=_mm256_fmadd_pd(a0,bj,c10);
+                                     c11=_mm256_fmadd_pd(a1,bj,c11);
+        bj=_mm256_broadcast_sd(b+2); c20=_mm256_fmadd_pd(a0,bj,c20);
+                                     c21=_mm256_fmadd_pd(a1,bj,c21);
+        bj=_mm256_broadcast_sd(b+3); c30=_mm256_fmadd_pd(a0,bj,c30);
+                                     c31=_mm256_fmadd_pd(a1,bj,c31);
     }
-    for (j=0;j<n;j++) {
-        for (i=0;i<j;i++) {
-            s=A[i+j*n]; for (k=0;k<i;k++) s-=A[i+k*n]*A[k+j*n]; A[i+j*n]=s;
+    _mm256_storeu_pd(c   ,c00); _mm256_storeu_pd(c+ 4,c01);
+    _mm256_storeu_pd(c+ 8,c10); _mm256_storeu_pd(c+12,c11);
+    _mm256_storeu_pd(c+16,c20); _mm256_storeu_pd(c+20,c21);
+    _mm256_storeu_pd(c+24,c30); _mm256_storeu_pd(c+28,c31);
+}
+#else
+static void matkern(int kc, const double *a, const double *b, double *c)
+{
+    int i,j,p;
+
+    for (i=0;i<MATMR*MATNR;i++) c[i]=0.0;
+
+    for (p=0;p<kc;p++,a+=MATMR,b+=MATNR) {
+        for (j=0;j<MATNR;j++) for (i=0;i<MATMR;i++) {
+            c[i+j*MATMR]+=a[i]*b[j];
         }
-        big=0.0;
-        for (i=j;i<n;i++) {
-            s=A[i+j*n]; for (k=0;k<j;k++) s-=A[i+k*n]*A[k+j*n]; A[i+j*n]=s;
-            if ((tmp=vv[i]*fabs(s))>=big) {big=tmp; imax=i;}
+    }
+}
+#endif
+/* multiply matrix (blocked) -------------------------------------------------
+* C=alpha*op(A)*op(B)+beta*C with cache blocks of packed A and B and register
+* blocks of MATMR x MATNR. if sym=1, C=alpha*A*A' or alpha*A'*A (beta=0) is
+* computed only in the lower triangle and copied to the upper one
+*-----------------------------------------------------------------------------*/
+static void matgemm(int ta, int tb, int n, int k, int m, double alpha,
+                    const double *A, int lda, const double *B, int ldb,
+                    double beta, double *C, int ldc, int sym)
+{
+    double *ap,*bp,c[MATMR*MATNR],b,*q;
+    int i,j,ic,jc,pc,ir,jr,mc,nc,kc,mr,nr;
+
+    kc=m<MATKC?m:MATKC;
+    mc=n<MATMC?n:MATMC;
+    nc=k<MATNC?k:MATNC;
+    ap=mat((mc+MATMR-1)/MATMR*MATMR,kc);
+    bp=mat((nc+MATNR-1)/MATNR*MATNR,kc);
+
+    for (jc=0;jc<k;jc+=MATNC) {
+        nc=k-jc<MATNC?k-jc:MATNC;
+
+        for (pc=0;pc<m;pc+=MATKC) {
+            kc=m-pc<MATKC?m-pc:MATKC;
+            b=pc==0?beta:1.0;
+            matpack(!tb,B,ldb,jc,nc,pc,kc,MATNR,bp);
+
+            for (ic=0;ic<n;ic+=MATMC) {
+                mc=n-ic<MATMC?n-ic:MATMC;
+                if (sym&&ic+mc<=jc) continue;
+                matpack(ta,A,lda,ic,mc,pc,kc,MATMR,ap);
+
+                for (jr=0;jr<nc;jr+=MATNR) {
+                    nr=nc-jr<MATNR?nc-jr:MATNR;
+
+                    for (ir=0;ir<mc;ir+=MATMR) {
+                        mr=mc-ir<MATMR?mc-ir:MATMR;
+                        if (sym&&ic+ir+mr<=jc+jr) continue;
+
+                        matkern(kc,ap+ir*kc,bp+jr*kc,c);
+
+                        q=C+(ic+ir)+(jc+jr)*ldc;
+                        for (j=0;j<nr;j++) for (i=0;i<mr;i++) {
+                            if (b==0.0) q[i+j*ldc]=alpha*c[i+j*MATMR];
+                            else q[i+j*ldc]=alpha*c[i+j*MATMR]+b*q[i+j*ldc];
+                        }
+                    }
+                }
+            }
         }
-        if (j!=imax) {
-            for (k=0;k<n;k++) {
-                tmp=A[imax+k*n]; A[imax+k*n]=A[j+k*n]; A[j+k*n]=tmp;
+    }
+    if (sym) {
+        for (j=1;j<k;j++) for (i=0;i<j;i++) C[i+j*ldc]=C[j+i*ldc];
+    }
+    matfree(ap); matfree(bp);
+}
+/* multiply matrix ˷ C = (a * A * B) + (b * C) -----------------------------------------------------------
+    trʾ˷ʽN޸ĶTתãԴƣNTA޸ĶBת
+    AnmУBmkУCnk
+    a(alpha)ǰ˵ĳb(beta)Cǰ˵ĳ
+    small matrices are multiplied directly, larger ones by the blocked kernel
+    or the system library selected by setmatlib() */
+extern void matmul(const char *tr, int n, int k, int m, double alpha,
+                   const double *A, const double *B, double beta, double *C)
+{
+    double ops=(double)n*k*m;
+    int ta=tr[0]=='T',tb=tr[1]=='T',lda=ta?m:n,ldb=tb?k:m;
+
+    if (lib_dgemm&&ops>=MATMINLIB) {
+        lib_dgemm((char *)tr,(char *)tr+1,&n,&k,&m,&alpha,(double *)A,&lda,
+                  (double *)B,&ldb,&beta,C,&n);
+    }
+    else if (ops<MATMINBLK) {
+        matmuls(ta,tb,n,k,m,alpha,A,lda,B,ldb,beta,C);
+    }
+    else {
+        matgemm(ta,tb,n,k,m,alpha,A,lda,B,ldb,beta,C,n,
+                A==B&&n==k&&ta!=tb&&beta==0.0);
+    }
+}
+/* solve triangular equation (B=A^-1*B) --------------------------------------
+* A: unit lower triangular (upper=0) or upper triangular (upper=1) (n x n),
+* B: n x m. solved by blocks of MATNB rows, the remaining rows are updated by
+* the blocked multiply
+*-----------------------------------------------------------------------------*/
+static void mattrsm(int upper, int n, int m, const double *A, int lda,
+                    double *B, int ldb)
+{
+    const double *a;
+    double s,*b;
+    int i,j,r,q,ib;
+
+    if (!upper) {
+        for (i=0;i<n;i+=MATNB) {
+            ib=n-i<MATNB?n-i:MATNB;
+            for (j=0;j<m;j++) {
+                b=B+j*ldb;
+                for (q=i;q<i+ib;q++) {
+                    if ((s=b[q])==0.0) continue;
+                    for (r=q+1,a=A+q*lda;r<i+ib;r++) b[r]-=a[r]*s;
+                }
             }
-            *d=-(*d); vv[imax]=vv[j];
+            if (i+ib>=n) break;
+            matgemm(0,0,n-i-ib,m,ib,-1.0,A+i+ib+i*lda,lda,B+i,ldb,1.0,B+i+ib,
+                    ldb,0);
         }
-        indx[j]=imax;
-        if (A[j+j*n]==0.0) {free(vv); return -1;}
-        if (j!=n-1) {
-            tmp=1.0/A[j+j*n]; for (i=j+1;i<n;i++) A[i+j*n]*=tmp;
+    }
+    else {
+        for (i=(n-1)/MATNB*MATNB;i>=0;i-=MATNB) {
+            ib=n-i<MATNB?n-i:MATNB;
+            for (j=0;j<m;j++) {
+                b=B+j*ldb;
+                for (q=i+ib-1;q>=i;q--) {
+                    if ((s=b[q]/=A[q+q*lda])==0.0) continue;
+                    for (r=i,a=A+q*lda;r<q;r++) b[r]-=a[r]*s;
+                }
+            }
+            if (i==0) break;
+            matgemm(0,0,i,m,ib,-1.0,A+i*lda,lda,B+i,ldb,1.0,B,ldb,0);
         }
     }
-    free(vv);
-    return 0;
 }
-/* LU back-substitution ------------------------------------------------------*/
-static void lubksb(const double *A, int n, const int *indx, double *b)
+/* LU decomposition (P*A=L*U) ------------------------------------------------
+* partial pivoting, the panels of MATNB columns are factorized directly and the
+* trailing matrix is updated by the blocked multiply
+*-----------------------------------------------------------------------------*/
+static int matlu(double *A, int n, int *ipiv)
 {
-    double s;
-    int i,ii=-1,ip,j;
-    
-    for (i=0;i<n;i++) {
-        ip=indx[i]; s=b[ip]; b[ip]=b[i];
-        if (ii>=0) for (j=ii;j<i;j++) s-=A[i+j*n]*b[j]; else if (s) ii=i;
-        b[i]=s;
-    }
-    for (i=n-1;i>=0;i--) {
-        s=b[i]; for (j=i+1;j<n;j++) s-=A[i+j*n]*b[j]; b[i]=s/A[i+i*n];
+    double big,tmp;
+    int i,j,k,jj,jb,imax;
+
+    for (j=0;j<n;j+=MATNB) {
+        jb=n-j<MATNB?n-j:MATNB;
+
+        for (jj=j;jj<j+jb;jj++) {
+            for (i=imax=jj,big=0.0;i<n;i++) {
+                if ((tmp=fabs(A[i+jj*n]))>big) {big=tmp; imax=i;}
+            }
+            if (big==0.0) return -1;
+            ipiv[jj]=imax;
+            if (imax!=jj) {
+                for (k=0;k<n;k++) {
+                    tmp=A[imax+k*n]; A[imax+k*n]=A[jj+k*n]; A[jj+k*n]=tmp;
+                }
+            }
+            tmp=1.0/A[jj+jj*n];
+            for (i=jj+1;i<n;i++) A[i+jj*n]*=tmp;
+
+            for (k=jj+1;k<j+jb;k++) {
+                if ((tmp=A[jj+k*n])==0.0) continue;
+                for (i=jj+1;i<n;i++) A[i+k*n]-=A[i+jj*n]*tmp;
+            }
+        }
+        if (j+jb>=n) break;
+
+        /* U12=L11^-1*A12, A22=A22-L21*U12 */
+        mattrsm(0,jb,n-j-jb,A+j+j*n,n,A+j+(j+jb)*n,n);
+        matgemm(0,0,n-j-jb,n-j-jb,jb,-1.0,A+j+jb+j*n,n,A+j+(j+jb)*n,n,1.0,
+                A+j+jb+(j+jb)*n,n,0);
     }
+    return 0;
 }
 /* inverse of matrix ---------------------------------------------------------*/
 extern int matinv(double *A, int n)
 {
-    double d,*B;
-    int i,j,*indx;
-    
-    indx=imat(n,1); B=mat(n,n); matcpy(B,A,n,n);
-    if (ludcmp(B,n,indx,&d)) {free(indx); free(B); return -1;}
-    for (j=0;j<n;j++) {
-        for (i=0;i<n;i++) A[i+j*n]=0.0;
-        A[j+j*n]=1.0;
-        lubksb(B,n,indx,A+j*n);
+    double *B,*work,tmp;
+    int i,j,info,lwork,*ipiv;
+
+    ipiv=imat(n,1);
+
+    if (lib_dgetrf&&n>=MATMINLIBN) {
+        lwork=n*64;
+        work=mat(lwork,1);
+        lib_dgetrf(&n,&n,A,&n,ipiv,&info);
+        if (!info) lib_dgetri(&n,A,&n,ipiv,work,&lwork,&info);
+        matfree(ipiv); matfree(work);
+        return info;
     }
-    free(indx); free(B);
+    B=mat(n,n); matcpy(B,A,n,n);
+    if (matlu(B,n,ipiv)) {matfree(ipiv); matfree(B); return -1;}
+
+    /* A^-1=U^-1*L^-1*P */
+    for (i=0;i<n*n;i++) A[i]=0.0;
+    for (i=0;i<n;i++) A[i+i*n]=1.0;
+    for (i=0;i<n;i++) {
+        if (ipiv[i]==i) continue;
+        for (j=0;j<n;j++) {
+            tmp=A[i+j*n]; A[i+j*n]=A[ipiv[i]+j*n]; A[ipiv[i]+j*n]=tmp;
+        }
+    }
+    mattrsm(0,n,n,B,n,A,n);
+    mattrsm(1,n,n,B,n,A,n);
+    matfree(ipiv); matfree(B);
     return 0;
 }
 /* solve linear equation -----------------------------------------------------*/
@@ -1134,7 +1507,7 @@ extern int solve(const char *tr, const double *A, const double *Y, int n,
     
     matcpy(B,A,n,n);
     if (!(info=matinv(B,n))) matmul(tr[0]=='N'?"NN":"TN",n,m,n,1.0,B,Y,0.0,X);
-    free(B);
+    matfree(B);
     return info;
 }
 #endif
@@ -1163,7 +1536,263 @@ extern int lsq(const double *A, const double *y, int n, int m, double *x,
     matmul("NT",n,n,m,1.0,A,A,0.0,Q);  /* Q=A*A' */
 	for (i = 0; i<3; i++) Q[i + i*n] += coordfixedvalue*coordfixedvalue;
     if (!(info=matinv(Q,n))) matmul("NN",n,1,n,1.0,Q,Ay,0.0,x); /* x=Q^-1*Ay */
-    free(Ay);
+    matfree(Ay);
+    return info;
+}
+/* solve normal equation by cholesky decomposition (fixed size) --------------*/
+template <int N>
+static int lsqnrm_(const double *A, const double *b, double *x, double *Q)
+{
+    double L[N*N],di[N],y[N],s;
+    int i,j,k;
+    
+    /* A=L*L' */
+    for (j=0;j<N;j++) {
+        for (s=A[j+j*N],k=0;k<j;k++) s-=L[j+k*N]*L[j+k*N];
+        if (s<=0.0) return -1;
+        L[j+j*N]=sqrt(s); di[j]=1.0/L[j+j*N];
+        for (i=j+1;i<N;i++) {
+            for (s=A[i+j*N],k=0;k<j;k++) s-=L[i+k*N]*L[j+k*N];
+            L[i+j*N]=s*di[j];
+        }
+    }
+    /* x=L'^-1*L^-1*b */
+    for (i=0;i<N;i++) {
+        for (s=b[i],k=0;k<i;k++) s-=L[i+k*N]*y[k];
+        y[i]=s*di[i];
+    }
+    for (i=N-1;i>=0;i--) {
+        for (s=y[i],k=i+1;k<N;k++) s-=L[k+i*N]*x[k];
+        x[i]=s*di[i];
+    }
+    if (!Q) return 0;
+    
+    /* Q=L'^-1*L^-1 (L^-1 overwrites L) */
+    for (j=0;j<N;j++) {
+        L[j+j*N]=di[j];
+        for (i=j+1;i<N;i++) {
+            for (s=0.0,k=j;k<i;k++) s-=L[i+k*N]*L[k+j*N];
+            L[i+j*N]=s*di[i];
+        }
+    }
+    for (j=0;j<N;j++) for (i=j;i<N;i++) {
+        for (s=0.0,k=i;k<N;k++) s+=L[k+i*N]*L[k+j*N];
+        Q[i+j*N]=Q[j+i*N]=s;
+    }
+    return 0;
+}
+/* least square estimation by normal equation ----------------------------------
+* solve normal equation of least square estimation (x=N^-1*b) accumulated by
+* the caller without the design matrix
+* args   : double *A        I   normal matrix N=H'*W*H (n x n)
+*          double *b        I   normal vector b=H'*W*y (n x 1)
+*          int    n         I   number of parameters
+*          double *x        O   estmated parameters (n x 1)
+*          double *Q        O   esimated parameters covariance matrix (n x n)
+*                               (NULL: not output)
+* return : status (0:ok,0>:error)
+* notes  : the lower part of A is used. the solver is unrolled by the compiler
+*          for the parameter counts of the point positioning (4-10) and the
+*          working memory is on the stack, otherwise matinv() is used
+*-----------------------------------------------------------------------------*/
+extern int lsqnrm(const double *A, const double *b, int n, double *x,
+                  double *Q)
+{
+    double *B;
+    int info;
+    
+    switch (n) {
+        case  4: return lsqnrm_< 4>(A,b,x,Q);
+        case  5: return lsqnrm_< 5>(A,b,x,Q);
+        case  6: return lsqnrm_< 6>(A,b,x,Q);
+        case  7: return lsqnrm_< 7>(A,b,x,Q);
+        case  8: return lsqnrm_< 8>(A,b,x,Q);
+        case  9: return lsqnrm_< 9>(A,b,x,Q);
+        case 10: return lsqnrm_<10>(A,b,x,Q);
+    }
+    B=mat(n,n);
+    matcpy(B,A,n,n);
+    if (!(info=matinv(B,n))) {
+        matmul("NN",n,1,n,1.0,B,b,0.0,x);
+        if (Q) matcpy(Q,B,n,n);
+    }
+    matfree(B);
+    return info;
+}
+/* filter update algorithm --------------------------------------------------*/
+static int filtalg=FILTALG_STD;
+
+/* set filter update algorithm -------------------------------------------------
+* select the measurement update algorithm of filter()
+* args   : int    alg       I   algorithm (FILTALG_STD:batch with LU inverse,
+*                               FILTALG_CHOL:Cholesky gain and Joseph form,
+*                               FILTALG_SEQ:sequential scalar updates)
+* return : none
+* notes  : not thread-safe: call it before starting the processing threads
+*-----------------------------------------------------------------------------*/
+extern void setfiltalg(int alg)
+{
+    trace(3,"setfiltalg: alg=%d\n",alg);
+    
+    filtalg=alg==FILTALG_CHOL||alg==FILTALG_SEQ?alg:FILTALG_STD;
+}
+/* cholesky decomposition (A=L*L', L overwrites lower part of A) ------------*/
+static int matchol(double *A, int n)
+{
+    double d,*a;
+    int i,j,l;
+    
+    for (j=0;j<n;j++) {
+        if ((d=A[j+j*n])<=0.0) return -1;
+        A[j+j*n]=d=sqrt(d);
+        for (a=A+j*n,i=j+1;i<n;i++) a[i]/=d;
+        for (l=j+1;l<n;l++) {
+            if ((d=a[l])==0.0) continue;
+            for (i=l;i<n;i++) A[i+l*n]-=a[i]*d;
+        }
+    }
+    return 0;
+}
+/* solve by cholesky factor (B=B*L'^-1 or B=B*L^-1, B: k x m) ----------------*/
+static void cholsolve(int tr, const double *L, int m, double *B, int k)
+{
+    double d;
+    int a,i,j;
+    
+    if (tr) { /* B*L'=B0 */
+        for (j=0;j<m;j++) {
+            for (i=0;i<j;i++) {
+                if ((d=L[j+i*m])==0.0) continue;
+                for (a=0;a<k;a++) B[a+j*k]-=B[a+i*k]*d;
+            }
+            for (d=1.0/L[j+j*m],a=0;a<k;a++) B[a+j*k]*=d;
+        }
+    }
+    else { /* B*L=B0 */
+        for (j=m-1;j>=0;j--) {
+            for (i=j+1;i<m;i++) {
+                if ((d=L[i+j*m])==0.0) continue;
+                for (a=0;a<k;a++) B[a+j*k]-=B[a+i*k]*d;
+            }
+            for (d=1.0/L[j+j*m],a=0;a<k;a++) B[a+j*k]*=d;
+        }
+    }
+}
+/* batch update with LU inverse of innovation covariance ---------------------*/
+static int filter_std(const double *F, double *Q, const double *v, int k,
+                      int m, double *dx, double *P_)
+{
+    double *K=mat(k,m),*p,fb;
+    int a,b,j,info;
+    
+    if (!(info=matinv(Q,m))) {
+        matmul("NN",k,m,m,1.0,F,Q,0.0,K);   /* K=P*H*Q^-1 */
+        matmul("NN",k,1,m,1.0,K,v,0.0,dx);  /* dx=K*v */
+        
+        /* Pp=(I-K*H')*P=P-K*F' by symmetric rank-m update of lower part */
+        for (j=0;j<m;j++) for (b=0;b<k;b++) {
+            if ((fb=F[b+j*k])==0.0) continue;
+            for (p=P_+b*k,a=b;a<k;a++) p[a]-=K[a+j*k]*fb;
+        }
+        for (b=0;b<k;b++) for (a=b+1;a<k;a++) P_[b+a*k]=P_[a+b*k];
+    }
+    matfree(K);
+    return info;
+}
+/* batch update with cholesky gain and joseph form ---------------------------
+* Q=L*L', K=F*L'^-1*L^-1, Pp=(I-K*H')*P*(I-K*H')'+K*R*K'
+*-----------------------------------------------------------------------------*/
+static int filter_chol(const int *ix, const int *nz, const int *jp,
+                       const double *H, const double *F, double *Q,
+                       const double *v, const double *R, int k, int n, int m,
+                       double *dx, double *P_)
+{
+    double *K,*M,*N,*f,*p;
+    const double *h;
+    int a,b,j,l;
+    
+    if (matchol(Q,m)) return -1;
+    
+    K=mat(k,m); M=mat(k,k); N=zeros(k,m);
+    matcpy(K,F,k,m);
+    cholsolve(1,Q,m,K,k);
+    cholsolve(0,Q,m,K,k);
+    matmul("NN",k,1,m,1.0,K,v,0.0,dx);
+    
+    /* M=(I-K*H')*P, N=M*H-K*R */
+    matcpy(M,P_,k,k);
+    matmul("NT",k,k,m,-1.0,K,F,1.0,M);
+    for (j=0;j<m;j++) {
+        for (f=N+j*k,l=jp[j];l<jp[j+1];l++) {
+            h=H+ix[nz[l]]+j*n;
+            for (p=M+nz[l]*k,a=0;a<k;a++) f[a]+=p[a]*(*h);
+        }
+    }
+    matmul("NN",k,m,m,-1.0,K,R,1.0,N);
+    
+    /* Pp=M-N*K' (symmetrized) */
+    matmul("NT",k,k,m,-1.0,N,K,1.0,M);
+    for (b=0;b<k;b++) for (a=b;a<k;a++) {
+        P_[a+b*k]=P_[b+a*k]=0.5*(M[a+b*k]+M[b+a*k]);
+    }
+    matfree(K); matfree(M); matfree(N);
+    return 0;
+}
+/* sequential scalar updates -------------------------------------------------
+* measurements are decorrelated by the cholesky factor of R if R is not
+* diagonal, then processed one by one with the innovations corrected by the
+* previous state updates
+*-----------------------------------------------------------------------------*/
+static int filter_seq(const int *ix, const double *H, const double *v,
+                      const double *R, int k, int n, int m, double *dx,
+                      double *P_)
+{
+    double *Hw,*vw,*L=NULL,*f,*h,*p,r,s,is,e;
+    int a,b,i,j,l,diag=1,info=0,*nz;
+    
+    for (j=0;j<m&&diag;j++) for (i=0;i<m;i++) {
+        if (i!=j&&R[i+j*m]!=0.0) {diag=0; break;}
+    }
+    Hw=mat(k,m); vw=mat(m,1); f=mat(k,1); nz=imat(k,1);
+    for (j=0;j<m;j++) for (a=0;a<k;a++) Hw[a+j*k]=H[ix[a]+j*n];
+    matcpy(vw,v,m,1);
+    
+    if (!diag) {
+        L=mat(m,m); matcpy(L,R,m,m);
+        if (matchol(L,m)) {
+            matfree(Hw); matfree(vw); matfree(f); matfree(nz); matfree(L);
+            return -1;
+        }
+        cholsolve(1,L,m,Hw,k); /* Hw=H*L'^-1, vw=L^-1*v */
+        cholsolve(1,L,m,vw,1);
+    }
+    for (a=0;a<k;a++) dx[a]=0.0;
+    
+    for (j=0;j<m;j++) {
+        h=Hw+j*k;
+        r=diag?R[j+j*m]:1.0;
+        
+        /* f=P*h, s=h'*P*h+r, e=v-h'*dx */
+        for (a=0;a<k;a++) f[a]=0.0;
+        for (b=l=0;b<k;b++) {
+            if (h[b]==0.0) continue;
+            nz[l++]=b;
+            for (p=P_+b*k,a=0;a<k;a++) f[a]+=p[a]*h[b];
+        }
+        for (s=r,e=vw[j],i=0;i<l;i++) {
+            s+=h[nz[i]]*f[nz[i]];
+            e-=h[nz[i]]*dx[nz[i]];
+        }
+        if (s<=0.0) {info=-1; break;}
+        
+        /* dx=dx+f/s*e, P=P-f*f'/s */
+        for (is=1.0/s,a=0;a<k;a++) dx[a]+=f[a]*is*e;
+        for (b=0;b<k;b++) {
+            if (f[b]==0.0) continue;
+            for (p=P_+b*k,a=0;a<k;a++) p[a]-=f[a]*f[b]*is;
+        }
+    }
+    matfree(Hw); matfree(vw); matfree(f); matfree(nz); matfree(L);
     return info;
 }
 /* kalman filter ---------------------------------------------------------------
@@ -1171,57 +1800,81 @@ extern int lsq(const double *A, const double *y, int n, int m, double *x,
 *
 *   K=P*H*(H'*P*H+R)^-1, xp=x+K*v, Pp=(I-K*H')*P
 *
-* args   : double *x        I   states vector (n x 1)
-*          double *P        I   covariance matrix of states (n x n)
+* args   : double *x        IO  states vector (n x 1)
+*          double *P        IO  covariance matrix of states (n x n)
 *          double *H        I   transpose of design matrix (n x m)
 *          double *v        I   innovation (measurement - model) (m x 1)
 *          double *R        I   covariance matrix of measurement error (m x m)
 *          int    n,m       I   number of states and measurements
-*          double *xp       O   states vector after update (n x 1)
-*          double *Pp       O   covariance matrix of states after update (n x n)
 * return : status (0:ok,<0:error)
 * notes  : matirix stored by column-major order (fortran convention)
 *          if state x[i]==0.0, not updates state x[i]/P[i+i*n]
+*          x and P are updated in place on the active states only. the
+*          products with H use its nonzero pattern, so the cost scales with
+*          the number of active states and nonzero elements of H
+*          the update algorithm is selected by setfiltalg():
+*          FILTALG_STD : Q=H'*P*H+R inverted by LU, Pp=P-K*(P*H)' by
+*                        symmetric rank-m update
+*          FILTALG_CHOL: Q factorized by cholesky (error if Q is not
+*                        positive-definite), Pp by joseph form
+*          FILTALG_SEQ : one measurement at a time (R decorrelated by its
+*                        cholesky factor if not diagonal), no m x m inverse
 *-----------------------------------------------------------------------------*/
-static int filter_(const double *x, const double *P, const double *H,
-                   const double *v, const double *R, int n, int m,
-                   double *xp, double *Pp)
+static int filter_(const int *ix, int k, const double *H, const double *v,
+                   const double *R, int n, int m, double *x, double *P)
 {
-    double *F=mat(n,m),*Q=mat(m,m),*K=mat(n,m),*I=eye(n);
-    int info;
+    double *P_=mat(k,k),*F=NULL,*Q=NULL,*dx=mat(k,1),*f,*p;
+    const double *h;
+    int a,b,i,j,l,info,*nz=NULL,*jp=NULL;
     
-    matcpy(Q,R,m,m);
-    matcpy(xp,x,n,1);
-    matmul("NN",n,m,n,1.0,P,H,0.0,F);       /* Q=H'*P*H+R */
-    matmul("TN",m,m,n,1.0,H,F,1.0,Q);
-    if (!(info=matinv(Q,m))) {
-        matmul("NN",n,m,m,1.0,F,Q,0.0,K);   /* K=P*H*Q^-1 */
-        matmul("NN",n,1,m,1.0,K,v,1.0,xp);  /* xp=x+K*v */
-        matmul("NT",n,n,m,-1.0,K,H,1.0,I);  /* Pp=(I-K*H')*P */
-        matmul("NN",n,n,n,1.0,I,P,0.0,Pp);
+    for (b=0;b<k;b++) for (a=0;a<k;a++) P_[a+b*k]=P[ix[a]+ix[b]*n];
+    
+    if (filtalg==FILTALG_SEQ) {
+        info=filter_seq(ix,H,v,R,k,n,m,dx,P_);
     }
-    free(F); free(Q); free(K); free(I);
+    else {
+        F=zeros(k,m); Q=mat(m,m); nz=imat(k*m+1,1); jp=imat(m+1,1);
+        
+        /* nonzero pattern of active rows of H by measurement */
+        for (j=l=0;j<m;j++) {
+            jp[j]=l;
+            for (a=0;a<k;a++) if (H[ix[a]+j*n]!=0.0) nz[l++]=a;
+        }
+        jp[m]=l;
+        
+        /* F=P*H, Q=H'*P*H+R */
+        for (j=0;j<m;j++) {
+            for (f=F+j*k,l=jp[j];l<jp[j+1];l++) {
+                h=H+ix[nz[l]]+j*n;
+                for (p=P_+nz[l]*k,a=0;a<k;a++) f[a]+=p[a]*(*h);
+            }
+        }
+        matcpy(Q,R,m,m);
+        for (i=0;i<m;i++) for (l=jp[i];l<jp[i+1];l++) {
+            for (j=0;j<m;j++) Q[i+j*m]+=H[ix[nz[l]]+i*n]*F[nz[l]+j*k];
+        }
+        if (filtalg==FILTALG_CHOL) {
+            info=filter_chol(ix,nz,jp,H,F,Q,v,R,k,n,m,dx,P_);
+        }
+        else {
+            info=filter_std(F,Q,v,k,m,dx,P_);
+        }
+    }
+    if (!info) {
+        for (a=0;a<k;a++) x[ix[a]]+=dx[a];
+        for (b=0;b<k;b++) for (a=0;a<k;a++) P[ix[a]+ix[b]*n]=P_[a+b*k];
+    }
+    matfree(P_); matfree(F); matfree(Q); matfree(dx); matfree(nz); matfree(jp);
     return info;
 }
 extern int filter(double *x, double *P, const double *H, const double *v,
                   const double *R, int n, int m)
 {
-    double *x_,*xp_,*P_,*Pp_,*H_;
-    int i,j,k,info,*ix;
+    int i,k,info,*ix;
     
     ix=imat(n,1); for (i=k=0;i<n;i++) if (x[i]!=0.0&&P[i+i*n]>0.0) ix[k++]=i;
-    x_=mat(k,1); xp_=mat(k,1); P_=mat(k,k); Pp_=mat(k,k); H_=mat(k,m);
-    for (i=0;i<k;i++) {
-        x_[i]=x[ix[i]];
-        for (j=0;j<k;j++) P_[i+j*k]=P[ix[i]+ix[j]*n];
-        for (j=0;j<m;j++) H_[i+j*k]=H[ix[i]+j*n];
-    }
-    info=filter_(x_,P_,H_,v,R,k,m,xp_,Pp_);
-    for (i=0;i<k;i++) {
-        x[ix[i]]=xp_[i];
-        for (j=0;j<k;j++) P[ix[i]+ix[j]*n]=Pp_[i+j*k];
-    }
-    free(ix); free(x_); free(xp_); free(P_); free(Pp_); free(H_);
+    info=filter_(ix,k,H,v,R,n,m,x,P);
+    matfree(ix);
     return info;
 }
 /* smoother --------------------------------------------------------------------
@@ -1256,7 +1909,7 @@ extern int smoother(const double *xf, const double *Qf, const double *xb,
             matmul("NN",n,1,n,1.0,Qs,xx,0.0,xs);
         }
     }
-    free(invQf); free(invQb); free(xx);
+    matfree(invQf); matfree(invQb); matfree(xx);
     return info;
 }
 /* print matrix ----------------------------------------------------------------
@@ -1709,7 +2362,7 @@ extern void time2str(gtime_t t, char *s, int n)
 *-----------------------------------------------------------------------------*/
 extern char *time_str(gtime_t t, int n)
 {
-    static char buff[64];
+    static THREADLOCAL char buff[64];
     time2str(t,buff,n);
     return buff;
 }
@@ -1783,6 +2436,102 @@ extern void sleepms(int ms)
     nanosleep(&ts,NULL);
 #endif
 }
+/* get number of cpus ----------------------------------------------------------
+* get number of online processors
+* args   : none
+* return : number of processors (1 if unknown)
+*-----------------------------------------------------------------------------*/
+extern int ncpuget(void)
+{
+#ifdef WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors>0?(int)info.dwNumberOfProcessors:1;
+#else
+    long n=sysconf(_SC_NPROCESSORS_ONLN);
+    return n>0?(int)n:1;
+#endif
+}
+/* parallel loop ---------------------------------------------------------------*/
+#define MAXPARTHREAD 64                 /* max number of worker threads */
+
+typedef struct {        /* parallel loop control type */
+    int n,next;         /* number of indices, next index */
+    parfunc_t *func;    /* loop body */
+    void *arg;          /* user argument */
+    lock_t lock;        /* lock flag */
+} parctl_t;
+
+#ifdef WIN32
+static DWORD WINAPI parthread(void *arg)
+#else
+static void *parthread(void *arg)
+#endif
+{
+    parctl_t *ctl=(parctl_t *)arg;
+    int i;
+    
+    for (;;) {
+        lock(&ctl->lock);
+        i=ctl->next++;
+        unlock(&ctl->lock);
+        if (i>=ctl->n) break;
+        ctl->func(i,ctl->arg);
+    }
+    return 0;
+}
+/* parallel loop ---------------------------------------------------------------
+* execute func(i,arg) for i=0..n-1 by worker threads
+* args   : int    n         I   number of loop indices
+*          int    nthread   I   number of threads (0:number of cpus,1:serial)
+*          parfunc_t *func  I   loop body function
+*          void   *arg      I   user argument passed to func
+* return : none
+* notes  : func must be reentrant and write only to outputs owned by index i.
+*          indices are assigned to threads dynamically, so the order of calls
+*          is not defined. the calling thread joins the work.
+*-----------------------------------------------------------------------------*/
+extern void parfor(int n, int nthread, parfunc_t *func, void *arg)
+{
+    thread_t thread[MAXPARTHREAD];
+    parctl_t ctl;
+    int i,nt=0;
+    
+    if (nthread<=0) nthread=ncpuget();
+    if (nthread>n) nthread=n;
+    if (nthread>MAXPARTHREAD) nthread=MAXPARTHREAD;
+    
+    if (nthread<=1) {
+        for (i=0;i<n;i++) func(i,arg);
+        return;
+    }
+    ctl.n=n; ctl.next=0; ctl.func=func; ctl.arg=arg;
+    initlock(&ctl.lock);
+    
+    for (i=0;i<nthread-1;i++) {
+#ifdef WIN32
+        if (!(thread[nt]=CreateThread(NULL,0,parthread,&ctl,0,NULL))) break;
+#else
+        if (pthread_create(thread+nt,NULL,parthread,&ctl)) break;
+#endif
+        nt++;
+    }
+    parthread(&ctl);
+    
+    for (i=0;i<nt;i++) {
+#ifdef WIN32
+        WaitForSingleObject(thread[i],INFINITE);
+        CloseHandle(thread[i]);
+#else
+        pthread_join(thread[i],NULL);
+#endif
+    }
+#ifdef WIN32
+    DeleteCriticalSection(&ctl.lock);
+#else
+    pthread_mutex_destroy(&ctl.lock);
+#endif
+}
 /* convert degree to deg-min-sec -----------------------------------------------
 * convert degree to degree-minute-second
 * args   : double deg       I   degree
@@ -2089,6 +2838,26 @@ static void nut_iau1980(double t, const double *f, double *dpsi, double *deps)
     *dpsi*=1E-4*AS2R; /* 0.1 mas -> rad */
     *deps*=1E-4*AS2R;
 }
+/* precession and nutation angles --------------------------------------------*/
+static void prenut_ang(double t, double *ang)
+{
+    double t2,t3,f[5];
+    
+    t2=t*t; t3=t2*t;
+    
+    /* astronomical arguments */
+    ast_args(t,f);
+    
+    /* iau 1976 precession */
+    ang[0]=(2306.2181*t+0.30188*t2+0.017998*t3)*AS2R; /* ze */
+    ang[1]=(2004.3109*t-0.42665*t2-0.041833*t3)*AS2R; /* th */
+    ang[2]=(2306.2181*t+1.09468*t2+0.018203*t3)*AS2R; /* z */
+    ang[3]=(84381.448-46.8150*t-0.00059*t2+0.001813*t3)*AS2R; /* eps */
+    
+    /* iau 1980 nutation */
+    nut_iau1980(t,f,ang+4,ang+5); /* dpsi,deps */
+    ang[6]=f[4];
+}
 /* eci to ecef transformation matrix -------------------------------------------
 * compute eci to ecef transformation matrix
 * args   : gtime_t tutc     I   time in utc
@@ -2098,64 +2867,95 @@ static void nut_iau1980(double t, const double *f, double *dpsi, double *deps)
 *                               (NULL: no output)
 * return : none
 * note   : see ref [3] chap 5
-*          not thread-safe
+*          precession and nutation angles are evaluated at nodes of NUTINT s in
+*          TT and linearly interpolated (error < 1E-8 arcsec). nodes and the
+*          last NECICACHE matrices are cached per thread, so the function is
+*          thread-safe and the results do not depend on the order of calls.
 *-----------------------------------------------------------------------------*/
+#define NUTINT      60.0                /* interval of nutation nodes (s) */
+#define NECICACHE   8                   /* number of cached matrices */
+
 extern void eci2ecef(gtime_t tutc, const double *erpv, double *U, double *gmst)
 {
     const double ep2000[]={2000,1,1,12,0,0};
-    static gtime_t tutc_;
-    static double U_[9],gmst_;
+    static THREADLOCAL int nnode[2]={-1,-1},icache=0;
+    static THREADLOCAL double anode[2][7];
+    static THREADLOCAL gtime_t tcache[NECICACHE];
+    static THREADLOCAL double ecache[NECICACHE][3],Ucache[NECICACHE][9];
+    static THREADLOCAL double gcache[NECICACHE];
     gtime_t tgps;
-    double eps,ze,th,z,t,t2,t3,dpsi,deps,gast,f[5];
+    double tt,a,d,ang[7],eps,dpsi,gast,gmst_;
     double R1[9],R2[9],R3[9],R[9],W[9],N[9],P[9],NP[9];
-    int i;
-    
-    trace(4,"eci2ecef: tutc=%s\n",time_str(tutc,3));
+    int i,j,n;
     
-    if (fabs(timediff(tutc,tutc_))<0.01) { /* read cache */
-        for (i=0;i<9;i++) U[i]=U_[i];
-        if (gmst) *gmst=gmst_; 
+    /* read cache */
+    for (i=0;i<NECICACHE;i++) {
+        if (!tcache[i].time||tcache[i].time!=tutc.time||tcache[i].sec!=tutc.sec||
+            ecache[i][0]!=erpv[0]||ecache[i][1]!=erpv[1]||
+            ecache[i][2]!=erpv[2]) continue;
+        for (j=0;j<9;j++) U[j]=Ucache[i][j];
+        if (gmst) *gmst=gcache[i];
         return;
     }
-    tutc_=tutc;
+    trace(4,"eci2ecef: tutc=%s\n",time_str(tutc,3));
     
-    /* terrestrial time */
-    tgps=utc2gpst(tutc_);
-    t=(timediff(tgps,epoch2time(ep2000))+19.0+32.184)/86400.0/36525.0;
-    t2=t*t; t3=t2*t;
+    /* terrestrial time since J2000 (s) */
+    tgps=utc2gpst(tutc);
+    tt=timediff(tgps,epoch2time(ep2000))+19.0+32.184;
     
-    /* astronomical arguments */
-    ast_args(t,f);
+    /* precession and nutation angles at nodes */
+    n=(int)floor(tt/NUTINT);
+    for (i=0;i<2;i++) {
+        if (nnode[i]==n+i) continue;
+        if (nnode[1-i]==n+i) {
+            for (j=0;j<7;j++) anode[i][j]=anode[1-i][j];
+        }
+        else {
+            prenut_ang((n+i)*NUTINT/86400.0/36525.0,anode[i]);
+        }
+        nnode[i]=n+i;
+    }
+    a=tt/NUTINT-n;
+    for (j=0;j<6;j++) ang[j]=(1.0-a)*anode[0][j]+a*anode[1][j];
+    
+    /* node of moon (omega) unwrapped across 2pi between nodes */
+    d=anode[1][6]-anode[0][6];
+    if      (d> PI) d-=2.0*PI;
+    else if (d<-PI) d+=2.0*PI;
+    ang[6]=anode[0][6]+a*d;
+    eps=ang[3];
+    dpsi=ang[4];
     
     /* iau 1976 precession */
-    ze=(2306.2181*t+0.30188*t2+0.017998*t3)*AS2R;
-    th=(2004.3109*t-0.42665*t2-0.041833*t3)*AS2R;
-    z =(2306.2181*t+1.09468*t2+0.018203*t3)*AS2R;
-    eps=(84381.448-46.8150*t-0.00059*t2+0.001813*t3)*AS2R;
-    Rz(-z,R1); Ry(th,R2); Rz(-ze,R3);
+    Rz(-ang[2],R1); Ry(ang[1],R2); Rz(-ang[0],R3);
     matmul("NN",3,3,3,1.0,R1,R2,0.0,R);
     matmul("NN",3,3,3,1.0,R, R3,0.0,P); /* P=Rz(-z)*Ry(th)*Rz(-ze) */
     
     /* iau 1980 nutation */
-    nut_iau1980(t,f,&dpsi,&deps);
-    Rx(-eps-deps,R1); Rz(-dpsi,R2); Rx(eps,R3);
+    Rx(-eps-ang[5],R1); Rz(-dpsi,R2); Rx(eps,R3);
     matmul("NN",3,3,3,1.0,R1,R2,0.0,R);
     matmul("NN",3,3,3,1.0,R ,R3,0.0,N); /* N=Rx(-eps)*Rz(-dspi)*Rx(eps) */
     
     /* greenwich aparent sidereal time (rad) */
-    gmst_=utc2gmst(tutc_,erpv[2]);
+    gmst_=utc2gmst(tutc,erpv[2]);
     gast=gmst_+dpsi*cos(eps);
-    gast+=(0.00264*sin(f[4])+0.000063*sin(2.0*f[4]))*AS2R;
+    gast+=(0.00264*sin(ang[6])+0.000063*sin(2.0*ang[6]))*AS2R;
     
     /* eci to ecef transformation matrix */
     Ry(-erpv[0],R1); Rx(-erpv[1],R2); Rz(gast,R3);
     matmul("NN",3,3,3,1.0,R1,R2,0.0,W );
     matmul("NN",3,3,3,1.0,W ,R3,0.0,R ); /* W=Ry(-xp)*Rx(-yp) */
     matmul("NN",3,3,3,1.0,N ,P ,0.0,NP);
-    matmul("NN",3,3,3,1.0,R ,NP,0.0,U_); /* U=W*Rz(gast)*N*P */
+    matmul("NN",3,3,3,1.0,R ,NP,0.0,U ); /* U=W*Rz(gast)*N*P */
     
-    for (i=0;i<9;i++) U[i]=U_[i];
-    if (gmst) *gmst=gmst_; 
+    if (gmst) *gmst=gmst_;
+    
+    /* write cache */
+    tcache[icache]=tutc;
+    for (j=0;j<3;j++) ecache[icache][j]=erpv[j];
+    for (j=0;j<9;j++) Ucache[icache][j]=U[j];
+    gcache[icache]=gmst_;
+    icache=(icache+1)%NECICACHE;
     
     trace(5,"gmst=%.12f gast=%.12f\n",gmst_,gast);
     trace(5,"P=\n"); tracemat(5,P,3,3,15,12);
@@ -3711,6 +4511,33 @@ extern double ionppp(const double *pos, const double *azel, double re,
     }
     return 1.0/sqrt(1.0-rp*rp);
 }
+/* standard atmosphere -------------------------------------------------------*/
+static int stdatmos(const double *pos, double humi, double *pres, double *temp,
+                    double *e)
+{
+    const double temp0=15.0; /* temparature at sea level */
+    double hgt;
+    
+    if (pos[2]<-100.0||1E4<pos[2]) return 0;
+    
+    hgt=pos[2]<0.0?0.0:pos[2];
+    
+    *pres=1013.25*pow(1.0-2.2557E-5*hgt,5.2568);
+    *temp=temp0-6.5E-3*hgt+273.16;
+    *e=6.108*humi*exp((17.15*(*temp)-4684.0)/((*temp)-38.45));
+    return 1;
+}
+/* saastamoinen model --------------------------------------------------------*/
+static double saastamoinen(double pres, double temp, double e, double el)
+{
+    double z,trph,trpw;
+    
+    z=PI/2.0-el;
+    //trph=0.0022768*pres/(1.0-0.00266*cos(2.0*pos[0])-0.00028*hgt/1E3)/cos(z);
+	trph = 0.0022768*(pres - tan(z)*tan(z)) / cos(z);
+    trpw=0.002277*(1255.0/temp+0.05)*e/cos(z);
+    return trph+trpw;
+}
 /* troposphere model -----------------------------------------------------------
 * compute tropospheric delay by standard atmosphere and saastamoinen model
 * args   : gtime_t time     I   time
@@ -3722,24 +4549,11 @@ extern double ionppp(const double *pos, const double *azel, double re,
 extern double tropmodel(gtime_t time, const double *pos, const double *azel,
                         double humi)
 {
-    const double temp0=15.0; /* temparature at sea level */
-    double hgt,pres,temp,e,z,trph,trpw;
-    
-    if (pos[2]<-100.0||1E4<pos[2]||azel[1]<=0) return 0.0;
-    
-    /* standard atmosphere */
-    hgt=pos[2]<0.0?0.0:pos[2];
+    double pres,temp,e;
     
-    pres=1013.25*pow(1.0-2.2557E-5*hgt,5.2568);
-    temp=temp0-6.5E-3*hgt+273.16;
-    e=6.108*humi*exp((17.15*temp-4684.0)/(temp-38.45));
+    if (azel[1]<=0||!stdatmos(pos,humi,&pres,&temp,&e)) return 0.0;
     
-    /* saastamoninen model */
-    z=PI/2.0-azel[1];
-    //trph=0.0022768*pres/(1.0-0.00266*cos(2.0*pos[0])-0.00028*hgt/1E3)/cos(z);
-	trph = 0.0022768*(pres - tan(z)*tan(z)) / cos(z);
-    trpw=0.002277*(1255.0/temp+0.05)*e/cos(z);
-    return trph+trpw;
+    return saastamoinen(pres,temp,e,azel[1]);
 }
 #ifndef IERS_MODEL
 
@@ -3754,8 +4568,8 @@ static double mapf(double el, double a, double b, double c)
     double sinel=sin(el);
     return (1.0+a/(1.0+b/(1.0+c)))/(sinel+(a/(sinel+b/(sinel+c))));
 }
-static double nmf(gtime_t time, const double pos[], const double azel[],
-                  double *mapfw)
+/* nmf coefficients at receiver latitude and day of year ---------------------*/
+static void nmfcoef(gtime_t time, const double pos[], double *ah, double *aw)
 {
     /* ref [5] table 3 */
     /* hydro-ave-a,b,c, hydro-amp-a,b,c, wet-a,b,c at latitude 15,30,45,60,75 */
@@ -3772,15 +4586,9 @@ static double nmf(gtime_t time, const double pos[], const double azel[],
         { 1.4275268E-3, 1.5138625E-3, 1.4572752E-3, 1.5007428E-3, 1.7599082E-3},
         { 4.3472961E-2, 4.6729510E-2, 4.3908931E-2, 4.4626982E-2, 5.4736038E-2}
     };
-    const double aht[]={ 2.53E-5, 5.49E-3, 1.14E-3}; /* height correction */
-    
-    double y,cosy,ah[3],aw[3],dm,el=azel[1],lat=pos[0]*R2D,hgt=pos[2];
+    double y,cosy,lat=pos[0]*R2D;
     int i;
     
-    if (el<=0.0) {
-        if (mapfw) *mapfw=0.0;
-        return 0.0;
-    }
     /* year from doy 28, added half a year for southern latitudes */
     y=(time2doy(time)-28.0)/365.25+(lat<0.0?0.5:0.0);
     
@@ -3791,6 +4599,18 @@ static double nmf(gtime_t time, const double pos[], const double azel[],
         ah[i]=interpc(coef[i  ],lat)-interpc(coef[i+3],lat)*cosy;
         aw[i]=interpc(coef[i+6],lat);
     }
+}
+/* nmf mapping functions at elevation ----------------------------------------*/
+static double nmfel(double el, double hgt, const double *ah, const double *aw,
+                    double *mapfw)
+{
+    const double aht[]={ 2.53E-5, 5.49E-3, 1.14E-3}; /* height correction */
+    double dm;
+    
+    if (el<=0.0) {
+        if (mapfw) *mapfw=0.0;
+        return 0.0;
+    }
     /* ellipsoidal height is used instead of height above sea level */
     dm=(1.0/sin(el)-mapf(el,aht[0],aht[1],aht[2]))*hgt/1E3;
     
@@ -3798,6 +4618,19 @@ static double nmf(gtime_t time, const double pos[], const double azel[],
     
     return mapf(el,ah[0],ah[1],ah[2])+dm;
 }
+static double nmf(gtime_t time, const double pos[], const double azel[],
+                  double *mapfw)
+{
+    double ah[3],aw[3];
+    
+    if (azel[1]<=0.0) {
+        if (mapfw) *mapfw=0.0;
+        return 0.0;
+    }
+    nmfcoef(time,pos,ah,aw);
+    
+    return nmfel(azel[1],pos[2],ah,aw,mapfw);
+}
 #endif /* !IERS_MODEL */
 
 /* troposphere mapping function ------------------------------------------------
@@ -3842,6 +4675,125 @@ extern double tropmapf(gtime_t time, const double pos[], const double azel[],
     return nmf(time,pos,azel,mapfw); /* NMF */
 #endif
 }
+/* initialize receiver troposphere context -------------------------------------
+* compute station and time dependent terms of troposphere models once per epoch
+* args   : tropctx_t *ctx   O   receiver troposphere context
+*          gtime_t time     I   time
+*          double *pos      I   receiver position {lat,lon,h} (rad,m)
+*          double humi      I   relative humidity for tropmodelc()
+* return : none
+* notes  : tropmodelc(ctx,azel) and tropmapfc(ctx,azel,mapfw) are identical to
+*          tropmodel(time,pos,azel,humi) and tropmapf(time,pos,azel,mapfw)
+*-----------------------------------------------------------------------------*/
+extern void inittropctx(tropctx_t *ctx, gtime_t time, const double *pos,
+                        double humi)
+{
+#ifdef IERS_MODEL
+    const double ep[]={2000,1,1,12,0,0};
+#endif
+    int i;
+    
+    ctx->time=time;
+    for (i=0;i<3;i++) ctx->pos[i]=pos[i];
+    ctx->humi=humi;
+    ctx->pres=ctx->temp=ctx->e=ctx->zhd=ctx->mjd=ctx->hgt=0.0;
+    for (i=0;i<3;i++) ctx->ah[i]=ctx->aw[i]=0.0;
+    
+    /* standard atmosphere and zenith hydrostatic delay */
+    if ((ctx->stat=stdatmos(pos,humi,&ctx->pres,&ctx->temp,&ctx->e))) {
+        ctx->zhd=saastamoinen(ctx->pres,ctx->temp,0.0,PI/2.0);
+    }
+    if (!(ctx->mstat=pos[2]>=-1000.0&&pos[2]<=20000.0)) return;
+    
+#ifdef IERS_MODEL
+    ctx->mjd=51544.5+(timediff(time,epoch2time(ep)))/86400.0;
+    ctx->hgt=pos[2]-geoidh(pos); /* height in m (mean sea level) */
+#else
+    nmfcoef(time,pos,ctx->ah,ctx->aw);
+#endif
+}
+/* troposphere model with receiver context -------------------------------------
+* compute tropospheric delay by standard atmosphere and saastamoinen model
+* args   : tropctx_t *ctx   I   receiver troposphere context
+*          double *azel     I   azimuth/elevation angle {az,el} (rad)
+* return : tropospheric delay (m)
+*-----------------------------------------------------------------------------*/
+extern double tropmodelc(const tropctx_t *ctx, const double *azel)
+{
+    if (!ctx->stat||azel[1]<=0) return 0.0;
+    
+    return saastamoinen(ctx->pres,ctx->temp,ctx->e,azel[1]);
+}
+/* troposphere mapping function with receiver context --------------------------
+* compute tropospheric mapping function by NMF (GMF with IERS_MODEL)
+* args   : tropctx_t *ctx   I   receiver troposphere context
+*          double *azel     I   azimuth/elevation angle {az,el} (rad)
+*          double *mapfw    IO  wet mapping function (NULL: not output)
+* return : dry mapping function
+*-----------------------------------------------------------------------------*/
+extern double tropmapfc(const tropctx_t *ctx, const double *azel,
+                        double *mapfw)
+{
+#ifdef IERS_MODEL
+    double mjd,lat,lon,hgt,zd,gmfh,gmfw;
+#endif
+    if (!ctx->mstat) {
+        if (mapfw) *mapfw=0.0;
+        return 0.0;
+    }
+#ifdef IERS_MODEL
+    mjd=ctx->mjd;
+    lat=ctx->pos[0];
+    lon=ctx->pos[1];
+    hgt=ctx->hgt;
+    zd =PI/2.0-azel[1];
+    
+    /* call GMF */
+    gmf_(&mjd,&lat,&lon,&hgt,&zd,&gmfh,&gmfw);
+    
+    if (mapfw) *mapfw=gmfw;
+    return gmfh;
+#else
+    return nmfel(azel[1],ctx->pos[2],ctx->ah,ctx->aw,mapfw); /* NMF */
+#endif
+}
+/* troposphere models of satellites --------------------------------------------
+* compute tropospheric delays of satellites at an epoch
+* args   : tropctx_t *ctx   I   receiver troposphere context
+*          double *azel     I   azimuth/elevation angles {az1,el1,...,azn,eln}
+*          int    n         I   number of satellites
+*          double *trp      O   tropospheric delays (m) {trp1,...,trpn}
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void tropmodels(const tropctx_t *ctx, const double *azel, int n,
+                       double *trp)
+{
+    int i;
+    
+    for (i=0;i<n;i++) trp[i]=tropmodelc(ctx,azel+i*2);
+}
+/* troposphere mapping functions of satellites ---------------------------------
+* compute tropospheric mapping functions of satellites at an epoch
+* args   : tropctx_t *ctx   I   receiver troposphere context
+*          double *azel     I   azimuth/elevation angles {az1,el1,...,azn,eln}
+*          int    n         I   number of satellites
+*          double *mapfh    O   dry mapping functions {mh1,...,mhn} (NULL: no
+*                               output)
+*          double *mapfw    O   wet mapping functions {mw1,...,mwn} (NULL: no
+*                               output)
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void tropmapfs(const tropctx_t *ctx, const double *azel, int n,
+                      double *mapfh, double *mapfw)
+{
+    double mh;
+    int i;
+    
+    for (i=0;i<n;i++) {
+        mh=tropmapfc(ctx,azel+i*2,mapfw?mapfw+i:NULL);
+        if (mapfh) mapfh[i]=mh;
+    }
+}
 /* interpolate antenna phase center variation --------------------------------*/
 static double interpvar(double ang, const double *var)
 {
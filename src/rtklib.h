@@ -229,6 +229,7 @@ extern "C" {
 #ifndef MAXOBS
 #define MAXOBS      80                  /* max number of obs in an epoch */
 #endif
+#define MAXSTSLOT   MAXOBS              /* max satellite slots of rtk states */
 #define MAXRCV      64                  /* max receiver number (1 to MAXRCV) */
 #define MAXOBSTYPE  64                  /* max number of obs type in RINEX */
 #ifdef OBS_100HZ
@@ -254,6 +255,8 @@ extern "C" {
 #define MAXSBSURA   8                   /* max URA of SBAS satellite */
 #define MAXBAND     10                  /* max SBAS band of IGP */
 #define MAXNIGP     201                 /* max number of IGP in SBAS band */
+#define NSBSIGPLAT  37                  /* number of SBAS IGP grid latitudes (-90:5:90) */
+#define NSBSIGPLON  72                  /* number of SBAS IGP grid longitudes (-180:5:175) */
 #define MAXNGEO     4                   /* max number of GEO satellites */
 #define MAXCOMMENT  10                  /* max number of RINEX comments */
 #define MAXSTRPATH  1024                /* max length of stream path */
@@ -406,6 +409,13 @@ extern "C" {
 #define EPHOPT_SSRCOM 4                 /* ephemeris option: broadcast + SSR_COM */
 #define EPHOPT_LEX  5                   /* ephemeris option: QZSS LEX ephemeris */
 
+#define MATLIB_INT  0                   /* matrix library: internal */
+#define MATLIB_SYS  1                   /* matrix library: system BLAS/LAPACK */
+
+#define FILTALG_STD 0                   /* filter update: batch with LU inverse */
+#define FILTALG_CHOL 1                  /* filter update: cholesky and joseph form */
+#define FILTALG_SEQ 2                   /* filter update: sequential scalar */
+
 #define ARMODE_OFF  0                   /* AR mode: off */
 #define ARMODE_CONT 1                   /* AR mode: continuous */
 #define ARMODE_INST 2                   /* AR mode: instantaneous */
@@ -413,6 +423,10 @@ extern "C" {
 #define ARMODE_WLNL 4                   /* AR mode: wide lane/narrow lane */
 #define ARMODE_TCAR 5                   /* AR mode: triple carrier ar */
 
+#define ARPAR_OFF   0                   /* partial AR: off */
+#define ARPAR_ELEV  1                   /* partial AR: subsets by elevation */
+#define ARPAR_VAR   2                   /* partial AR: subsets by variance */
+
 #define SBSOPT_LCORR 1                  /* SBAS option: long term correction */
 #define SBSOPT_FCORR 2                  /* SBAS option: fast correction */
 #define SBSOPT_ICORR 4                  /* SBAS option: ionosphere correction */
@@ -526,6 +540,7 @@ extern "C" {
 #define initlock(f) InitializeCriticalSection(f)
 #define lock(f)     EnterCriticalSection(f)
 #define unlock(f)   LeaveCriticalSection(f)
+#define THREADLOCAL __declspec(thread)
 #define FILEPATHSEP '\\'
 #else
 #define thread_t    pthread_t
@@ -533,6 +548,7 @@ extern "C" {
 #define initlock(f) pthread_mutex_init(f,NULL)
 #define lock(f)     pthread_mutex_lock(f)
 #define unlock(f)   pthread_mutex_unlock(f)
+#define THREADLOCAL __thread
 #define FILEPATHSEP '/'
 #endif
 
@@ -708,11 +724,52 @@ typedef struct {        /* norad two line element data type */
     int rev;            /* revolution number at epoch */
 } tled_t;
 
+typedef struct {        /* norad two line element index type */
+    char key[16];       /* index key (catalog number or designator) */
+    int i;              /* index of two line element data */
+} tleidx_t;
+
 typedef struct {        /* norad two line element type */
     int n,nmax;         /* number/max number of two line element data */
     tled_t *data;       /* norad two line element data */
+    tleidx_t *isatno;   /* index sorted by catalog number (NULL: no index) */
+    tleidx_t *idesig;   /* index sorted by international designator */
 } tle_t;
 
+typedef struct {        /* TLE batch propagation type */
+    int ns,nt;          /* number of satellites/epochs */
+    gtime_t ts;         /* first epoch (GPST) */
+    double tint;        /* epoch interval (s) */
+    int *index;         /* TLE data index of satellites */
+    double *rs[6];      /* sat position/velocity {x,y,z,vx,vy,vz} (ecef) (m|m/s)
+                           rs[j][k+i*nt]: component j of sat i at epoch k */
+} tlebat_t;
+
+typedef struct {        /* TLE satellite pass type */
+    int sat;            /* satellite index in batch */
+    int site;           /* site index */
+    gtime_t ts,te;      /* rise/set time (GPST) */
+    gtime_t tmax;       /* time of max elevation (GPST) */
+    double elmax;       /* max elevation (rad) */
+} tlepass_t;
+
+typedef struct {        /* satellite visibility window type */
+    int sat;            /* satellite number */
+    int site;           /* site index */
+    gtime_t ts,te;      /* start/end time (GPST) */
+    double elmax;       /* max elevation (rad) */
+} viswin_t;
+
+typedef struct {        /* visibility and dop forecast type */
+    int nsite,nt;       /* number of sites/epochs */
+    gtime_t ts;         /* first epoch (GPST) */
+    double tint;        /* epoch interval (s) */
+    int *ns;            /* number of visible satellites ns[k+m*nt] */
+    float *dop;         /* DOPs {GDOP,PDOP,HDOP,VDOP} dop[j+(k+m*nt)*4] */
+    int nw;             /* number of visibility windows */
+    viswin_t *win;      /* visibility windows sorted by site and start time */
+} visfcst_t;
+
 typedef struct {        /* TEC grid type */
     gtime_t time;       /* epoch time (GPST) */
     int ndata[3];       /* TEC grid data size {nlat,nlon,nhgt} */
@@ -792,6 +849,11 @@ typedef struct {        /* SBAS ionospheric corrections type */
     sbsigp_t igp[MAXNIGP]; /* ionospheric correction */
 } sbsion_t;
 
+typedef struct {        /* SBAS IGP grid index type */
+    short igp[NSBSIGPLAT][NSBSIGPLON][2]; /* band*MAXNIGP+index+1 of IGPs at
+                           lat=-90+i*5,lon=-180+j*5 in band order (0:none) */
+} sbsigpidx_t;
+
 typedef struct {        /* DGPS/GNSS correction type */
     gtime_t t0;         /* correction time */
     double prc;         /* pseudorange correction (PRC) (m) */
@@ -871,6 +933,18 @@ typedef struct {        /* trop data type */
     float std[3];       /* std-dev (m) */
 } trop_t;
 
+typedef struct {        /* receiver troposphere context type */
+    gtime_t time;       /* time (GPST) */
+    double pos[3];      /* receiver position {lat,lon,h} (rad,m) */
+    double humi;        /* relative humidity */
+    int stat;           /* standard atmosphere status (0:out of height range) */
+    int mstat;          /* mapping function status (0:out of height range) */
+    double pres,temp,e; /* pressure (hPa), temperature (K), water vapour (hPa) */
+    double zhd;         /* zenith hydrostatic delay (m) */
+    double ah[3],aw[3]; /* NMF hydrostatic/wet coefficients {a,b,c} */
+    double mjd,hgt;     /* GMF mjd and height above mean sea level (m) */
+} tropctx_t;
+
 typedef struct {        /* ppp corrections type */
     int nsta;           /* number of stations */
     char stas[MAXSTA][8]; /* station names */
@@ -881,6 +955,31 @@ typedef struct {        /* ppp corrections type */
     trop_t *trop[MAXSTA]; /* trop data */
 } pppcorr_t;
 
+typedef struct {        /* satellite state grid data type */
+    double rs[6];       /* satellite position/velocity (ecef) (m|m/s) */
+    double dts[2];      /* satellite clock bias/drift (s|s/s) */
+    float var;          /* satellite position and clock variance (m^2) */
+    int svh;            /* satellite health flag */
+    int eid;            /* ephemeris index (-1:no data) */
+} sgridd_t;
+
+typedef struct {        /* satellite state grid type */
+    gtime_t ts;         /* time of first grid epoch */
+    double tint;        /* grid interval (s) */
+    int n;              /* number of grid epochs */
+    int ephopt;         /* ephemeris option of grid data (EPHOPT_???) */
+    sgridd_t *data;     /* grid data {sat1 epoch 0..n-1,sat2 epoch 0..n-1,...} */
+} satgrid_t;
+
+typedef struct {        /* tide displacement grid type */
+    gtime_t ts;         /* time of first grid epoch (utc) */
+    double tint;        /* grid interval (s) */
+    int n;              /* number of grid epochs */
+    int opt[2];         /* tidedisp() options {rover,base} (0:not gridded) */
+    double rr[2][3];    /* station positions {rover,base} (ecef) (m) */
+    double *dr;         /* displacements (ecef) (m) {rover epoch 0..n-1,base ...} */
+} tidegrid_t;
+
 
 
 typedef struct {        /* navigation data type */
@@ -923,6 +1022,7 @@ typedef struct {        /* navigation data type */
     pcv_t pcvs[MAXSAT]; /* satellite antenna pcv */
     sbssat_t sbssat;    /* SBAS satellite corrections */
     sbsion_t sbsion[MAXBAND+1]; /* SBAS ionosphere corrections */
+    sbsigpidx_t sbsigpidx; /* SBAS IGP grid index of sbsion */
     dgps_t dgps[MAXSAT]; /* DGPS corrections */
     ssr_t ssr[MAXSAT];  /* SSR corrections */
     lexeph_t lexeph[MAXSAT]; /* LEX ephemeris */
@@ -934,6 +1034,8 @@ typedef struct {        /* navigation data type */
 	int obstsys;
 	int igmasta;
 	int isci[7][MAXFREQ]; /* record the ISC index: 0:pilot, 1:data */
+	satgrid_t *sgrid;   /* session satellite state grid (NULL:not used) */
+	tidegrid_t *tgrid;  /* session tide displacement grid (NULL:not used) */
 } nav_t;
 
 typedef struct {        /* station parameter type */
@@ -1139,6 +1241,15 @@ typedef struct {        /* processing options type */
     char pppopt[256];   /* ppp option */
 	double  coordfixed;      /* nalysis only.0: SPP, unlimited~1E6: fixed to known position. Default: 0 */
 	int  outsat;
+	double sgridint;    /* satellite state grid interval (s) (0:off) */
+	double tgridint;    /* tide displacement grid interval (s) (0:off) */
+	int  nthread;       /* number of worker threads (0:number of cpus) */
+	int  matlib;        /* matrix library (MATLIB_???) */
+	int  filtalg;       /* filter update algorithm (FILTALG_???) */
+	int  nqmode;        /* NeQuick-G STEC integration mode (0:reference,1:fast,2:fast+grid) */
+	int  raimexc;       /* max number of satellites excluded by raim fde (0:1) */
+	int  arpartial;     /* partial AR (ARPAR_???) */
+	double arpsucc;     /* min success rate of bootstrapping for partial AR (0:no check) */
 } prcopt_t;
 
 typedef struct {        /* solution options type */
@@ -1179,6 +1290,7 @@ typedef struct {        /* file options type */
     char geexe  [MAXSTRPATH]; /* google earth exec file */
     char solstat[MAXSTRPATH]; /* solution statistics file */
     char trace  [MAXSTRPATH]; /* debug trace file */
+    char nqdir  [MAXSTRPATH]; /* NeQuick-G MODIP/CCIR data directory */
 } filopt_t;
 
 typedef struct {        /* RINEX options type */
@@ -1254,6 +1366,15 @@ typedef struct {        /* ambiguity control type */
     char flags[MAXSAT]; /* fix flags */
 } ambc_t;
 
+typedef struct {        /* matrix arena type */
+    char *buff;         /* arena buffer */
+    size_t size;        /* buffer size (bytes) */
+    size_t used;        /* used size (bytes) */
+    size_t top;         /* offset of top block (bytes) (-1:none) */
+    size_t peak;        /* peak demand since reset (bytes) */
+    size_t ovf;         /* demand allocated in heap since reset (bytes) */
+} matarena_t;
+
 typedef struct {        /* RTK control/result type */
     sol_t  sol;         /* RTK solution */
     double rb[6];       /* base position/velocity (ecef) (m|m/s) */
@@ -1264,6 +1385,10 @@ typedef struct {        /* RTK control/result type */
     int nfix;           /* number of continuous fixes of ambiguity */
     ambc_t ambc[MAXSAT]; /* ambibuity control */
     ssat_t ssat[MAXSAT]; /* satellite status */
+    int islot[MAXSAT];  /* state slot of satellite (-1:none) */
+    int slotsat[MAXSTSLOT]; /* satellite of state slot */
+    int nslot;          /* number of used state slots */
+    matarena_t arena;   /* arena of epoch temporary matrices */
     int neb;            /* bytes in error message buffer */
     char errbuf[MAXERRMSG]; /* error message buffer */
     prcopt_t opt;       /* processing options */
@@ -1475,6 +1600,10 @@ EXPORT double *mat  (int n, int m);
 EXPORT int    *imat (int n, int m);
 EXPORT double *zeros(int n, int m);
 EXPORT double *eye  (int n);
+EXPORT void   matfree(void *p);
+EXPORT matarena_t *matarena(matarena_t *arena);
+EXPORT void   matarena_reset(matarena_t *arena);
+EXPORT void   matarena_free (matarena_t *arena);
 EXPORT double dot (const double *a, const double *b, int n);
 EXPORT double norm(const double *a, int n);
 EXPORT void cross3(const double *a, const double *b, double *c);
@@ -1483,12 +1612,16 @@ EXPORT void matcpy(double *A, const double *B, int n, int m);
 EXPORT void matmul(const char *tr, int n, int k, int m, double alpha,
                    const double *A, const double *B, double beta, double *C);
 EXPORT int  matinv(double *A, int n);
+EXPORT int  setmatlib(int lib);
 EXPORT int  solve (const char *tr, const double *A, const double *Y, int n,
                    int m, double *X);
 EXPORT int  lsq   (const double *A, const double *y, int n, int m, double *x,
 	double *Q, double coordfixedvalue);
+EXPORT int  lsqnrm(const double *A, const double *b, int n, double *x,
+                   double *Q);
 EXPORT int  filter(double *x, double *P, const double *H, const double *v,
                    const double *R, int n, int m);
+EXPORT void setfiltalg(int alg);
 EXPORT int  smoother(const double *xf, const double *Qf, const double *xb,
                      const double *Qb, int n, double *xs, double *Qs);
 EXPORT void matprint (const double *A, int n, int m, int p, int q);
@@ -1525,6 +1658,9 @@ EXPORT int read_leaps(const char *file);
 EXPORT int adjgpsweek(int week);
 EXPORT unsigned int tickget(void);
 EXPORT void sleepms(int ms);
+EXPORT int  ncpuget(void);
+typedef void parfunc_t(int i, void *arg);
+EXPORT void parfor(int n, int nthread, parfunc_t *func, void *arg);
 
 EXPORT int reppath(const char *path, char *rpath, gtime_t time, const char *rov,
                    const char *base);
@@ -1593,13 +1729,28 @@ EXPORT double tropmodel(gtime_t time, const double *pos, const double *azel,
                         double humi);
 EXPORT double tropmapf(gtime_t time, const double *pos, const double *azel,
                        double *mapfw);
+EXPORT void inittropctx(tropctx_t *ctx, gtime_t time, const double *pos,
+                        double humi);
+EXPORT double tropmodelc(const tropctx_t *ctx, const double *azel);
+EXPORT double tropmapfc(const tropctx_t *ctx, const double *azel,
+                        double *mapfw);
+EXPORT void tropmodels(const tropctx_t *ctx, const double *azel, int n,
+                       double *trp);
+EXPORT void tropmapfs(const tropctx_t *ctx, const double *azel, int n,
+                      double *mapfh, double *mapfw);
 EXPORT int iontec(gtime_t time, const nav_t *nav, const double *pos,
                   const double *azel, int opt, double *delay, double *var);
+EXPORT int iontecs(gtime_t time, const nav_t *nav, const double *pos,
+                   const double *azel, int n, int opt, double *delay,
+                   double *var, int *stat);
 EXPORT void readtec(const char *file, nav_t *nav, int opt);
 EXPORT int ionocorr(prcopt_t opt,gtime_t time, const nav_t *nav, int sat, const double *pos,const double *satpos,
                     const double *azel, int ionoopt, double *ion, double *var);
 EXPORT int tropcorr(gtime_t time, const nav_t *nav, const double *pos,
                     const double *azel, int tropopt, double *trp, double *var);
+EXPORT int tropcorrc(const tropctx_t *ctx, const nav_t *nav,
+                     const double *azel, int tropopt, double *trp,
+                     double *var);
 
 /* antenna models ------------------------------------------------------------*/
 EXPORT int  readpcv(const char *file, pcvs_t *pcvs);
@@ -1614,6 +1765,12 @@ EXPORT void sunmoonpos(gtime_t tutc, const double *erpv, double *rsun,
                        double *rmoon, double *gmst);
 EXPORT void tidedisp(gtime_t tutc, const double *rr, int opt, const erp_t *erp,
                      const double *odisp, double *dr);
+EXPORT tidegrid_t *tidegrid_new(const prcopt_t *opt, gtime_t ts, gtime_t te,
+                                double tint, const double *rr,
+                                const int *tideopt, const erp_t *erp);
+EXPORT void tidegrid_free(tidegrid_t *tgrid);
+EXPORT int  tidegrid_disp(const tidegrid_t *tgrid, int sta, gtime_t tutc,
+                          const double *rr, int opt, double *dr);
 
 /* geiod models --------------------------------------------------------------*/
 EXPORT int opengeoid(int model, const char *file);
@@ -1664,6 +1821,8 @@ EXPORT void seph2pos(gtime_t time, const seph_t *seph, double *rs, double *dts,
                      double *var);
 EXPORT int  peph2pos(gtime_t time, int sat, const nav_t *nav, int opt,
                      double *rs, double *dts, double *var);
+EXPORT void satantoffs(gtime_t time, const double *rs, const int *sats, int n,
+                       const nav_t *nav, double *dant);
 EXPORT void satantoff(gtime_t time, const double *rs, int sat, const nav_t *nav,
                       double *dant);
 EXPORT int  satpos(gtime_t time, gtime_t teph, int sat, int ephopt,
@@ -1673,6 +1832,11 @@ EXPORT int  satpos(gtime_t time, gtime_t teph, int sat, int ephopt,
 //                    int sateph, double *rs, double *dts, double *var, int *svh);
 extern void satposs(gtime_t teph, const obsd_t *obs, int n, const nav_t *nav,
 	const prcopt_t *opt, int ephopt, double *rs, double *dts, double *var, int *svh);
+EXPORT satgrid_t *satgrid_new(const prcopt_t *opt, gtime_t ts, gtime_t te,
+                              double tint, int ephopt, const nav_t *nav);
+EXPORT void satgrid_free(satgrid_t *sgrid);
+EXPORT int  satgrid_pos(const satgrid_t *sgrid, gtime_t time, int sat,
+                        double *rs, double *dts, double *var, int *svh);
 
 EXPORT void satseleph(int sys, int sel);
 EXPORT void readsp3(const char *file, nav_t *nav, int opt);
@@ -1683,6 +1847,22 @@ EXPORT void alm2pos(gtime_t time, const alm_t *alm, double *rs, double *dts);
 
 EXPORT int tle_read(const char *file, tle_t *tle);
 EXPORT int tle_name_read(const char *file, tle_t *tle);
+EXPORT void tle_free(tle_t *tle);
+EXPORT int tle_find(const tle_t *tle, const char *name, const char *satno,
+                    const char *desig);
+EXPORT int tle_batch(const tle_t *tle, const int *index, int ns, gtime_t ts,
+                     double tint, int nt, const erp_t *erp, int nthread,
+                     tlebat_t *bat);
+EXPORT void tle_batch_free(tlebat_t *bat);
+EXPORT int tle_pass(const tlebat_t *bat, const double *pos, int nsite,
+                    double elmask, int nthread, tlepass_t **pass);
+
+/* visibility forecast functions ---------------------------------------------*/
+EXPORT int  readyuma(const char *file, nav_t *nav);
+EXPORT int  visfcst(const nav_t *nav, int alm, int navsys, gtime_t ts,
+                    double tint, int nt, const double *pos, int nsite,
+                    double elmask, int nthread, visfcst_t *vf);
+EXPORT void visfcst_free(visfcst_t *vf);
 EXPORT int tle_pos(gtime_t time, const char *name, const char *satno,
                    const char *desig, const tle_t *tle, const erp_t *erp,
                    double *rs);
@@ -1863,6 +2043,9 @@ EXPORT int lambda(int n, int m, const double *a, const double *Q, double *F,
 EXPORT int lambda_reduction(int n, const double *Q, double *Z);
 EXPORT int lambda_search(int n, int m, const double *a, const double *Q,
                          double *F, double *s);
+EXPORT int lambda_par(int n, int m, const double *a, const double *Q,
+                      const int *ord, int nmin, double p0, double thres,
+                      int nthread, double *F, double *s, int *fix);
 
 /* standard positioning ------------------------------------------------------*/
 EXPORT int pntpos(const obsd_t *obs, int n, const nav_t *nav,
@@ -1897,6 +2080,7 @@ EXPORT int postpos(gtime_t ts, gtime_t te, double ti, double tu,
     const prcopt_t* popt, const solopt_t* sopt,
     const filopt_t* fopt, const char** infile, int n, const char* outfile,
     const char* rov, const char* base);
+EXPORT void init_nav(nav_t *nav);
 
 /* stream server functions ---------------------------------------------------*/
 EXPORT void strsvrinit (strsvr_t *svr, int nout);
@@ -1961,6 +2145,17 @@ EXPORT int lexioncorr(gtime_t time, const nav_t *nav, const double *pos,
                       const double *azel, double *delay, double *var);
 extern double ionmodel_BDSK8(gtime_t t, const double *ion, const double *pos, const double *azel);
 extern double ionmodel_BDSK9(gtime_t t, const BDSSH *bdssh, const double *pos, const double *azel);
+extern int ionmodel_BDSK9s(gtime_t time, const BDSSH *bdssh, const double *pos, const double *rs,
+                           int n, double *ion);
+extern void ionmodel_nequick_setdir(const char *dir);
+extern void ionmodel_nequick_free(void);
+extern void ionmodel_nequick_setmode(int mode);
+extern int ionmodel_nequick_bench(const double *galionpar, int month, double UTC, double usr_longitude_degree,
+                                  double usr_latitude_degree, double usr_height_meters, const double *sat,
+                                  int n, int mode, int nrep, double *stat);
+extern int ionmodel_nequicks(const double *galionpar, int month, double UTC, double usr_longitude_degree,
+                             double usr_latitude_degree, double usr_height_meters, const double *sat,
+                             int n, double *stec);
 
 extern double ionmodel_BDSK9_2(gtime_t time, double* brdPara, const double *pos, const double *satxyz);
 
@@ -1977,6 +2172,7 @@ extern double median_t(double *data, int n);
 extern double median2_t(double *data, int n);
 extern double median3_t(double *data, int n, double *mad);
 extern double permutation(int flag, const double *x0, const int nx0, const double ratio);
+extern double clustmean(const double *x, int n, double eps, int minpts);
 extern void outsatres(rtk_t* rtk, int* sat, int ns);
 extern void outsatres_single(FILE *fpSat_p, rtk_t* rtk, obsd_t *obs, int n);
 extern void outsatsnr_single(FILE *fpSat_snr, rtk_t* rtk, obsd_t *obs, int n);
@@ -64,6 +64,7 @@
 #define MAXACC      30.0     /* max accel for doppler slip detection (m/s^2) */
 
 #define VAR_HOLDAMB 0.001    /* constraint to hold ambiguity (cycle^2) */
+#define MINAMBPAR   4        /* min number of ambiguities fixed by partial AR */
 
 #define TTOL_MOVEB  (1.0+2*DTTOL)
                              /* time sync tolerance for moving-baseline (s) */
@@ -71,18 +72,19 @@
 /* number of parameters (pos,ionos,tropos,hw-bias,phase-bias,real,estimated) */
 #define NF(opt)     ((opt)->ionoopt==IONOOPT_IFLC?1:(opt)->nf)
 #define NP(opt)     ((opt)->dynamics==0?3:9)
-#define NI(opt)     ((opt)->ionoopt!=IONOOPT_EST?0:MAXSAT)
+#define NI(opt)     ((opt)->ionoopt!=IONOOPT_EST?0:MAXSTSLOT)
 #define NT(opt)     ((opt)->tropopt<TROPOPT_EST?0:((opt)->tropopt<TROPOPT_ESTG?2:6))
 #define NL(opt)     ((opt)->glomodear!=2?0:NFREQGLO)
-#define NB(opt)     ((opt)->mode<=PMODE_DGPS?0:MAXSAT*NF(opt))
+#define NB(opt)     ((opt)->mode<=PMODE_DGPS?0:MAXSTSLOT*NF(opt))
 #define NR(opt)     (NP(opt)+NI(opt)+NT(opt)+NL(opt))
 #define NX(opt)     (NR(opt)+NB(opt))
 
-/* state variable index */
-#define II(s,opt)   (NP(opt)+(s)-1)                 /* ionos (s:satellite no) */
+/* state variable index (ionos and phase-bias by state slot of satellite) */
+#define II(s,rtk)   (NP(&(rtk)->opt)+(rtk)->islot[(s)-1]) /* ionos (s:sat no) */
 #define IT(r,opt)   (NP(opt)+NI(opt)+NT(opt)/2*(r)) /* tropos (r:0=rov,1:ref) */
 #define IL(f,opt)   (NP(opt)+NI(opt)+NT(opt)+(f))   /* receiver h/w bias */
-#define IB(s,f,opt) (NR(opt)+MAXSAT*(f)+(s)-1) /* phase bias (s:satno,f:freq) */
+#define IB(s,f,rtk) (NR(&(rtk)->opt)+MAXSTSLOT*(f)+(rtk)->islot[(s)-1])
+                                        /* phase bias (s:satno,f:freq) */
 
 #ifdef EXTGSI
 
@@ -269,9 +271,9 @@ extern int rtkoutstat(rtk_t *rtk, char *buff)
     if (est&&rtk->opt.ionoopt==IONOOPT_EST) {
         for (i=0;i<MAXSAT;i++) {
             ssat=rtk->ssat+i;
-            if (!ssat->vs) continue;
+            if (!ssat->vs||rtk->islot[i]<0) continue;
             satno2id(i+1,id);
-            j=II(i+1,&rtk->opt);
+            j=II(i+1,rtk);
             xa[0]=j<rtk->na?rtk->xa[j]:0.0;
             p+=sprintf(p,"$ION,%d,%.3f,%d,%s,%.1f,%.1f,%.4f,%.4f\n",week,tow,
                        rtk->sol.stat,id,ssat->azel[0]*R2D,ssat->azel[1]*R2D,
@@ -510,7 +512,7 @@ static void udpos(rtk_t *rtk, double tt)
         if (rtk->x[i]!=0.0&&rtk->P[i+i*rtk->nx]>0.0) ix[nx++]=i;
     }
     if (nx<9) {
-        free(ix);
+        matfree(ix);
         return;
     }
     /* state transition of position/velocity/acceleration */
@@ -552,7 +554,7 @@ static void udpos(rtk_t *rtk, double tt)
     for (i=0;i<3;i++) for (j=0;j<3;j++) {
         rtk->P[i+6+(j+6)*rtk->nx]+=Qv[i+j*3];
     }
-    free(ix); free(F); free(P); free(FP); free(x); free(xp);
+    matfree(ix); matfree(F); matfree(P); matfree(FP); matfree(x); matfree(xp);
 }
 /* temporal update of ionospheric parameters ---------------------------------*/
 static void udion(rtk_t *rtk, double tt, double bl, const int *sat, int ns)
@@ -563,13 +565,14 @@ static void udion(rtk_t *rtk, double tt, double bl, const int *sat, int ns)
     trace(3,"udion   : tt=%.3f bl=%.0f ns=%d\n",tt,bl,ns);
     
     for (i=1;i<=MAXSAT;i++) {
-        j=II(i,&rtk->opt);
+        if (rtk->islot[i-1]<0) continue;
+        j=II(i,rtk);
         if (rtk->x[j]!=0.0&&
             rtk->ssat[i-1].outc[0]>GAP_RESION&&rtk->ssat[i-1].outc[1]>GAP_RESION)
             rtk->x[j]=0.0;
     }
     for (i=0;i<ns;i++) {
-        j=II(sat[i],&rtk->opt);
+        j=II(sat[i],rtk);
         
         if (rtk->x[j]==0.0) {
             initx(rtk,1E-6,SQR(rtk->opt.std[1]*bl/1E4),j);
@@ -855,12 +858,13 @@ static void udbias(rtk_t *rtk, double tt, const obsd_t *obs, const int *sat,
         for (i=1;i<=MAXSAT;i++) {
             
 			reset = ++rtk->ssat[i - 1].outc[fidx[f]]>(unsigned int)rtk->opt.maxout;
-			if (rtk->x[IB(i, f, &rtk->opt)] != 0.0)trace(3, "sat=%d outc no.=%d %d\n", i, rtk->ssat[i - 1].outc[fidx[f]], rtk->opt.maxout);
-            if (rtk->opt.modear==ARMODE_INST&&rtk->x[IB(i,f,&rtk->opt)]!=0.0) {
-                initx(rtk,0.0,0.0,IB(i,f,&rtk->opt));
+            j=rtk->islot[i-1]<0?-1:IB(i,f,rtk);
+			if (j >= 0 && rtk->x[j] != 0.0)trace(3, "sat=%d outc no.=%d %d\n", i, rtk->ssat[i - 1].outc[fidx[f]], rtk->opt.maxout);
+            if (rtk->opt.modear==ARMODE_INST&&j>=0&&rtk->x[j]!=0.0) {
+                initx(rtk,0.0,0.0,j);
             }
-            else if (reset&&rtk->x[IB(i,f,&rtk->opt)]!=0.0) {
-                initx(rtk,0.0,0.0,IB(i,f,&rtk->opt));
+            else if (reset&&j>=0&&rtk->x[j]!=0.0) {
+                initx(rtk,0.0,0.0,j);
                 trace(3,"udbias : obs outage counter overflow (sat=%3d L%d n=%d)\n",
 					i, f + 1, rtk->ssat[i - 1].outc[fidx[f]]);
 				rtk->ssat[i - 1].outc[fidx[f]] = 0;
@@ -871,7 +875,7 @@ static void udbias(rtk_t *rtk, double tt, const obsd_t *obs, const int *sat,
         }
         /* reset phase-bias if detecting cycle slip */
         for (i=0;i<ns;i++) {
-            j=IB(sat[i],f,&rtk->opt);
+            j=IB(sat[i],f,rtk);
             rtk->P[j+j*rtk->nx]+=rtk->opt.prn[0]*rtk->opt.prn[0]*fabs(tt);
 			slip = rtk->ssat[sat[i] - 1].slip[fidx[f]];
 			if (rtk->opt.ionoopt == IONOOPT_IFLC) slip |= rtk->ssat[sat[i] - 1].slip[fidx[1]];
@@ -907,23 +911,120 @@ static void udbias(rtk_t *rtk, double tt, const obsd_t *obs, const int *sat,
                 C2=-SQR(lam1)/(SQR(lam2)-SQR(lam1));
                 bias[i]=(C1*lam1*cp1+C2*lam2*cp2)-(C1*pr1+C2*pr2);
             }
-            if (rtk->x[IB(sat[i],f,&rtk->opt)]!=0.0) {
-                offset+=bias[i]-rtk->x[IB(sat[i],f,&rtk->opt)];
+            if (rtk->x[IB(sat[i],f,rtk)]!=0.0) {
+                offset+=bias[i]-rtk->x[IB(sat[i],f,rtk)];
                 j++;
             }
         }
         /* correct phase-bias offset to enssure phase-code coherency */
         if (j>0) {
-            for (i=1;i<=MAXSAT;i++) {
-                if (rtk->x[IB(i,f,&rtk->opt)]!=0.0) rtk->x[IB(i,f,&rtk->opt)]+=offset/j;
+            for (i=0;i<rtk->nslot;i++) {
+                k=IB(rtk->slotsat[i],f,rtk);
+                if (rtk->x[k]!=0.0) rtk->x[k]+=offset/j;
             }
         }
         /* set initial states of phase-bias */
         for (i=0;i<ns;i++) {
-            if (bias[i]==0.0||rtk->x[IB(sat[i],f,&rtk->opt)]!=0.0) continue;
-            initx(rtk,bias[i],SQR(rtk->opt.std[0]),IB(sat[i],f,&rtk->opt));
+            if (bias[i]==0.0||rtk->x[IB(sat[i],f,rtk)]!=0.0) continue;
+            initx(rtk,bias[i],SQR(rtk->opt.std[0]),IB(sat[i],f,rtk));
         }
-        free(bias);
+        matfree(bias);
+    }
+}
+/* state indices of state slot ----------------------------------------------*/
+static int slotstate(const rtk_t *rtk, int slot, int *index)
+{
+    int f,n=0;
+    
+    if (NI(&rtk->opt)>0) index[n++]=NP(&rtk->opt)+slot;
+    if (NB(&rtk->opt)>0) {
+        for (f=0;f<NF(&rtk->opt);f++) index[n++]=NR(&rtk->opt)+MAXSTSLOT*f+slot;
+    }
+    return n;
+}
+/* clear state ---------------------------------------------------------------*/
+static void clearstate(rtk_t *rtk, int i)
+{
+    int j;
+    
+    initx(rtk,0.0,0.0,i);
+    if (i>=rtk->na) return;
+    rtk->xa[i]=0.0;
+    for (j=0;j<rtk->na;j++) rtk->Pa[i+j*rtk->na]=rtk->Pa[j+i*rtk->na]=0.0;
+}
+/* move state and its covariance to cleared state ----------------------------*/
+static void movestate(rtk_t *rtk, int i, int j)
+{
+    int k,nx=rtk->nx,na=rtk->na;
+    
+    rtk->x[j]=rtk->x[i];
+    for (k=0;k<nx;k++) rtk->P[j+k*nx]=rtk->P[i+k*nx];
+    for (k=0;k<nx;k++) rtk->P[k+j*nx]=rtk->P[k+i*nx];
+    if (i<na&&j<na) {
+        rtk->xa[j]=rtk->xa[i];
+        for (k=0;k<na;k++) rtk->Pa[j+k*na]=rtk->Pa[i+k*na];
+        for (k=0;k<na;k++) rtk->Pa[k+j*na]=rtk->Pa[k+i*na];
+    }
+    clearstate(rtk,i);
+}
+/* release state slot of satellite -------------------------------------------
+* clear the states of the slot and move the last slot into it to keep the
+* used slots packed
+*-----------------------------------------------------------------------------*/
+static void freeslot(rtk_t *rtk, int sat)
+{
+    int i,n,slot=rtk->islot[sat-1],last=rtk->nslot-1;
+    int index[1+NFREQ],ilast[1+NFREQ];
+    
+    trace(4,"freeslot: sat=%3d slot=%d\n",sat,slot);
+    
+    n=slotstate(rtk,slot,index);
+    slotstate(rtk,last,ilast);
+    for (i=0;i<n;i++) clearstate(rtk,index[i]);
+    
+    if (slot<last) {
+        for (i=0;i<n;i++) movestate(rtk,ilast[i],index[i]);
+        rtk->slotsat[slot]=rtk->slotsat[last];
+        rtk->islot[rtk->slotsat[slot]-1]=slot;
+    }
+    rtk->islot[sat-1]=-1;
+    rtk->slotsat[last]=0;
+    rtk->nslot--;
+}
+/* update state slots of satellites ------------------------------------------
+* release the slots without initialized states and allocate the slots of the
+* satellites used in the epoch. if no slot is free, the slot of the untracked
+* satellite with the longest outage is released
+*-----------------------------------------------------------------------------*/
+static void udslot(rtk_t *rtk, const int *sat, int ns)
+{
+    unsigned char used[MAXSAT]={0};
+    int i,j,k,n,index[1+NFREQ];
+    
+    trace(3,"udslot  : ns=%d nslot=%d\n",ns,rtk->nslot);
+    
+    for (i=0;i<ns;i++) used[sat[i]-1]=1;
+    
+    for (i=rtk->nslot-1;i>=0;i--) {
+        if (used[rtk->slotsat[i]-1]) continue;
+        n=slotstate(rtk,i,index);
+        for (j=0;j<n;j++) if (rtk->x[index[j]]!=0.0) break;
+        if (j>=n) freeslot(rtk,rtk->slotsat[i]);
+    }
+    for (i=0;i<ns;i++) {
+        if (rtk->islot[sat[i]-1]>=0) continue;
+        
+        if (rtk->nslot>=MAXSTSLOT) {
+            for (j=0,k=-1;j<rtk->nslot;j++) {
+                if (used[rtk->slotsat[j]-1]) continue;
+                if (k<0||rtk->ssat[rtk->slotsat[j]-1].outc[0]>
+                         rtk->ssat[rtk->slotsat[k]-1].outc[0]) k=j;
+            }
+            if (k<0) continue;
+            freeslot(rtk,rtk->slotsat[k]);
+        }
+        rtk->islot[sat[i]-1]=rtk->nslot;
+        rtk->slotsat[rtk->nslot++]=sat[i];
     }
 }
 /* temporal update of states --------------------------------------------------*/
@@ -934,6 +1035,9 @@ static void udstate(rtk_t *rtk, const obsd_t *obs, const int *sat,
     
     trace(3,"udstate : ns=%d\n",ns);
     
+    /* update state slots of satellites */
+    udslot(rtk,sat,ns);
+    
     /* temporal update of position/velocity/acceleration */
     udpos(rtk,tt);
     
@@ -1010,7 +1114,7 @@ static int zdres(int base, const obsd_t *obs, int n, const double *rs,
                  int index, double *y, double *e, double *azel)
 {
     double r,rr_[3],pos[3],dant[NFREQ]={0},disp[3];
-    double zhd,zazel[]={0.0,90.0*D2R};
+    tropctx_t trc;
     int i,nf=NF(opt);
 	int sys;
     trace(3,"zdres   : n=%d\n",n);
@@ -1023,12 +1127,18 @@ static int zdres(int base, const obsd_t *obs, int n, const double *rs,
     
     /* earth tide correction */
     if (opt->tidecorr) {
-        tidedisp(gpst2utc(obs[0].time),rr_,opt->tidecorr,&nav->erp,
-                 opt->odisp[base],disp);
+        if (!tidegrid_disp(nav->tgrid,base,gpst2utc(obs[0].time),rr_,
+                           opt->tidecorr,disp)) {
+            tidedisp(gpst2utc(obs[0].time),rr_,opt->tidecorr,&nav->erp,
+                     opt->odisp[base],disp);
+        }
         for (i=0;i<3;i++) rr_[i]+=disp[i];
     }
     ecef2pos(rr_,pos);
     
+    /* receiver troposphere terms of the epoch */
+    inittropctx(&trc,obs[0].time,pos,0.0);
+    
     for (i=0;i<n;i++) {
         /* compute geometric-range and azimuth/elevation angle */
 		sys = satsys(obs[i].sat, NULL);
@@ -1042,8 +1152,7 @@ static int zdres(int base, const obsd_t *obs, int n, const double *rs,
         r+=-CLIGHT*dts[i*2];
         
         /* troposphere delay model (hydrostatic) */
-        zhd=tropmodel(obs[0].time,pos,zazel,0.0);
-        r+=tropmapf(obs[i].time,pos,azel+i*2,NULL)*zhd;
+        r+=tropmapfc(&trc,azel+i*2,NULL)*trc.zhd;
         
         /* receiver antenna phase center correction */
         antmodel(opt->pcvr+index,opt->antdel[index],azel+i*2,opt->posopt[1],
@@ -1134,16 +1243,12 @@ static int constbl(rtk_t *rtk, const double *x, const double *P, double *v,
     return 1;
 }
 /* precise tropspheric model -------------------------------------------------*/
-static double prectrop(gtime_t time, const double *pos, int r,
-                       const double *azel, const prcopt_t *opt, const double *x,
-                       double *dtdx)
+static double prectrop(double m_w, int r, const double *azel,
+                       const prcopt_t *opt, const double *x, double *dtdx)
 {
-    double m_w=0.0,cotz,grad_n,grad_e;
+    double cotz,grad_n,grad_e;
     int i=IT(r,opt);
     
-    /* wet mapping function */
-    tropmapf(time,pos,azel,&m_w);
-    
     if (opt->tropopt>=TROPOPT_ESTG&&azel[1]>0.0) {
         
         /* m_w=m_0+m_0*cot(el)*(Gn*cos(az)+Ge*sin(az)): ref [6] */
@@ -1227,6 +1332,8 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x,
     prcopt_t *opt=&rtk->opt;
     double bl,dr[3],posu[3],posr[3],didxi=0.0,didxj=0.0,*im;
     double *tropr,*tropu,*dtdxr,*dtdxu,*Ri,*Rj,lami,lamj,fi,fj,df,*Hi=NULL;
+    double azelu[MAXSAT*2],azelr[MAXSAT*2],mwu[MAXSAT],mwr[MAXSAT];
+    tropctx_t trcu,trcr;
     int i,j,k,m,f,ff,nv=0,nb[NFREQ*4*2+2]={0},b=0,sysi,sysj,nf=NF(opt);
 	int fidx[MAXFREQ] = { 0 };
 
@@ -1242,15 +1349,26 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x,
         rtk->ssat[i].resp[j]=rtk->ssat[i].resc[j]=0.0;
     }
 	frqidx(rtk->opt, fidx);
-    /* compute factors of ionospheric and tropospheric delay */
+    /* wet mapping functions of rover and base in a pass over satellites */
+    if (opt->tropopt>=TROPOPT_EST) {
+        for (i=0;i<ns;i++) {
+            azelu[i*2]=azel[iu[i]*2]; azelu[1+i*2]=azel[1+iu[i]*2];
+            azelr[i*2]=azel[ir[i]*2]; azelr[1+i*2]=azel[1+ir[i]*2];
+        }
+        inittropctx(&trcu,rtk->sol.time,posu,0.0);
+        inittropctx(&trcr,rtk->sol.time,posr,0.0);
+        tropmapfs(&trcu,azelu,ns,NULL,mwu);
+        tropmapfs(&trcr,azelr,ns,NULL,mwr);
+        for (i=0;i<ns;i++) {
+            tropu[i]=prectrop(mwu[i],0,azel+iu[i]*2,opt,x,dtdxu+i*3);
+            tropr[i]=prectrop(mwr[i],1,azel+ir[i]*2,opt,x,dtdxr+i*3);
+        }
+    }
+    /* compute factors of ionospheric delay */
     for (i=0;i<ns;i++) {
         if (opt->ionoopt>=IONOOPT_EST) {
             im[i]=(ionmapf(posu,azel+iu[i]*2)+ionmapf(posr,azel+ir[i]*2))/2.0;
         }
-        if (opt->tropopt>=TROPOPT_EST) {
-            tropu[i]=prectrop(rtk->sol.time,posu,0,azel+iu[i]*2,opt,x,dtdxu+i*3);
-            tropr[i]=prectrop(rtk->sol.time,posr,1,azel+ir[i]*2,opt,x,dtdxr+i*3);
-        }
     }
     for (m=0;m<5;m++) /* m=0:gps/sbs,1:glo,2:gal,3:bds,4:qzs */
     
@@ -1296,10 +1414,10 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x,
                 fi=lami/lam_carr[0]; fj=lamj/lam_carr[0];
                 didxi=(f<nf?-1.0:1.0)*fi*fi*im[i];
                 didxj=(f<nf?-1.0:1.0)*fj*fj*im[j];
-                v[nv]-=didxi*x[II(sat[i],opt)]-didxj*x[II(sat[j],opt)];
+                v[nv]-=didxi*x[II(sat[i],rtk)]-didxj*x[II(sat[j],rtk)];
                 if (H) {
-                    Hi[II(sat[i],opt)]= didxi;
-                    Hi[II(sat[j],opt)]=-didxj;
+                    Hi[II(sat[i],rtk)]= didxi;
+                    Hi[II(sat[j],rtk)]=-didxj;
                 }
             }
             /* double-differenced tropospheric delay term */
@@ -1314,17 +1432,17 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x,
             /* double-differenced phase-bias term */
             if (f<nf) {
                 if (opt->ionoopt!=IONOOPT_IFLC) {
-                    v[nv]-=lami*x[IB(sat[i],f,opt)]-lamj*x[IB(sat[j],f,opt)];
+                    v[nv]-=lami*x[IB(sat[i],f,rtk)]-lamj*x[IB(sat[j],f,rtk)];
                     if (H) {
-                        Hi[IB(sat[i],f,opt)]= lami;
-                        Hi[IB(sat[j],f,opt)]=-lamj;
+                        Hi[IB(sat[i],f,rtk)]= lami;
+                        Hi[IB(sat[j],f,rtk)]=-lamj;
                     }
                 }
                 else {
-                    v[nv]-=x[IB(sat[i],f,opt)]-x[IB(sat[j],f,opt)];
+                    v[nv]-=x[IB(sat[i],f,rtk)]-x[IB(sat[j],f,rtk)];
                     if (H) {
-                        Hi[IB(sat[i],f,opt)]= 1.0;
-                        Hi[IB(sat[j],f,opt)]=-1.0;
+                        Hi[IB(sat[i],f,rtk)]= 1.0;
+                        Hi[IB(sat[j],f,rtk)]=-1.0;
                     }
                 }
             }
@@ -1401,8 +1519,8 @@ static int ddres(rtk_t *rtk, const nav_t *nav, double dt, const double *x,
     /* double-differenced measurement error covariance */
     ddcov(nb,b,Ri,Rj,nv,R);
     
-    free(Ri); free(Rj); free(im);
-    free(tropu); free(tropr); free(dtdxu); free(dtdxr);
+    matfree(Ri); matfree(Rj); matfree(im);
+    matfree(tropu); matfree(tropr); matfree(dtdxu); matfree(dtdxr);
     
     return nv;
 }
@@ -1442,7 +1560,7 @@ static double intpres(gtime_t time, const obsd_t *obs, int n, const nav_t *nav,
     return fabs(ttb)>fabs(tt)?ttb:tt;
 }
 /* single to double-difference transformation matrix (D') --------------------*/
-static int ddmat(rtk_t *rtk, double *D)
+static int ddmat(rtk_t *rtk, double *D, int *ix)
 {
     int i,j,k,m,f,nb=0,nx=rtk->nx,na=rtk->na,nf=NF(&rtk->opt),nofix;
 	int fidx[MAXFREQ];
@@ -1459,34 +1577,38 @@ static int ddmat(rtk_t *rtk, double *D)
         
         nofix=(m==1&&rtk->opt.glomodear==0)||(m==3&&rtk->opt.bdsmodear==0);
         
-        for (f=0,k=na;f<nf;f++,k+=MAXSAT) {
+        for (f=0;f<nf;f++) {
             
-            for (i=k;i<k+MAXSAT;i++) {
-                if (rtk->x[i]==0.0||!test_sys(rtk->ssat[i-k].sys,m)||
-                    !rtk->ssat[i-k].vsat[fidx[f]]||!rtk->ssat[i-k].half[fidx[f]]) {
+            /* reference satellite (k: state index, -1: none) */
+            for (i=0,k=-1;i<MAXSAT;i++) {
+                if (rtk->islot[i]<0||rtk->x[IB(i+1,f,rtk)]==0.0||
+                    !test_sys(rtk->ssat[i].sys,m)||
+                    !rtk->ssat[i].vsat[fidx[f]]||!rtk->ssat[i].half[fidx[f]]) {
                     continue;
                 }
-                if (rtk->ssat[i-k].lock[fidx[f]]>0&&!(rtk->ssat[i-k].slip[fidx[f]]&2)&&
-                    rtk->ssat[i-k].azel[1]>=rtk->opt.elmaskar&&!nofix) {
-                    rtk->ssat[i-k].fix[fidx[f]]=2; /* fix */
+                if (rtk->ssat[i].lock[fidx[f]]>0&&!(rtk->ssat[i].slip[fidx[f]]&2)&&
+                    rtk->ssat[i].azel[1]>=rtk->opt.elmaskar&&!nofix) {
+                    rtk->ssat[i].fix[fidx[f]]=2; /* fix */
+                    k=IB(i+1,f,rtk);
                     break;
                 }
-                else rtk->ssat[i-k].fix[fidx[f]]=1;
+                else rtk->ssat[i].fix[fidx[f]]=1;
             }
-            for (j=k;j<k+MAXSAT;j++) {
-                if (i==j||rtk->x[j]==0.0||!test_sys(rtk->ssat[j-k].sys,m)||
-                    !rtk->ssat[j-k].vsat[fidx[f]]) {
+            for (j=0;j<MAXSAT;j++) {
+                if (i==j||rtk->islot[j]<0||rtk->x[IB(j+1,f,rtk)]==0.0||
+                    !test_sys(rtk->ssat[j].sys,m)||!rtk->ssat[j].vsat[fidx[f]]) {
                     continue;
                 }
-                if (rtk->ssat[j-k].lock[fidx[f]]>0&&!(rtk->ssat[j-k].slip[fidx[f]]&2)&&
-                    rtk->ssat[i-k].vsat[fidx[f]]&&
-                    rtk->ssat[j-k].azel[1]>=rtk->opt.elmaskar&&!nofix) {
-                    D[i+(na+nb)*nx]= 1.0;
-                    D[j+(na+nb)*nx]=-1.0;
+                if (k>=0&&rtk->ssat[j].lock[fidx[f]]>0&&!(rtk->ssat[j].slip[fidx[f]]&2)&&
+                    rtk->ssat[i].vsat[fidx[f]]&&
+                    rtk->ssat[j].azel[1]>=rtk->opt.elmaskar&&!nofix) {
+                    D[k+(na+nb)*nx]= 1.0;
+                    D[IB(j+1,f,rtk)+(na+nb)*nx]=-1.0;
+                    ix[nb*2]=j; ix[nb*2+1]=fidx[f]; /* satellite and frequency */
                     nb++;
-                    rtk->ssat[j-k].fix[fidx[f]]=2; /* fix */
+                    rtk->ssat[j].fix[fidx[f]]=2; /* fix */
                 }
-                else rtk->ssat[j-k].fix[fidx[f]]=1;
+                else rtk->ssat[j].fix[fidx[f]]=1;
             }
         }
     }
@@ -1496,7 +1618,7 @@ static int ddmat(rtk_t *rtk, double *D)
 /* restore single-differenced ambiguity --------------------------------------*/
 static void restamb(rtk_t *rtk, const double *bias, int nb, double *xa)
 {
-    int i,n,m,f,index[MAXSAT],nv=0,nf=NF(&rtk->opt);
+    int i,n,m,f,index[MAXSTSLOT],nv=0,nf=NF(&rtk->opt);
     
     trace(3,"restamb :\n");
     
@@ -1506,10 +1628,11 @@ static void restamb(rtk_t *rtk, const double *bias, int nb, double *xa)
     for (m=0;m<5;m++) for (f=0;f<nf;f++) {
         
         for (n=i=0;i<MAXSAT;i++) {
-            if (!test_sys(rtk->ssat[i].sys,m)||rtk->ssat[i].fix[f]!=2) {
+            if (!test_sys(rtk->ssat[i].sys,m)||rtk->ssat[i].fix[f]!=2||
+                rtk->islot[i]<0) {
                 continue;
             }
-            index[n++]=IB(i+1,f,&rtk->opt);
+            index[n++]=IB(i+1,f,rtk);
         }
         if (n<2) continue;
         
@@ -1524,7 +1647,7 @@ static void restamb(rtk_t *rtk, const double *bias, int nb, double *xa)
 static void holdamb(rtk_t *rtk, const double *xa)
 {
     double *v,*H,*R;
-    int i,n,m,f,info,index[MAXSAT],nb=rtk->nx-rtk->na,nv=0,nf=NF(&rtk->opt);
+    int i,n,m,f,info,index[MAXSTSLOT],nb=rtk->nx-rtk->na,nv=0,nf=NF(&rtk->opt);
 	int fidx[MAXFREQ];
     trace(3,"holdamb :\n");
     
@@ -1535,10 +1658,10 @@ static void holdamb(rtk_t *rtk, const double *xa)
         
         for (n=i=0;i<MAXSAT;i++) {
             if (!test_sys(rtk->ssat[i].sys,m)||rtk->ssat[i].fix[fidx[f]]!=2||
-                rtk->ssat[i].azel[1]<rtk->opt.elmaskhold) {
+                rtk->ssat[i].azel[1]<rtk->opt.elmaskhold||rtk->islot[i]<0) {
                 continue;
             }
-            index[n++]=IB(i+1,f,&rtk->opt);
+            index[n++]=IB(i+1,f,rtk);
 			rtk->ssat[i].fix[fidx[f]] = 3; /* hold */
         }
         /* constraint to fixed ambiguity */
@@ -1558,15 +1681,58 @@ static void holdamb(rtk_t *rtk, const double *xa)
         if ((info=filter(rtk->x,rtk->P,H,v,R,rtk->nx,nv))) {
             errmsg(rtk,"filter error (info=%d)\n",info);
         }
-        free(R);
+        matfree(R);
+    }
+    matfree(v); matfree(H);
+}
+/* partial ambiguity resolution ------------------------------------------------
+* fix the largest subset of double-differenced ambiguities in the order of
+* elevation or variance passing the success rate and the ratio-test (the full
+* set by the ratio-test only if no subset reaches the success rate). the
+* ambiguities, the covariances and the fixed solutions are packed to the fixed
+* ones and the fix flags of the others are cleared.
+*-----------------------------------------------------------------------------*/
+static int parlambda(rtk_t *rtk, const int *ix, int na, int nb, double *y,
+                     double *Qb, double *Qab, double *b, double *s)
+{
+    prcopt_t *opt=&rtk->opt;
+    double *F,*key;
+    int i,j,k,n,*ord,*fix,*idx;
+    
+    ord=imat(nb,1); fix=imat(nb,1); idx=imat(nb,1); F=mat(nb,2); key=mat(nb,1);
+    
+    /* order of priority (elevation descending or variance ascending) */
+    for (i=0;i<nb;i++) {
+        key[i]=opt->arpartial==ARPAR_ELEV?-rtk->ssat[ix[i*2]].azel[1]:Qb[i+i*nb];
+        for (j=i;j>0&&key[ord[j-1]]>key[i];j--) ord[j]=ord[j-1];
+        ord[j]=i;
+    }
+    n=lambda_par(nb,2,y+na,Qb,ord,MIN(MINAMBPAR,nb),opt->arpsucc,
+                 opt->thresar[0],opt->nthread,F,s,fix);
+    
+    if (n>0) {
+        /* pack fixed ambiguities in order of double-difference */
+        for (i=k=0;i<nb;i++) {
+            if (fix[i]) idx[k++]=i;
+            else rtk->ssat[ix[i*2]].fix[ix[i*2+1]]=1;
+        }
+        for (i=0;i<n;i++) {
+            y[na+i]=y[na+idx[i]]; b[i]=F[idx[i]]; b[i+n]=F[idx[i]+nb];
+        }
+        for (j=0;j<n;j++) {
+            for (i=0;i<n ;i++) Qb [i+j*n ]=Qb [idx[i]+idx[j]*nb];
+            for (i=0;i<na;i++) Qab[i+j*na]=Qab[i+idx[j]*na];
+        }
+        trace(3,"parlambda: nb=%d nfix=%d\n",nb,n);
     }
-    free(v); free(H);
+    matfree(ord); matfree(fix); matfree(idx); matfree(F); matfree(key);
+    return n;
 }
 /* resolve integer ambiguity by LAMBDA ---------------------------------------*/
 static int resamb_LAMBDA(rtk_t *rtk, double *bias, double *xa)
 {
     prcopt_t *opt=&rtk->opt;
-    int i,j,ny,nb,info,nx=rtk->nx,na=rtk->na;
+    int i,j,ny,nb,info,nx=rtk->nx,na=rtk->na,*ix;
     double *D,*DP,*y,*Qy,*b,*db,*Qb,*Qab,*QQ,s[2];
     
     trace(3,"resamb_LAMBDA : nx=%d\n",nx);
@@ -1578,10 +1744,10 @@ static int resamb_LAMBDA(rtk_t *rtk, double *bias, double *xa)
         return 0;
     }
     /* single to double-difference transformation matrix (D') */
-    D=zeros(nx,nx);
-    if ((nb=ddmat(rtk,D))<=0) {
+    D=zeros(nx,nx); ix=imat(nx,2);
+    if ((nb=ddmat(rtk,D,ix))<=0) {
         errmsg(rtk,"no valid double-difference\n");
-        free(D);
+        matfree(D); matfree(ix);
         return 0;
     }
     ny=na+nb; y=mat(ny,1); Qy=mat(ny,ny); DP=mat(ny,nx);
@@ -1599,7 +1765,15 @@ static int resamb_LAMBDA(rtk_t *rtk, double *bias, double *xa)
     trace(4,"N(0)="); tracemat(4,y+na,1,nb,10,3);
     
     /* lambda/mlambda integer least-square estimation */
-    if (!(info=lambda(nb,2,y+na,Qb,b,s))) {
+    if (opt->arpartial!=ARPAR_OFF) {
+        
+        /* partial ambiguity resolution (nb: number of fixed ambiguities) */
+        if ((i=parlambda(rtk,ix,na,nb,y,Qb,Qab,b,s))>0) nb=i;
+        info=i>0||(i==0&&s[0]>0.0)?0:-1;
+    }
+    else info=lambda(nb,2,y+na,Qb,b,s);
+    
+    if (!info) {
         
         trace(4,"N(1)="); tracemat(4,b   ,1,nb,10,3);
         trace(4,"N(2)="); tracemat(4,b+nb,1,nb,10,3);
@@ -1644,8 +1818,9 @@ static int resamb_LAMBDA(rtk_t *rtk, double *bias, double *xa)
     else {
         errmsg(rtk,"lambda error (info=%d)\n",info);
     }
-    free(D); free(y); free(Qy); free(DP);
-    free(b); free(db); free(Qb); free(Qab); free(QQ);
+    matfree(D); matfree(y); matfree(Qy); matfree(DP);
+    matfree(b); matfree(db); matfree(Qb); matfree(Qab); matfree(QQ);
+    matfree(ix);
     
     return nb; /* number of ambiguities */
 }
@@ -1733,7 +1908,7 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
                y+nu*nf*2,e+nu*3,azel+nu*2)) {
         errmsg(rtk,"initial base station position error\n");
         
-        free(rs); free(dts); free(var); free(y); free(e); free(azel);
+        matfree(rs); matfree(dts); matfree(var); matfree(y); matfree(e); matfree(azel);
         return 0;
     }
     /* time-interpolation of residuals (for post-processing) */
@@ -1744,9 +1919,11 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
     if ((ns=selsat(obs,azel,nu,nr,opt,sat,iu,ir))<=0) {
         errmsg(rtk,"no common satellite\n");
         
-        free(rs); free(dts); free(var); free(y); free(e); free(azel);
+        matfree(rs); matfree(dts); matfree(var); matfree(y); matfree(e); matfree(azel);
         return 0;
     }
+    if (ns>MAXSTSLOT) ns=MAXSTSLOT;
+    
     /* temporal update of states */
     udstate(rtk,obs,sat,iu,ir,ns,nav);
     
@@ -1898,8 +2075,8 @@ static int relpos(rtk_t *rtk, const obsd_t *obs, int nu, int nr,
         if (rtk->ssat[i].fix[fidx[j]]==2&&stat!=SOLQ_FIX) rtk->ssat[i].fix[fidx[j]]=1;
         if (rtk->ssat[i].slip[fidx[j]]&1) rtk->ssat[i].slipc[fidx[j]]++;
     }
-    free(rs); free(dts); free(var); free(y); free(e); free(azel);
-    free(xp); free(Pp);  free(xa);  free(v); free(H); free(R); free(bias);
+    matfree(rs); matfree(dts); matfree(var); matfree(y); matfree(e); matfree(azel);
+    matfree(xp); matfree(Pp);  matfree(xa);  matfree(v); matfree(H); matfree(R); matfree(bias);
     
     if (stat!=SOLQ_NONE) rtk->sol.stat=stat;
     
@@ -1916,6 +2093,7 @@ extern void rtkinit(rtk_t *rtk, const prcopt_t *opt)
     sol_t sol0={{0}};
     ambc_t ambc0={{{0}}};
     ssat_t ssat0={0};
+    matarena_t arena0={0};
     int i;
     
     trace(3,"rtkinit :\n");
@@ -1933,8 +2111,13 @@ extern void rtkinit(rtk_t *rtk, const prcopt_t *opt)
     for (i=0;i<MAXSAT;i++) {
         rtk->ambc[i]=ambc0;
         rtk->ssat[i]=ssat0;
+        rtk->islot[i]=-1;
     }
+    for (i=0;i<MAXSTSLOT;i++) rtk->slotsat[i]=0;
+    rtk->nslot=0;
     for (i=0;i<MAXERRMSG;i++) rtk->errbuf[i]=0;
+    rtk->arena=arena0;
+    rtk->arena.top=(size_t)-1;
     rtk->opt=*opt;
 }
 /* free rtk control ------------------------------------------------------------
@@ -1951,66 +2134,10 @@ extern void rtkfree(rtk_t *rtk)
     free(rtk->P ); rtk->P =NULL;
     free(rtk->xa); rtk->xa=NULL;
     free(rtk->Pa); rtk->Pa=NULL;
+    matarena_free(&rtk->arena);
 }
-/* precise positioning ---------------------------------------------------------
-* input observation data and navigation message, compute rover position by 
-* precise positioning
-* args   : rtk_t *rtk       IO  rtk control/result struct
-*            rtk->sol       IO  solution
-*                .time      O   solution time
-*                .rr[]      IO  rover position/velocity
-*                               (I:fixed mode,O:single mode)
-*                .dtr[0]    O   receiver clock bias (s)
-*                .dtr[1]    O   receiver glonass-gps time offset (s)
-*                .Qr[]      O   rover position covarinace
-*                .stat      O   solution status (SOLQ_???)
-*                .ns        O   number of valid satellites
-*                .age       O   age of differential (s)
-*                .ratio     O   ratio factor for ambiguity validation
-*            rtk->rb[]      IO  base station position/velocity
-*                               (I:relative mode,O:moving-base mode)
-*            rtk->nx        I   number of all states
-*            rtk->na        I   number of integer states
-*            rtk->ns        O   number of valid satellite
-*            rtk->tt        O   time difference between current and previous (s)
-*            rtk->x[]       IO  float states pre-filter and post-filter
-*            rtk->P[]       IO  float covariance pre-filter and post-filter
-*            rtk->xa[]      O   fixed states after AR
-*            rtk->Pa[]      O   fixed covariance after AR
-*            rtk->ssat[s]   IO  sat(s+1) status
-*                .sys       O   system (SYS_???)
-*                .az   [r]  O   azimuth angle   (rad) (r=0:rover,1:base)
-*                .el   [r]  O   elevation angle (rad) (r=0:rover,1:base)
-*                .vs   [r]  O   data valid single     (r=0:rover,1:base)
-*                .resp [f]  O   freq(f+1) pseudorange residual (m)
-*                .resc [f]  O   freq(f+1) carrier-phase residual (m)
-*                .vsat [f]  O   freq(f+1) data vaild (0:invalid,1:valid)
-*                .fix  [f]  O   freq(f+1) ambiguity flag
-*                               (0:nodata,1:float,2:fix,3:hold)
-*                .slip [f]  O   freq(f+1) slip flag
-*                               (bit8-7:rcv1 LLI, bit6-5:rcv2 LLI,
-*                                bit2:parity unknown, bit1:slip)
-*                .lock [f]  IO  freq(f+1) carrier lock count
-*                .outc [f]  IO  freq(f+1) carrier outage count
-*                .slipc[f]  IO  freq(f+1) cycle slip count
-*                .rejc [f]  IO  freq(f+1) data reject count
-*                .gf        IO  geometry-free phase (L1-L2) (m)
-*                .gf2       IO  geometry-free phase (L1-L5) (m)
-*            rtk->nfix      IO  number of continuous fixes of ambiguity
-*            rtk->neb       IO  bytes of error message buffer
-*            rtk->errbuf    IO  error message buffer
-*            rtk->tstr      O   time string for debug
-*            rtk->opt       I   processing options
-*          obsd_t *obs      I   observation data for an epoch
-*                               obs[i].rcv=1:rover,2:reference
-*                               sorted by receiver and satellte
-*          int    n         I   number of observation data
-*          nav_t  *nav      I   navigation messages
-* return : status (0:no solution,1:valid solution)
-* notes  : before calling function, base station position rtk->sol.rb[] should
-*          be properly set for relative mode except for moving-baseline
-*-----------------------------------------------------------------------------*/
-extern int rtkpos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
+/* precise positioning for an epoch -----------------------------------------*/
+static int rtkpos_(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
 {
     prcopt_t *opt=&rtk->opt;
     sol_t solb={{0}};
@@ -2097,3 +2224,75 @@ extern int rtkpos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
     
     return 1;
 }
+/* precise positioning ---------------------------------------------------------
+* input observation data and navigation message, compute rover position by 
+* precise positioning
+* args   : rtk_t *rtk       IO  rtk control/result struct
+*            rtk->sol       IO  solution
+*                .time      O   solution time
+*                .rr[]      IO  rover position/velocity
+*                               (I:fixed mode,O:single mode)
+*                .dtr[0]    O   receiver clock bias (s)
+*                .dtr[1]    O   receiver glonass-gps time offset (s)
+*                .Qr[]      O   rover position covarinace
+*                .stat      O   solution status (SOLQ_???)
+*                .ns        O   number of valid satellites
+*                .age       O   age of differential (s)
+*                .ratio     O   ratio factor for ambiguity validation
+*            rtk->rb[]      IO  base station position/velocity
+*                               (I:relative mode,O:moving-base mode)
+*            rtk->nx        I   number of all states
+*            rtk->na        I   number of integer states
+*            rtk->ns        O   number of valid satellite
+*            rtk->tt        O   time difference between current and previous (s)
+*            rtk->x[]       IO  float states pre-filter and post-filter
+*            rtk->P[]       IO  float covariance pre-filter and post-filter
+*            rtk->xa[]      O   fixed states after AR
+*            rtk->Pa[]      O   fixed covariance after AR
+*            rtk->ssat[s]   IO  sat(s+1) status
+*                .sys       O   system (SYS_???)
+*                .az   [r]  O   azimuth angle   (rad) (r=0:rover,1:base)
+*                .el   [r]  O   elevation angle (rad) (r=0:rover,1:base)
+*                .vs   [r]  O   data valid single     (r=0:rover,1:base)
+*                .resp [f]  O   freq(f+1) pseudorange residual (m)
+*                .resc [f]  O   freq(f+1) carrier-phase residual (m)
+*                .vsat [f]  O   freq(f+1) data vaild (0:invalid,1:valid)
+*                .fix  [f]  O   freq(f+1) ambiguity flag
+*                               (0:nodata,1:float,2:fix,3:hold)
+*                .slip [f]  O   freq(f+1) slip flag
+*                               (bit8-7:rcv1 LLI, bit6-5:rcv2 LLI,
+*                                bit2:parity unknown, bit1:slip)
+*                .lock [f]  IO  freq(f+1) carrier lock count
+*                .outc [f]  IO  freq(f+1) carrier outage count
+*                .slipc[f]  IO  freq(f+1) cycle slip count
+*                .rejc [f]  IO  freq(f+1) data reject count
+*                .gf        IO  geometry-free phase (L1-L2) (m)
+*                .gf2       IO  geometry-free phase (L1-L5) (m)
+*            rtk->nfix      IO  number of continuous fixes of ambiguity
+*            rtk->neb       IO  bytes of error message buffer
+*            rtk->errbuf    IO  error message buffer
+*            rtk->tstr      O   time string for debug
+*            rtk->opt       I   processing options
+*          obsd_t *obs      I   observation data for an epoch
+*                               obs[i].rcv=1:rover,2:reference
+*                               sorted by receiver and satellte
+*          int    n         I   number of observation data
+*          nav_t  *nav      I   navigation messages
+* return : status (0:no solution,1:valid solution)
+* notes  : before calling function, base station position rtk->sol.rb[] should
+*          be properly set for relative mode except for moving-baseline
+*          the temporary matrices of the epoch are allocated in rtk->arena
+*          and released all together at the end of the epoch
+*-----------------------------------------------------------------------------*/
+extern int rtkpos(rtk_t *rtk, const obsd_t *obs, int n, const nav_t *nav)
+{
+    matarena_t *arena;
+    int stat;
+    
+    /* temporary matrices of the epoch in the arena of rtk */
+    arena=matarena(&rtk->arena);
+    stat=rtkpos_(rtk,obs,n,nav);
+    matarena(arena);
+    matarena_reset(&rtk->arena);
+    return stat;
+}
@@ -411,6 +411,27 @@ static int decode_sbstype26(const sbsmsg_t *msg, sbsion_t *sbsion)
     trace(5,"decode_sbstype26: band=%d block=%d\n",band,block);
     return 1;
 }
+/* index igps on lat/lon grid -----------------------------------------------*/
+static void indexigp(nav_t *nav)
+{
+    const sbsigp_t *p;
+    short *q;
+    int i,j,k;
+    
+    memset(&nav->sbsigpidx,0,sizeof(sbsigpidx_t));
+    
+    for (i=0;i<=MAXBAND;i++) {
+        for (j=0;j<nav->sbsion[i].nigp;j++) {
+            p=nav->sbsion[i].igp+j;
+            if (p->lat<-90||p->lat>90||p->lon<-180||p->lon>=180||
+                p->lat%5||p->lon%5) continue;
+            q=nav->sbsigpidx.igp[(p->lat+90)/5][(p->lon+180)/5];
+            k=q[0]?1:0;
+            if (q[k]) q[0]=q[1]; /* keep last two in band order */
+            q[k]=(short)(i*MAXNIGP+j+1);
+        }
+    }
+}
 /* update sbas corrections -----------------------------------------------------
 * update sbas correction parameters in navigation data with a sbas message
 * args   : sbsmg_t  *msg    I   sbas message
@@ -438,7 +459,8 @@ extern int sbsupdatecorr(const sbsmsg_t *msg, nav_t *nav)
         case  6: stat=decode_sbstype6 (msg,&nav->sbssat); break;
         case  7: stat=decode_sbstype7 (msg,&nav->sbssat); break;
         case  9: stat=decode_sbstype9 (msg,nav);          break;
-        case 18: stat=decode_sbstype18(msg,nav ->sbsion); break;
+        case 18: if ((stat=decode_sbstype18(msg,nav->sbsion))) indexigp(nav);
+                 break;
         case 24: stat=decode_sbstype24(msg,&nav->sbssat); break;
         case 25: stat=decode_sbstype25(msg,&nav->sbssat); break;
         case 26: stat=decode_sbstype26(msg,nav ->sbsion); break;
@@ -596,13 +618,21 @@ extern void sbsoutmsg(FILE *fp, sbsmsg_t *sbsmsg)
     for (i=0;i<29;i++) fprintf(fp,"%02X",sbsmsg->msg[i]);
     fprintf(fp,"\n");
 }
+/* igp entries at grid point -------------------------------------------------*/
+static const short *gridigp(const sbsigpidx_t *idx, int lat, int lon)
+{
+    if (lat<-90||lat>90||lon<-180||lon>=180||lat%5||lon%5) return NULL;
+    return idx->igp[(lat+90)/5][(lon+180)/5];
+}
 /* search igps ---------------------------------------------------------------*/
 static void searchigp(gtime_t time, const double *pos, const sbsion_t *ion,
-                      const sbsigp_t **igp, double *x, double *y)
+                      const sbsigpidx_t *idx, const sbsigp_t **igp, double *x,
+                      double *y)
 {
-    int i,latp[2],lonp[4];
+    int i,j,k,n=0,latp[2],lonp[4],id[8],slot[8];
     double lat=pos[0]*R2D,lon=pos[1]*R2D;
     const sbsigp_t *p;
+    const short *q;
     
     trace(4,"searchigp: pos=%.3f %.3f\n",pos[0]*R2D,pos[1]*R2D);
     
@@ -638,41 +668,36 @@ static void searchigp(gtime_t time, const double *pos, const sbsion_t *ion,
         }
     }
     for (i=0;i<4;i++) if (lonp[i]==180) lonp[i]=-180;
-    for (i=0;i<=MAXBAND;i++) {
-        for (p=ion[i].igp;p<ion[i].igp+ion[i].nigp;p++) {
-            if (p->t0.time==0) continue;
-            if      (p->lat==latp[0]&&p->lon==lonp[0]&&p->give>0) igp[0]=p;
-            else if (p->lat==latp[1]&&p->lon==lonp[1]&&p->give>0) igp[1]=p;
-            else if (p->lat==latp[0]&&p->lon==lonp[2]&&p->give>0) igp[2]=p;
-            else if (p->lat==latp[1]&&p->lon==lonp[3]&&p->give>0) igp[3]=p;
-            if (igp[0]&&igp[1]&&igp[2]&&igp[3]) return;
+    
+    /* valid igps at {ws,wn,es,en} sorted in mask order (band,index) */
+    for (i=0;i<4;i++) {
+        for (j=0;j<i;j++) if (latp[j%2]==latp[i%2]&&lonp[j]==lonp[i]) break;
+        if (j<i||!(q=gridigp(idx,latp[i%2],lonp[i]))) continue;
+        for (k=0;k<2;k++) {
+            if (!q[k]) continue;
+            p=ion[(q[k]-1)/MAXNIGP].igp+(q[k]-1)%MAXNIGP;
+            if (p->t0.time==0||p->give<=0) continue;
+            for (j=n++;j>0&&q[k]<id[j-1];j--) {
+                id[j]=id[j-1]; slot[j]=slot[j-1];
+            }
+            id[j]=q[k]; slot[j]=i;
         }
     }
+    /* later igps overwrite earlier ones until all four found */
+    for (i=0;i<n;i++) {
+        igp[slot[i]]=ion[(id[i]-1)/MAXNIGP].igp+(id[i]-1)%MAXNIGP;
+        if (igp[0]&&igp[1]&&igp[2]&&igp[3]) return;
+    }
 }
-/* sbas ionospheric delay correction -------------------------------------------
-* compute sbas ionosphric delay correction
-* args   : gtime_t  time    I   time
-*          nav_t    *nav    I   navigation data
-*          double   *pos    I   receiver position {lat,lon,height} (rad/m)
-*          double   *azel   I   satellite azimuth/elavation angle (rad)
-*          double   *delay  O   slant ionospheric delay (L1) (m)
-*          double   *var    O   variance of ionospheric delay (m^2)
-* return : status (1:ok, 0:no correction)
-* notes  : before calling the function, sbas ionosphere correction parameters
-*          in navigation data (nav->sbsion) must be set by callig 
-*          sbsupdatecorr()
-*-----------------------------------------------------------------------------*/
-extern int sbsioncorr(gtime_t time, const nav_t *nav, const double *pos,
-                      const double *azel, double *delay, double *var)
+/* sbas ionospheric delay correction at ipp ---------------------------------*/
+static int ioncorr(gtime_t time, const nav_t *nav, const double *pos,
+                   const double *azel, double *delay, double *var)
 {
     const double re=6378.1363,hion=350.0;
     int i,err=0;
     double fp,posp[2],x=0.0,y=0.0,t,w[4]={0};
     const sbsigp_t *igp[4]={0}; /* {ws,wn,es,en} */
     
-    trace(4,"sbsioncorr: pos=%.3f %.3f azel=%.3f %.3f\n",pos[0]*R2D,pos[1]*R2D,
-          azel[0]*R2D,azel[1]*R2D);
-    
     *delay=*var=0.0;
     if (pos[2]<-100.0||azel[1]<=0) return 1;
     
@@ -680,7 +705,7 @@ extern int sbsioncorr(gtime_t time, const nav_t *nav, const double *pos,
     fp=ionppp(pos,azel,re,hion,posp);
     
     /* search igps around ipp */
-    searchigp(time,posp,nav->sbsion,igp,&x,&y);
+    searchigp(time,posp,nav->sbsion,&nav->sbsigpidx,igp,&x,&y);
     
     /* weight of igps */
     if (igp[0]&&igp[1]&&igp[2]&&igp[3]) {
@@ -716,9 +741,33 @@ extern int sbsioncorr(gtime_t time, const nav_t *nav, const double *pos,
         *var+=w[i]*varicorr(igp[i]->give)*9E-8*fabs(t);
     }
     *delay*=fp; *var*=fp*fp;
+    return 1;
+}
+/* sbas ionospheric delay correction -------------------------------------------
+* compute sbas ionosphric delay correction
+* args   : gtime_t  time    I   time
+*          nav_t    *nav    I   navigation data
+*          double   *pos    I   receiver position {lat,lon,height} (rad/m)
+*          double   *azel   I   satellite azimuth/elavation angle (rad)
+*          double   *delay  O   slant ionospheric delay (L1) (m)
+*          double   *var    O   variance of ionospheric delay (m^2)
+* return : status (1:ok, 0:no correction)
+* notes  : before calling the function, sbas ionosphere correction parameters
+*          in navigation data (nav->sbsion) must be set by callig 
+*          sbsupdatecorr()
+*-----------------------------------------------------------------------------*/
+extern int sbsioncorr(gtime_t time, const nav_t *nav, const double *pos,
+                      const double *azel, double *delay, double *var)
+{
+    int stat;
+    
+    trace(4,"sbsioncorr: pos=%.3f %.3f azel=%.3f %.3f\n",pos[0]*R2D,pos[1]*R2D,
+          azel[0]*R2D,azel[1]*R2D);
+    
+    stat=ioncorr(time,nav,pos,azel,delay,var);
     
     trace(5,"sbsioncorr: dion=%7.2f sig=%7.2f\n",*delay,sqrt(*var));
-    return 1;
+    return stat;
 }
 /* get meterological parameters ----------------------------------------------*/
 static void getmet(double lat, double *met)
@@ -1,7 +1,6 @@
 #include "rtklib.h"
 #include "math.h"
 #include "stdio.h"
-#include "DBSCAN.h"
 #define SQR(x)      ((x)*(x))
 // threshold of cycle-slip
 #define THRES_SLIP  2.0             
@@ -16,44 +15,6 @@ char outpath[1024];
 FILE* fpSat;
 
 
-extern double permutation(int flag, const double *x0, const int nx0, const double ratio)
-{
-	int i, j, index, nx;
-	double help;
-	double *x = zeros(nx0, 1);
-
-	for (i = 0, nx = 0; i < nx0; i++){
-		if (fabs(x0[i])>1E-6){ x[nx++] = x0[i]; }
-	}
-	for (i = 0; i < nx; i++){
-		for (j = i + 1; j < nx; j++){
-			if (flag == 1){
-				if (x[i]>x[j]){
-					help = x[j];
-					x[j] = x[i];
-					x[i] = help;
-				}
-			}
-			else {
-				if (x[i] < x[j]){
-					help = x[i];
-					x[i] = x[j];
-					x[j] = help;
-				}
-			}
-		}
-	}
-	index = nx>0 ? (int)round(ratio*nx) - 1 : -1;
-	if (index >= 0){
-		return x[index];
-	}
-	else
-	{
-		return 0.0;
-	}
-}
-
-
 extern double median_t(double *data, int n){
 	double median, MAD, mean_t = 0.0;
 	double vv[MAXSAT];
@@ -82,19 +43,16 @@ extern double median_t(double *data, int n){
 }
 
 extern double median2_t(double *res, int npt){
-	vector<point> data;
+	double data[MAXSAT];
 	double mean_t = 0.0;
-	int i, j,n,nok=0;
-	for (i = 0; i < npt; i++){
+	int i, nok = 0;
+	for (i = 0; i < npt&&nok < MAXSAT; i++){
 		if (fabs(res[i]) < 1E-9)continue;
-		vector<float> xn;
-		xn.push_back(res[i]);	
-		//printf("%d: %lf\n", i,res[i]);
-		point p(xn, nok++);
-		data.push_back(p);
+		data[nok++] = res[i];
 	}
+	if (nok <= 0) return 0.0;
 
-	mean_t=DBSCAN(data, 1.5, (int)(nok*0.5));
+	mean_t = clustmean(data, nok, 1.5, (int)(nok*0.5));
 
 	for (i = 0; i < npt; i++)
 	{
@@ -30,6 +30,10 @@
 #define GMS         1.327124E+20    /* sun gravitational constant */
 #define GMM         4.902801E+12    /* moon gravitational constant */
 
+#define NPTGRID     4               /* number of points of grid interpolation */
+#define MAXTGRID    1000000         /* max number of tide grid epochs */
+#define MAXTGRIDDST 100.0           /* max distance to grid station (m) */
+
 /* function prototypes -------------------------------------------------------*/
 #ifdef IERS_MODEL
 extern int dehanttideinel_(double *xsta, int *year, int *mon, int *day,
@@ -286,3 +290,140 @@ extern void tidedisp(gtime_t tutc, const double *rr, int opt, const erp_t *erp,
     }
     trace(5,"tidedisp: dr=%.3f %.3f %.3f\n",dr[0],dr[1],dr[2]);
 }
+typedef struct {        /* tide displacement grid fill argument type */
+    const prcopt_t *opt; /* processing options */
+    const erp_t *erp;   /* earth rotation parameters */
+    tidegrid_t *tgrid;  /* tide displacement grid */
+} tgridarg_t;
+
+/* fill tide displacement grid at an epoch of a station ----------------------*/
+static void tgrid_fill(int i, void *arg)
+{
+    tgridarg_t *a=(tgridarg_t *)arg;
+    const tidegrid_t *tgrid=a->tgrid;
+    gtime_t tutc;
+    int k=i%tgrid->n,j=i/tgrid->n;
+    
+    if (!tgrid->opt[j]) return;
+    
+    tutc=timeadd(tgrid->ts,k*tgrid->tint);
+    tidedisp(tutc,tgrid->rr[j],tgrid->opt[j],a->erp,a->opt->odisp[j],
+             tgrid->dr+i*3);
+}
+/* generate tide displacement grid ---------------------------------------------
+* precompute tidal displacements of rover and base stations on a regular time
+* grid covering a processing session
+* args   : prcopt_t *opt    I   processing options (odisp,nthread)
+*          gtime_t ts       I   session start time (utc)
+*          gtime_t te       I   session end time (utc)
+*          double tint      I   grid interval (s)
+*          double *rr       I   station positions (ecef) (m) {rover,base}
+*                               (zero: station not gridded)
+*          int    *tideopt  I   tidedisp() options of stations {rover,base}
+*                               (0: station not gridded)
+*          erp_t  *erp      I   earth rotation parameters (NULL: not used)
+* return : tide displacement grid (NULL: error)
+* notes  : grid epochs are aligned to integer multiples of tint and padded for
+*          the interpolation stencil at both ends.
+*          grid epochs are filled in parallel by opt->nthread threads.
+*          the grid must be released by tidegrid_free()
+*-----------------------------------------------------------------------------*/
+extern tidegrid_t *tidegrid_new(const prcopt_t *opt, gtime_t ts, gtime_t te,
+                                double tint, const double *rr,
+                                const int *tideopt, const erp_t *erp)
+{
+    tidegrid_t *tgrid;
+    tgridarg_t arg;
+    double tow;
+    int i,j,week,n;
+    
+    trace(3,"tidegrid_new: ts=%s tint=%.0f\n",time_str(ts,0),tint);
+    
+    if (tint<=0.0) return NULL;
+    
+    tow=time2gpst(ts,&week);
+    ts=gpst2time(week,(floor(tow/tint)-NPTGRID/2)*tint);
+    n=(int)ceil(timediff(te,ts)/tint)+NPTGRID/2+2;
+    
+    if (n<=NPTGRID||n>MAXTGRID) {
+        trace(2,"tidegrid_new: invalid grid epochs n=%d\n",n);
+        return NULL;
+    }
+    if (!(tgrid=(tidegrid_t *)malloc(sizeof(tidegrid_t)))||
+        !(tgrid->dr=(double *)calloc(3*2*n,sizeof(double)))) {
+        trace(1,"tidegrid_new: malloc error n=%d\n",n);
+        free(tgrid);
+        return NULL;
+    }
+    tgrid->ts=ts;
+    tgrid->tint=tint;
+    tgrid->n=n;
+    for (i=0;i<2;i++) {
+        for (j=0;j<3;j++) tgrid->rr[i][j]=rr[j+i*3];
+        tgrid->opt[i]=norm(rr+i*3,3)>0.0?tideopt[i]:0;
+    }
+    arg.opt=opt;
+    arg.erp=erp;
+    arg.tgrid=tgrid;
+    
+    parfor(2*n,opt->nthread,tgrid_fill,&arg);
+    
+    return tgrid;
+}
+/* free tide displacement grid -------------------------------------------------
+* free tide displacement grid generated by tidegrid_new()
+* args   : tidegrid_t *tgrid I  tide displacement grid (NULL: no operation)
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void tidegrid_free(tidegrid_t *tgrid)
+{
+    if (!tgrid) return;
+    free(tgrid->dr);
+    free(tgrid);
+}
+/* tidal displacement by tide displacement grid --------------------------------
+* interpolate tidal displacement of a station on tide displacement grid
+* args   : tidegrid_t *tgrid I  tide displacement grid
+*          int    sta       I   station (0:rover,1:base)
+*          gtime_t tutc     I   time in utc
+*          double *rr       I   site position (ecef) (m)
+*          int    opt       I   tidedisp() options
+*          double *dr       O   displacement by earth tides (ecef) (m)
+* return : status (1:ok,0:out of grid or not interpolatable)
+* notes  : displacements are interpolated by NPTGRID points polynomial. the
+*          interpolation fails if the options differ from the grid ones or the
+*          site is more than MAXTGRIDDST apart from the grid station, so the
+*          caller should compute the displacement by tidedisp()
+*-----------------------------------------------------------------------------*/
+extern int tidegrid_disp(const tidegrid_t *tgrid, int sta, gtime_t tutc,
+                         const double *rr, int opt, double *dr)
+{
+    const double *d;
+    double tt,t[NPTGRID],p[NPTGRID],drr[3];
+    int i,j,k,i0;
+    
+    if (!tgrid||sta<0||sta>1||!opt||tgrid->opt[sta]!=opt) return 0;
+    
+    for (j=0;j<3;j++) drr[j]=rr[j]-tgrid->rr[sta][j];
+    if (norm(drr,3)>MAXTGRIDDST) return 0;
+    
+    tt=timediff(tutc,tgrid->ts)/tgrid->tint;
+    k=(int)floor(tt);
+    i0=k-NPTGRID/2+1;
+    
+    if (i0<0||i0+NPTGRID>tgrid->n) return 0;
+    
+    d=tgrid->dr+(sta*tgrid->n+i0)*3;
+    
+    for (i=0;i<NPTGRID;i++) t[i]=(i0+i-tt)*tgrid->tint;
+    for (j=0;j<3;j++) {
+        for (i=0;i<NPTGRID;i++) p[i]=d[j+i*3];
+        
+        /* polynomial interpolation by Neville's algorithm */
+        for (k=1;k<NPTGRID;k++) for (i=0;i<NPTGRID-k;i++) {
+            p[i]=(t[i+k]*p[i]-t[i]*p[i+1])/(t[i+k]-t[i]);
+        }
+        dr[j]=p[0];
+    }
+    return 1;
+}
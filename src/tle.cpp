@@ -39,20 +39,23 @@
 #define QOMS2T      1.88027916E-9       /* = pow((QO-SO)*AE/XKMPER,4.0) */
 #define S           1.01222928          /* = AE*(1.0+SO/XKMPER) */
 
-static void SGP4_STR3(double tsince, const tled_t *data, double *rs)
+typedef struct {        /* SGP4 propagator constants type */
+    double xnodeo,omegao,xmo,eo,xincl,bstar;
+    double cosio,sinio,x3thm1,x1mth2,x7thm1,xnodp,aodp,eta,delmo,sinmo;
+    double c1,c4,c5,xmdot,omgdot,xnodot,omgcof,xmcof,xnodcf,t2cof,xlcof,aycof;
+    double d2,d3,d4,t3cof,t4cof,t5cof;
+    int isimp;
+} sgp4_t;
+
+/* initialize SGP4 propagator with TLE data ----------------------------------*/
+static void SGP4_init(const tled_t *data, sgp4_t *c)
 {
-    double xnodeo,omegao,xmo,eo,xincl,xno,xndt2o,xndd6o,bstar;
+    double xnodeo,omegao,xmo,eo,xincl,xno,bstar;
     double a1,cosio,theta2,x3thm1,eosq,betao2,betao,del1,ao,delo,xnodp,aodp,s4;
     double qoms24,perige,pinvsq,tsi,eta,etasq,eeta,psisq,coef,coef1,c1,c2,c3,c4;
     double c5,sinio,a3ovk2,x1mth2,theta4,xmdot,x1m5th,omgdot,xhdot1,xnodot;
-    double omgcof,xmcof,xnodcf,t2cof,xlcof,aycof,delmo,sinmo,x7thm1,c1sq,d2,d3;
-    double d4,t3cof,t4cof,t5cof,xmdf,omgadf,xnoddf,omega,xmp,tsq,xnode,delomg;
-    double delm,tcube,tfour,a,e,xl,beta,xn,axn,xll,aynl,xlt,ayn,capu,sinepw;
-    double cosepw,epw,ecose,esine,elsq,pl,r,rdot,rfdot,betal,cosu,sinu,u,sin2u;
-    double cos2u,rk,uk,xnodek,xinck,rdotk,rfdotk,sinuk,cosuk,sinik,cosik,sinnok;
-    double cosnok,xmx,xmy,ux,uy,uz,vx,vy,vz,x,y,z,xdot,ydot,zdot;
-    double temp,temp1,temp2,temp3,temp4,temp5,temp6,tempa,tempe,templ;
-    int i,isimp;
+    double c1sq,d2,d3,d4,temp,temp1,temp2,temp3;
+    int isimp;
     
     xnodeo=data->OMG*DE2RA;
     omegao=data->omg*DE2RA;
@@ -60,8 +63,6 @@ static void SGP4_STR3(double tsince, const tled_t *data, double *rs)
     xincl=data->inc*DE2RA;
     temp=TWOPI/XMNPDA/XMNPDA;
     xno=data->n*temp*XMNPDA;
-    xndt2o=data->ndot*temp;
-    xndd6o=data->nddot*temp/XMNPDA;
     bstar=data->bstar/AE;
     eo=data->ecc;
     /*
@@ -133,15 +134,15 @@ static void SGP4_STR3(double tsince, const tled_t *data, double *rs)
     xhdot1=-temp1*cosio;
     xnodot=xhdot1+(0.5*temp2*(4.0-19.0*theta2)+2.0*temp3*(3.0-
             7.0*theta2))*cosio;
-    omgcof=bstar*c3*cos(omegao);
-    xmcof=-TOTHRD*coef*bstar*AE/eeta;
-    xnodcf=3.5*betao2*xhdot1*c1;
-    t2cof=1.5*c1;
-    xlcof=0.125*a3ovk2*sinio*(3.0+5.0*cosio)/(1.0+cosio);
-    aycof=0.25*a3ovk2*sinio;
-    delmo=pow(1.0+eta*cos(xmo),3.0);
-    sinmo=sin(xmo);
-    x7thm1=7.0*theta2-1.0;
+    c->omgcof=bstar*c3*cos(omegao);
+    c->xmcof=-TOTHRD*coef*bstar*AE/eeta;
+    c->xnodcf=3.5*betao2*xhdot1*c1;
+    c->t2cof=1.5*c1;
+    c->xlcof=0.125*a3ovk2*sinio*(3.0+5.0*cosio)/(1.0+cosio);
+    c->aycof=0.25*a3ovk2*sinio;
+    c->delmo=pow(1.0+eta*cos(xmo),3.0);
+    c->sinmo=sin(xmo);
+    c->x7thm1=7.0*theta2-1.0;
     
     if (isimp!=1) {
         c1sq=c1*c1;
@@ -149,47 +150,64 @@ static void SGP4_STR3(double tsince, const tled_t *data, double *rs)
         temp=d2*tsi*c1/3.0;
         d3=(17.0*aodp+s4)*temp;
         d4=0.5*temp*aodp*tsi*(221.0*aodp+31.0*s4)*c1;
-        t3cof=d2+2.0*c1sq;
-        t4cof=0.25*(3.0*d3+c1*(12.0*d2+10.0*c1sq));
-        t5cof=0.2*(3.0*d4+12.0*c1*d3+6.0*d2*d2+15.0*c1sq*(2.0*d2+c1sq));
+        c->t3cof=d2+2.0*c1sq;
+        c->t4cof=0.25*(3.0*d3+c1*(12.0*d2+10.0*c1sq));
+        c->t5cof=0.2*(3.0*d4+12.0*c1*d3+6.0*d2*d2+15.0*c1sq*(2.0*d2+c1sq));
     }
     else {
-        d2=d3=d4=t3cof=t4cof=t5cof=0.0;
+        d2=d3=d4=c->t3cof=c->t4cof=c->t5cof=0.0;
     }
+    c->xnodeo=xnodeo; c->omegao=omegao; c->xmo=xmo; c->eo=eo; c->xincl=xincl;
+    c->bstar=bstar; c->cosio=cosio; c->sinio=sinio; c->x3thm1=x3thm1;
+    c->x1mth2=x1mth2; c->xnodp=xnodp; c->aodp=aodp; c->eta=eta;
+    c->c1=c1; c->c4=c4; c->c5=c5; c->xmdot=xmdot; c->omgdot=omgdot;
+    c->xnodot=xnodot; c->d2=d2; c->d3=d3; c->d4=d4; c->isimp=isimp;
+}
+/* SGP4 model propagation with initialized constants -------------------------*/
+static void SGP4_prop(double tsince, const sgp4_t *c, double *rs)
+{
+    double xmdf,omgadf,xnoddf,omega,xmp,tsq,xnode,delomg;
+    double delm,tcube,tfour,a,e,xl,beta,xn,axn,xll,aynl,xlt,ayn,capu,sinepw;
+    double cosepw,epw,ecose,esine,elsq,pl,r,rdot,rfdot,betal,cosu,sinu,u,sin2u;
+    double cos2u,rk,uk,xnodek,xinck,rdotk,rfdotk,sinuk,cosuk,sinik,cosik,sinnok;
+    double cosnok,xmx,xmy,ux,uy,uz,vx,vy,vz,x,y,z,xdot,ydot,zdot;
+    double temp,temp1,temp2,temp3,temp4,temp5,temp6,tempa,tempe,templ;
+    int i;
+    
     /* update for secular gravity and atmospheric drag */
-    xmdf=xmo+xmdot*tsince;
-    omgadf=omegao+omgdot*tsince;
-    xnoddf=xnodeo+xnodot*tsince;
+    xmdf=c->xmo+c->xmdot*tsince;
+    omgadf=c->omegao+c->omgdot*tsince;
+    xnoddf=c->xnodeo+c->xnodot*tsince;
     omega=omgadf;
     xmp=xmdf;
     tsq=tsince*tsince;
-    xnode=xnoddf+xnodcf*tsq;
-    tempa=1.0-c1*tsince;
-    tempe=bstar*c4*tsince;
-    templ=t2cof*tsq;
-    if (isimp==1) {
-        delomg=omgcof*tsince;
-        delm=xmcof*(pow(1.0+eta*cos(xmdf),3.0)-delmo);
+    xnode=xnoddf+c->xnodcf*tsq;
+    tempa=1.0-c->c1*tsince;
+    tempe=c->bstar*c->c4*tsince;
+    templ=c->t2cof*tsq;
+    if (c->isimp==1) {
+        delomg=c->omgcof*tsince;
+        delm=c->xmcof*(pow(1.0+c->eta*cos(xmdf),3.0)-c->delmo);
         temp=delomg+delm;
         xmp=xmdf+temp;
         omega=omgadf-temp;
         tcube=tsq*tsince;
         tfour=tsince*tcube;
-        tempa=tempa-d2*tsq-d3*tcube-d4*tfour;
-        tempe=tempe+bstar*c5*(sin(xmp)-sinmo);
-        templ=templ+t3cof*tcube+tfour*(t4cof+tsince*t5cof);
+        tempa=tempa-c->d2*tsq-c->d3*tcube-c->d4*tfour;
+        tempe=tempe+c->bstar*c->c5*(sin(xmp)-c->sinmo);
+        templ=templ+c->t3cof*tcube+tfour*(c->t4cof+tsince*c->t5cof);
     }
-    a=aodp*pow(tempa,2.0);
-    e=eo-tempe;
-    xl=xmp+omega+xnode+xnodp*templ;
+    a=c->aodp*pow(tempa,2.0);
+    e=c->eo-tempe;
+    xl=xmp+omega+xnode+c->xnodp*templ;
     beta=sqrt(1.0-e*e);
     xn=XKE/pow(a,1.5);
     
     /* long period periodics */
     axn=e*cos(omega);
     temp=1.0/(a*beta*beta);
-    xll=temp*xlcof*axn;
-    aynl=temp*aycof;
+    xll=temp*c->xlcof*axn;
+    aynl=temp*c->aycof;
     xlt=xl+xll;
     ayn=e*sin(omega)+aynl;
     
@@ -230,12 +248,12 @@ static void SGP4_STR3(double tsince, const tled_t *data, double *rs)
     temp2=temp1*temp;
     
     /* update for short periodics */
-    rk=r*(1.0-1.5*temp2*betal*x3thm1)+0.5*temp1*x1mth2*cos2u;
-    uk=u-0.25*temp2*x7thm1*sin2u;
-    xnodek=xnode+1.5*temp2*cosio*sin2u;
-    xinck=xincl+1.5*temp2*cosio*sinio*cos2u;
-    rdotk=rdot-xn*temp1*x1mth2*sin2u;
-    rfdotk=rfdot+xn*temp1*(x1mth2*cos2u+1.5*x3thm1);
+    rk=r*(1.0-1.5*temp2*betal*c->x3thm1)+0.5*temp1*c->x1mth2*cos2u;
+    uk=u-0.25*temp2*c->x7thm1*sin2u;
+    xnodek=xnode+1.5*temp2*c->cosio*sin2u;
+    xinck=c->xincl+1.5*temp2*c->cosio*c->sinio*cos2u;
+    rdotk=rdot-xn*temp1*c->x1mth2*sin2u;
+    rfdotk=rfdot+xn*temp1*(c->x1mth2*cos2u+1.5*c->x3thm1);
     
     /* orientation vectors */
     sinuk=sin(uk);
@@ -268,6 +286,14 @@ static void SGP4_STR3(double tsince, const tled_t *data, double *rs)
     rs[4]=ydot*XKMPER/AE*XMNPDA/86400.0*1E3;
     rs[5]=zdot*XKMPER/AE*XMNPDA/86400.0*1E3;
 }
+/* SGP4 model propagator by STR#3 (ref [1] sec.6,11) -------------------------*/
+static void SGP4_STR3(double tsince, const tled_t *data, double *rs)
+{
+    sgp4_t c;
+    
+    SGP4_init(data,&c);
+    SGP4_prop(tsince,&c,rs);
+}
 /* drop spaces at string tail ------------------------------------------------*/
 static void chop(char *buff)
 {
@@ -374,6 +400,47 @@ static int cmp_tle_data(const void *p1, const void *p2)
     const tled_t *q1=(const tled_t *)p1,*q2=(const tled_t *)p2;
     return strcmp(q1->name,q2->name);
 }
+/* compare TLE index by key and data index -----------------------------------*/
+static int cmp_tle_idx(const void *p1, const void *p2)
+{
+    const tleidx_t *q1=(const tleidx_t *)p1,*q2=(const tleidx_t *)p2;
+    int stat=strcmp(q1->key,q2->key);
+    return stat?stat:q1->i-q2->i;
+}
+/* generate TLE index by catalog number and international designator ---------*/
+static int tle_index(tle_t *tle)
+{
+    tleidx_t *idx;
+    int i,n=tle->n>0?tle->n:1;
+    
+    if (!(idx=(tleidx_t *)realloc(tle->isatno,sizeof(tleidx_t)*n*2))) {
+        trace(1,"tle index malloc error\n");
+        free(tle->isatno); tle->isatno=tle->idesig=NULL;
+        return 0;
+    }
+    tle->isatno=idx;
+    tle->idesig=idx+n;
+    
+    for (i=0;i<tle->n;i++) {
+        strcpy(tle->isatno[i].key,tle->data[i].satno);
+        strcpy(tle->idesig[i].key,tle->data[i].desig);
+        tle->isatno[i].i=tle->idesig[i].i=i;
+    }
+    qsort(tle->isatno,tle->n,sizeof(tleidx_t),cmp_tle_idx);
+    qsort(tle->idesig,tle->n,sizeof(tleidx_t),cmp_tle_idx);
+    return 1;
+}
+/* search TLE index (first data index with the key, -1: not found) -----------*/
+static int search_idx(const tleidx_t *idx, int n, const char *key)
+{
+    int i,j=0,k=n;
+    
+    while (j<k) { /* lower bound */
+        i=(j+k)/2;
+        if (strcmp(idx[i].key,key)<0) j=i+1; else k=i;
+    }
+    return j<n&&!strcmp(idx[j].key,key)?idx[j].i:-1;
+}
 /* read TLE file ---------------------------------------------------------------
 * read NORAD TLE (two line element) data file (ref [2],[3])
 * args   : char   *file     I   NORAD TLE data file
@@ -434,7 +501,9 @@ extern int tle_read(const char *file, tle_t *tle)
     
     /* sort tle data by satellite name */
     if (tle->n>0) qsort(tle->data,tle->n,sizeof(tled_t),cmp_tle_data);
-    return 1;
+    
+    /* index by catalog number and international designator */
+    return tle_index(tle);
 }
 /* read TLE satellite name file ------------------------------------------------
 * read TLE satellite name file
@@ -470,11 +539,7 @@ extern int tle_name_read(const char *file, tle_t *tle)
         if (sscanf(buff,"%s %s %s",name,satno,desig)<2) continue;
         satno[5]='\0';
         
-        for (i=0;i<tle->n;i++) {
-            if (!strcmp(tle->data[i].satno,satno)||
-                !strcmp(tle->data[i].desig,desig)) break;
-        }
-        if (i>=tle->n) {
+        if ((i=tle_find(tle,"",satno,desig))<0) {
             trace(4,"no tle data: satno=%s desig=%s\n",satno,desig);
             continue;
         }
@@ -485,28 +550,34 @@ extern int tle_name_read(const char *file, tle_t *tle)
     
     /* sort tle data by satellite name */
     if (tle->n>0) qsort(tle->data,tle->n,sizeof(tled_t),cmp_tle_data);
-    return 1;
+    
+    /* index by catalog number and international designator */
+    return tle_index(tle);
 }
-/* satellite position and velocity with TLE data -------------------------------
-* compute satellite position and velocity in ECEF with TLE data
-* args   : gtime_t time     I   time (GPST)
+/* free TLE data --------------------------------------------------------------
+* free TLE data and index
+* args   : tle_t  *tle      IO  TLE data
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void tle_free(tle_t *tle)
+{
+    free(tle->data); tle->data=NULL; tle->n=tle->nmax=0;
+    free(tle->isatno); tle->isatno=tle->idesig=NULL;
+}
+/* search TLE data -------------------------------------------------------------
+* search TLE data by satellite name, catalog number or international designator
+* args   : tle_t  *tle      I   TLE data
 *          char   *name     I   satellite name           ("": not specified)
 *          char   *satno    I   satellite catalog number ("": not specified)
 *          char   *desig    I   international designaor  ("": not specified)
-*          tle_t  *tle      I   TLE data
-*          erp_t  *erp      I   EOP data (NULL: not used)
-*          double *rs       O   sat position/velocity {x,y,z,vx,vy,vz} (m,m/s)
-* return : status (1:ok,0:error)
-* notes  : the coordinates of the position and velocity are ECEF (ITRF)
-*          if erp == NULL, polar motion and ut1-utc are neglected
+* return : index of TLE data (-1: not found)
+* notes  : the name is searched first. if not found, the first data matching
+*          the catalog number or the designator is returned. the index built
+*          by tle_read() or tle_name_read() is used if available.
 *-----------------------------------------------------------------------------*/
-extern int tle_pos(gtime_t time, const char *name, const char *satno,
-                   const char *desig, const tle_t *tle, const erp_t *erp,
-                   double *rs)
+extern int tle_find(const tle_t *tle, const char *name, const char *satno,
+                    const char *desig)
 {
-    gtime_t tutc;
-    double tsince,rs_tle[6],rs_pef[6],gmst;
-    double R1[9]={0},R2[9]={0},R3[9]={0},W[9],erpv[5]={0};
     int i=0,j,k,stat=1;
     
     /* binary search by satellite name */
@@ -517,42 +588,379 @@ extern int tle_pos(gtime_t time, const char *name, const char *satno,
             if (stat<0) k=i-1; else j=i+1;
         }
     }
-    /* serial search by catalog no or international designator */
-    if (stat&&(*satno||*desig)) {
-        for (i=0;i<tle->n;i++) {
-            if (!strcmp(tle->data[i].satno,satno)||
-                !strcmp(tle->data[i].desig,desig)) break;
-        }
-        if (i<tle->n) stat=0;
-    }
-    if (stat) {
-        trace(4,"no tle data: name=%s satno=%s desig=%s\n",name,satno,desig);
-        return 0;
-    }
-    tutc=gpst2utc(time);
+    if (!stat) return i;
     
-    /* time since epoch (min) */
-    tsince=timediff(tutc,tle->data[i].epoch)/60.0;
+    if (!*satno&&!*desig) return -1;
     
-    /* SGP4 model propagator by STR#3 */
-    SGP4_STR3(tsince,tle->data+i,rs_tle);
+    /* binary search by catalog no or international designator */
+    if (tle->isatno&&tle->idesig) {
+        j=search_idx(tle->isatno,tle->n,satno);
+        k=search_idx(tle->idesig,tle->n,desig);
+        return j<0?k:(k<0||j<k?j:k);
+    }
+    /* serial search by catalog no or international designator */
+    for (i=0;i<tle->n;i++) {
+        if (!strcmp(tle->data[i].satno,satno)||
+            !strcmp(tle->data[i].desig,desig)) return i;
+    }
+    return -1;
+}
+/* TEME to ECEF rotation matrices (ref [2] IID, Appendix C) ------------------*/
+static void teme2ecef(gtime_t time, const erp_t *erp, double *R3, double *W)
+{
+    double R1[9]={0},R2[9]={0},erpv[5]={0},gmst;
+    int i;
     
     /* erp values */
     if (erp) geterp(erp,time,erpv);
     
     /* GMST (rad) */
-    gmst=utc2gmst(tutc,erpv[2]);
+    gmst=utc2gmst(gpst2utc(time),erpv[2]);
     
-    /* TEME (true equator, mean eqinox) -> ECEF (ref [2] IID, Appendix C) */
+    for (i=0;i<9;i++) R3[i]=0.0;
     R1[0]=1.0; R1[4]=R1[8]=cos(-erpv[1]); R1[7]=sin(-erpv[1]); R1[5]=-R1[7];
     R2[4]=1.0; R2[0]=R2[8]=cos(-erpv[0]); R2[2]=sin(-erpv[0]); R2[6]=-R2[2];
     R3[8]=1.0; R3[0]=R3[4]=cos(gmst); R3[3]=sin(gmst); R3[1]=-R3[3];
-    matmul("NN",3,1,3,1.0,R3,rs_tle  ,0.0,rs_pef  );
-    matmul("NN",3,1,3,1.0,R3,rs_tle+3,0.0,rs_pef+3);
+    matmul("NN",3,3,3,1.0,R1,R2,0.0,W);
+}
+/* TEME (true equator, mean eqinox) -> ECEF position/velocity ----------------*/
+static void rot_teme(const double *R3, const double *W, const double *rs_tle,
+                     double *rs)
+{
+    double rs_pef[6];
+    int i;
+    
+    for (i=0;i<3;i++) {
+        rs_pef[i  ]=R3[i]*rs_tle[0]+R3[i+3]*rs_tle[1]+R3[i+6]*rs_tle[2];
+        rs_pef[i+3]=R3[i]*rs_tle[3]+R3[i+3]*rs_tle[4]+R3[i+6]*rs_tle[5];
+    }
     rs_pef[3]+=OMGE*rs_pef[1];
     rs_pef[4]-=OMGE*rs_pef[0];
-    matmul("NN",3,3,3,1.0,R1,R2,0.0,W);
-    matmul("NN",3,1,3,1.0,W,rs_pef  ,0.0,rs  );
-    matmul("NN",3,1,3,1.0,W,rs_pef+3,0.0,rs+3);
+    for (i=0;i<3;i++) {
+        rs[i  ]=W[i]*rs_pef[0]+W[i+3]*rs_pef[1]+W[i+6]*rs_pef[2];
+        rs[i+3]=W[i]*rs_pef[3]+W[i+3]*rs_pef[4]+W[i+6]*rs_pef[5];
+    }
+}
+/* satellite position and velocity with TLE data -------------------------------
+* compute satellite position and velocity in ECEF with TLE data
+* args   : gtime_t time     I   time (GPST)
+*          char   *name     I   satellite name           ("": not specified)
+*          char   *satno    I   satellite catalog number ("": not specified)
+*          char   *desig    I   international designaor  ("": not specified)
+*          tle_t  *tle      I   TLE data
+*          erp_t  *erp      I   EOP data (NULL: not used)
+*          double *rs       O   sat position/velocity {x,y,z,vx,vy,vz} (m,m/s)
+* return : status (1:ok,0:error)
+* notes  : the coordinates of the position and velocity are ECEF (ITRF)
+*          if erp == NULL, polar motion and ut1-utc are neglected
+*-----------------------------------------------------------------------------*/
+extern int tle_pos(gtime_t time, const char *name, const char *satno,
+                   const char *desig, const tle_t *tle, const erp_t *erp,
+                   double *rs)
+{
+    double tsince,rs_tle[6],R3[9],W[9];
+    int i;
+    
+    if ((i=tle_find(tle,name,satno,desig))<0) {
+        trace(4,"no tle data: name=%s satno=%s desig=%s\n",name,satno,desig);
+        return 0;
+    }
+    /* time since epoch (min) */
+    tsince=timediff(gpst2utc(time),tle->data[i].epoch)/60.0;
+    
+    /* SGP4 model propagator by STR#3 */
+    SGP4_STR3(tsince,tle->data+i,rs_tle);
+    
+    /* TEME -> ECEF */
+    teme2ecef(time,erp,R3,W);
+    rot_teme(R3,W,rs_tle,rs);
+    return 1;
+}
+/* batch propagation -----------------------------------------------------------*/
+typedef struct {        /* batch propagation argument type */
+    const tle_t *tle;   /* TLE data */
+    tlebat_t *bat;      /* batch propagation */
+    const gtime_t *tutc; /* epoch time (UTC) */
+    const double *R;    /* TEME to ECEF matrices {R3,W} of epochs */
+} tlebatarg_t;
+
+static void batch_sat(int i, void *arg)
+{
+    tlebatarg_t *a=(tlebatarg_t *)arg;
+    tlebat_t *bat=a->bat;
+    const tled_t *data=a->tle->data+bat->index[i];
+    sgp4_t c;
+    double tsince,rs_tle[6],rs[6];
+    int j,k;
+    
+    SGP4_init(data,&c);
+    
+    for (k=0;k<bat->nt;k++) {
+        
+        /* time since epoch (min) */
+        tsince=timediff(a->tutc[k],data->epoch)/60.0;
+        
+        SGP4_prop(tsince,&c,rs_tle);
+        rot_teme(a->R+k*18,a->R+k*18+9,rs_tle,rs);
+        for (j=0;j<6;j++) bat->rs[j][k+i*bat->nt]=rs[j];
+    }
+}
+/* batch propagation with TLE data ---------------------------------------------
+* compute positions and velocities of many satellites over a regular time grid
+* args   : tle_t  *tle      I   TLE data
+*          int    *index    I   TLE data indices of satellites (NULL: all data)
+*          int    ns        I   number of satellites (ignored if index==NULL)
+*          gtime_t ts       I   first epoch (GPST)
+*          double tint      I   epoch interval (s)
+*          int    nt        I   number of epochs
+*          erp_t  *erp      I   EOP data (NULL: not used)
+*          int    nthread   I   number of threads (0:number of cpus)
+*          tlebat_t *bat    O   batch propagation (struct of arrays)
+* return : status (1:ok,0:error)
+* notes  : TEME to ECEF rotation is computed once per epoch and the SGP4
+*          initialization once per satellite. satellites are propagated in
+*          parallel. release the batch by tle_batch_free()
+*-----------------------------------------------------------------------------*/
+extern int tle_batch(const tle_t *tle, const int *index, int ns, gtime_t ts,
+                     double tint, int nt, const erp_t *erp, int nthread,
+                     tlebat_t *bat)
+{
+    tlebatarg_t arg;
+    gtime_t time,*tutc=NULL;
+    double *R=NULL,*rs=NULL;
+    int i,j,k;
+    
+    trace(3,"tle_batch: ns=%d nt=%d tint=%.0f\n",ns,nt,tint);
+    
+    if (!index) ns=tle->n;
+    
+    bat->ns=bat->nt=0;
+    bat->index=NULL;
+    for (j=0;j<6;j++) bat->rs[j]=NULL;
+    
+    if (ns<=0||nt<=0) return 0;
+    
+    if (!(bat->index=imat(ns,1))||!(rs=mat(6*ns,nt))||
+        !(tutc=(gtime_t *)malloc(sizeof(gtime_t)*nt))||!(R=mat(18,nt))) {
+        trace(1,"tle_batch: malloc error ns=%d nt=%d\n",ns,nt);
+        matfree(bat->index); bat->index=NULL;
+        matfree(rs); free(tutc); matfree(R);
+        return 0;
+    }
+    for (i=0;i<ns;i++) {
+        if ((bat->index[i]=index?index[i]:i)<0||bat->index[i]>=tle->n) {
+            trace(2,"tle_batch: invalid index=%d\n",bat->index[i]);
+            matfree(bat->index); bat->index=NULL;
+            matfree(rs); free(tutc); matfree(R);
+            return 0;
+        }
+    }
+    bat->ns=ns;
+    bat->nt=nt;
+    bat->ts=ts;
+    bat->tint=tint;
+    for (j=0;j<6;j++) bat->rs[j]=rs+j*ns*nt;
+    
+    /* utc and TEME to ECEF rotation of epochs */
+    for (k=0;k<nt;k++) {
+        time=timeadd(ts,k*tint);
+        tutc[k]=gpst2utc(time);
+        teme2ecef(time,erp,R+k*18,R+k*18+9);
+    }
+    arg.tle=tle;
+    arg.bat=bat;
+    arg.tutc=tutc;
+    arg.R=R;
+    parfor(ns,nthread,batch_sat,&arg);
+    
+    free(tutc); matfree(R);
+    return 1;
+}
+/* free batch propagation ------------------------------------------------------
+* free batch propagation generated by tle_batch()
+* args   : tlebat_t *bat    IO  batch propagation
+* return : none
+*-----------------------------------------------------------------------------*/
+extern void tle_batch_free(tlebat_t *bat)
+{
+    int j;
+    
+    matfree(bat->index); bat->index=NULL;
+    matfree(bat->rs[0]);
+    for (j=0;j<6;j++) bat->rs[j]=NULL;
+    bat->ns=bat->nt=0;
+}
+/* satellite pass generation -------------------------------------------------*/
+typedef struct {        /* pass list of satellite type */
+    int n,nmax;         /* number/max number of passes */
+    int stat;           /* status (0:ok,-1:memory allocation error) */
+    tlepass_t *data;    /* passes */
+} passlist_t;
+
+typedef struct {        /* pass generation argument type */
+    const tlebat_t *bat; /* batch propagation */
+    const double *rr;   /* site positions (ecef) (m) */
+    const double *up;   /* site up unit vectors (ecef) */
+    int nsite;          /* number of sites */
+    double elmask;      /* elevation mask (rad) */
+    passlist_t *list;   /* pass lists of satellites */
+} passarg_t;
+
+static int add_pass(passlist_t *list, const tlepass_t *pass)
+{
+    tlepass_t *data;
+    
+    if (list->n>=list->nmax) {
+        list->nmax=list->nmax<=0?16:list->nmax*2;
+        if (!(data=(tlepass_t *)realloc(list->data,sizeof(tlepass_t)*list->nmax))) {
+            free(list->data); list->data=NULL; list->n=list->nmax=0;
+            return 0;
+        }
+        list->data=data;
+    }
+    list->data[list->n++]=*pass;
     return 1;
 }
+/* elevation angle of satellite at epoch -------------------------------------*/
+static double pass_el(const tlebat_t *bat, int i, int k, const double *rr,
+                      const double *up)
+{
+    double e[3],r;
+    int j;
+    
+    for (j=0;j<3;j++) e[j]=bat->rs[j][k+i*bat->nt]-rr[j];
+    if ((r=norm(e,3))<=0.0) return PI/2.0;
+    return asin(dot(e,up,3)/r);
+}
+static void pass_sat(int i, void *arg)
+{
+    passarg_t *a=(passarg_t *)arg;
+    const tlebat_t *bat=a->bat;
+    const double *rr,*up;
+    tlepass_t pass={0};
+    double el,elp=0.0,el0,el2,d,x;
+    int k,kmax=0,m,in;
+    
+    pass.sat=i;
+    
+    for (m=0;m<a->nsite;m++) {
+        pass.site=m;
+        rr=a->rr+m*3;
+        up=a->up+m*3;
+        
+        for (k=in=0;k<bat->nt;k++,elp=el) {
+            el=pass_el(bat,i,k,rr,up);
+            
+            if (el>=a->elmask) {
+                if (!in) { /* rise */
+                    x=k>0?(a->elmask-elp)/(el-elp):1.0;
+                    pass.ts=timeadd(bat->ts,(k-1+x)*bat->tint);
+                    pass.elmax=el; kmax=k; in=1;
+                }
+                else if (el>pass.elmax) {
+                    pass.elmax=el; kmax=k;
+                }
+                if (k<bat->nt-1) continue;
+                pass.te=timeadd(bat->ts,k*bat->tint);
+            }
+            else if (in) { /* set */
+                x=(a->elmask-elp)/(el-elp);
+                pass.te=timeadd(bat->ts,(k-1+x)*bat->tint);
+            }
+            else continue;
+            
+            in=0;
+            
+            /* max elevation by parabolic fit */
+            pass.tmax=timeadd(bat->ts,kmax*bat->tint);
+            if (kmax>0&&kmax<bat->nt-1) {
+                el0=pass_el(bat,i,kmax-1,rr,up);
+                el2=pass_el(bat,i,kmax+1,rr,up);
+                if ((d=el0-2.0*pass.elmax+el2)<0.0) {
+                    x=0.5*(el0-el2)/d;
+                    pass.tmax=timeadd(pass.tmax,x*bat->tint);
+                    pass.elmax-=0.25*(el0-el2)*x;
+                }
+            }
+            if (!add_pass(a->list+i,&pass)) {
+                a->list[i].stat=-1;
+                return;
+            }
+        }
+    }
+}
+/* compare passes by rise time -----------------------------------------------*/
+static int cmp_pass(const void *p1, const void *p2)
+{
+    const tlepass_t *q1=(const tlepass_t *)p1,*q2=(const tlepass_t *)p2;
+    double tt=timediff(q1->ts,q2->ts);
+    if (tt!=0.0) return tt<0.0?-1:1;
+    return q1->site!=q2->site?q1->site-q2->site:q1->sat-q2->sat;
+}
+/* generate satellite passes ---------------------------------------------------
+* generate visibility passes of satellites over ground sites
+* args   : tlebat_t *bat    I   batch propagation by tle_batch()
+*          double *pos      I   site positions {lat,lon,h} (rad,m) (3 x nsite)
+*          int    nsite     I   number of sites
+*          double elmask    I   elevation mask (rad)
+*          int    nthread   I   number of threads (0:number of cpus)
+*          tlepass_t **pass O   passes sorted by rise time (allocated)
+* return : number of passes (-1: error)
+* notes  : rise and set times are linearly interpolated between epochs and the
+*          max elevation is refined by a parabolic fit. passes in progress at
+*          the first or last epoch are truncated at the epoch.
+*          release the passes by free()
+*-----------------------------------------------------------------------------*/
+extern int tle_pass(const tlebat_t *bat, const double *pos, int nsite,
+                    double elmask, int nthread, tlepass_t **pass)
+{
+    passarg_t arg;
+    passlist_t *list;
+    double *rr=NULL,*up=NULL;
+    int i,j,n=0;
+    
+    trace(3,"tle_pass: ns=%d nsite=%d elmask=%.1f\n",bat->ns,nsite,elmask*R2D);
+    
+    *pass=NULL;
+    
+    if (bat->ns<=0||nsite<=0) return 0;
+    
+    if (!(list=(passlist_t *)calloc(bat->ns,sizeof(passlist_t)))||
+        !(rr=mat(3,nsite))||!(up=mat(3,nsite))) {
+        free(list); matfree(rr);
+        return -1;
+    }
+    for (i=0;i<nsite;i++) {
+        pos2ecef(pos+i*3,rr+i*3);
+        up[  i*3]=cos(pos[i*3])*cos(pos[1+i*3]);
+        up[1+i*3]=cos(pos[i*3])*sin(pos[1+i*3]);
+        up[2+i*3]=sin(pos[i*3]);
+    }
+    arg.bat=bat;
+    arg.rr=rr;
+    arg.up=up;
+    arg.nsite=nsite;
+    arg.elmask=elmask;
+    arg.list=list;
+    parfor(bat->ns,nthread,pass_sat,&arg);
+    
+    for (i=0;i<bat->ns;i++) {
+        if (list[i].stat) {
+            trace(2,"tle_pass: memory allocation error sat=%d\n",i);
+            n=-1;
+            break;
+        }
+        n+=list[i].n;
+    }
+    if (n>0&&(*pass=(tlepass_t *)malloc(sizeof(tlepass_t)*n))) {
+        for (i=n=0;i<bat->ns;i++) for (j=0;j<list[i].n;j++) {
+            (*pass)[n++]=list[i].data[j];
+        }
+        qsort(*pass,n,sizeof(tlepass_t),cmp_pass);
+    }
+    else if (n>0) n=-1;
+    
+    for (i=0;i<bat->ns;i++) free(list[i].data);
+    free(list); matfree(rr); matfree(up);
+    return n;
+}